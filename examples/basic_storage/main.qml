@@ -49,7 +49,7 @@ Window {
         property int dataCount: 10 * 256
 
         computeShader: ":/shaders/computeshader.comp.qsb"
-        dispatchX: computeItem.dataCount / 256
+        globalSizeX: computeItem.dataCount
 
         buffers: [
             StorageBuffer {
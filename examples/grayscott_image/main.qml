@@ -16,6 +16,7 @@ Window {
     property int contentWidth: 1024
     property real stretch: 1.0 / 2.0
     property size simulationSize: Qt.size(window.contentWidth * window.stretch, window.height * window.stretch)
+    property real centerPointSize: 10.0
 
     width: window.contentWidth + window.controlPanelWidth
     height: 1024
@@ -29,50 +30,16 @@ Window {
         timer.running = false;
         computeItem.timestep = 0;
 
-        const pixels = simulationSize.width * simulationSize.height;
-        const bufferSize = 16 * pixels; // 16 bytes per pixel (rgba, one 4 byte float per channel)
-
-        const centerPointSize = 10.0;
-        const left = (simulationSize.width - centerPointSize) / 2.0;
-        const right = (simulationSize.width + centerPointSize) / 2.0;
-        const top = (simulationSize.height - centerPointSize) / 2.0;
-        const bottom = (simulationSize.height + centerPointSize) / 2.0;
-
-        let buffer = new ArrayBuffer(bufferSize);
-        let view = new Float32Array(buffer);
-        let i = 0;
-        let coordXY = 0;
-        while(i < bufferSize) {
-
-            let xCoord = coordXY % simulationSize.width;
-            let yCoord = Math.floor(coordXY / simulationSize.width);
-
-            if (window.inCenterPoint(xCoord, yCoord, left, right, top, bottom)) {
-                view[i + 0] = 1.0; // u material
-                view[i + 1] = 1.0; // v material
-            } else {
-                view[i + 0] = 1.0; // u material
-                view[i + 1] = 0.0; // v material
-            }
-
-
-            view[i + 2] = 0.0; // unused
-            view[i + 3] = 1.0; // unused
-
-            i += 4;
-            coordXY++;
-        }
-        imageBufferA.buffer = buffer;
-
-        // buffer b
-        const bufferBSize = 16 * simulationSize.width * simulationSize.height; // same as StorageBufferA
-        let bufferB = new ArrayBuffer(bufferBSize);
-        imageBufferB.buffer = bufferB;
+        // the images get the current simulation size, e.g. after a window resize; resize() does
+        // nothing if the size did not change
+        imageBufferA.resize(simulationSize, false);
+        imageBufferB.resize(simulationSize, false);
+        result.resize(simulationSize, false);
 
-        // result buffer
-        const resultBufferSize = 4 * simulationSize.width * simulationSize.height; // 4 bytes per pixel
-        let resultBuffer = new ArrayBuffer(resultBufferSize);
-        result.buffer = resultBuffer;
+        // refilled on the GPU by the initializers of the images
+        imageBufferA.reset();
+        imageBufferB.reset();
+        result.reset();
 
         computeItem.compute();
         timer.running = true;
@@ -82,16 +49,12 @@ Window {
         return Math.floor(Math.random() * max);
     }
 
-    function inCenterPoint(x, y, left, right, top, bottom) {
-        return (x >= left && x <= right && y >= top && y <= bottom);
-    }
-
     ComputeItem {
         id: computeItem
         computeShader: ":/shaders/computeshader.comp.qsb"
 
-        dispatchX: simulationSize.width / 32
-        dispatchY: simulationSize.height / 32
+        globalSizeX: simulationSize.width
+        globalSizeY: simulationSize.height
 
         property real du: duRate.value
         property real dv: dvRate.value
@@ -106,21 +69,29 @@ Window {
         property real mouseY: -5.0
 
 
+        // sized in restart()
         buffers: [
             ImageBuffer {
                 id: imageBufferA
-                imageSize: simulationSize
                 textureFormat: ImageBuffer.RGBA32F
+                // u material everywhere, v material in a square in the center
+                initializers: BufferInitializer {
+                    fill: BufferInitializer.Rectangle
+                    rect: Qt.rect((simulationSize.width - window.centerPointSize) / 2, (simulationSize.height - window.centerPointSize) / 2,
+                                  window.centerPointSize + 1, window.centerPointSize + 1)
+                    value: Qt.vector4d(1.0, 1.0, 0.0, 1.0)
+                    background: Qt.vector4d(1.0, 0.0, 0.0, 1.0)
+                }
             },
             ImageBuffer {
                 id: imageBufferB
-                imageSize: simulationSize
                 textureFormat: ImageBuffer.RGBA32F
+                initializers: BufferInitializer {}
             },
             ImageBuffer {
                 id: result
-                imageSize: simulationSize
                 textureFormat: ImageBuffer.RGBA8
+                initializers: BufferInitializer {}
             }
         ]
 
@@ -319,15 +290,20 @@ Window {
             width: window.contentWidth
             computeItem: computeItem
             resultBuffer: result
+            // stays visible as the source of the effect, so that the computation is not paused
+            // as hidden; only its own drawing is switched off
+            opacity: postprocessingCheckBox.checked ? 0.0 : 1.0
+        }
 
-            layer.enabled: postprocessingCheckBox.checked
-            layer.samplerName: "source"
-            layer.effect: ShaderEffect {
-                property real contentWidth: imageBufferView.width
-                property real contentHeight: imageBufferView.height
-                fragmentShader: "shaders/postprocessing.frag.qsb"
-            }
+        ShaderEffect {
+            anchors.fill: imageBufferView
+            visible: postprocessingCheckBox.checked
 
+            // samples the compute result directly, no intermediate layer texture
+            property var source: imageBufferView
+            property real contentWidth: window.simulationSize.width
+            property real contentHeight: window.simulationSize.height
+            fragmentShader: "shaders/postprocessing.frag.qsb"
         }
 
         MouseArea {
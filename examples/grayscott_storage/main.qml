@@ -21,15 +21,12 @@ Window {
     property int dataCountY: window.height / spread
 
     property int dataCount: window.dataCountX * window.dataCountY;
+    property int centerPointSize: 10
 
     function randomInt(max) {
         return Math.floor(Math.random() * max);
     }
 
-    function inCenterPoint(x, y, left, right, top, bottom) {
-        return (x >= left && x <= right && y >= top && y <= bottom);
-    }
-
     function toSceneX(xCoord, stretch) {
         return (xCoord / window.width) * 2.0 * stretch - 1.0;
     }
@@ -42,7 +39,7 @@ Window {
         id: computeItem
         computeShader: ":/shaders/computeshader.comp.qsb"
 
-        dispatchX: window.width * 2
+        globalSizeX: window.dataCount
 
         property real du: 0.190
         property real dv: 0.050
@@ -51,7 +48,6 @@ Window {
 
         property int dataCount: window.dataCount
         property int height: window.dataCountY
-        property int timestep: 0
 
         property real mouseX: -5.0
         property real mouseY: -5.0
@@ -66,55 +62,56 @@ Window {
         buffers: [
             StorageBuffer {
                 id: storageBufferA
-                
-                Component.onCompleted: {
-                    const dataSize = 8 * window.dataCount; // 8 entries per point: x pos, y pos, u material, v material, rgba color
-                    const bufferSize = 4 * dataSize; // four bytes per entry
-
-                    const centerPointSize = 10.0;
-                    const left = (window.dataCountX - centerPointSize) / 2.0;
-                    const right = (window.dataCountX + centerPointSize) / 2.0;
-                    const top = (window.dataCountY - centerPointSize) / 2.0;
-                    const bottom = (window.dataCountY + centerPointSize) / 2.0;
-
-                    let buffer = new ArrayBuffer(bufferSize);
-                    let view = new Float32Array(buffer);
-                    let i = 0;
-                    let coordXY = 0;
-                    while(i < dataSize) {
-
-                        let xCoord = coordXY % window.dataCountX;
-                        let yCoord = Math.floor(coordXY / window.dataCountX);
-
-                        view[i]     = window.toSceneX(xCoord, window.spread);
-                        view[i + 1] = window.toSceneY(yCoord, window.spread);
-
-                        if (window.inCenterPoint(xCoord, yCoord, left, right, top, bottom)) {
-                            view[i + 2] = 1.0; // u material
-                            view[i + 3] = 1.0; // v material
-                        } else {
-                            view[i + 2] = 1.0; // u material
-                            view[i + 3] = 0.0; // v material
-                        }
-
-
-                        view[i + 4] = 0.0; // r
-                        view[i + 5] = 0.0; // g
-                        view[i + 6] = 0.0; // b
-                        view[i + 7] = 1.0; // a
-
-                        i += 8;
-                        coordXY++;
+
+                // the GridCell struct of the shader; filled on the GPU when the buffer is created
+                layout: StorageBuffer.Std140
+                fields: [
+                    BufferField { name: "pos"; type: BufferField.Vec2 },
+                    BufferField { name: "uMaterial"; type: BufferField.Float },
+                    BufferField { name: "vMaterial"; type: BufferField.Float },
+                    BufferField { name: "color"; type: BufferField.Vec4 }
+                ]
+                count: window.dataCount
+                initializers: [
+                    BufferInitializer {
+                        fill: BufferInitializer.Grid
+                        count: window.dataCount
+                        stride: 8
+                        components: 2
+                        width: window.dataCountX
+                        minimum: -1.0
+                        maximum: 1.0
+                    },
+                    BufferInitializer {
+                        count: window.dataCount
+                        offset: 2
+                        stride: 8
+                        value: Qt.vector4d(1.0, 0.0, 0.0, 0.0)
+                    },
+                    BufferInitializer {
+                        fill: BufferInitializer.Rectangle
+                        count: window.dataCount
+                        offset: 3
+                        stride: 8
+                        width: window.dataCountX
+                        rect: Qt.rect((window.dataCountX - window.centerPointSize) / 2, (window.dataCountY - window.centerPointSize) / 2,
+                                      window.centerPointSize, window.centerPointSize)
+                        value: Qt.vector4d(1.0, 0.0, 0.0, 0.0)
+                    },
+                    BufferInitializer {
+                        count: window.dataCount
+                        offset: 4
+                        stride: 8
+                        components: 4
+                        value: Qt.vector4d(0.0, 0.0, 0.0, 1.0)
                     }
-                    storageBufferA.buffer = buffer;
-                }
+                ]
             },
             StorageBuffer {
                 id: storageBufferB
-                Component.onCompleted: {
-                    const size = 8 * 4 * window.dataCount; // same as StorageBufferA
-                    let buffer = new ArrayBuffer(size);
-                    storageBufferB.buffer = buffer;
+                // same size as storageBufferA, zeroed
+                initializers: BufferInitializer {
+                    count: 8 * window.dataCount
                 }
             }
         ]
@@ -123,20 +120,13 @@ Window {
         
     }
 
-    Timer {
-        id: timer
-        running: true
-        repeat: true
-        interval: 1
-        onTriggered: computeItem.timestep += 1
-    }
-
     StorageBufferView {
         id: view
         anchors.fill: parent
         computeItem: computeItem
         resultBuffer: storageBufferA
-        numberOfPoints: window.dataCount
+        numberOfPoints: storageBufferA.count
+        strideInByte: storageBufferA.stride
         pointSize: 2.0
 
         /*NumberAnimation on pointSize {
@@ -0,0 +1,59 @@
+// SPDX-FileCopyrightText: 2024 basysKom GmbH
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#include "asyncreadback.h"
+
+#include <QDebug>
+
+AsyncReadback::AsyncReadback(const Callback &onCompleted)
+    : m_onCompleted(onCompleted)
+{
+    m_result.completed = [this]() {
+        handleCompleted();
+    };
+}
+
+void AsyncReadback::readBackBuffer(QRhiResourceUpdateBatch *updateBatch, QRhiBuffer *buffer, quint32 offset, quint32 size)
+{
+    if (m_pending || m_released || !updateBatch || !buffer) {
+        return;
+    }
+
+    m_pending = true;
+    updateBatch->readBackBuffer(buffer, offset, size, &m_result);
+}
+
+void AsyncReadback::readBackTexture(QRhiResourceUpdateBatch *updateBatch, QRhiTexture *texture)
+{
+    if (m_pending || m_released || !updateBatch || !texture) {
+        return;
+    }
+
+    m_pending = true;
+    updateBatch->readBackTexture(QRhiReadbackDescription(texture), &m_result);
+}
+
+void AsyncReadback::release()
+{
+    if (m_pending) {
+        // QRhi still references m_result; delete once the readback has completed
+        m_released = true;
+        return;
+    }
+    delete this;
+}
+
+void AsyncReadback::handleCompleted()
+{
+    m_pending = false;
+
+    if (m_released) {
+        delete this;
+        return;
+    }
+
+    if (m_onCompleted) {
+        m_onCompleted(m_result.data);
+    }
+}
@@ -0,0 +1,50 @@
+// SPDX-FileCopyrightText: 2024 basysKom GmbH
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#pragma once
+
+#include <QByteArray>
+
+#include <functional>
+
+#if QT_VERSION >= QT_VERSION_CHECK(6, 6, 0)
+  #include <rhi/qrhi.h>
+#else
+  #include <private/qrhi_p.h>
+#endif
+
+/**
+ * \brief A QRhiReadbackResult that may outlive its requester
+ *
+ * QRhi keeps a raw pointer to the readback result until the frame that issued the
+ * readback has completed on the GPU. Owners therefore never delete an AsyncReadback
+ * directly but call release(), which defers the deletion until the outstanding
+ * readback (if any) has completed.
+ *
+ * All functions must be called on the render thread.
+ */
+class AsyncReadback
+{
+public:
+    using Callback = std::function<void(const QByteArray &data)>;
+
+    explicit AsyncReadback(const Callback &onCompleted);
+
+    bool isPending() const { return m_pending; }
+
+    void readBackBuffer(QRhiResourceUpdateBatch *updateBatch, QRhiBuffer *buffer, quint32 offset, quint32 size);
+    void readBackTexture(QRhiResourceUpdateBatch *updateBatch, QRhiTexture *texture);
+
+    // deletes the object now or as soon as the outstanding readback has completed
+    void release();
+
+private:
+    ~AsyncReadback() = default;
+    void handleCompleted();
+
+    QRhiReadbackResult m_result;
+    Callback m_onCompleted;
+    bool m_pending { false };
+    bool m_released { false };
+};
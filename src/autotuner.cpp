@@ -0,0 +1,187 @@
+// SPDX-FileCopyrightText: 2024 basysKom GmbH
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#include "autotuner.h"
+
+#include <QDebug>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMutex>
+#include <QSaveFile>
+#include <QStandardPaths>
+
+Q_LOGGING_CATEGORY(lcAutotune, "qci.autotune", QtInfoMsg)
+
+namespace {
+// all render threads share the results file
+QMutex resultsMutex;
+
+QJsonObject readResults(const QString &fileName)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return QJsonObject();
+    }
+    return QJsonDocument::fromJson(file.readAll()).object();
+}
+}
+
+QVector<Autotuner::Result> Autotuner::benchmark(QRhi *rhi, const QVector<Variant> &variants, QRhiShaderResourceBindings *bindings,
+                                                int dynamicOffsetBinding, const GroupCount &groupCount, int iterations)
+{
+    QVector<Result> results;
+    if (!rhi || !bindings) {
+        return results;
+    }
+
+    for (const auto &variant : variants) {
+        Result result;
+        result.name = variant.name;
+
+        QRhiComputePipeline *pipeline = rhi->newComputePipeline();
+        pipeline->setShaderResourceBindings(bindings);
+        pipeline->setShaderStage({ QRhiShaderStage::Compute, variant.shader });
+        if (!variant.shader.isValid() || !pipeline->create()) {
+            delete pipeline;
+            results << result;
+            continue;
+        }
+
+        const auto groups = groupCount(variant.shader);
+        const QRhiCommandBuffer::DynamicOffset dynamicOffset(dynamicOffsetBinding, 0);
+
+        // the first frame warms up caches and lazily created driver state
+        for (int run = 0; run < 2; ++run) {
+            QRhiCommandBuffer *cb = nullptr;
+            QElapsedTimer timer;
+            timer.start();
+
+            if (rhi->beginOffscreenFrame(&cb) != QRhi::FrameOpSuccess) {
+                break;
+            }
+
+            cb->beginComputePass();
+            cb->setComputePipeline(pipeline);
+            if (dynamicOffsetBinding >= 0) {
+                cb->setShaderResources(bindings, 1, &dynamicOffset);
+            } else {
+                cb->setShaderResources(bindings);
+            }
+            for (int i = 0; i < iterations; ++i) {
+                cb->dispatch(groups[0], groups[1], groups[2]);
+            }
+            cb->endComputePass();
+
+            // waits until the GPU has finished
+            rhi->endOffscreenFrame();
+
+            double seconds = 0.0;
+#if QT_VERSION >= QT_VERSION_CHECK(6, 6, 0)
+            seconds = cb->lastCompletedGpuTime();
+#endif
+            if (seconds <= 0.0) {
+                seconds = double(timer.nsecsElapsed()) / 1e9;
+            }
+
+            result.milliseconds = seconds * 1000.0 / iterations;
+            result.valid = true;
+        }
+
+        delete pipeline;
+        results << result;
+    }
+
+    return results;
+}
+
+int Autotuner::fastest(const QVector<Result> &results)
+{
+    int best = -1;
+    for (int i = 0; i < results.size(); ++i) {
+        if (results.at(i).valid && (best < 0 || results.at(i).milliseconds < results.at(best).milliseconds)) {
+            best = i;
+        }
+    }
+    return best;
+}
+
+QString Autotuner::table(const QVector<Result> &results)
+{
+    const int best = fastest(results);
+
+    QString text = QStringLiteral("%1  %2\n").arg(QStringLiteral("variant"), -24).arg(QStringLiteral("ms/dispatch"));
+    for (int i = 0; i < results.size(); ++i) {
+        const auto &result = results.at(i);
+        const QString time = result.valid ? QString::number(result.milliseconds, 'f', 4) : QStringLiteral("failed");
+        text += QStringLiteral("%1  %2%3\n").arg(result.name, -24).arg(time).arg(i == best ? QStringLiteral("  *") : QString());
+    }
+    return text;
+}
+
+QString Autotuner::deviceKey(QRhi *rhi)
+{
+    const QRhiDriverInfo info = rhi->driverInfo();
+    return QStringLiteral("%1/%2/%3:%4").arg(QString::fromLatin1(rhi->backendName()),
+                                             QString::fromUtf8(info.deviceName))
+            .arg(info.vendorId, 0, 16).arg(info.deviceId, 0, 16);
+}
+
+bool Autotuner::lookup(QRhi *rhi, const QString &kernelKey, QString *name)
+{
+    QMutexLocker locker(&resultsMutex);
+    const QJsonObject results = readResults(resultsFileName());
+    const QJsonObject entry = results.value(deviceKey(rhi)).toObject().value(kernelKey).toObject();
+    if (!entry.contains(QLatin1String("best"))) {
+        return false;
+    }
+
+    *name = entry.value(QLatin1String("best")).toString();
+    return true;
+}
+
+void Autotuner::store(QRhi *rhi, const QString &kernelKey, const QVector<Result> &results, int best)
+{
+    if (best < 0 || best >= results.size()) {
+        return;
+    }
+
+    QJsonArray timings;
+    for (const auto &result : results) {
+        timings.append(QJsonObject {
+            { QLatin1String("variant"), result.name },
+            { QLatin1String("ms"), result.valid ? QJsonValue(result.milliseconds) : QJsonValue() }
+        });
+    }
+
+    QMutexLocker locker(&resultsMutex);
+    const QString fileName = resultsFileName();
+    QJsonObject all = readResults(fileName);
+    QJsonObject device = all.value(deviceKey(rhi)).toObject();
+    device.insert(kernelKey, QJsonObject {
+        { QLatin1String("best"), results.at(best).name },
+        { QLatin1String("timings"), timings }
+    });
+    all.insert(deviceKey(rhi), device);
+
+    QDir().mkpath(QFileInfo(fileName).absolutePath());
+    QSaveFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "Cannot write autotuning results to" << fileName;
+        return;
+    }
+    file.write(QJsonDocument(all).toJson());
+    if (!file.commit()) {
+        qWarning() << "Cannot write autotuning results to" << fileName;
+    }
+}
+
+QString Autotuner::resultsFileName()
+{
+    return QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + QLatin1String("/qtquickcomputeitem/autotune.json");
+}
@@ -0,0 +1,67 @@
+// SPDX-FileCopyrightText: 2024 basysKom GmbH
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#pragma once
+
+#include <QLoggingCategory>
+#include <QString>
+#include <QVector>
+
+#include <array>
+#include <functional>
+
+#if QT_VERSION >= QT_VERSION_CHECK(6, 6, 0)
+  #include <rhi/qrhi.h>
+#else
+  #include <private/qrhi_p.h>
+#endif
+
+// the result tables; enable with QT_LOGGING_RULES="qci.autotune.debug=true"
+Q_DECLARE_LOGGING_CATEGORY(lcAutotune)
+
+/**
+ * \brief Times variants of a compute shader and remembers the fastest one per device
+ *
+ * Every variant is dispatched in offscreen frames, so benchmark() must not be called while
+ * a frame is recorded, e.g. from QQuickWindow::beforeFrameBegin. The GPU time is taken from
+ * the timestamps of the command buffer if the backend provides them, otherwise from the wall
+ * clock time of the offscreen frame, which waits for the GPU to finish.
+ *
+ * The choices are stored as JSON next to the shader cache, keyed by the device and driver
+ * and by a caller provided key for the kernel.
+ */
+class Autotuner
+{
+public:
+    struct Variant {
+        QString name;
+        QShader shader;
+    };
+
+    struct Result {
+        QString name;
+        double milliseconds { 0.0 };
+        bool valid { false };
+    };
+
+    using GroupCount = std::function<std::array<int, 3>(const QShader &shader)>;
+
+    // dynamicOffsetBinding is the binding of a uniformBufferWithDynamicOffset in bindings or -1
+    static QVector<Result> benchmark(QRhi *rhi, const QVector<Variant> &variants, QRhiShaderResourceBindings *bindings,
+                                     int dynamicOffsetBinding, const GroupCount &groupCount, int iterations = 20);
+
+    // index of the fastest valid result or -1
+    static int fastest(const QVector<Result> &results);
+
+    static QString table(const QVector<Result> &results);
+
+    // device and driver the results are valid for
+    static QString deviceKey(QRhi *rhi);
+
+    static bool lookup(QRhi *rhi, const QString &kernelKey, QString *name);
+    static void store(QRhi *rhi, const QString &kernelKey, const QVector<Result> &results, int best);
+
+private:
+    static QString resultsFileName();
+};
@@ -0,0 +1,239 @@
+// SPDX-FileCopyrightText: 2024 basysKom GmbH
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#include "bufferfield.h"
+
+#include <QColor>
+#include <QDebug>
+#include <QMatrix4x4>
+#include <QPointF>
+#include <QVarLengthArray>
+#include <QVector2D>
+#include <QVector3D>
+#include <QVector4D>
+
+#include <cstring>
+
+namespace {
+
+enum class Scalar {
+    Float,
+    Int,
+    UInt
+};
+
+Scalar scalarOf(BufferField::Type type)
+{
+    switch (type) {
+    case BufferField::Int:
+    case BufferField::IVec2:
+    case BufferField::IVec3:
+    case BufferField::IVec4:
+        return Scalar::Int;
+    case BufferField::UInt:
+    case BufferField::UVec2:
+    case BufferField::UVec3:
+    case BufferField::UVec4:
+        return Scalar::UInt;
+    default:
+        return Scalar::Float;
+    }
+}
+
+QVarLengthArray<double, 16> valuesOf(const QVariant &value)
+{
+    QVarLengthArray<double, 16> values;
+    switch (value.metaType().id()) {
+    case QMetaType::QVector2D: {
+        const auto v = value.value<QVector2D>();
+        values << v.x() << v.y();
+        break;
+    }
+    case QMetaType::QVector3D: {
+        const auto v = value.value<QVector3D>();
+        values << v.x() << v.y() << v.z();
+        break;
+    }
+    case QMetaType::QVector4D: {
+        const auto v = value.value<QVector4D>();
+        values << v.x() << v.y() << v.z() << v.w();
+        break;
+    }
+    case QMetaType::QColor: {
+        const auto c = value.value<QColor>();
+        values << c.redF() << c.greenF() << c.blueF() << c.alphaF();
+        break;
+    }
+    case QMetaType::QPointF:
+    case QMetaType::QPoint: {
+        const auto p = value.toPointF();
+        values << p.x() << p.y();
+        break;
+    }
+    case QMetaType::QMatrix4x4: {
+        // column major like GLSL
+        const auto m = value.value<QMatrix4x4>();
+        const float *data = m.constData();
+        for (int i = 0; i < 16; ++i) {
+            values << data[i];
+        }
+        break;
+    }
+    default:
+        if (value.canConvert<QVariantList>() && value.metaType().id() != QMetaType::QString) {
+            const auto list = value.toList();
+            for (const auto &entry : list) {
+                values << entry.toDouble();
+            }
+        } else {
+            values << value.toDouble();
+        }
+        break;
+    }
+    return values;
+}
+
+} // namespace
+
+BufferField::BufferField(QObject *parent)
+    : QObject(parent)
+{
+}
+
+void BufferField::setName(const QString &name)
+{
+    if (name == m_name) {
+        return;
+    }
+    m_name = name;
+    emit changed();
+}
+
+void BufferField::setType(Type type)
+{
+    if (type == m_type) {
+        return;
+    }
+    m_type = type;
+    emit changed();
+}
+
+int BufferField::components(Type type)
+{
+    switch (type) {
+    case Vec2:
+    case IVec2:
+    case UVec2:
+        return 2;
+    case Vec3:
+    case IVec3:
+    case UVec3:
+        return 3;
+    case Vec4:
+    case IVec4:
+    case UVec4:
+        return 4;
+    case Mat4:
+        return 16;
+    default:
+        return 1;
+    }
+}
+
+quint32 BufferField::alignment(Type type)
+{
+    switch (components(type)) {
+    case 1:
+        return 4;
+    case 2:
+        return 8;
+    default:
+        // vec3 is aligned like vec4, matrices like their column vectors
+        return 16;
+    }
+}
+
+bool BufferField::encode(Type type, const QVariant &value, char *data)
+{
+    const auto values = valuesOf(value);
+    const int count = components(type);
+    if (values.size() > count) {
+        qWarning() << "Too many components for a field of type" << type << value;
+        return false;
+    }
+
+    const Scalar scalar = scalarOf(type);
+    for (int c = 0; c < count; ++c) {
+        const double v = c < values.size() ? values.at(c) : 0.0;
+        char *word = data + c * 4;
+        switch (scalar) {
+        case Scalar::Int: {
+            const qint32 i = qint32(v);
+            memcpy(word, &i, 4);
+            break;
+        }
+        case Scalar::UInt: {
+            const quint32 u = quint32(qMax(0.0, v));
+            memcpy(word, &u, 4);
+            break;
+        }
+        default: {
+            const float f = float(v);
+            memcpy(word, &f, 4);
+            break;
+        }
+        }
+    }
+    return true;
+}
+
+QVariant BufferField::decode(Type type, const char *data)
+{
+    const int count = components(type);
+    float f[16];
+    qint32 i[4];
+    quint32 u[4];
+
+    switch (scalarOf(type)) {
+    case Scalar::Int: {
+        memcpy(i, data, size_t(count) * 4);
+        if (count == 1) {
+            return i[0];
+        }
+        QVariantList list;
+        for (int c = 0; c < count; ++c) {
+            list << i[c];
+        }
+        return list;
+    }
+    case Scalar::UInt: {
+        memcpy(u, data, size_t(count) * 4);
+        if (count == 1) {
+            return u[0];
+        }
+        QVariantList list;
+        for (int c = 0; c < count; ++c) {
+            list << u[c];
+        }
+        return list;
+    }
+    default:
+        break;
+    }
+
+    memcpy(f, data, size_t(count) * 4);
+    switch (type) {
+    case Vec2:
+        return QVector2D(f[0], f[1]);
+    case Vec3:
+        return QVector3D(f[0], f[1], f[2]);
+    case Vec4:
+        return QVector4D(f[0], f[1], f[2], f[3]);
+    case Mat4:
+        // QMatrix4x4 takes rows
+        return QMatrix4x4(f).transposed();
+    default:
+        return double(f[0]);
+    }
+}
@@ -0,0 +1,74 @@
+// SPDX-FileCopyrightText: 2024 basysKom GmbH
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#pragma once
+
+#include <QByteArray>
+#include <QObject>
+#include <QString>
+#include <QVariant>
+
+#include <qqml.h>
+
+/**
+ * \brief One member of the element struct of a StorageBuffer
+ *
+ * The fields of a StorageBuffer describe its elements like the struct of the shader does, e.g.
+ *
+ *     struct Particle { vec2 position; float u; float v; vec4 color; };
+ *
+ * becomes four fields in the same order. Offsets and the stride follow from the types and the
+ * layout rules of the buffer, see StorageBuffer::layout.
+ */
+class BufferField : public QObject
+{
+    Q_OBJECT
+    Q_PROPERTY(QString name READ name WRITE setName NOTIFY changed)
+    Q_PROPERTY(Type type READ type WRITE setType NOTIFY changed)
+    QML_ELEMENT
+
+public:
+    enum Type {
+        Float,
+        Int,
+        UInt,
+        Vec2,
+        Vec3,
+        Vec4,
+        IVec2,
+        IVec3,
+        IVec4,
+        UVec2,
+        UVec3,
+        UVec4,
+        Mat4
+    };
+    Q_ENUM(Type)
+
+    explicit BufferField(QObject *parent = nullptr);
+
+    QString name() const { return m_name; }
+    void setName(const QString &name);
+
+    Type type() const { return m_type; }
+    void setType(Type type);
+
+    // 32 bit scalars of the type
+    static int components(Type type);
+    // base alignment in bytes; the same for std140 and std430 as there are no array fields
+    static quint32 alignment(Type type);
+    static quint32 size(Type type) { return quint32(components(type)) * 4; }
+
+    // Converts numbers, Qt.vector2d/3d/4d, colors, matrices and arrays into size(type) bytes.
+    // Missing components are zero.
+    static bool encode(Type type, const QVariant &value, char *data);
+    static QVariant decode(Type type, const char *data);
+
+signals:
+    void changed();
+
+private:
+    QString m_name;
+    Type m_type { Float };
+};
@@ -0,0 +1,406 @@
+// SPDX-FileCopyrightText: 2024 basysKom GmbH
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#include "bufferinitializer.h"
+
+#include <QDebug>
+#include <QFloat16>
+
+#include <cmath>
+#include <cstring>
+
+namespace {
+
+// the hash and the random numbers of shaders/initializers/fill.comp
+quint32 pcgHash(quint32 value)
+{
+    const quint32 state = value * 747796405u + 2891336453u;
+    const quint32 word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+    return (word >> 22u) ^ word;
+}
+
+void random4(const BufferInitializer::Parameters &p, quint32 index, quint32 salt, float result[4])
+{
+    quint32 hash = pcgHash(index ^ pcgHash(p.seed + salt));
+    for (int c = 0; c < 4; ++c) {
+        result[c] = float(hash >> 8u) / 16777216.0f;
+        hash = pcgHash(hash);
+    }
+}
+
+quint32 rowWidth(const BufferInitializer::Parameters &p, quint32 count)
+{
+    return p.width > 0 ? p.width : qMax(1u, count);
+}
+
+void initialValue(const BufferInitializer::Parameters &p, quint32 index, quint32 count, float result[4])
+{
+    const quint32 width = rowWidth(p, count);
+    const float x = float(index % width);
+    const float y = float(index / width);
+
+    switch (p.fill) {
+    case BufferInitializer::Iota:
+        for (int c = 0; c < 4; ++c) {
+            result[c] = p.value[c] + float(index) * p.step;
+        }
+        return;
+    case BufferInitializer::Uniform: {
+        random4(p, index, 0u, result);
+        for (int c = 0; c < 4; ++c) {
+            result[c] = p.minimum + (p.maximum - p.minimum) * result[c];
+        }
+        return;
+    }
+    case BufferInitializer::Normal: {
+        // Box-Muller; u is in (0, 1]
+        float u[4];
+        float v[4];
+        random4(p, index, 0u, u);
+        random4(p, index, 1u, v);
+        for (int c = 0; c < 4; ++c) {
+            const float radius = std::sqrt(-2.0f * std::log(1.0f - u[c]));
+            result[c] = p.mean + p.deviation * radius * std::cos(6.2831853f * v[c]);
+        }
+        return;
+    }
+    case BufferInitializer::Rectangle: {
+        const bool inside = x >= p.rect[0] && y >= p.rect[1] && x < p.rect[0] + p.rect[2] && y < p.rect[1] + p.rect[3];
+        memcpy(result, inside ? p.value : p.background, sizeof(float) * 4);
+        return;
+    }
+    case BufferInitializer::Disc: {
+        const float dx = x - p.center[0];
+        const float dy = y - p.center[1];
+        const bool inside = dx * dx + dy * dy <= p.radius * p.radius;
+        memcpy(result, inside ? p.value : p.background, sizeof(float) * 4);
+        return;
+    }
+    case BufferInitializer::Grid: {
+        const quint32 height = qMax(1u, (count + width - 1) / width);
+        result[0] = p.minimum + (p.maximum - p.minimum) * x / float(width);
+        result[1] = p.minimum + (p.maximum - p.minimum) * y / float(height);
+        result[2] = p.value[2];
+        result[3] = p.value[3];
+        return;
+    }
+    default:
+        memcpy(result, p.value, sizeof(float) * 4);
+        return;
+    }
+}
+
+quint32 encodeWord(const BufferInitializer::Parameters &p, quint32 index, int component, float value)
+{
+    quint32 word = 0;
+    switch (p.valueType) {
+    case BufferInitializer::Int: {
+        // exact for large indices
+        const qint32 result = p.fill == BufferInitializer::Iota ? qint32(p.value[component]) + qint32(index) * qint32(p.step) : qint32(value);
+        memcpy(&word, &result, sizeof(word));
+        break;
+    }
+    case BufferInitializer::UInt:
+        word = p.fill == BufferInitializer::Iota ? quint32(qMax(0.0f, p.value[component])) + index * quint32(qMax(0.0f, p.step))
+                                                 : quint32(qMax(0.0f, value));
+        break;
+    default:
+        memcpy(&word, &value, sizeof(word));
+        break;
+    }
+    return word;
+}
+
+} // namespace
+
+quint32 BufferInitializer::Parameters::elementCount(quint32 size) const
+{
+    const quint32 words = size / quint32(sizeof(quint32));
+    if (offset >= words || stride == 0) {
+        return 0;
+    }
+    // the last element needs its components only, not the whole stride
+    const quint32 fitting = (words - offset - qMin(components, words - offset)) / stride + 1;
+    return count > 0 ? qMin(count, fitting) : fitting;
+}
+
+quint32 BufferInitializer::Parameters::requiredSize() const
+{
+    if (count == 0) {
+        return 0;
+    }
+    return (offset + (count - 1) * stride + components) * quint32(sizeof(quint32));
+}
+
+BufferInitializer::BufferInitializer(QObject *parent)
+    : QObject(parent)
+{
+}
+
+void BufferInitializer::update()
+{
+    // the settings apply when the buffer is created or reset the next time
+    m_parameters.stride = m_stride > 0 ? quint32(m_stride) : m_parameters.components;
+    emit changed();
+}
+
+void BufferInitializer::setFill(Fill fill)
+{
+    if (fill == m_parameters.fill) {
+        return;
+    }
+    m_parameters.fill = fill;
+    update();
+}
+
+void BufferInitializer::setValueType(ValueType type)
+{
+    if (type == m_parameters.valueType) {
+        return;
+    }
+    m_parameters.valueType = type;
+    update();
+}
+
+void BufferInitializer::setCount(int count)
+{
+    if (quint32(qMax(0, count)) == m_parameters.count) {
+        return;
+    }
+    m_parameters.count = quint32(qMax(0, count));
+    update();
+}
+
+void BufferInitializer::setOffset(int offset)
+{
+    if (quint32(qMax(0, offset)) == m_parameters.offset) {
+        return;
+    }
+    m_parameters.offset = quint32(qMax(0, offset));
+    update();
+}
+
+void BufferInitializer::setStride(int stride)
+{
+    stride = qMax(0, stride);
+    if (stride == m_stride) {
+        return;
+    }
+    m_stride = stride;
+    update();
+}
+
+void BufferInitializer::setComponents(int components)
+{
+    components = qBound(1, components, 4);
+    if (quint32(components) == m_parameters.components) {
+        return;
+    }
+    m_parameters.components = quint32(components);
+    update();
+}
+
+void BufferInitializer::setWidth(int width)
+{
+    if (quint32(qMax(0, width)) == m_parameters.width) {
+        return;
+    }
+    m_parameters.width = quint32(qMax(0, width));
+    update();
+}
+
+QVector4D BufferInitializer::value() const
+{
+    return QVector4D(m_parameters.value[0], m_parameters.value[1], m_parameters.value[2], m_parameters.value[3]);
+}
+
+void BufferInitializer::setValue(const QVector4D &value)
+{
+    if (value == this->value()) {
+        return;
+    }
+    for (int c = 0; c < 4; ++c) {
+        m_parameters.value[c] = value[c];
+    }
+    update();
+}
+
+QVector4D BufferInitializer::background() const
+{
+    return QVector4D(m_parameters.background[0], m_parameters.background[1], m_parameters.background[2], m_parameters.background[3]);
+}
+
+void BufferInitializer::setBackground(const QVector4D &background)
+{
+    if (background == this->background()) {
+        return;
+    }
+    for (int c = 0; c < 4; ++c) {
+        m_parameters.background[c] = background[c];
+    }
+    update();
+}
+
+void BufferInitializer::setStep(qreal step)
+{
+    if (float(step) == m_parameters.step) {
+        return;
+    }
+    m_parameters.step = float(step);
+    update();
+}
+
+void BufferInitializer::setMinimum(qreal minimum)
+{
+    if (float(minimum) == m_parameters.minimum) {
+        return;
+    }
+    m_parameters.minimum = float(minimum);
+    update();
+}
+
+void BufferInitializer::setMaximum(qreal maximum)
+{
+    if (float(maximum) == m_parameters.maximum) {
+        return;
+    }
+    m_parameters.maximum = float(maximum);
+    update();
+}
+
+void BufferInitializer::setMean(qreal mean)
+{
+    if (float(mean) == m_parameters.mean) {
+        return;
+    }
+    m_parameters.mean = float(mean);
+    update();
+}
+
+void BufferInitializer::setDeviation(qreal deviation)
+{
+    if (float(deviation) == m_parameters.deviation) {
+        return;
+    }
+    m_parameters.deviation = float(deviation);
+    update();
+}
+
+void BufferInitializer::setSeed(int seed)
+{
+    if (quint32(seed) == m_parameters.seed) {
+        return;
+    }
+    m_parameters.seed = quint32(seed);
+    update();
+}
+
+QRectF BufferInitializer::rect() const
+{
+    return QRectF(m_parameters.rect[0], m_parameters.rect[1], m_parameters.rect[2], m_parameters.rect[3]);
+}
+
+void BufferInitializer::setRect(const QRectF &rect)
+{
+    if (rect == this->rect()) {
+        return;
+    }
+    m_parameters.rect[0] = float(rect.x());
+    m_parameters.rect[1] = float(rect.y());
+    m_parameters.rect[2] = float(rect.width());
+    m_parameters.rect[3] = float(rect.height());
+    update();
+}
+
+QPointF BufferInitializer::center() const
+{
+    return QPointF(m_parameters.center[0], m_parameters.center[1]);
+}
+
+void BufferInitializer::setCenter(const QPointF &center)
+{
+    if (center == this->center()) {
+        return;
+    }
+    m_parameters.center[0] = float(center.x());
+    m_parameters.center[1] = float(center.y());
+    update();
+}
+
+void BufferInitializer::setRadius(qreal radius)
+{
+    if (float(radius) == m_parameters.radius) {
+        return;
+    }
+    m_parameters.radius = float(radius);
+    update();
+}
+
+void BufferInitializer::setCustomFunction(const QString &function)
+{
+    if (function == m_customFunction) {
+        return;
+    }
+    m_customFunction = function;
+    m_parameters.customFunction = function.toUtf8();
+    update();
+}
+
+bool BufferInitializer::fillBuffer(const Parameters &parameters, QByteArray *data)
+{
+    if (parameters.fill == Custom) {
+        qWarning() << "Custom initializers are not supported by the CPU backend";
+        return false;
+    }
+
+    const quint32 count = parameters.elementCount(quint32(data->size()));
+    quint32 *words = reinterpret_cast<quint32 *>(data->data());
+    float value[4];
+    for (quint32 i = 0; i < count; ++i) {
+        initialValue(parameters, i, count, value);
+        for (quint32 c = 0; c < parameters.components; ++c) {
+            words[parameters.offset + i * parameters.stride + c] = encodeWord(parameters, i, int(c), value[c]);
+        }
+    }
+    return true;
+}
+
+bool BufferInitializer::fillImage(const Parameters &parameters, QByteArray *data, const QSize &imageSize, int bytesPerPixel)
+{
+    if (parameters.fill == Custom) {
+        qWarning() << "Custom initializers are not supported by the CPU backend";
+        return false;
+    }
+
+    // the rows of an image are its 2D layout
+    Parameters p = parameters;
+    p.width = quint32(qMax(1, imageSize.width()));
+    const quint32 count = quint32(qMax(0, imageSize.width() * imageSize.height()));
+    if (data->size() < qsizetype(count) * bytesPerPixel) {
+        return false;
+    }
+
+    char *pixels = data->data();
+    float value[4];
+    for (quint32 i = 0; i < count; ++i) {
+        initialValue(p, i, count, value);
+        char *pixel = pixels + qsizetype(i) * bytesPerPixel;
+        for (int c = 0; c < 4; ++c) {
+            switch (bytesPerPixel) {
+            case 4:
+                pixel[c] = char(quint8(std::lround(qBound(0.0f, value[c], 1.0f) * 255.0f)));
+                break;
+            case 8: {
+                const qfloat16 half(value[c]);
+                memcpy(pixel + c * 2, &half, sizeof(half));
+                break;
+            }
+            default:
+                memcpy(pixel + c * 4, &value[c], sizeof(float));
+                break;
+            }
+        }
+    }
+    return true;
+}
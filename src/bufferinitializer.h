@@ -0,0 +1,197 @@
+// SPDX-FileCopyrightText: 2024 basysKom GmbH
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#pragma once
+
+#include <QByteArray>
+#include <QObject>
+#include <QPointF>
+#include <QRectF>
+#include <QSize>
+#include <QString>
+#include <QVector4D>
+
+#include <qqml.h>
+
+/**
+ * \brief Fills a StorageBuffer or ImageBuffer on the GPU when its resource is created or reset
+ *
+ * Replaces fill loops in QML: the contents are generated by a compute kernel, see
+ * InitializerKernels, instead of being built in JavaScript and uploaded. A buffer may have
+ * several initializers, which run in order, e.g. one per field of an interleaved struct.
+ * They run when the resource is created for a buffer without data or image source of its
+ * own, and on ComputeShaderBuffer::reset().
+ *
+ * Storage buffers are seen as count elements of stride 32 bit words. Every element gets
+ * components values of valueType, written from word offset on. For the 2D fills element i is
+ * at (i % width, i / width). Images are filled pixel by pixel with all four channels.
+ *
+ * If a storage buffer has no data of its own, its size follows from count, offset and stride
+ * of its initializers; words no initializer covers are undefined then.
+ *
+ * Fills:
+ * - Constant: value
+ * - Iota: value + i * step in every component
+ * - Uniform: random values in [minimum, maximum)
+ * - Normal: random values with mean and deviation
+ * - Rectangle, Disc: value inside rect or the disc at center with radius, background outside
+ * - Grid: the coordinates of the element mapped to [minimum, maximum); z and w from value
+ * - Custom: the GLSL function vec4 initialValue(uint index, uvec2 coord) in customFunction;
+ *   not supported by the CPU backend
+ *
+ * The random fills are reproducible: the same seed gives the same contents on every device.
+ */
+class BufferInitializer : public QObject
+{
+    Q_OBJECT
+    Q_PROPERTY(Fill fill READ fill WRITE setFill NOTIFY changed)
+    Q_PROPERTY(ValueType valueType READ valueType WRITE setValueType NOTIFY changed)
+    // storage buffers only; 0 fills as many elements as the buffer holds
+    Q_PROPERTY(int count READ count WRITE setCount NOTIFY changed)
+    Q_PROPERTY(int offset READ offset WRITE setOffset NOTIFY changed)
+    // in words; 0 for components
+    Q_PROPERTY(int stride READ stride WRITE setStride NOTIFY changed)
+    Q_PROPERTY(int components READ components WRITE setComponents NOTIFY changed)
+    // elements per row of the 2D fills; 0 for a single row
+    Q_PROPERTY(int width READ width WRITE setWidth NOTIFY changed)
+
+    Q_PROPERTY(QVector4D value READ value WRITE setValue NOTIFY changed)
+    Q_PROPERTY(QVector4D background READ background WRITE setBackground NOTIFY changed)
+    Q_PROPERTY(qreal step READ step WRITE setStep NOTIFY changed)
+    Q_PROPERTY(qreal minimum READ minimum WRITE setMinimum NOTIFY changed)
+    Q_PROPERTY(qreal maximum READ maximum WRITE setMaximum NOTIFY changed)
+    Q_PROPERTY(qreal mean READ mean WRITE setMean NOTIFY changed)
+    Q_PROPERTY(qreal deviation READ deviation WRITE setDeviation NOTIFY changed)
+    Q_PROPERTY(int seed READ seed WRITE setSeed NOTIFY changed)
+    Q_PROPERTY(QRectF rect READ rect WRITE setRect NOTIFY changed)
+    Q_PROPERTY(QPointF center READ center WRITE setCenter NOTIFY changed)
+    Q_PROPERTY(qreal radius READ radius WRITE setRadius NOTIFY changed)
+    Q_PROPERTY(QString customFunction READ customFunction WRITE setCustomFunction NOTIFY changed)
+    QML_ELEMENT
+
+public:
+    // keep in sync with the FILL_ defines of shaders/initializers/fill.comp
+    enum Fill {
+        Constant = 0,
+        Iota = 1,
+        Uniform = 2,
+        Normal = 3,
+        Rectangle = 4,
+        Disc = 5,
+        Grid = 6,
+        Custom = 7
+    };
+    Q_ENUM(Fill)
+
+    enum ValueType {
+        Float,
+        Int,
+        UInt
+    };
+    Q_ENUM(ValueType)
+
+    // a copy of the settings for the render thread, taken while the GUI thread is blocked
+    struct Parameters {
+        Fill fill { Constant };
+        ValueType valueType { Float };
+        quint32 count { 0 };
+        quint32 offset { 0 };
+        quint32 stride { 1 };
+        quint32 components { 1 };
+        quint32 width { 0 };
+        float value[4] { 0.0f, 0.0f, 0.0f, 0.0f };
+        float background[4] { 0.0f, 0.0f, 0.0f, 0.0f };
+        float step { 1.0f };
+        float minimum { 0.0f };
+        float maximum { 1.0f };
+        float mean { 0.0f };
+        float deviation { 1.0f };
+        quint32 seed { 0 };
+        float rect[4] { 0.0f, 0.0f, 0.0f, 0.0f };
+        float center[2] { 0.0f, 0.0f };
+        float radius { 0.0f };
+        QByteArray customFunction;
+
+        // elements written into a storage buffer of size bytes
+        quint32 elementCount(quint32 size) const;
+        // bytes a storage buffer needs for count elements; 0 if count is not set
+        quint32 requiredSize() const;
+    };
+
+    explicit BufferInitializer(QObject *parent = nullptr);
+
+    Fill fill() const { return m_parameters.fill; }
+    void setFill(Fill fill);
+
+    ValueType valueType() const { return m_parameters.valueType; }
+    void setValueType(ValueType type);
+
+    int count() const { return int(m_parameters.count); }
+    void setCount(int count);
+
+    int offset() const { return int(m_parameters.offset); }
+    void setOffset(int offset);
+
+    int stride() const { return m_stride; }
+    void setStride(int stride);
+
+    int components() const { return int(m_parameters.components); }
+    void setComponents(int components);
+
+    int width() const { return int(m_parameters.width); }
+    void setWidth(int width);
+
+    QVector4D value() const;
+    void setValue(const QVector4D &value);
+
+    QVector4D background() const;
+    void setBackground(const QVector4D &background);
+
+    qreal step() const { return m_parameters.step; }
+    void setStep(qreal step);
+
+    qreal minimum() const { return m_parameters.minimum; }
+    void setMinimum(qreal minimum);
+
+    qreal maximum() const { return m_parameters.maximum; }
+    void setMaximum(qreal maximum);
+
+    qreal mean() const { return m_parameters.mean; }
+    void setMean(qreal mean);
+
+    qreal deviation() const { return m_parameters.deviation; }
+    void setDeviation(qreal deviation);
+
+    int seed() const { return int(m_parameters.seed); }
+    void setSeed(int seed);
+
+    QRectF rect() const;
+    void setRect(const QRectF &rect);
+
+    QPointF center() const;
+    void setCenter(const QPointF &center);
+
+    qreal radius() const { return m_parameters.radius; }
+    void setRadius(qreal radius);
+
+    QString customFunction() const { return m_customFunction; }
+    void setCustomFunction(const QString &function);
+
+    Parameters parameters() const { return m_parameters; }
+
+    // CPU version of the built-in fills for the CPU backend; same results as the kernel up to
+    // float rounding. Images are tightly packed RGBA pixels of bytesPerPixel bytes.
+    static bool fillBuffer(const Parameters &parameters, QByteArray *data);
+    static bool fillImage(const Parameters &parameters, QByteArray *data, const QSize &imageSize, int bytesPerPixel);
+
+signals:
+    void changed();
+
+private:
+    void update();
+
+    Parameters m_parameters;
+    int m_stride { 0 };
+    QString m_customFunction;
+};
@@ -0,0 +1,320 @@
+// SPDX-FileCopyrightText: 2024 basysKom GmbH
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#include "bufferrecorder.h"
+
+#include <QDebug>
+#include <QGuiApplication>
+
+#include "computeitem.h"
+#include "computescheduler.h"
+
+BufferRecorder::BufferRecorder(QObject *parent)
+    : QObject(parent)
+{
+    init();
+}
+
+BufferRecorder::~BufferRecorder()
+{
+    // the render thread does not see this recorder anymore once this returns
+    if (m_scheduler) {
+        m_scheduler->unregisterRecorder(this);
+    }
+
+    for (const auto &slot : std::as_const(m_slots)) {
+        slot.readback->release();
+    }
+    m_slots.clear();
+    m_renderWriter.reset();
+
+    // writes the queued frames; readbacks still in flight are lost
+    releaseWriter();
+}
+
+void BufferRecorder::init()
+{
+    const QWindowList windowList = QGuiApplication::allWindows();
+    for (auto w : std::as_const(windowList)) {
+        if ((m_window = qobject_cast<QQuickWindow *>(w))) {
+            break;
+        }
+    }
+
+    if (!m_window) {
+        qWarning() << "No QQuickWindow found; cannot init" << metaObject()->className();
+        return;
+    }
+
+    m_scheduler = ComputeScheduler::forWindow(m_window);
+    m_scheduler->registerRecorder(this);
+}
+
+void BufferRecorder::setBuffer(ComputeShaderBuffer *buffer)
+{
+    if (buffer == m_buffer) {
+        return;
+    }
+    m_buffer = buffer;
+    emit bufferChanged();
+}
+
+void BufferRecorder::setFileName(const QString &fileName)
+{
+    if (fileName == m_fileName) {
+        return;
+    }
+    m_fileName = fileName;
+    emit fileNameChanged();
+}
+
+void BufferRecorder::setInterval(int interval)
+{
+    interval = qMax(1, interval);
+    if (interval == m_interval) {
+        return;
+    }
+    m_interval = interval;
+    emit intervalChanged();
+}
+
+void BufferRecorder::setRecording(bool recording)
+{
+    if (recording == m_recording) {
+        return;
+    }
+
+    if (recording) {
+        if (!m_window) {
+            setErrorString(QStringLiteral("BufferRecorder is not initialized"));
+            return;
+        }
+        if (m_fileName.isEmpty()) {
+            setErrorString(QStringLiteral("No file name set"));
+            return;
+        }
+
+        auto writer = RecordingWriter::create(m_fileName,
+                                              static_cast<Recording::Compression>(m_compression),
+                                              m_compressionLevel,
+                                              m_maxQueuedFrames,
+                                              static_cast<RecordingWriter::DropPolicy>(m_dropPolicy));
+        QString error;
+        if (!writer->open(&error)) {
+            setErrorString(error);
+            return;
+        }
+
+        // the writer thread reports; the totals are applied on the GUI thread
+        QPointer<BufferRecorder> guard(this);
+        writer->setProgressCallback([guard](quint64 writtenFrames, quint64 writtenBytes, quint64 droppedFrames) {
+            QMetaObject::invokeMethod(guard.data(), [guard, writtenFrames, writtenBytes, droppedFrames]() {
+                if (!guard) {
+                    return;
+                }
+                guard->m_recordedFrames = int(writtenFrames);
+                guard->m_writtenBytes = qint64(writtenBytes);
+                guard->m_droppedFrames = int(droppedFrames);
+                emit guard->statisticsChanged();
+            }, Qt::QueuedConnection);
+        });
+
+        m_writer = std::move(writer);
+        m_recordedFrames = 0;
+        m_droppedFrames = 0;
+        m_writtenBytes = 0;
+        emit statisticsChanged();
+        setErrorString(QString());
+    } else {
+        releaseWriter();
+    }
+
+    m_recording = recording;
+    emit recordingChanged();
+
+    if (m_window) {
+        m_window->update();
+    }
+}
+
+void BufferRecorder::setStagingSlots(int slots)
+{
+    slots = qMax(1, slots);
+    if (slots == m_stagingSlots) {
+        return;
+    }
+    m_stagingSlots = slots;
+    emit stagingSlotsChanged();
+}
+
+void BufferRecorder::setMaxQueuedFrames(int frames)
+{
+    frames = qMax(1, frames);
+    if (frames == m_maxQueuedFrames) {
+        return;
+    }
+    // applies to the next recording
+    m_maxQueuedFrames = frames;
+    emit maxQueuedFramesChanged();
+}
+
+void BufferRecorder::setDropPolicy(DropPolicy policy)
+{
+    if (policy == m_dropPolicy) {
+        return;
+    }
+    m_dropPolicy = policy;
+    emit dropPolicyChanged();
+}
+
+void BufferRecorder::setCompression(Compression compression)
+{
+    if (compression == m_compression) {
+        return;
+    }
+    m_compression = compression;
+    emit compressionChanged();
+}
+
+void BufferRecorder::setCompressionLevel(int level)
+{
+    level = qBound(-1, level, 9);
+    if (level == m_compressionLevel) {
+        return;
+    }
+    m_compressionLevel = level;
+    emit compressionLevelChanged();
+}
+
+void BufferRecorder::setErrorString(const QString &error)
+{
+    if (error == m_errorString) {
+        return;
+    }
+    if (!error.isEmpty()) {
+        qWarning() << metaObject()->className() << error;
+    }
+    m_errorString = error;
+    emit errorStringChanged();
+}
+
+void BufferRecorder::releaseWriter()
+{
+    if (!m_writer) {
+        return;
+    }
+    // progress reported after this point is not applied to the statistics anymore
+    m_writer->setProgressCallback({});
+    // the render thread and the slots in flight may still hold a reference; after the last one
+    // the writer thread closes the files, see RecordingWriter::create()
+    m_writer.reset();
+}
+
+void BufferRecorder::synchronize()
+{
+    // called on the render thread while the GUI thread is blocked
+    ComputeItem *item = m_buffer ? m_buffer->computeItem() : nullptr;
+    if (item != m_renderItem) {
+        m_renderStepsSinceCapture = 0;
+    }
+    m_renderItem = item;
+    m_renderIndex = item ? item->indexForBuffer(m_buffer) : -1;
+
+    m_renderInterval = m_interval;
+    m_renderStagingSlots = m_stagingSlots;
+    if (m_renderWriter != m_writer) {
+        // a new recording counts its steps from the start
+        m_renderStep = 0;
+        m_renderStepsSinceCapture = 0;
+    }
+    m_renderWriter = m_writer;
+    m_renderResourcesValid = true;
+}
+
+void BufferRecorder::finish(QRhiResourceUpdateBatch *readbacks)
+{
+    // render thread, after all dispatches of the frame have been recorded
+    if (!m_renderResourcesValid || !m_renderWriter || !m_renderItem || m_renderIndex < 0) {
+        return;
+    }
+
+    ComputeItem *item = m_renderItem;
+    if (!item->m_framePrepared || item->m_recordedSteps <= 0) {
+        return;
+    }
+
+    m_renderStep += quint64(item->m_recordedSteps);
+    m_renderStepsSinceCapture += item->m_recordedSteps;
+    if (m_renderStepsSinceCapture < m_renderInterval) {
+        return;
+    }
+    m_renderStepsSinceCapture = 0;
+
+    QRhiBuffer *buffer = m_renderIndex < item->m_rhiStorageBuffers.size() ? item->m_rhiStorageBuffers.at(m_renderIndex) : nullptr;
+    QRhiTexture *texture = m_renderIndex < item->m_rhiTextures.size() ? item->m_rhiTextures.at(m_renderIndex) : nullptr;
+    if (!buffer && !texture) {
+        return;
+    }
+
+    while (m_slots.size() < m_renderStagingSlots) {
+        const int index = m_slots.size();
+        StagingSlot slot;
+        slot.readback = new AsyncReadback([this, index](const QByteArray &data) {
+            handleReadback(index, data);
+        });
+        m_slots << slot;
+    }
+
+    // slots beyond a lowered stagingSlots are drained but not reused
+    int free = -1;
+    for (int i = 0; i < m_renderStagingSlots; ++i) {
+        if (!m_slots.at(i).readback->isPending()) {
+            free = i;
+            break;
+        }
+    }
+    if (free < 0) {
+        // the GPU is further ahead than the readbacks in flight allow
+        m_renderWriter->reportDropped();
+        return;
+    }
+
+    StagingSlot &slot = m_slots[free];
+    slot.writer = m_renderWriter;
+    slot.step = m_renderStep;
+    if (texture) {
+        slot.imageSize = texture->pixelSize();
+        slot.format = quint32(texture->format());
+        slot.readback->readBackTexture(readbacks, texture);
+    } else {
+        slot.imageSize = QSize();
+        slot.format = 0;
+        slot.readback->readBackBuffer(readbacks, buffer, 0, buffer->size());
+    }
+}
+
+void BufferRecorder::handleReadback(int slot, const QByteArray &data)
+{
+    // render thread; the data is copied to the writer queue, the file is written elsewhere
+    StagingSlot &staging = m_slots[slot];
+    const std::shared_ptr<RecordingWriter> writer = std::move(staging.writer);
+    staging.writer.reset();
+    if (!writer || data.isEmpty()) {
+        return;
+    }
+
+    Recording::Frame frame;
+    frame.step = staging.step;
+    frame.imageSize = staging.imageSize;
+    frame.format = staging.format;
+    frame.data = data;
+    writer->enqueue(std::move(frame));
+}
+
+void BufferRecorder::forgetItem(ComputeItem *item)
+{
+    // the resources are resolved again with the next synchronization
+    Q_UNUSED(item);
+    m_renderResourcesValid = false;
+}
@@ -0,0 +1,186 @@
+// SPDX-FileCopyrightText: 2024 basysKom GmbH
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#pragma once
+
+#include <QObject>
+#include <QPointer>
+#include <QQuickWindow>
+#include <QSize>
+#include <QString>
+#include <QVector>
+
+#include <memory>
+
+#include <qqml.h>
+
+#if QT_VERSION >= QT_VERSION_CHECK(6, 6, 0)
+  #include <rhi/qrhi.h>
+#else
+  #include <private/qrhi_p.h>
+#endif
+
+#include "asyncreadback.h"
+#include "computeshaderbuffer.h"
+#include "recordingfile.h"
+
+class ComputeItem;
+class ComputeScheduler;
+
+/**
+ * \brief Streams every Nth step of a storage buffer or image to disk
+ *
+ * After every frame in which the ComputeItem owning buffer has computed, the recorder counts
+ * the steps of that frame and, once interval steps have passed, reads the buffer back
+ * asynchronously into one of stagingSlots readbacks. Completed readbacks go to a writer thread,
+ * which appends them to fileName, see RecordingWriter for the format and BufferRecording for
+ * reading it back.
+ *
+ * Rendering never waits for the disk: if all staging slots are in flight or the writer queue
+ * is full, frames are dropped according to dropPolicy and counted in droppedFrames.
+ */
+class BufferRecorder : public QObject
+{
+    Q_OBJECT
+    Q_PROPERTY(ComputeShaderBuffer* buffer READ buffer WRITE setBuffer NOTIFY bufferChanged)
+    Q_PROPERTY(QString fileName READ fileName WRITE setFileName NOTIFY fileNameChanged)
+    // record every interval-th step; frames are captured at the end of a frame
+    Q_PROPERTY(int interval READ interval WRITE setInterval NOTIFY intervalChanged)
+    Q_PROPERTY(bool recording READ recording WRITE setRecording NOTIFY recordingChanged)
+    // readbacks in flight at most
+    Q_PROPERTY(int stagingSlots READ stagingSlots WRITE setStagingSlots NOTIFY stagingSlotsChanged)
+    // frames waiting for the writer at most
+    Q_PROPERTY(int maxQueuedFrames READ maxQueuedFrames WRITE setMaxQueuedFrames NOTIFY maxQueuedFramesChanged)
+    Q_PROPERTY(DropPolicy dropPolicy READ dropPolicy WRITE setDropPolicy NOTIFY dropPolicyChanged)
+    Q_PROPERTY(Compression compression READ compression WRITE setCompression NOTIFY compressionChanged)
+    // 1 (fast) to 9 (small), -1 for the zlib default
+    Q_PROPERTY(int compressionLevel READ compressionLevel WRITE setCompressionLevel NOTIFY compressionLevelChanged)
+
+    Q_PROPERTY(int recordedFrames READ recordedFrames NOTIFY statisticsChanged)
+    Q_PROPERTY(int droppedFrames READ droppedFrames NOTIFY statisticsChanged)
+    Q_PROPERTY(qint64 writtenBytes READ writtenBytes NOTIFY statisticsChanged)
+    Q_PROPERTY(QString errorString READ errorString NOTIFY errorStringChanged)
+    QML_ELEMENT
+
+public:
+    enum DropPolicy {
+        // keep what is queued and skip the new frame
+        DropNewest = RecordingWriter::DropNewest,
+        // keep the recording current, drop the oldest queued frame
+        DropOldest = RecordingWriter::DropOldest
+    };
+    Q_ENUM(DropPolicy)
+
+    enum Compression {
+        NoCompression = Recording::NoCompression,
+        Zlib = Recording::ZlibCompression
+    };
+    Q_ENUM(Compression)
+
+    explicit BufferRecorder(QObject *parent = nullptr);
+    ~BufferRecorder();
+
+    ComputeShaderBuffer* buffer() const { return m_buffer.data(); }
+    void setBuffer(ComputeShaderBuffer *buffer);
+
+    QString fileName() const { return m_fileName; }
+    void setFileName(const QString &fileName);
+
+    int interval() const { return m_interval; }
+    void setInterval(int interval);
+
+    bool recording() const { return m_recording; }
+    void setRecording(bool recording);
+
+    int stagingSlots() const { return m_stagingSlots; }
+    void setStagingSlots(int slots);
+
+    int maxQueuedFrames() const { return m_maxQueuedFrames; }
+    void setMaxQueuedFrames(int frames);
+
+    DropPolicy dropPolicy() const { return m_dropPolicy; }
+    void setDropPolicy(DropPolicy policy);
+
+    Compression compression() const { return m_compression; }
+    void setCompression(Compression compression);
+
+    int compressionLevel() const { return m_compressionLevel; }
+    void setCompressionLevel(int level);
+
+    int recordedFrames() const { return m_recordedFrames; }
+    int droppedFrames() const { return m_droppedFrames; }
+    qint64 writtenBytes() const { return m_writtenBytes; }
+    QString errorString() const { return m_errorString; }
+
+    Q_INVOKABLE void start() { setRecording(true); }
+    Q_INVOKABLE void stop() { setRecording(false); }
+
+signals:
+    void bufferChanged();
+    void fileNameChanged();
+    void intervalChanged();
+    void recordingChanged();
+    void stagingSlotsChanged();
+    void maxQueuedFramesChanged();
+    void dropPolicyChanged();
+    void compressionChanged();
+    void compressionLevelChanged();
+    void statisticsChanged();
+    void errorStringChanged();
+
+private:
+    friend class ComputeScheduler;
+
+    struct StagingSlot {
+        AsyncReadback *readback { nullptr };
+        std::shared_ptr<RecordingWriter> writer;
+        quint64 step { 0 };
+        QSize imageSize;
+        quint32 format { 0 };
+    };
+
+    void init();
+    void setErrorString(const QString &error);
+    void releaseWriter();
+
+    // render thread, see ComputeScheduler
+    void synchronize();
+    void finish(QRhiResourceUpdateBatch *readbacks);
+    void forgetItem(ComputeItem *item);
+    void handleReadback(int slot, const QByteArray &data);
+
+    QQuickWindow *m_window { nullptr };
+    QPointer<ComputeScheduler> m_scheduler;
+
+    QPointer<ComputeShaderBuffer> m_buffer;
+    QString m_fileName;
+    int m_interval { 1 };
+    bool m_recording { false };
+    int m_stagingSlots { 3 };
+    int m_maxQueuedFrames { 8 };
+    DropPolicy m_dropPolicy { DropNewest };
+    Compression m_compression { NoCompression };
+    int m_compressionLevel { 1 };
+
+    int m_recordedFrames { 0 };
+    int m_droppedFrames { 0 };
+    qint64 m_writtenBytes { 0 };
+    QString m_errorString;
+
+    // the writer of the current recording; shared with the staging slots in flight
+    std::shared_ptr<RecordingWriter> m_writer;
+
+    // copied in synchronize()
+    ComputeItem *m_renderItem { nullptr };
+    int m_renderIndex { -1 };
+    int m_renderInterval { 1 };
+    int m_renderStagingSlots { 3 };
+    std::shared_ptr<RecordingWriter> m_renderWriter;
+    // cleared when the ComputeItem goes away between synchronizing and recording
+    bool m_renderResourcesValid { false };
+
+    quint64 m_renderStep { 0 };
+    int m_renderStepsSinceCapture { 0 };
+    QVector<StagingSlot> m_slots;
+};
@@ -0,0 +1,150 @@
+// SPDX-FileCopyrightText: 2024 basysKom GmbH
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#include "bufferresizer.h"
+
+#include <QDebug>
+#include <QFile>
+
+#include <cstring>
+
+namespace {
+constexpr quint32 resizeWorkgroupSize = 256;
+// minimum number of work groups per dimension guaranteed by all backends
+constexpr quint32 maxGroupsPerDimension = 65535;
+}
+
+BufferResizer::~BufferResizer()
+{
+    releaseResources();
+}
+
+bool BufferResizer::scheduleCopy(QRhi *rhi, QRhiResourceUpdateBatch *updateBatch, QRhiBuffer *source, QRhiBuffer *destination,
+                                 quint32 copySize, const QByteArray &pattern)
+{
+    if (!rhi || !updateBatch || !source || !destination) {
+        return false;
+    }
+
+    if (!m_shader.isValid()) {
+        QFile shaderFile(QLatin1String(":/shaders/buffer_resize.comp.qsb"));
+        if (!shaderFile.open(QIODevice::ReadOnly)) {
+            qWarning() << "Cannot open shader file:" << shaderFile.fileName();
+            return false;
+        }
+        m_shader = QShader::fromSerialized(shaderFile.readAll());
+    }
+
+    const QByteArray fillPattern = pattern.isEmpty() ? QByteArray(sizeof(quint32), 0) : pattern;
+    const quint32 totalWords = destination->size() / sizeof(quint32);
+    const quint32 groups = (totalWords + resizeWorkgroupSize - 1) / resizeWorkgroupSize;
+
+    Copy copy;
+    copy.groupsX = int(qMin(groups, maxGroupsPerDimension));
+    copy.groupsY = int((groups + maxGroupsPerDimension - 1) / maxGroupsPerDimension);
+
+    const quint32 params[4] = {
+        qMin(copySize, source->size()) / quint32(sizeof(quint32)),
+        totalWords,
+        quint32(fillPattern.size()) / quint32(sizeof(quint32)),
+        quint32(copy.groupsX) * resizeWorkgroupSize
+    };
+
+    copy.patternBuffer = rhi->newBuffer(QRhiBuffer::Immutable, QRhiBuffer::StorageBuffer, fillPattern.size());
+    copy.paramsBuffer = rhi->newBuffer(QRhiBuffer::Dynamic, QRhiBuffer::UniformBuffer, sizeof(params));
+    if (!copy.patternBuffer->create() || !copy.paramsBuffer->create()) {
+        qWarning() << "Cannot create resources for resizing a storage buffer";
+        releaseCopy(copy);
+        return false;
+    }
+
+    updateBatch->uploadStaticBuffer(copy.patternBuffer, fillPattern.constData());
+    updateBatch->updateDynamicBuffer(copy.paramsBuffer, 0, sizeof(params), params);
+
+    copy.bindings = rhi->newShaderResourceBindings();
+    copy.bindings->setBindings({
+        QRhiShaderResourceBinding::bufferLoad(0, QRhiShaderResourceBinding::ComputeStage, source),
+        QRhiShaderResourceBinding::bufferStore(1, QRhiShaderResourceBinding::ComputeStage, destination),
+        QRhiShaderResourceBinding::bufferLoad(2, QRhiShaderResourceBinding::ComputeStage, copy.patternBuffer),
+        QRhiShaderResourceBinding::uniformBuffer(3, QRhiShaderResourceBinding::ComputeStage, copy.paramsBuffer)
+    });
+    copy.bindings->create();
+
+    copy.pipeline = rhi->newComputePipeline();
+    copy.pipeline->setShaderResourceBindings(copy.bindings);
+    copy.pipeline->setShaderStage({ QRhiShaderStage::Compute, m_shader });
+    if (!copy.pipeline->create()) {
+        qWarning() << "Cannot create pipeline for resizing a storage buffer";
+        releaseCopy(copy);
+        return false;
+    }
+
+    m_pendingCopies.append(copy);
+    return true;
+}
+
+void BufferResizer::recordCopies(QRhiCommandBuffer *cb, QRhiResourceUpdateBatch *updateBatch)
+{
+    if (m_pendingCopies.isEmpty()) {
+        if (updateBatch) {
+            cb->resourceUpdate(updateBatch);
+        }
+        return;
+    }
+
+    cb->beginComputePass(updateBatch);
+    for (const auto &copy : std::as_const(m_pendingCopies)) {
+        cb->setComputePipeline(copy.pipeline);
+        cb->setShaderResources();
+        cb->dispatch(copy.groupsX, copy.groupsY, 1);
+    }
+    cb->endComputePass();
+
+    m_finishedCopies += m_pendingCopies;
+    m_pendingCopies.clear();
+}
+
+void BufferResizer::releaseFinished()
+{
+    for (auto &copy : m_finishedCopies) {
+        releaseCopy(copy);
+    }
+    m_finishedCopies.clear();
+}
+
+void BufferResizer::releaseResources()
+{
+    releaseFinished();
+    for (auto &copy : m_pendingCopies) {
+        releaseCopy(copy);
+    }
+    m_pendingCopies.clear();
+}
+
+QByteArray BufferResizer::resizedData(const QByteArray &data, int size, const QByteArray &pattern)
+{
+    if (size <= data.size()) {
+        return data.left(size);
+    }
+
+    QByteArray result = data;
+    result.resize(size);
+    if (pattern.isEmpty()) {
+        memset(result.data() + data.size(), 0, size - data.size());
+    } else {
+        for (int i = data.size(); i < size; ++i) {
+            result[i] = pattern.at((i - data.size()) % pattern.size());
+        }
+    }
+    return result;
+}
+
+void BufferResizer::releaseCopy(Copy &copy)
+{
+    delete copy.pipeline;
+    delete copy.bindings;
+    delete copy.paramsBuffer;
+    delete copy.patternBuffer;
+    copy = Copy();
+}
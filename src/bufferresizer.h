@@ -0,0 +1,67 @@
+// SPDX-FileCopyrightText: 2024 basysKom GmbH
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#pragma once
+
+#include <QByteArray>
+#include <QVector>
+
+#if QT_VERSION >= QT_VERSION_CHECK(6, 6, 0)
+  #include <rhi/qrhi.h>
+#else
+  #include <private/qrhi_p.h>
+#endif
+
+/**
+ * \brief Copies the contents of storage buffers into resized replacements on the GPU
+ *
+ * QRhi has no buffer to buffer copy, so the copy is done by a small compute pass
+ * which also fills the new space with a repeating pattern. Copies are scheduled
+ * while the pipeline is (re)built and recorded before the next dispatch. The
+ * transient resources of a copy are kept until the following frame.
+ *
+ * Render thread only.
+ */
+class BufferResizer
+{
+public:
+    BufferResizer() = default;
+    ~BufferResizer();
+
+    BufferResizer(const BufferResizer &) = delete;
+    BufferResizer &operator=(const BufferResizer &) = delete;
+
+    // copy the first copySize bytes of source into destination; the rest is filled with pattern
+    bool scheduleCopy(QRhi *rhi, QRhiResourceUpdateBatch *updateBatch, QRhiBuffer *source, QRhiBuffer *destination,
+                      quint32 copySize, const QByteArray &pattern);
+
+    bool hasPendingCopies() const { return !m_pendingCopies.isEmpty(); }
+
+    // records one compute pass containing all pending copies; updateBatch may be nullptr
+    void recordCopies(QRhiCommandBuffer *cb, QRhiResourceUpdateBatch *updateBatch);
+
+    // releases the resources of the copies recorded in an earlier frame
+    void releaseFinished();
+
+    void releaseResources();
+
+    // returns data resized to size; new space is filled with the repeating pattern (zero if empty)
+    static QByteArray resizedData(const QByteArray &data, int size, const QByteArray &pattern);
+
+private:
+    struct Copy {
+        QRhiBuffer *patternBuffer { nullptr };
+        QRhiBuffer *paramsBuffer { nullptr };
+        QRhiShaderResourceBindings *bindings { nullptr };
+        QRhiComputePipeline *pipeline { nullptr };
+        int groupsX { 0 };
+        int groupsY { 0 };
+    };
+
+    static void releaseCopy(Copy &copy);
+
+    QShader m_shader;
+    QVector<Copy> m_pendingCopies;
+    QVector<Copy> m_finishedCopies;
+};
@@ -7,10 +7,30 @@
 #include <QDebug>
 #include <QImage>
 #include <QFile>
+#include <QDataStream>
+#include <QSaveFile>
 #include <QRunnable>
 #include <QGuiApplication>
+#include <QFileInfo>
+#include <QCryptographicHash>
 
+#include <algorithm>
+#include <cstring>
+
+#include "autotuner.h"
+#include "computescheduler.h"
+#include "computetrace.h"
 #include "imagebuffer.h"
+#include "shadercompiler.h"
+#include "uniformpropertybinding.h"
+
+namespace {
+
+// header of the files written by ComputeItem::saveState()
+constexpr quint32 StateMagic = 0x53494351; // "QCIS"
+constexpr quint32 StateVersion = 1;
+
+} // namespace
 
 class PlainComputeTexture : public QSGTexture
 {
@@ -20,7 +40,7 @@ public:
         , m_texture(t),
         m_size(s) {}
 
-bool hasMipmaps() const override { return false; }
+bool hasMipmaps() const override { return m_texture && m_texture->flags().testFlag(QRhiTexture::MipMapped); }
 bool hasAlphaChannel() const override { return false; }
 QSize textureSize() const override { return m_size; }
 QRhiTexture* rhiTexture() const override { return m_texture; }
@@ -61,13 +81,30 @@ ComputeItem::ComputeItem(QObject *parent)
 
 ComputeItem::~ComputeItem()
 {
+    // the render thread does not see this item anymore once this returns
+    if (m_scheduler) {
+        m_scheduler->unregisterItem(this);
+    }
+
     for (const auto sbuf : std::as_const(m_buffers)) {
         if (sbuf) {
             disconnect(sbuf, &ComputeShaderBuffer::bufferChanged, this, nullptr);
-            sbuf->setComputeItem(nullptr);  
+            if (sbuf->computeItem() == this) {
+                sbuf->setComputeItem(nullptr);
+            }
         } 
     }
 
+    if (m_residualReadback) {
+        m_residualReadback->release();
+        m_residualReadback = nullptr;
+    }
+    for (auto readback : std::as_const(m_stateReadbacks)) {
+        readback->release();
+    }
+    m_stateReadbacks.clear();
+    releaseCounterReadbacks();
+
     releaseResources();
 }
 
@@ -83,17 +120,6 @@ QShader ComputeItem::loadShader(const QString &filename)
     return QShader();
 }
 
-QRhi* ComputeItem::rhiInterface() const
-{
-    if (!m_window) {
-        return nullptr;
-    }
-
-    QSGRendererInterface *renderInterface = m_window->rendererInterface();
-    QRhi *rhi = static_cast<QRhi *>(renderInterface->getResource(m_window, QSGRendererInterface::RhiResource));
-    return rhi;
-}
-
 
 QString ComputeItem::computeShader() const
 {
@@ -107,459 +133,2634 @@ void ComputeItem::setComputeShader(const QString &filename)
     }
 
     m_computeShaderFilename = filename;
-    m_dirty = true;
+    m_shaderChanged = true;
+    updateShaderWatcher();
     emit computeShaderChanged();
 }
 
-QQmlListProperty<ComputeShaderBuffer> ComputeItem::buffers()
-{
-    return QQmlListProperty<ComputeShaderBuffer>(this, nullptr, &ComputeItem::append_storageBuffer, nullptr,
-        nullptr, nullptr, nullptr, nullptr);
-}
-
-void ComputeItem::append_storageBuffer(QQmlListProperty<ComputeShaderBuffer> *list, ComputeShaderBuffer *buffer)
+void ComputeItem::setComputeShaderSource(const QString &source)
 {
-
-    if (!buffer) {
-        qWarning() << "Cannot add empty buffer";
+    if (source == m_computeShaderSource) {
         return;
     }
 
-    ComputeItem *computeItem = qobject_cast<ComputeItem *>(list->object);
-    if (computeItem) {
-        if (buffer->hasComputeItem()) {
-            qWarning() << "Cannot add a buffer object that is owned by another ComputeItem";
-            return; 
-        }
-
-        computeItem->m_buffers.append(buffer);
+    m_computeShaderSource = source;
+    m_shaderChanged = true;
+    emit computeShaderSourceChanged();
+}
 
-        connect(buffer, &ComputeShaderBuffer::bufferChanged, computeItem, [computeItem]() {
-            computeItem->m_dirty = true;
-        }, Qt::DirectConnection );
+bool ComputeItem::isPrecompiledShader() const
+{
+    return m_renderShaderSource.isEmpty() && m_renderShaderFilename.endsWith(QLatin1String(".qsb"));
+}
 
-        buffer->setComputeItem(computeItem);   
-        computeItem->m_dirty = true;
+QByteArray ComputeItem::glslSource(QString *errorMessage) const
+{
+    // render thread
+    if (!m_renderShaderSource.isEmpty()) {
+        return m_renderShaderSource.toUtf8();
     }
 
+    QFile shaderFile(m_renderShaderFilename);
+    if (!shaderFile.open(QIODevice::ReadOnly)) {
+        *errorMessage = QStringLiteral("Cannot open compute shader %1").arg(m_renderShaderFilename);
+        return QByteArray();
+    }
+    return shaderFile.readAll();
 }
 
-ComputeShaderBuffer* ComputeItem::bufferAt(int idx) const
+QShader ComputeItem::loadComputeShader(QRhi *rhi, QString *errorMessage)
 {
-    if ((idx < 0) || (idx >= m_buffers.size())) {
-        qWarning() << "Cannot get buffer: Index out of bounds";
-        return nullptr;
+    // render thread
+    if (isPrecompiledShader()) {
+        // once per shader and defines, not on every reload or rebuild
+        const QByteArray ignoredDefines = m_renderShaderFilename.toUtf8() + '\0' + m_renderDefinesPreamble;
+        if (!m_renderDefinesPreamble.isEmpty() && ignoredDefines != m_ignoredDefines) {
+            qWarning() << "Defines are ignored for the precompiled shader" << m_renderShaderFilename
+                       << "- the values have to be passed as uniforms";
+        }
+        m_ignoredDefines = ignoredDefines;
+        const QShader shader = loadShader(m_renderShaderFilename);
+        if (!shader.isValid()) {
+            *errorMessage = QStringLiteral("Cannot load compute shader %1").arg(m_renderShaderFilename);
+        }
+        return shader;
     }
-    return m_buffers.at(idx);
-}
-
 
-QRhiBuffer* ComputeItem::rhiStorageBufferAt(int idx) const
-{
-    if ((idx < 0) || (idx >= m_rhiStorageBuffers.size())) {
-        qWarning() << "Cannot get QRhiBuffer: Index out of bounds";
-        return nullptr;
+    const QByteArray source = glslSource(errorMessage);
+    if (source.isEmpty()) {
+        return QShader();
     }
-    return m_rhiStorageBuffers.at(idx);
-}
 
-QSGTexture* ComputeItem::qsgTextureAt(int idx) const
-{
-    if ((idx < 0) || (idx >= m_qsgTextures.size())) {
-        qWarning() << "Cannot get QSGTexture: Index out of bounds";
-        return nullptr;
+    QString compileError;
+    const QShader shader = ShaderCompiler::compileComputeShader(rhi, source, m_renderDefinesPreamble + m_tunedPreamble, &compileError);
+    if (!shader.isValid()) {
+        *errorMessage = QStringLiteral("Cannot compile %1: %2").arg(shaderName(), compileError);
     }
-    return m_qsgTextures.at(idx);
+    return shader;
 }
 
-
-void ComputeItem::componentComplete()
+QString ComputeItem::shaderName() const
 {
-    handleDynamicProperties();
+    return m_renderShaderSource.isEmpty() ? m_renderShaderFilename : QStringLiteral("inline compute shader");
 }
 
-void ComputeItem::handleDynamicProperties()
+void ComputeItem::setDefines(const QVariantMap &defines)
 {
+    if (defines == m_defines) {
+        return;
+    }
 
-    const QMetaObject *metaObject = this->metaObject();
+    m_defines = defines;
+    m_definesPreamble = ShaderCompiler::definesPreamble(m_defines);
 
-    QMetaMethod handlePropertyChangedMethod;
-    int handlePropertyChangedMethodIndex = metaObject->indexOfSlot(QMetaObject::normalizedSignature("handlePropertyChanged()"));
-    if (handlePropertyChangedMethodIndex != -1) { 
-        handlePropertyChangedMethod = metaObject->method(handlePropertyChangedMethodIndex);
+    // another variant of the same shader; the buffers and bindings stay in place
+    m_shaderReloaded = true;
+    if (m_window) {
+        m_window->update();
     }
+    emit definesChanged();
+}
 
-    for (int i = 0; i < metaObject->propertyCount(); ++i) {
-        QMetaProperty property = metaObject->property(i);
-        const QString propertyName = property.name();
-        const QVariant propertyValue = this->property(propertyName.toUtf8());
-
-        if (property.hasNotifySignal() && isValidUniformProperty(propertyName, propertyValue)) {
-            const QMetaType::Type metaType = static_cast<const QMetaType::Type>(propertyValue.metaType().id());
-            UniformProperty uniformProperty;
-            uniformProperty.name = propertyName;
-            uniformProperty.metaType = metaType;
-            if (metaType == QMetaType::Int || metaType == QMetaType::Bool) {
-                uniformProperty.i32value = propertyValue.toInt();
-                uniformProperty.sizeInBytes = 4;
-            } else if (metaType == QMetaType::Double) {
-                //QML real and double properties are both stored as QMetaType::Double internally
-                // we support only 4 byte float uniforms for now
-                uniformProperty.fvalue = propertyValue.toFloat();
-                uniformProperty.sizeInBytes = 4;
-            }
-            m_signalIndexMap.insert(property.notifySignalIndex(), m_uniformPropertyList.count());
-            m_uniformPropertyList.append(uniformProperty);
-            connect(this, property.notifySignal(), this, handlePropertyChangedMethod);
+void ComputeItem::setAutotune(bool autotune)
+{
+    if (autotune != m_autotune) {
+        m_autotune = autotune;
+        m_autotuneChanged = true;
+        if (m_window) {
+            m_window->update();
         }
+        emit autotuneChanged();
     }
 }
 
-bool ComputeItem::isValidUniformProperty(const QString &name, const QVariant &value) const
+void ComputeItem::setAutotuneCandidates(const QVariantList &candidates)
 {
-    // check for ComputeItem's properties
-    if (name == QLatin1String("dispatchX") || name == QLatin1String("dispatchY") || name == QLatin1String("dispatchZ")) {
-        return false;
+    if (candidates != m_autotuneCandidates) {
+        m_autotuneCandidates = candidates;
+        m_autotuneChanged = m_autotune;
+        emit autotuneCandidatesChanged();
     }
-
-    const QMetaType::Type metaType = static_cast<const QMetaType::Type>(value.metaType().id());
-    return value.isValid() &&
-        (metaType == QMetaType::Int || metaType == QMetaType::Bool || metaType == QMetaType::Double);
 }
 
-quint32 ComputeItem::uniformBufferSize() const
+void ComputeItem::setTunedLocalSize(int localSize)
 {
-    quint32 size = 0;
-    for (const auto &item : std::as_const(m_uniformPropertyList)) {
-        size += item.sizeInBytes;
+    if (localSize != m_tunedLocalSize) {
+        m_tunedLocalSize = localSize;
+        emit tunedLocalSizeChanged();
     }
-    return size;
 }
 
-void ComputeItem::updateUniformBuffer(QRhiResourceUpdateBatch *updateBatch)
+void ComputeItem::runAutotune(QRhi *rhi)
 {
-    quint32 offset = 0;
-    for (const auto &uniformItem : std::as_const(m_uniformPropertyList)) {
-        if (uniformItem.metaType == QMetaType::Double) {
-            updateBatch->updateDynamicBuffer(m_computeUBuf, offset, uniformItem.sizeInBytes, &uniformItem.fvalue);
-        } else {
-            updateBatch->updateDynamicBuffer(m_computeUBuf, offset, uniformItem.sizeInBytes, &uniformItem.i32value);
-        }
-        offset += uniformItem.sizeInBytes;
+    // render thread, outside of a frame
+    m_autotunePending = false;
+
+    if (isPrecompiledShader()) {
+        qWarning() << "Autotuning needs a GLSL compute shader using LOCAL_SIZE_X; cannot tune" << m_renderShaderFilename;
+        return;
     }
-}
 
+    if (m_renderGlobalSize[0] <= 0) {
+        qWarning() << "Autotuning needs globalSizeX";
+        return;
+    }
 
-void ComputeItem::handlePropertyChanged()
-{
+    if (m_renderDefinesPreamble.contains("#define LOCAL_SIZE_X ")) {
+        qWarning() << "LOCAL_SIZE_X is set by defines; not autotuning";
+        return;
+    }
 
-    static const QString changeSignalPostfix = QLatin1String("Changed");
-    QObject *senderObj = sender();
-    if (!senderObj) {
+    QString errorMessage;
+    const QByteArray source = glslSource(&errorMessage);
+    if (source.isEmpty()) {
+        reportShaderError(errorMessage);
         return;
     }
 
-    const QMetaObject *senderMetaObj = senderObj->metaObject();
-    int signalIndex = senderSignalIndex();
+    // the fastest local size depends on the kernel and the problem size
+    const QString kernelKey = QString::fromLatin1(QCryptographicHash::hash(source + '\0' + m_renderDefinesPreamble, QCryptographicHash::Sha256).toHex())
+            + QStringLiteral("/%1x%2x%3").arg(m_renderGlobalSize[0]).arg(m_renderGlobalSize[1]).arg(m_renderGlobalSize[2]);
 
-    if (senderMetaObj && m_signalIndexMap.contains(signalIndex)) {
+    QString best;
+    if (!Autotuner::lookup(rhi, kernelKey, &best)) {
+        const int maxLocalSize = qMin(rhi->resourceLimit(QRhi::MaxThreadGroupX), rhi->resourceLimit(QRhi::MaxThreadsPerThreadGroup));
 
-        int uniformIndex = m_signalIndexMap[signalIndex];
-        if (uniformIndex >= 0 && uniformIndex < m_uniformPropertyList.count()) {
-            UniformProperty *toUpdate = &m_uniformPropertyList[uniformIndex];
+        QVector<Autotuner::Variant> variants;
+        for (const int localSize : std::as_const(m_renderAutotuneCandidates)) {
+            if (localSize <= 0 || (maxLocalSize > 0 && localSize > maxLocalSize)) {
+                continue;
+            }
+            const QByteArray preamble = m_renderDefinesPreamble + "#define LOCAL_SIZE_X " + QByteArray::number(localSize) + '\n';
+            variants << Autotuner::Variant { QString::number(localSize), ShaderCompiler::compileComputeShader(rhi, source, preamble) };
+        }
 
-            const QMetaMethod metaMethod = senderMetaObj->method(signalIndex);
-            const QByteArray propName = metaMethod.name().chopped(changeSignalPostfix.length());
-            const QVariant value = senderObj->property(propName);
+        // trial dispatches must not touch the simulation state; bind scratch resources of the same size
+        QVector<QRhiBuffer *> scratchBuffers(m_buffers.size(), nullptr);
+        QVector<QRhiTexture *> scratchTextures(m_buffers.size(), nullptr);
+        for (int i = 0; i < m_buffers.size(); ++i) {
+            if (const QRhiBuffer *buffer = m_rhiStorageBuffers.at(i)) {
+                scratchBuffers[i] = m_resourcePool.acquireBuffer(rhi, buffer->type(), buffer->usage(), buffer->size());
+            } else if (const QRhiTexture *texture = m_rhiTextures.at(i)) {
+                scratchTextures[i] = m_resourcePool.acquireTexture(rhi, texture->format(), texture->pixelSize(), texture->flags());
+            }
+        }
 
-            if (value.isValid()) {
-                if (value.canConvert<int>() && (toUpdate->metaType == QMetaType::Int || toUpdate->metaType == QMetaType::Bool)) {
-                    toUpdate->i32value = value.toInt();
-                } else if (value.canConvert<float>() && toUpdate->metaType == QMetaType::Double) {
-                    toUpdate->fvalue = value.toFloat();
-                }
+        const auto bindingList = resourceBindings(scratchBuffers, scratchTextures);
+        QRhiShaderResourceBindings *bindings = rhi->newShaderResourceBindings();
+        bindings->setBindings(bindingList.cbegin(), bindingList.cend());
+        bindings->create();
+
+        int maxGroups = rhi->resourceLimit(QRhi::MaxThreadGroupsPerDimension);
+        if (maxGroups <= 0) {
+            maxGroups = 65535;
+        }
+
+        const auto groupCount = [this, maxGroups](const QShader &shader) {
+            const auto localSize = shader.description().computeShaderLocalSize();
+            std::array<int, 3> groups;
+            for (int i = 0; i < 3; ++i) {
+                const int local = qMax(1, int(localSize[i]));
+                groups[i] = qMin(maxGroups, (qMax(1, m_renderGlobalSize[i]) + local - 1) / local);
             }
+            return groups;
+        };
+
+        const auto results = Autotuner::benchmark(rhi, variants, bindings, m_builtinsUBuf ? m_builtinsBinding : -1, groupCount);
+
+        delete bindings;
+        for (auto buffer : std::as_const(scratchBuffers)) {
+            m_resourcePool.release(buffer);
+        }
+        for (auto texture : std::as_const(scratchTextures)) {
+            m_resourcePool.release(texture);
+        }
+
+        const int bestIndex = Autotuner::fastest(results);
+        if (bestIndex < 0) {
+            qWarning() << "Autotuning of" << shaderName() << "failed";
+            return;
         }
 
+        qCDebug(lcAutotune).noquote() << "Autotuning" << shaderName() << "on" << Autotuner::deviceKey(rhi) << "\n" << Autotuner::table(results);
+        Autotuner::store(rhi, kernelKey, results, bestIndex);
+        best = results.at(bestIndex).name;
     }
+
+    m_tunedPreamble = "#define LOCAL_SIZE_X " + best.toLatin1() + '\n';
+    m_renderShaderReloaded = true;
+    m_dirty = true;
+
+    const int localSize = best.toInt();
+    QMetaObject::invokeMethod(this, [this, localSize]() {
+        setTunedLocalSize(localSize);
+    }, Qt::QueuedConnection);
+    m_window->update();
 }
 
-void ComputeItem::computeStep()
+void ComputeItem::setHotReload(bool hotReload)
 {
-    if (!m_isInitialized) {
-        qWarning() << "ComputeItem is not initialized";
-        return;
+    if (hotReload != m_hotReload) {
+        m_hotReload = hotReload;
+        updateShaderWatcher();
+        emit hotReloadChanged();
     }
-
-    connect(m_window, &QQuickWindow::beforeRendering, this, [this]() {
-        const auto rhi = rhiInterface();
-        if (!m_pipelineIsInitialized || m_dirty) {
-            initPipeline(rhi);
-        }  
-        doCompute(rhi);
-     }, Qt::SingleShotConnection );
-
 }
 
-void ComputeItem::compute()
+void ComputeItem::updateShaderWatcher()
 {
-    if (!m_isInitialized) {
-        qWarning() << "ComputeItem is not initialized";
+    if (m_shaderWatcher) {
+        delete m_shaderWatcher;
+        m_shaderWatcher = nullptr;
+    }
+
+    // resources are compiled in and cannot change
+    if (!m_hotReload || m_computeShaderFilename.isEmpty() || m_computeShaderFilename.startsWith(QLatin1Char(':'))) {
         return;
     }
 
-    if (m_isRunning) {
+    if (!QFileInfo::exists(m_computeShaderFilename)) {
+        qWarning() << "Cannot watch compute shader" << m_computeShaderFilename;
         return;
     }
 
-    connect(m_window, &QQuickWindow::beforeRendering, this, [this]() {
-        const auto rhi = rhiInterface();
-        if (!m_pipelineIsInitialized || m_dirty) {
-            initPipeline(rhi);
+    m_shaderWatcher = new QFileSystemWatcher({ m_computeShaderFilename }, this);
+    connect(m_shaderWatcher, &QFileSystemWatcher::fileChanged, this, [this](const QString &path) {
+        // editors often replace the file instead of writing it; watch the new one
+        if (!m_shaderWatcher->files().contains(path) && QFileInfo::exists(path)) {
+            m_shaderWatcher->addPath(path);
         }
-        doCompute(rhi, /* continuously = */ true);
-     }, Qt::DirectConnection );
 
+        m_shaderReloaded = true;
+        if (m_window) {
+            m_window->update();
+        }
+    });
 }
 
-void ComputeItem::stop()
+void ComputeItem::setShaderError(const QString &error)
 {
-    if (!m_isInitialized) {
-        qWarning() << "ComputeItem is not initialized";
-        return;
+    if (error != m_shaderError) {
+        m_shaderError = error;
+        emit shaderErrorChanged();
     }
+}
 
-    if (!m_isRunning) {
-        return;
+void ComputeItem::reportMemoryUsage(QRhi *rhi)
+{
+    // render thread
+    const ResourcePool::Usage usage = m_resourcePool.usage();
+    const qint64 totalUsage = ResourcePool::globalBytes();
+    QString error = m_resourcePool.budgetError();
+    if (!error.isEmpty()) {
+        error = QStringLiteral("%1: %2").arg(shaderName(), error);
+    }
+    if (error != m_renderMemoryError) {
+        // once per rejection, not per frame
+        m_renderMemoryError = error;
+        if (!error.isEmpty()) {
+            qWarning() << error;
+        }
     }
 
-    disconnect(m_window, &QQuickWindow::beforeRendering, this, nullptr);
-    m_isRunning = false;
+    QVariantMap statistics;
+#if QT_VERSION >= QT_VERSION_CHECK(6, 6, 0)
+    if (rhi) {
+        const QRhiStats stats = rhi->statistics();
+        statistics.insert(QStringLiteral("totalPipelineCreationTime"), stats.totalPipelineCreationTime);
+        statistics.insert(QStringLiteral("blockCount"), stats.blockCount);
+        statistics.insert(QStringLiteral("allocCount"), stats.allocCount);
+        statistics.insert(QStringLiteral("usedBytes"), stats.usedBytes);
+        statistics.insert(QStringLiteral("unusedBytes"), stats.unusedBytes);
+        statistics.insert(QStringLiteral("totalUsageBytes"), stats.totalUsageBytes);
+    }
+#else
+    Q_UNUSED(rhi);
+#endif
+
+    QMetaObject::invokeMethod(this, [this, usage, totalUsage, statistics, error]() {
+        m_memoryUsage = usage;
+        m_totalMemoryUsage = totalUsage;
+        m_rhiStatistics = statistics;
+        m_memoryError = error;
+        emit memoryUsageChanged();
+    }, Qt::QueuedConnection);
 }
 
-
-void ComputeItem::doCompute(QRhi *rhi, bool continuously)
+void ComputeItem::reportShaderError(const QString &error)
 {
-
-    if (!m_isInitialized || !m_pipelineIsInitialized) {
-        qWarning() << "ComputeItem is not initialized";
+    // render thread
+    if (error == m_renderShaderError) {
         return;
     }
 
-    if (m_hasErrors) {
-        qWarning() << "Error occurred";
-        return;
+    m_renderShaderError = error;
+    if (!error.isEmpty()) {
+        qWarning() << error;
     }
 
-    QSGRendererInterface *renderInterface = m_window->rendererInterface();
-    QRhiSwapChain *swapChain =
-        static_cast<QRhiSwapChain *>(renderInterface->getResource(m_window, QSGRendererInterface::RhiSwapchainResource));
+    QMetaObject::invokeMethod(this, [this, error]() {
+        setShaderError(error);
+    }, Qt::QueuedConnection);
+}
 
-    QRhiCommandBuffer *cb = swapChain->currentFrameCommandBuffer();
-    QRhiResourceUpdateBatch *updateBatch = rhi->nextResourceUpdateBatch();
-    if (m_initialUpdates) {
-        updateBatch->merge(m_initialUpdates);
-        m_initialUpdates->release();
-        m_initialUpdates = nullptr;
+void ComputeItem::setFixedTimestep(qreal timestep)
+{
+    if (timestep < 0.0) {
+        qWarning() << "Cannot set a negative timestep";
+        return;
     }
 
-    updateUniformBuffer(updateBatch);
-
-    cb->beginComputePass(updateBatch);
-    cb->setComputePipeline(m_computePipeline);
-    cb->setShaderResources();
-    cb->dispatch(m_dispatchX, m_dispatchY, m_dispatchZ);
-    cb->endComputePass();
-
-    if (continuously) {
-        m_isRunning = true;
-        m_window->update();
+    if (timestep != m_fixedTimestep) {
+        m_fixedTimestep = timestep;
+        emit fixedTimestepChanged();
     }
-
-    emit notifyChange();
 }
 
-void ComputeItem::releaseResources()
+void ComputeItem::setMaxStepsPerFrame(int steps)
 {
+    if (steps < 1) {
+        qWarning() << "At least one step per frame is required";
+        return;
+    }
 
-    qDeleteAll(m_releasePool);
-    m_releasePool.clear();
+    if (steps != m_maxStepsPerFrame) {
+        m_maxStepsPerFrame = steps;
+        // the builtins uniform buffer holds one slot per step
+        m_bindingsChanged = true;
+        emit maxStepsPerFrameChanged();
+    }
+}
 
-    if (m_initialUpdates) {
-        m_initialUpdates->release();
-        m_initialUpdates = nullptr;
+void ComputeItem::setGlobalSize(int dimension, int size)
+{
+    if (size < 0) {
+        qWarning() << "Cannot set a negative global size";
+        return;
     }
 
-    m_computeUBuf =  nullptr;
-    m_computeBindings =  nullptr;
-    m_computePipeline =  nullptr;
+    if (size == m_globalSize[dimension]) {
+        return;
+    }
 
-    m_rhiStorageBuffers.clear();
+    m_globalSize[dimension] = size;
+    // the number of dispatches and thus of ComputeBuiltins slots may change
+    m_bindingsChanged = true;
 
-    if (m_window) {
-        for (auto texture : m_qsgTextures) {
-            m_window->scheduleRenderJob(new CleanupPlainComputeTexture(texture), QQuickWindow::BeforeSynchronizingStage);
-        }
-    } else {
-        qDeleteAll(m_qsgTextures);
+    switch (dimension) {
+    case 0: emit globalSizeXChanged(); break;
+    case 1: emit globalSizeYChanged(); break;
+    default: emit globalSizeZChanged(); break;
     }
-    m_qsgTextures.clear();
 }
 
-void ComputeItem::init()
+void ComputeItem::updateDispatches(QRhi *rhi)
 {
-    const QWindowList windowList = QGuiApplication::allWindows();
-    for (auto w : std::as_const(windowList)) {
-        if ((m_window = qobject_cast<QQuickWindow *>(w))) {
-            break;
+    // render thread; called whenever the shader or the global size changed
+    m_dispatches.clear();
+    if (m_renderGlobalSize[0] <= 0) {
+        return;
+    }
+
+    const auto localSize = m_computeShader.description().computeShaderLocalSize();
+    const int localLimits[3] = { rhi->resourceLimit(QRhi::MaxThreadGroupX),
+                                 rhi->resourceLimit(QRhi::MaxThreadGroupY),
+                                 rhi->resourceLimit(QRhi::MaxThreadGroupZ) };
+    const int maxThreads = rhi->resourceLimit(QRhi::MaxThreadsPerThreadGroup);
+
+    int groups[3];
+    quint64 threads = 1;
+    for (int i = 0; i < 3; ++i) {
+        const int local = qMax(1, int(localSize[i]));
+        if (localLimits[i] > 0 && local > localLimits[i]) {
+            reportShaderError(QStringLiteral("Local size %1 of %2 exceeds the limit of %3").arg(local).arg(shaderName()).arg(localLimits[i]));
         }
+        threads *= quint64(local);
+        groups[i] = (qMax(1, m_renderGlobalSize[i]) + local - 1) / local;
+    }
+    if (maxThreads > 0 && threads > quint64(maxThreads)) {
+        reportShaderError(QStringLiteral("Work group of %1 has %2 invocations, the limit is %3").arg(shaderName()).arg(threads).arg(maxThreads));
     }
 
-    if (!m_window) {
-        qWarning() << "No QQuickWindow found; cannot init ComputeItem";
-        return;
+    int maxGroups = rhi->resourceLimit(QRhi::MaxThreadGroupsPerDimension);
+    if (maxGroups <= 0) {
+        maxGroups = 65535;
     }
 
-    m_isInitialized = true;
+    for (int z = 0; z < groups[2]; z += maxGroups) {
+        for (int y = 0; y < groups[1]; y += maxGroups) {
+            for (int x = 0; x < groups[0]; x += maxGroups) {
+                Dispatch dispatch;
+                dispatch.groups[0] = qMin(maxGroups, groups[0] - x);
+                dispatch.groups[1] = qMin(maxGroups, groups[1] - y);
+                dispatch.groups[2] = qMin(maxGroups, groups[2] - z);
+                dispatch.offset[0] = quint32(x);
+                dispatch.offset[1] = quint32(y);
+                dispatch.offset[2] = quint32(z);
+                m_dispatches << dispatch;
+            }
+        }
+    }
 
-    connect(m_window, &QQuickWindow::beforeSynchronizing, this, [this]() {
-        const auto rhi = rhiInterface();
-        initPipeline(rhi);
-        doCompute(rhi);
-    }, static_cast<Qt::ConnectionType>(Qt::DirectConnection | Qt::SingleShotConnection) );
+    if (m_dispatches.size() > 1 && m_builtinsBinding < 0) {
+        qWarning() << "The work of" << shaderName() << "exceeds" << maxGroups
+                   << "work groups per dimension; declare ComputeBuiltins and use workGroupOffset to split it";
+        m_dispatches.resize(1);
+    }
+}
+
+void ComputeItem::setTargetRate(qreal rate)
+{
+    if (rate < 0.0) {
+        qWarning() << "Cannot set a negative target rate";
+        return;
+    }
 
+    if (rate != m_targetRate) {
+        m_targetRate = rate;
+        emit targetRateChanged();
+    }
 }
 
-std::pair<QRhiTexture::Format, quint32> ComputeItem::toRhiTextureFormat(ImageBuffer::TextureFormat format) const
+void ComputeItem::setPauseWhenHidden(bool pause)
 {
-    switch (format) {
-        case ImageBuffer::RGBA8: return std::pair<QRhiTexture::Format, quint32>(QRhiTexture::RGBA8, 4);
-        case ImageBuffer::RGBA16F: return std::pair<QRhiTexture::Format, quint32>(QRhiTexture::RGBA16F, 8);
-        case ImageBuffer::RGBA32F: return std::pair<QRhiTexture::Format, quint32>(QRhiTexture::RGBA32F, 16);     
-        default: return std::pair<QRhiTexture::Format, quint32>(QRhiTexture::RGBA8, 4);
+    if (pause != m_pauseWhenHidden) {
+        m_pauseWhenHidden = pause;
+        if (!m_pauseWhenHidden && m_isRunning && m_window) {
+            m_window->update();
+        }
+        emit pauseWhenHiddenChanged();
     }
 }
 
+void ComputeItem::setBackend(Backend backend)
+{
+    if (backend != m_backend) {
+        m_backend = backend;
+        emit backendChanged();
+    }
+}
 
-void ComputeItem::initPipeline(QRhi *rhi)
+void ComputeItem::setCpuKernel(const QString &name)
 {
+    if (name != m_cpuKernelName) {
+        m_cpuKernelName = name;
+        emit cpuKernelChanged();
+    }
+}
 
-    if (!m_isInitialized || !rhi) {
+void ComputeItem::setMemoryBudget(qint64 bytes)
+{
+    bytes = qMax(qint64(0), bytes);
+    if (bytes == m_memoryBudget) {
         return;
     }
-
-    if (m_pipelineIsInitialized) {
-        releaseResources();
-        m_pipelineIsInitialized = false;
+    m_memoryBudget = bytes;
+    emit memoryBudgetChanged();
+
+    if (!m_memoryError.isEmpty()) {
+        // the rebuild that ran out of budget is tried again
+        m_buffersChanged = true;
+        if (m_window) {
+            m_window->update();
+        }
     }
+}
 
+void ComputeItem::setConvergenceBuffer(StorageBuffer *buffer)
+{
+    if (buffer != m_convergenceBuffer.data()) {
+        m_convergenceBuffer = buffer;
+        emit convergenceBufferChanged();
+    }
+}
 
-    m_hasErrors = false;
-    m_initialUpdates = rhi->nextResourceUpdateBatch();
+void ComputeItem::setConvergenceThreshold(qreal threshold)
+{
+    if (threshold != m_convergenceThreshold) {
+        m_convergenceThreshold = threshold;
+        emit convergenceThresholdChanged();
+    }
+}
 
-    m_computeUBuf = rhi->newBuffer(QRhiBuffer::Dynamic, QRhiBuffer::UniformBuffer, uniformBufferSize());
-    m_computeUBuf->create();
-    m_releasePool << m_computeUBuf;
+void ComputeItem::registerView(QQuickItem *view)
+{
+    if (!view || m_views.contains(view)) {
+        return;
+    }
 
-    updateUniformBuffer(m_initialUpdates);
+    m_views.append(view);
+    connect(view, &QQuickItem::visibleChanged, this, &ComputeItem::updateHidden);
+    connect(view, &QObject::destroyed, this, [this]() {
+        m_views.removeIf([](const QPointer<QQuickItem> &view) { return view.isNull(); });
+        updateHidden();
+    });
+    updateHidden();
+}
 
-    m_computeBindings = rhi->newShaderResourceBindings();
+void ComputeItem::unregisterView(QQuickItem *view)
+{
+    if (!view || !m_views.contains(view)) {
+        return;
+    }
 
-    std::vector<QRhiShaderResourceBinding> resourceBindingList;
-    quint32 binding = 0;
-    for (const auto buf : std::as_const(m_buffers)) {
-        const auto byteBuffer = buf->buffer();
-        qDebug() << "BYTE BUFFER HAS SIZE" << byteBuffer.size();
-        if (buf->type() == ComputeShaderBuffer::StorageBuffer) {
-            m_qsgTextures << nullptr;
-            if (byteBuffer.size() > 0) {
-                QRhiBuffer *rhiBuf = rhi->newBuffer(QRhiBuffer::Immutable, QRhiBuffer::StorageBuffer | QRhiBuffer::VertexBuffer, byteBuffer.size());
-                rhiBuf->create();
-
-                m_releasePool << rhiBuf;
-                m_rhiStorageBuffers << rhiBuf;
-
-                m_initialUpdates->uploadStaticBuffer(rhiBuf, byteBuffer.constData());
-                resourceBindingList.push_back(QRhiShaderResourceBinding::bufferLoadStore(binding, QRhiShaderResourceBinding::ComputeStage, rhiBuf));
-                binding++;
-            } else {
-                qWarning() << "Cannot upload empty storage buffer";
-            }
-        } else {
-            m_rhiStorageBuffers << nullptr;
-
-            if (buf->type() == ComputeShaderBuffer::Image) {
-                ImageBuffer *imageBuffer = qobject_cast<ImageBuffer*>(buf);
-                Q_ASSERT(imageBuffer);
-                if (byteBuffer.size() > 0) {
-
-                    const auto formatData = toRhiTextureFormat(imageBuffer->textureFormat());
-                    const auto textureFormat = formatData.first;
-                    const auto bytesPerPixel = formatData.second;
-                    const auto imageSize = imageBuffer->imageSize();
-                    const auto dataSize = imageSize.width() * imageSize.height() * bytesPerPixel;
-                    qDebug() << "Image size is" << dataSize;
-                    if (dataSize == byteBuffer.size()) {
-
-                        QRhiTexture *texture = rhi->newTexture(textureFormat, imageSize, 1, QRhiTexture::UsedWithLoadStore);
-                        texture->create();
-                        m_releasePool << texture;
-
-                        QRhiTextureUploadDescription textureDesc({ 0, 0, { byteBuffer.constData(), quint32(byteBuffer.size()) } });
-                        m_initialUpdates->uploadTexture(texture, textureDesc);
-                        resourceBindingList.push_back(QRhiShaderResourceBinding::imageLoadStore(binding, QRhiShaderResourceBinding::ComputeStage, texture, 0));
-                        binding++;
-
-                        auto qsgTexture = new PlainComputeTexture(texture, imageSize);
-                        imageBuffer->setQSGTexture(qsgTexture);
-                        m_qsgTextures.push_back(qsgTexture);
-
-                    } else {
-                        qWarning() << "Size mismatch; cannot upload image buffer";
-                        m_hasErrors = true;
-                    }
-
-                } else if (!imageBuffer->imageSource().isEmpty()) {
-                    QImage image = QImage(imageBuffer->imageSource()).convertToFormat(QImage::Format_RGBA8888);
-
-                    QRhiTexture *texture = rhi->newTexture(QRhiTexture::RGBA8, image.size(), 1, QRhiTexture::UsedWithLoadStore);
-                    texture->create();
-                    m_releasePool << texture;
-
-                    m_initialUpdates->uploadTexture(texture, image);
-                    resourceBindingList.push_back(QRhiShaderResourceBinding::imageLoadStore(binding, QRhiShaderResourceBinding::ComputeStage, texture, 0));
-                    binding++;
-
-                    auto qsgTexture = new PlainComputeTexture(texture, image.size());
-                    imageBuffer->setQSGTexture(qsgTexture);
-                    m_qsgTextures.push_back(qsgTexture);
+    m_views.removeAll(view);
+    disconnect(view, nullptr, this, nullptr);
+    updateHidden();
+}
 
-                } else {
-                    qWarning() << "Cannot upload image data";
-                    m_hasErrors = true;
-                }
+void ComputeItem::updateHidden()
+{
+    bool hidden = !m_window || !m_window->isVisible() || m_window->visibility() == QWindow::Minimized;
+    if (!hidden && !m_views.isEmpty()) {
+        hidden = std::none_of(m_views.cbegin(), m_views.cend(), [](const QPointer<QQuickItem> &view) {
+            return view && view->isVisible();
+        });
+    }
 
-            }
+    if (hidden != m_hidden) {
+        m_hidden = hidden;
+        // a paused computation does not request new frames; resume it
+        if (!m_hidden && m_isRunning && m_window) {
+            m_window->update();
         }
     }
+}
 
-    Q_ASSERT(m_rhiStorageBuffers.length() == m_buffers.length()); // list contains rhi buffers for storage buffers and nullptr for images
-    Q_ASSERT(m_qsgTextures.length() == m_buffers.length()); // list contains nullptr for storage buffers and QSGTextures for images
+void ComputeItem::handleResidual(float residual)
+{
+    if (residual != m_residual) {
+        m_residual = residual;
+        emit residualChanged();
+    }
 
-    resourceBindingList.push_back(QRhiShaderResourceBinding::uniformBuffer(binding, QRhiShaderResourceBinding::ComputeStage, m_computeUBuf));
+    if (m_isRunning && m_convergenceBuffer && residual < m_convergenceThreshold) {
+        stop();
+        emit converged();
+    }
+}
+
+QQmlListProperty<ComputeShaderBuffer> ComputeItem::buffers()
+{
+    return QQmlListProperty<ComputeShaderBuffer>(this, nullptr, &ComputeItem::append_storageBuffer, nullptr,
+        nullptr, nullptr, nullptr, nullptr);
+}
+
+void ComputeItem::append_storageBuffer(QQmlListProperty<ComputeShaderBuffer> *list, ComputeShaderBuffer *buffer)
+{
+
+    if (!buffer) {
+        qWarning() << "Cannot add empty buffer";
+        return;
+    }
+
+    ComputeItem *computeItem = qobject_cast<ComputeItem *>(list->object);
+    if (computeItem) {
+        if (computeItem->m_buffers.contains(buffer)) {
+            qWarning() << "Cannot add the same buffer object twice";
+            return;
+        }
+
+        computeItem->m_buffers.append(buffer);
+
+        connect(buffer, &ComputeShaderBuffer::bufferChanged, computeItem, [computeItem, buffer]() {
+            // only the resources of this buffer need to be recreated
+            computeItem->m_changedBuffers.insert(computeItem->m_buffers.indexOf(buffer));
+        }, Qt::DirectConnection );
+
+        connect(buffer, &ComputeShaderBuffer::resetRequested, computeItem, [computeItem, buffer]() {
+            computeItem->m_resetBuffers.insert(computeItem->m_buffers.indexOf(buffer));
+            if (computeItem->m_window) {
+                computeItem->m_window->update();
+            }
+        }, Qt::DirectConnection);
+
+        if (auto counter = qobject_cast<CounterBuffer *>(buffer)) {
+            connect(counter, &QObject::destroyed, computeItem, [computeItem, counter]() {
+                if (computeItem->m_scheduler) {
+                    computeItem->m_scheduler->forgetCounter(computeItem, counter);
+                } else {
+                    computeItem->forgetCounter(counter);
+                }
+            }, Qt::DirectConnection);
+        }
+
+        // the first ComputeItem owns the GPU resource, all others bind it as well
+        if (!buffer->hasComputeItem()) {
+            buffer->setComputeItem(computeItem);
+        }
+        computeItem->m_buffersChanged = true;
+    }
+
+}
+
+ComputeShaderBuffer* ComputeItem::bufferAt(int idx) const
+{
+    if ((idx < 0) || (idx >= m_buffers.size())) {
+        qWarning() << "Cannot get buffer: Index out of bounds";
+        return nullptr;
+    }
+    return m_buffers.at(idx);
+}
+
+
+QRhiBuffer* ComputeItem::rhiStorageBufferAt(int idx) const
+{
+    if ((idx < 0) || (idx >= m_rhiStorageBuffers.size())) {
+        qWarning() << "Cannot get QRhiBuffer: Index out of bounds";
+        return nullptr;
+    }
+    return m_rhiStorageBuffers.at(idx);
+}
+
+void ComputeItem::requestBufferResize(ComputeShaderBuffer *buffer, bool preserve, const QByteArray &pattern)
+{
+    const int index = m_buffers.indexOf(buffer);
+    if (index < 0) {
+        return;
+    }
+
+    ResizeRequest request { index, quint32(buffer->buffer().size()), QSize(), preserve, pattern };
+    if (auto imageBuffer = qobject_cast<ImageBuffer *>(buffer)) {
+        request.imageSize = imageBuffer->imageSize();
+    }
+    m_resizeRequests.append(request);
+}
+
+void ComputeItem::requestBufferRangeUpload(ComputeShaderBuffer *buffer, quint32 offset, const QByteArray &data)
+{
+    const int index = m_buffers.indexOf(buffer);
+    if (index < 0 || data.isEmpty()) {
+        return;
+    }
+
+    // writes of consecutive elements become one upload
+    if (!m_rangeUploads.isEmpty()) {
+        RangeUpload &last = m_rangeUploads.last();
+        if (last.index == index && last.offset + quint32(last.data.size()) == offset) {
+            last.data.append(data);
+            return;
+        }
+    }
+    m_rangeUploads.append({ index, offset, data });
+
+    if (m_window) {
+        m_window->update();
+    }
+}
+
+QSGTexture* ComputeItem::qsgTextureAt(int idx) const
+{
+    if ((idx < 0) || (idx >= m_qsgTextures.size())) {
+        qWarning() << "Cannot get QSGTexture: Index out of bounds";
+        return nullptr;
+    }
+    return m_qsgTextures.at(idx);
+}
+
+
+void ComputeItem::componentComplete()
+{
+    handleDynamicProperties();
+}
+
+void ComputeItem::handleDynamicProperties()
+{
+
+    const QMetaObject *metaObject = this->metaObject();
+
+    const QMetaObject &bindingMetaObject = UniformPropertyBinding::staticMetaObject;
+    const QMetaMethod updateMethod = bindingMetaObject.method(bindingMetaObject.indexOfSlot("update()"));
+
+    for (int i = 0; i < metaObject->propertyCount(); ++i) {
+        QMetaProperty property = metaObject->property(i);
+        const QString propertyName = property.name();
+        const QVariant propertyValue = this->property(propertyName.toUtf8());
+
+        if (property.hasNotifySignal() && isValidUniformProperty(propertyName, propertyValue)) {
+            const QMetaType::Type metaType = static_cast<const QMetaType::Type>(propertyValue.metaType().id());
+            UniformProperty uniformProperty;
+            uniformProperty.name = propertyName;
+            uniformProperty.metaType = metaType;
+            uniformProperty.offset = uniformBufferSize();
+            // int and bool are stored as 4 byte integers
+            // QML real and double properties are both stored as QMetaType::Double internally
+            // we support only 4 byte float uniforms for now
+            uniformProperty.sizeInBytes = 4;
+
+            m_uniformData.resize(uniformProperty.offset + uniformProperty.sizeInBytes);
+            writeUniformValue(uniformProperty, propertyValue);
+
+            m_uniformPropertyList.append(uniformProperty);
+
+            // resolve the property once; changes are written straight into the uniform slot
+            auto binding = new UniformPropertyBinding(this, property, metaType, uniformProperty.offset);
+            connect(this, property.notifySignal(), binding, updateMethod);
+        }
+    }
+
+    m_uniformDataChanged = true;
+}
+
+bool ComputeItem::isValidUniformProperty(const QString &name, const QVariant &value) const
+{
+    // check for ComputeItem's properties
+    if (ComputeItem::staticMetaObject.indexOfProperty(name.toUtf8().constData()) != -1) {
+        return false;
+    }
+
+    const QMetaType::Type metaType = static_cast<const QMetaType::Type>(value.metaType().id());
+    return value.isValid() &&
+        (metaType == QMetaType::Int || metaType == QMetaType::Bool || metaType == QMetaType::Double);
+}
+
+quint32 ComputeItem::uniformBufferSize() const
+{
+    quint32 size = 0;
+    for (const auto &item : std::as_const(m_uniformPropertyList)) {
+        size += item.sizeInBytes;
+    }
+    return size;
+}
+
+void ComputeItem::writeUniformValue(const UniformProperty &uniformProperty, const QVariant &value)
+{
+    if (uniformProperty.metaType == QMetaType::Int || uniformProperty.metaType == QMetaType::Bool) {
+        const qint32 i32value = value.toInt();
+        writeUniformData(uniformProperty.offset, &i32value, sizeof(qint32));
+    } else if (uniformProperty.metaType == QMetaType::Double) {
+        const float fvalue = value.toFloat();
+        writeUniformData(uniformProperty.offset, &fvalue, sizeof(float));
+    }
+}
+
+void ComputeItem::writeUniformData(quint32 offset, const void *data, quint32 size)
+{
+    // GUI thread only
+    Q_ASSERT(offset + size <= quint32(m_uniformData.size()));
+    memcpy(m_uniformData.data() + offset, data, size);
+    m_uniformDataChanged = true;
+}
+
+void ComputeItem::synchronize()
+{
+    // called on the render thread while the GUI thread is blocked
+    syncUniformData();
+
+    m_renderFixedTimestep = m_fixedTimestep;
+    m_renderMaxStepsPerFrame = m_maxStepsPerFrame;
+    m_renderTargetRate = m_targetRate;
+    m_renderPaused = m_pauseWhenHidden && m_hidden;
+    m_renderConvergenceBuffer = m_convergenceBuffer.data();
+    m_renderRunning = m_isRunning;
+    m_renderShaderFilename = m_computeShaderFilename;
+    m_renderShaderSource = m_computeShaderSource;
+    m_renderDefinesPreamble = m_definesPreamble;
+
+    if (m_autotuneChanged) {
+        m_renderAutotune = m_autotune;
+        m_renderAutotuneCandidates.clear();
+        for (const auto &candidate : std::as_const(m_autotuneCandidates)) {
+            m_renderAutotuneCandidates << candidate.toInt();
+        }
+        m_autotunePending = m_autotune;
+        if (!m_autotune && !m_tunedPreamble.isEmpty()) {
+            // back to the local size of the shader
+            m_tunedPreamble.clear();
+            m_renderShaderReloaded = true;
+            m_dirty = true;
+        }
+        m_autotuneChanged = false;
+    }
+    std::copy(std::begin(m_globalSize), std::end(m_globalSize), std::begin(m_renderGlobalSize));
+    m_renderStepRequests += m_stepRequests;
+    m_stepRequests = 0;
+
+    // buffers whose owner is gone are taken over
+    for (const auto buffer : std::as_const(m_buffers)) {
+        if (!buffer->hasComputeItem()) {
+            buffer->setComputeItem(this);
+            m_buffersChanged = true;
+        }
+    }
+    m_renderProducers = producers();
+
+    m_renderInitializers.resize(m_buffers.size());
+    m_renderWrittenRanges.resize(m_buffers.size());
+    for (int i = 0; i < m_buffers.size(); ++i) {
+        m_renderInitializers[i] = m_buffers.at(i)->initializerParameters();
+        const auto storageBuffer = qobject_cast<StorageBuffer *>(m_buffers.at(i));
+        m_renderWrittenRanges[i] = storageBuffer ? storageBuffer->writtenRanges() : QVector<StorageBuffer::WrittenRange>();
+    }
+    m_renderResetBuffers.unite(m_resetBuffers);
+    m_resetBuffers.clear();
+    m_renderRangeUploads += m_rangeUploads;
+    m_rangeUploads.clear();
+    QVector<Counter> counters;
+    for (int i = 0; i < m_buffers.size(); ++i) {
+        if (auto counter = qobject_cast<CounterBuffer *>(m_buffers.at(i))) {
+            counters.append({ i, counter, counter->resetValue(), counter->autoReset() });
+        }
+    }
+    const bool countersChanged = counters.size() != m_renderCounters.size()
+        || !std::equal(counters.cbegin(), counters.cend(), m_renderCounters.cbegin(), [](const Counter &a, const Counter &b) {
+               return a.index == b.index && a.buffer == b.buffer;
+           });
+    if (countersChanged) {
+        // the readbacks report to the counter they were created for
+        releaseCounterReadbacks();
+    }
+    const bool resetsChanged = countersChanged
+        || !std::equal(counters.cbegin(), counters.cend(), m_renderCounters.cbegin(), [](const Counter &a, const Counter &b) {
+               return a.resetValue == b.resetValue && a.autoReset == b.autoReset;
+           });
+    if (resetsChanged) {
+        releaseCounterFills();
+    }
+    m_renderCounters = counters;
+    m_renderMemoryBudget = m_memoryBudget;
+
+    if (m_buffersChanged || m_shaderChanged || m_shaderReloaded || m_bindingsChanged || !m_changedBuffers.isEmpty() || !m_resizeRequests.isEmpty()) {
+        m_renderBuffersChanged = m_renderBuffersChanged || m_buffersChanged;
+        m_renderShaderChanged = m_renderShaderChanged || m_shaderChanged;
+        m_renderShaderReloaded = m_renderShaderReloaded || m_shaderReloaded;
+        m_renderBindingsChanged = m_renderBindingsChanged || m_bindingsChanged;
+        m_renderChangedBuffers.unite(m_changedBuffers);
+        m_renderResizeRequests += m_resizeRequests;
+
+        m_buffersChanged = false;
+        m_shaderChanged = false;
+        m_shaderReloaded = false;
+        m_bindingsChanged = false;
+        m_changedBuffers.clear();
+        m_resizeRequests.clear();
+        m_dirty = true;
+    }
+    if (m_clockResetRequested) {
+        m_renderClockResetRequested = true;
+        m_clockResetRequested = false;
+    }
+    if (m_clockRestoreRequested) {
+        m_renderRestoredClock = m_restoredClock;
+        m_renderClockRestoreRequested = true;
+        m_clockRestoreRequested = false;
+    }
+    if (!m_saveStatePath.isEmpty()) {
+        m_renderSaveStatePath = m_saveStatePath;
+        m_renderSaveStateUniforms = m_saveStateUniforms;
+        m_saveStatePath.clear();
+        m_saveStateUniforms.clear();
+    }
+
+    if (m_backend != m_renderBackend || m_cpuKernelName != m_renderCpuKernelName) {
+        m_renderBackend = m_backend;
+        m_renderCpuKernelName = m_cpuKernelName;
+        // the backend is picked and the CPU copies are taken on a full rebuild
+        m_renderBuffersChanged = true;
+        m_dirty = true;
+    }
+}
+
+void ComputeItem::syncUniformData()
+{
+    // Called on the render thread while the GUI thread is blocked. Taking a shallow copy is
+    // enough: the next write on the GUI thread detaches m_uniformData from the snapshot.
+    if (m_uniformDataChanged) {
+        m_renderUniformData = m_uniformData;
+        m_uniformDataChanged = false;
+    }
+}
+
+void ComputeItem::updateUniformBuffer(QRhiResourceUpdateBatch *updateBatch)
+{
+    if (!m_computeUBuf || m_renderUniformData.isEmpty()) {
+        return;
+    }
+
+    const quint32 size = qMin(quint32(m_renderUniformData.size()), m_computeUBuf->size());
+    updateBatch->updateDynamicBuffer(m_computeUBuf, 0, size, m_renderUniformData.constData());
+}
+
+int ComputeItem::advanceClock(QRhiResourceUpdateBatch *updateBatch, bool singleStep, int firstStep)
+{
+    if (m_renderClockResetRequested) {
+        m_clock.invalidate();
+        m_accumulator = 0.0;
+        m_simulationTime = 0.0;
+        m_step = 0;
+        m_frameIndex = 0;
+        m_renderClockResetRequested = false;
+    }
+    if (m_renderClockRestoreRequested) {
+        m_clock.invalidate();
+        m_accumulator = 0.0;
+        m_simulationTime = m_renderRestoredClock.elapsed;
+        m_step = m_renderRestoredClock.step;
+        m_frameIndex = m_renderRestoredClock.frame;
+        m_renderClockRestoreRequested = false;
+    }
+
+    if (!m_clock.isValid()) {
+        m_clock.start();
+        m_lastClockNs = 0;
+    }
+
+    const qint64 nowNs = m_clock.nsecsElapsed();
+    const qreal frameDelta = qreal(nowNs - m_lastClockNs) / 1e9;
+    m_lastClockNs = nowNs;
+
+    const bool hasSlots = m_builtinsBinding >= 0 && m_builtinsUBuf;
+    if (!hasSlots && !m_cpuActive) {
+        m_frameIndex++;
+        return 1;
+    }
+
+    // CPU kernels get the builtins without ComputeBuiltins slots
+    const int slotSteps = hasSlots ? int(m_builtinsUBuf->size() / (m_builtinsSlotSize * quint32(m_builtinsSlotsPerStep))) : m_renderMaxStepsPerFrame;
+    const int maxSteps = qMin(m_renderMaxStepsPerFrame, slotSteps) - firstStep;
+    if (maxSteps <= 0) {
+        return 0;
+    }
+
+    int steps = qMin(1, maxSteps);
+    qreal stepDelta = frameDelta;
+    if (m_renderFixedTimestep > 0.0) {
+        stepDelta = m_renderFixedTimestep;
+        if (!singleStep) {
+            m_accumulator += frameDelta;
+            steps = qMin(int(m_accumulator / m_renderFixedTimestep), maxSteps);
+            m_accumulator -= steps * m_renderFixedTimestep;
+            // drop the backlog instead of falling behind further if the GPU cannot keep up
+            m_accumulator = qMin(m_accumulator, m_renderFixedTimestep);
+        }
+    }
+
+    for (int i = 0; i < steps; ++i) {
+        m_simulationTime += stepDelta;
+
+        ComputeBuiltins builtins;
+        builtins.step = m_step++;
+        builtins.frame = m_frameIndex;
+        builtins.elapsed = float(m_simulationTime);
+        builtins.delta = float(stepDelta);
+
+        if (m_cpuActive) {
+            m_cpuSteps.append({ builtins.step, builtins.frame, builtins.elapsed, builtins.delta });
+        }
+
+        // one slot per split dispatch, only the work group offset differs
+        for (int j = 0; hasSlots && j < m_builtinsSlotsPerStep; ++j) {
+            const Dispatch *dispatch = j < m_dispatches.size() ? &m_dispatches.at(j) : nullptr;
+            for (int k = 0; k < 3; ++k) {
+                builtins.workGroupOffset[k] = dispatch ? dispatch->offset[k] : 0;
+            }
+            builtins.workGroupOffset[3] = 0;
+            const quint32 slot = quint32((firstStep + i) * m_builtinsSlotsPerStep + j);
+            updateBatch->updateDynamicBuffer(m_builtinsUBuf, slot * m_builtinsSlotSize, sizeof(ComputeBuiltins), &builtins);
+        }
+    }
+
+    m_frameIndex++;
+    return steps;
+}
+
+
+void ComputeItem::computeStep()
+{
+    if (!m_isInitialized) {
+        qWarning() << "ComputeItem is not initialized";
+        return;
+    }
+
+    // recorded with the next frame, see ComputeScheduler
+    m_stepRequests++;
+    m_window->update();
+}
+
+void ComputeItem::compute()
+{
+    if (!m_isInitialized) {
+        qWarning() << "ComputeItem is not initialized";
+        return;
+    }
+
+    if (m_isRunning) {
+        return;
+    }
+
+    m_isRunning = true;
+    m_window->update();
+}
+
+void ComputeItem::stop()
+{
+    if (!m_isInitialized) {
+        qWarning() << "ComputeItem is not initialized";
+        return;
+    }
+
+    if (!m_isRunning) {
+        return;
+    }
+
+    m_updateTimer.stop();
+    m_isRunning = false;
+}
+
+QVector<ComputeItem *> ComputeItem::producers() const
+{
+    QVector<ComputeItem *> items;
+    for (const auto buffer : m_buffers) {
+        ComputeItem *owner = buffer->computeItem();
+        if (owner && owner != this && !items.contains(owner)) {
+            items << owner;
+        }
+    }
+    return items;
+}
+
+bool ComputeItem::updatePipeline(QRhi *rhi)
+{
+    // render thread; borrowed resources are fetched again when a producer has replaced them
+    for (auto producer : std::as_const(m_renderProducers)) {
+        if (producer->m_resourceGeneration != m_producerGenerations.value(producer)) {
+            for (int i = 0; i < m_borrowedResources.size(); ++i) {
+                if (m_borrowedResources.at(i)) {
+                    m_renderChangedBuffers.insert(i);
+                }
+            }
+            m_dirty = true;
+            break;
+        }
+    }
+
+    if (!m_pipelineIsInitialized || m_dirty) {
+        initPipeline(rhi);
+    }
+    return m_pipelineIsInitialized && !m_dirty;
+}
+
+void ComputeItem::beginFrame(QRhi *rhi)
+{
+    // render thread, before the frame of the window has begun
+    if (m_autotunePending && m_pipelineIsInitialized && !m_dirty && m_computePipeline && !m_cpuActive) {
+        runAutotune(rhi);
+    }
+}
+
+bool ComputeItem::prepareFrame(QRhi *rhi, QRhiCommandBuffer *cb, QRhiResourceUpdateBatch *updateBatch)
+{
+    TraceSpan span("ComputeItem::prepareFrame");
+    // render thread; the producers of shared buffers have been prepared already
+    m_framePrepared = false;
+    m_recordedContinuously = false;
+    m_recordedSteps = 0;
+    m_cpuSteps.clear();
+
+    if (m_trimPending) {
+        // the frame copying from the resources replaced by a resize has been submitted; do not
+        // hold twice the memory until the next rebuild
+        m_trimPending = false;
+        m_resourcePool.trim();
+        reportMemoryUsage(rhi);
+    }
+
+    if (m_renderStepRequests == 0 && !m_renderRunning) {
+        // Nothing to compute. Uploads, resize copies and initializer fills of a rebuild are
+        // recorded anyway, views bind the new resources right away. A requested snapshot is
+        // taken of the current contents.
+        const bool saveState = !m_renderSaveStatePath.isEmpty();
+        const bool pendingUpdates = m_initialUpdates || m_bufferResizer.hasPendingCopies() || m_initializerKernels.hasPendingFills();
+        if ((saveState || pendingUpdates || !m_renderResetBuffers.isEmpty() || !m_renderRangeUploads.isEmpty()) && m_pipelineIsInitialized && !m_dirty) {
+            resetBuffers(rhi);
+            flushInitialUpdates(cb, updateBatch);
+            uploadBufferRanges(updateBatch);
+            // the copies from resources replaced by a resize are recorded
+            releaseRetiredResources();
+            if (saveState) {
+                readBackState(updateBatch);
+            }
+        }
+        return false;
+    }
+
+    if (!updatePipeline(rhi)) {
+        // waiting for the resources of a producer; try again with the next frame
+        m_window->update();
+        return false;
+    }
+
+    if (!m_isInitialized || !m_pipelineIsInitialized) {
+        qWarning() << "ComputeItem is not initialized";
+        return false;
+    }
+
+    if (m_hasErrors || !m_resourcePool.budgetError().isEmpty() || (!m_computePipeline && !m_cpuActive)) {
+        // reported once by the rebuild that failed; nothing is dispatched until the next one
+        return false;
+    }
+
+    resetBuffers(rhi);
+    flushInitialUpdates(cb, updateBatch);
+    uploadBufferRanges(updateBatch);
+    updateUniformBuffer(updateBatch);
+
+    for (; m_renderStepRequests > 0; --m_renderStepRequests) {
+        if (prepareCompute(updateBatch, /* continuously = */ false) == 0) {
+            // all ComputeBuiltins slots of this frame are taken; continue with the next one
+            m_window->update();
+            break;
+        }
+    }
+
+    if (m_renderRunning) {
+        if (isComputeDue()) {
+            prepareCompute(updateBatch, /* continuously = */ true);
+            m_recordedContinuously = true;
+        } else {
+            requestNextCompute();
+        }
+    }
+
+    if (m_framePrepared) {
+        resetCounters(rhi, updateBatch);
+    }
+
+    if (m_cpuActive && m_recordedSteps > 0) {
+        runCpuSteps(updateBatch);
+    }
+
+    return m_framePrepared;
+}
+
+void ComputeItem::flushInitialUpdates(QRhiCommandBuffer *cb, QRhiResourceUpdateBatch *updateBatch)
+{
+    // the copies of the previous frame are recorded; their transient resources are no longer needed
+    m_bufferResizer.releaseFinished();
+    m_initializerKernels.releaseFinished();
+    if (m_bufferResizer.hasPendingCopies()) {
+        // resized buffers get their contents before the first dispatch reads them; the
+        // copies need a pass of their own ahead of the shared one
+        m_bufferResizer.recordCopies(cb, m_initialUpdates);
+        m_initialUpdates = nullptr;
+    }
+    if (m_initializerKernels.hasPendingFills()) {
+        // after the uploads, so that initializers can fill single fields of uploaded data
+        m_initializerKernels.recordFills(cb, m_initialUpdates);
+        m_initialUpdates = nullptr;
+    }
+
+    if (m_initialUpdates) {
+        updateBatch->merge(m_initialUpdates);
+        m_initialUpdates->release();
+        m_initialUpdates = nullptr;
+    }
+}
+
+void ComputeItem::resetBuffers(QRhi *rhi)
+{
+    // render thread; shared buffers are reset by their owner
+    if (m_renderResetBuffers.isEmpty()) {
+        return;
+    }
+
+    if (!m_initialUpdates) {
+        m_initialUpdates = rhi->nextResourceUpdateBatch();
+    }
+    for (const int index : std::as_const(m_renderResetBuffers)) {
+        if (index >= 0 && index < m_buffers.size() && !m_borrowedResources.at(index)) {
+            runInitializers(rhi, index);
+        }
+    }
+    m_renderResetBuffers.clear();
+}
+
+void ComputeItem::uploadBufferRanges(QRhiResourceUpdateBatch *updateBatch)
+{
+    // render thread; after the initial updates, so that the ranges are written after resize
+    // copies and initializer fills of the same frame
+    for (const auto &upload : std::as_const(m_renderRangeUploads)) {
+        if (upload.index >= m_buffers.size() || m_borrowedResources.at(upload.index)) {
+            continue;
+        }
+        QRhiBuffer *buffer = m_rhiStorageBuffers.at(upload.index);
+        const quint32 size = quint32(upload.data.size());
+        if (!buffer || upload.offset + size > buffer->size()) {
+            qWarning() << "Cannot upload storage buffer range: Out of bounds";
+            continue;
+        }
+
+        if (m_cpuActive) {
+            // the CPU copy is what the kernel works on
+            QByteArray &data = m_cpuData[upload.index];
+            if (qsizetype(upload.offset + size) <= data.size()) {
+                memcpy(data.data() + upload.offset, upload.data.constData(), size);
+            }
+        }
+        updateBatch->uploadStaticBuffer(buffer, upload.offset, size, upload.data.constData());
+    }
+    m_renderRangeUploads.clear();
+}
+
+void ComputeItem::resetCounters(QRhi *rhi, QRhiResourceUpdateBatch *updateBatch)
+{
+    // render thread; shared counters are reset by their owner. Every step starts from the reset
+    // value: a one thread fill is recorded before each step, see recordCounterResets(), and the
+    // CPU backend resets before each step in runCpuSteps().
+    if (m_cpuActive) {
+        return;
+    }
+    for (const auto &counter : std::as_const(m_renderCounters)) {
+        if (!counter.autoReset || counter.index >= m_rhiStorageBuffers.size() || m_borrowedResources.at(counter.index)
+            || m_counterFills.contains(counter.index)) {
+            continue;
+        }
+        QRhiBuffer *buffer = m_rhiStorageBuffers.at(counter.index);
+        if (!buffer) {
+            continue;
+        }
+
+        // exact for reset values up to 2^24, the fill takes its value as a float
+        BufferInitializer::Parameters parameters;
+        parameters.valueType = BufferInitializer::UInt;
+        parameters.count = 1;
+        parameters.value[0] = float(counter.resetValue);
+        const int fill = m_initializerKernels.createRecurringFill(rhi, updateBatch, parameters, buffer);
+        if (fill >= 0) {
+            m_counterFills.insert(counter.index, fill);
+        } else {
+            // without the fill kernel the counter is reset once per frame
+            updateBatch->uploadStaticBuffer(buffer, 0, sizeof(quint32), &counter.resetValue);
+        }
+    }
+}
+
+void ComputeItem::recordCounterResets(QRhiCommandBuffer *cb)
+{
+    // render thread, inside the compute pass; QRhi puts a barrier between the fill and the step
+    for (const int fill : std::as_const(m_counterFills)) {
+        m_initializerKernels.recordRecurringFill(cb, fill);
+    }
+    cb->setComputePipeline(m_computePipeline);
+}
+
+void ComputeItem::resetCpuCounters(const QVector<CpuComputeContext::Resource> &resources)
+{
+    // render thread, between the steps of runCpuSteps()
+    for (const auto &counter : std::as_const(m_renderCounters)) {
+        if (!counter.autoReset || counter.index >= resources.size() || m_borrowedResources.at(counter.index)) {
+            continue;
+        }
+        const CpuComputeContext::Resource &resource = resources.at(counter.index);
+        if (resource.data && resource.size >= qsizetype(sizeof(quint32))) {
+            memcpy(resource.data, &counter.resetValue, sizeof(quint32));
+        }
+    }
+}
+
+void ComputeItem::readBackCounters(QRhiResourceUpdateBatch *readbacks)
+{
+    // render thread under the mutex of the scheduler, so the counters are still alive here; the
+    // views of the counter pick up its render value
+    for (const auto &counter : std::as_const(m_renderCounters)) {
+        const auto value = m_counterValues.constFind(counter.index);
+        if (counter.buffer && value != m_counterValues.constEnd()) {
+            counter.buffer->setRenderValue(value.value());
+        }
+    }
+    m_counterValues.clear();
+
+    for (const auto &counter : std::as_const(m_renderCounters)) {
+        if (counter.index >= m_rhiStorageBuffers.size() || m_borrowedResources.at(counter.index)) {
+            continue;
+        }
+        QRhiBuffer *buffer = m_rhiStorageBuffers.at(counter.index);
+        if (!buffer) {
+            continue;
+        }
+
+        if (m_cpuActive) {
+            // the CPU copy is current already
+            const QByteArray *data = cpuData(counter.index);
+            if (counter.buffer && data && data->size() >= qsizetype(sizeof(quint32))) {
+                quint32 value;
+                memcpy(&value, data->constData(), sizeof(quint32));
+                counter.buffer->setRenderValue(value);
+            }
+            continue;
+        }
+
+        AsyncReadback *&readback = m_counterReadbacks[counter.index];
+        if (!readback) {
+            // completes within QRhi, outside of the mutex; the counter may be gone by then
+            const int index = counter.index;
+            readback = new AsyncReadback([this, index](const QByteArray &data) {
+                if (data.size() >= qsizetype(sizeof(quint32))) {
+                    quint32 value;
+                    memcpy(&value, data.constData(), sizeof(quint32));
+                    m_counterValues.insert(index, value);
+                }
+            });
+        }
+
+        // a fixed 4 byte readback, at most one in flight
+        if (!readback->isPending()) {
+            readback->readBackBuffer(readbacks, buffer, 0, sizeof(quint32));
+        }
+    }
+}
+
+void ComputeItem::releaseCounterReadbacks()
+{
+    for (auto readback : std::as_const(m_counterReadbacks)) {
+        readback->release();
+    }
+    m_counterReadbacks.clear();
+    m_counterValues.clear();
+}
+
+void ComputeItem::releaseCounterFills()
+{
+    for (const int fill : std::as_const(m_counterFills)) {
+        m_initializerKernels.releaseRecurringFill(fill);
+    }
+    m_counterFills.clear();
+}
+
+void ComputeItem::forgetCounter(CounterBuffer *counter)
+{
+    // GUI thread; the completed readbacks are not handed to it anymore
+    for (auto &renderCounter : m_renderCounters) {
+        if (renderCounter.buffer == counter) {
+            renderCounter.buffer = nullptr;
+        }
+    }
+}
+
+bool ComputeItem::isComputeDue()
+{
+    // render thread
+    if (m_renderPaused) {
+        return false;
+    }
+
+    if (m_renderTargetRate <= 0.0) {
+        return true;
+    }
+
+    if (!m_rateTimer.isValid()) {
+        m_rateTimer.start();
+        m_lastComputeNs = -1;
+    }
+
+    const qint64 nowNs = m_rateTimer.nsecsElapsed();
+    const qint64 intervalNs = qint64(1e9 / m_renderTargetRate);
+    if (m_lastComputeNs >= 0 && nowNs - m_lastComputeNs < intervalNs) {
+        return false;
+    }
+
+    m_lastComputeNs = nowNs;
+    return true;
+}
+
+void ComputeItem::requestNextCompute()
+{
+    // render thread
+    if (m_renderPaused) {
+        // no new frames while hidden; updateHidden() resumes
+        return;
+    }
+
+    if (m_renderTargetRate <= 0.0) {
+        m_window->update();
+        return;
+    }
+
+    // wait on the GUI thread instead of rendering at full refresh rate
+    const qint64 intervalNs = qint64(1e9 / m_renderTargetRate);
+    const qint64 remainingNs = qMax<qint64>(0, m_lastComputeNs + intervalNs - m_rateTimer.nsecsElapsed());
+    const int delayMs = int(remainingNs / 1000000);
+    QMetaObject::invokeMethod(this, [this, delayMs]() {
+        if (m_isRunning && !m_updateTimer.isActive()) {
+            m_updateTimer.start(delayMs);
+        }
+    }, Qt::QueuedConnection);
+}
+
+void ComputeItem::readBackResidual(QRhiResourceUpdateBatch *readbacks)
+{
+    // render thread
+    if (!m_renderConvergenceBuffer) {
+        return;
+    }
+
+    const int index = indexForBuffer(m_renderConvergenceBuffer);
+    QRhiBuffer *buffer = (index >= 0 && index < m_rhiStorageBuffers.size()) ? m_rhiStorageBuffers.at(index) : nullptr;
+    if (!buffer) {
+        return;
+    }
+
+    if (m_cpuActive) {
+        // the CPU copy is current already
+        const QByteArray *data = cpuData(index);
+        if (data && data->size() >= int(sizeof(float))) {
+            float residual;
+            memcpy(&residual, data->constData(), sizeof(float));
+            QMetaObject::invokeMethod(this, [this, residual]() {
+                handleResidual(residual);
+            }, Qt::QueuedConnection);
+        }
+        return;
+    }
+
+    if (!m_residualReadback) {
+        m_residualReadback = new AsyncReadback([this](const QByteArray &data) {
+            if (data.size() < int(sizeof(float))) {
+                return;
+            }
+            float residual;
+            memcpy(&residual, data.constData(), sizeof(float));
+            QMetaObject::invokeMethod(this, [this, residual]() {
+                handleResidual(residual);
+            }, Qt::QueuedConnection);
+        });
+    }
+
+    // at most one small readback in flight
+    if (m_residualReadback->isPending()) {
+        return;
+    }
+
+    m_residualReadback->readBackBuffer(readbacks, buffer, 0, sizeof(float));
+}
+
+void ComputeItem::resetClock()
+{
+    // applied on the render thread with the next synchronization
+    m_clockResetRequested = true;
+}
+
+bool ComputeItem::saveState(const QString &path)
+{
+    if (!m_isInitialized) {
+        qWarning() << "ComputeItem is not initialized";
+        return false;
+    }
+
+    if (m_savingState) {
+        qWarning() << "Cannot save the state of" << shaderName() << "to" << path << "- a snapshot is in progress";
+        return false;
+    }
+
+    // the uniform block is known on this side; only the buffers are read back
+    m_saveStateUniforms.clear();
+    for (const auto &uniformProperty : std::as_const(m_uniformPropertyList)) {
+        m_saveStateUniforms.insert(uniformProperty.name, property(uniformProperty.name.toUtf8()));
+    }
+
+    m_saveStatePath = path;
+    m_savingState = true;
+    m_window->update();
+    return true;
+}
+
+void ComputeItem::readBackState(QRhiResourceUpdateBatch *readbacks)
+{
+    // render thread, after the dispatches of the frame or in a frame without any
+    if (m_outstandingStateReadbacks > 0) {
+        return;
+    }
+
+    auto snapshot = std::make_shared<StateSnapshot>();
+    snapshot->path = m_renderSaveStatePath;
+    snapshot->uniforms = m_renderSaveStateUniforms;
+    snapshot->clock = { m_step, m_frameIndex, m_simulationTime };
+    snapshot->buffers.resize(m_buffers.size());
+    snapshot->failed = m_hasErrors;
+    m_renderSaveStatePath.clear();
+    m_renderSaveStateUniforms.clear();
+    m_stateSnapshot = snapshot;
+
+    while (m_stateReadbacks.size() < m_buffers.size()) {
+        const int index = m_stateReadbacks.size();
+        m_stateReadbacks << new AsyncReadback([this, index](const QByteArray &data) {
+            handleStateReadback(index, data);
+        });
+    }
+
+    QVector<int> pending;
+    for (int i = 0; i < m_buffers.size() && !snapshot->failed; ++i) {
+        StateSnapshot::Buffer &buffer = snapshot->buffers[i];
+        buffer.type = qint32(m_buffers.at(i)->type());
+
+        QRhiTexture *texture = m_rhiTextures.value(i);
+        if (texture) {
+            buffer.imageSize = texture->pixelSize();
+            buffer.format = quint32(texture->format());
+        }
+
+        if (m_cpuActive) {
+            // the CPU copy is current already
+            const QByteArray *data = cpuData(i);
+            if (data) {
+                buffer.data = *data;
+                continue;
+            }
+        }
+
+        if (!m_rhiStorageBuffers.value(i) && !texture) {
+            qWarning() << "Cannot save buffer" << i << "of" << shaderName() << "- it has no GPU resource";
+            snapshot->failed = true;
+            break;
+        }
+        pending << i;
+    }
+
+    if (snapshot->failed) {
+        pending.clear();
+    }
+
+    m_outstandingStateReadbacks = pending.size();
+    for (const int index : std::as_const(pending)) {
+        if (QRhiTexture *texture = m_rhiTextures.at(index)) {
+            m_stateReadbacks.at(index)->readBackTexture(readbacks, texture);
+        } else {
+            QRhiBuffer *buffer = m_rhiStorageBuffers.at(index);
+            m_stateReadbacks.at(index)->readBackBuffer(readbacks, buffer, 0, buffer->size());
+        }
+    }
+
+    if (m_outstandingStateReadbacks == 0) {
+        finishStateSnapshot();
+    }
+}
+
+void ComputeItem::handleStateReadback(int index, const QByteArray &data)
+{
+    // render thread
+    if (!m_stateSnapshot) {
+        return;
+    }
+
+    if (data.isEmpty()) {
+        m_stateSnapshot->failed = true;
+    } else {
+        m_stateSnapshot->buffers[index].data = data;
+    }
+
+    if (--m_outstandingStateReadbacks == 0) {
+        finishStateSnapshot();
+    }
+}
+
+void ComputeItem::finishStateSnapshot()
+{
+    // render thread; the file is written on the GUI thread
+    const std::shared_ptr<StateSnapshot> snapshot = std::move(m_stateSnapshot);
+    m_stateSnapshot.reset();
+    QMetaObject::invokeMethod(this, [this, snapshot]() {
+        writeStateSnapshot(*snapshot);
+    }, Qt::QueuedConnection);
+}
+
+void ComputeItem::writeStateSnapshot(const StateSnapshot &snapshot)
+{
+    m_savingState = false;
+
+    if (snapshot.failed) {
+        qWarning() << "Cannot take a snapshot of" << shaderName();
+        emit stateSaved(snapshot.path, false);
+        return;
+    }
+
+    // replaces an existing snapshot only once the new one is complete
+    QSaveFile file(snapshot.path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "Cannot save the state of" << shaderName() << "to" << snapshot.path << file.errorString();
+        emit stateSaved(snapshot.path, false);
+        return;
+    }
+
+    QDataStream stream(&file);
+    stream << StateMagic << StateVersion;
+    stream.setVersion(QDataStream::Qt_6_0);
+    stream << snapshot.uniforms;
+    stream << snapshot.clock.step << snapshot.clock.frame << double(snapshot.clock.elapsed);
+    stream << qint32(snapshot.buffers.size());
+    for (const auto &buffer : snapshot.buffers) {
+        // the contents are stored as they are on the GPU, in native byte order
+        stream << buffer.type << buffer.imageSize << buffer.format << buffer.data;
+    }
+
+    const bool success = stream.status() == QDataStream::Ok && file.commit();
+    if (!success) {
+        qWarning() << "Cannot save the state of" << shaderName() << "to" << snapshot.path << file.errorString();
+    }
+    emit stateSaved(snapshot.path, success);
+}
+
+bool ComputeItem::restoreState(const QString &path)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        qWarning() << "Cannot restore the state of" << shaderName() << "from" << path << file.errorString();
+        return false;
+    }
+
+    QDataStream stream(&file);
+    quint32 magic = 0;
+    quint32 version = 0;
+    stream >> magic >> version;
+    if (magic != StateMagic || version != StateVersion) {
+        qWarning() << path << "is not a ComputeItem snapshot of version" << StateVersion;
+        return false;
+    }
+    stream.setVersion(QDataStream::Qt_6_0);
+
+    StateSnapshot snapshot;
+    double elapsed = 0.0;
+    qint32 bufferCount = 0;
+    stream >> snapshot.uniforms >> snapshot.clock.step >> snapshot.clock.frame >> elapsed >> bufferCount;
+    snapshot.clock.elapsed = elapsed;
+
+    if (stream.status() != QDataStream::Ok || bufferCount != m_buffers.size()) {
+        qWarning() << "Cannot restore the state of" << shaderName() << "from" << path << "- the buffers do not match";
+        return false;
+    }
+
+    snapshot.buffers.resize(bufferCount);
+    for (int i = 0; i < bufferCount; ++i) {
+        StateSnapshot::Buffer &buffer = snapshot.buffers[i];
+        stream >> buffer.type >> buffer.imageSize >> buffer.format >> buffer.data;
+        if (stream.status() != QDataStream::Ok || buffer.type != qint32(m_buffers.at(i)->type())) {
+            qWarning() << "Cannot restore the state of" << shaderName() << "from" << path << "- buffer" << i << "does not match";
+            return false;
+        }
+    }
+
+    // Everything is checked; apply. Changed buffers are uploaded again with the next
+    // initPipeline(), the CPU side copies keep the restored contents for later rebuilds.
+    for (int i = 0; i < bufferCount; ++i) {
+        const StateSnapshot::Buffer &buffer = snapshot.buffers.at(i);
+        if (auto imageBuffer = qobject_cast<ImageBuffer *>(m_buffers.at(i))) {
+            imageBuffer->setImageSize(buffer.imageSize);
+            imageBuffer->setTextureFormat(static_cast<ImageBuffer::TextureFormat>(buffer.format));
+        }
+        m_buffers.at(i)->setBuffer(buffer.data);
+    }
+
+    for (auto it = snapshot.uniforms.cbegin(); it != snapshot.uniforms.cend(); ++it) {
+        setProperty(it.key().toUtf8(), it.value());
+    }
+
+    m_restoredClock = snapshot.clock;
+    m_clockRestoreRequested = true;
+    m_clockResetRequested = false;
+
+    if (m_window) {
+        m_window->update();
+    }
+    return true;
+}
+
+
+int ComputeItem::prepareCompute(QRhiResourceUpdateBatch *updateBatch, bool continuously)
+{
+    // a fixed timestep may leave nothing to dispatch in this frame
+    const int steps = advanceClock(updateBatch, !continuously, m_recordedSteps);
+    m_recordedSteps += steps;
+    m_framePrepared = true;
+    return steps;
+}
+
+void ComputeItem::recordDispatches(QRhiCommandBuffer *cb)
+{
+    // render thread, inside the compute pass shared by all items of the window; the CPU
+    // backend has done the work in prepareFrame() already
+    if (m_recordedSteps == 0 || m_cpuActive) {
+        return;
+    }
+
+    TraceSpan span("ComputeItem::recordDispatches");
+    span.addArg("steps", m_recordedSteps);
+
+    cb->setComputePipeline(m_computePipeline);
+
+    const auto dispatch = [this, cb](int index) {
+        if (m_dispatches.isEmpty()) {
+            cb->dispatch(m_dispatchX, m_dispatchY, m_dispatchZ);
+        } else {
+            const Dispatch &d = m_dispatches.at(index);
+            cb->dispatch(d.groups[0], d.groups[1], d.groups[2]);
+        }
+    };
+
+    // the counters start from their reset value in every step
+    const bool resetsCounters = !m_counterFills.isEmpty();
+
+    if (m_builtinsBinding < 0) {
+        for (int i = 0; i < m_recordedSteps; ++i) {
+            if (resetsCounters) {
+                recordCounterResets(cb);
+            }
+            if (i == 0 || resetsCounters) {
+                cb->setShaderResources();
+            }
+            dispatch(0);
+        }
+    } else {
+        // one dispatch per simulation step and split, each with its own ComputeBuiltins slot
+        const int dispatchCount = qMax(1, int(m_dispatches.size()));
+        for (int i = 0; i < m_recordedSteps; ++i) {
+            if (resetsCounters) {
+                recordCounterResets(cb);
+            }
+            for (int j = 0; j < qMin(dispatchCount, m_builtinsSlotsPerStep); ++j) {
+                const quint32 slot = quint32(i * m_builtinsSlotsPerStep + j);
+                const QRhiCommandBuffer::DynamicOffset builtinsOffset(m_builtinsBinding, slot * m_builtinsSlotSize);
+                cb->setShaderResources(m_computeBindings, 1, &builtinsOffset);
+                dispatch(j);
+            }
+        }
+    }
+}
+
+void ComputeItem::finishFrame(QRhiResourceUpdateBatch *readbacks)
+{
+    // all copies from resources replaced by a resize are recorded now
+    releaseRetiredResources();
+
+    readBackResidual(readbacks);
+    readBackCounters(readbacks);
+
+    if (!m_renderSaveStatePath.isEmpty()) {
+        readBackState(readbacks);
+    }
+
+    if (m_recordedContinuously) {
+        requestNextCompute();
+    }
+
+    emit notifyChange();
+}
+
+void ComputeItem::reportRecordTime(qreal milliseconds)
+{
+    // render thread
+    QMetaObject::invokeMethod(this, [this, milliseconds]() {
+        m_recordTime = milliseconds;
+        emit recordTimeChanged();
+    }, Qt::QueuedConnection);
+}
+
+void ComputeItem::releaseResources()
+{
+    releasePipelineObjects();
+    m_bufferResizer.releaseResources();
+    releaseCounterFills();
+    m_initializerKernels.releaseResources();
+    releaseRetiredResources();
+
+    for (int i = 0; i < m_buffers.size(); ++i) {
+        releaseBufferResources(i);
+    }
+    m_resourcePool.release(m_computeUBuf);
+    m_computeUBuf = nullptr;
+    m_resourcePool.trim();
+
+    if (m_initialUpdates) {
+        m_initialUpdates->release();
+        m_initialUpdates = nullptr;
+    }
+
+    m_rhiStorageBuffers.clear();
+    m_rhiTextures.clear();
+    m_borrowedResources.clear();
+    m_cpuData.clear();
+    m_cpuSources.clear();
+    m_cpuImageSizes.clear();
+    m_computeShader = QShader();
+    releaseQSGTextures();
+}
+
+void ComputeItem::releaseQSGTextures()
+{
+    if (m_window) {
+        for (auto texture : m_qsgTextures) {
+            if (texture) {
+                m_window->scheduleRenderJob(new CleanupPlainComputeTexture(texture), QQuickWindow::BeforeSynchronizingStage);
+            }
+        }
+    } else {
+        qDeleteAll(m_qsgTextures);
+    }
+    m_qsgTextures.clear();
+}
+
+void ComputeItem::releaseRetiredResources()
+{
+    if (m_retiredBuffers.isEmpty() && m_retiredTextures.isEmpty()) {
+        return;
+    }
+
+    // destroyed with the next frame instead of waiting for a rebuild, see prepareFrame()
+    m_trimPending = true;
+    if (m_window) {
+        m_window->update();
+    }
+
+    for (auto buffer : std::as_const(m_retiredBuffers)) {
+        m_resourcePool.release(buffer);
+    }
+    m_retiredBuffers.clear();
+
+    for (auto texture : std::as_const(m_retiredTextures)) {
+        m_resourcePool.release(texture);
+    }
+    m_retiredTextures.clear();
+}
+
+void ComputeItem::releasePipelineObjects()
+{
+    delete m_computePipeline;
+    m_computePipeline = nullptr;
+
+    delete m_computeBindings;
+    m_computeBindings = nullptr;
+
+    m_resourcePool.release(m_builtinsUBuf);
+    m_builtinsUBuf = nullptr;
+    m_builtinsBinding = -1;
+}
+
+void ComputeItem::releaseBufferResources(int index)
+{
+    if (index >= 0 && index < m_borrowedResources.size() && m_borrowedResources.at(index)) {
+        // owned by the producer
+        m_rhiStorageBuffers[index] = nullptr;
+        m_rhiTextures[index] = nullptr;
+        m_borrowedResources[index] = false;
+        return;
+    }
+
+    if (index >= 0 && index < m_rhiStorageBuffers.size()) {
+        m_resourcePool.release(m_rhiStorageBuffers.at(index));
+        m_rhiStorageBuffers[index] = nullptr;
+    }
+
+    if (index >= 0 && index < m_rhiTextures.size()) {
+        m_resourcePool.release(m_rhiTextures.at(index));
+        m_rhiTextures[index] = nullptr;
+    }
+}
+
+bool ComputeItem::useCpuBackend(QRhi *rhi) const
+{
+    if (m_renderBackend == Backend::Gpu) {
+        return false;
+    }
+    if (m_renderBackend == Backend::Auto && (rhi->backend() != QRhi::Null || m_renderCpuKernelName.isEmpty())) {
+        return false;
+    }
+    if (!CpuKernels::contains(m_renderCpuKernelName)) {
+        qWarning() << "No CPU kernel registered as" << m_renderCpuKernelName << "; running" << shaderName() << "on the GPU";
+        return false;
+    }
+    return true;
+}
+
+void ComputeItem::setCpuData(int index, const QByteArray &data, const QSize &imageSize)
+{
+    if (!m_cpuActive) {
+        return;
+    }
+    m_cpuData[index] = data;
+    m_cpuImageSizes[index] = imageSize;
+}
+
+QByteArray *ComputeItem::cpuData(int index)
+{
+    // render thread; the copy of a shared buffer is looked up at its owner on every use, the
+    // owner replaces it on a rebuild and is forgotten by the scheduler once it is destroyed
+    if (index < 0 || index >= m_cpuData.size()) {
+        return nullptr;
+    }
+
+    if (m_borrowedResources.at(index)) {
+        const CpuSource &source = m_cpuSources.at(index);
+        return isCpuSourceValid(source) ? source.owner->cpuData(source.index) : nullptr;
+    }
+
+    QByteArray &data = m_cpuData[index];
+    return data.isEmpty() ? nullptr : &data;
+}
+
+QSize ComputeItem::cpuImageSize(int index) const
+{
+    if (index < 0 || index >= m_cpuImageSizes.size()) {
+        return QSize();
+    }
 
-    m_computeBindings->setBindings(resourceBindingList.cbegin(), resourceBindingList.cend());
-    m_computeBindings->create();
-    m_releasePool << m_computeBindings;
+    if (m_borrowedResources.at(index)) {
+        const CpuSource &source = m_cpuSources.at(index);
+        return isCpuSourceValid(source) ? source.owner->cpuImageSize(source.index) : QSize();
+    }
+    return m_cpuImageSizes.at(index);
+}
 
-    m_computePipeline = rhi->newComputePipeline();
-    m_computePipeline->setShaderResourceBindings(m_computeBindings);
-    m_computePipeline->setShaderStage({ QRhiShaderStage::Compute, loadShader(m_computeShaderFilename) });
-    m_computePipeline->create();
-    m_releasePool << m_computePipeline;
+bool ComputeItem::isCpuSourceValid(const CpuSource &source) const
+{
+    // a producer of this frame that owns the buffer itself
+    return source.owner && m_renderProducers.contains(source.owner) && !source.owner->m_borrowedResources.value(source.index, true);
+}
 
-    m_pipelineIsInitialized = true;
-    m_dirty = false;
+void ComputeItem::runCpuSteps(QRhiResourceUpdateBatch *updateBatch)
+{
+    // render thread; takes the place of the dispatches of this frame
+    if (!m_cpuKernel.function) {
+        m_cpuSteps.clear();
+        return;
+    }
+
+    QVector<CpuComputeContext::Resource> resources(m_buffers.size());
+    for (int i = 0; i < m_buffers.size(); ++i) {
+        QByteArray *data = cpuData(i);
+        if (data) {
+            // detach here, the kernel writes from several threads
+            resources[i] = { data->data(), data->size(), cpuImageSize(i) };
+        }
+    }
+
+    QHash<QString, quint32> uniformOffsets;
+    for (const auto &uniformProperty : std::as_const(m_uniformPropertyList)) {
+        uniformOffsets.insert(uniformProperty.name, uniformProperty.offset);
+    }
+
+    const int *localSize = m_cpuKernel.localSize;
+    const int dispatch[3] = { m_dispatchX, m_dispatchY, m_dispatchZ };
+    int workGroups[3];
+    int globalSize[3];
+    for (int i = 0; i < 3; ++i) {
+        if (m_renderGlobalSize[0] > 0) {
+            globalSize[i] = qMax(1, m_renderGlobalSize[i]);
+            workGroups[i] = (globalSize[i] + localSize[i] - 1) / localSize[i];
+        } else {
+            workGroups[i] = qMax(0, dispatch[i]);
+            globalSize[i] = workGroups[i] * localSize[i];
+        }
+    }
+
+    CpuComputeContext context;
+    context.setResources(resources);
+    context.setUniforms(m_renderUniformData, uniformOffsets);
+    context.setWorkGroups(workGroups, localSize, globalSize);
+
+    for (const auto &builtins : std::as_const(m_cpuSteps)) {
+        resetCpuCounters(resources);
+        context.setBuiltins(builtins);
+        CpuDispatcher::instance()->run(context, m_cpuKernel.function);
+    }
+    m_cpuSteps.clear();
+
+    // views and GPU consumers read the results from the GPU resources. Shared buffers are
+    // uploaded here as well, the kernel may have written to the copy of their owner.
+    for (int i = 0; i < m_buffers.size(); ++i) {
+        const QByteArray *cpuCopy = cpuData(i);
+        if (!cpuCopy) {
+            continue;
+        }
+        const QByteArray &data = *cpuCopy;
+        if (m_rhiStorageBuffers.at(i)) {
+            updateBatch->uploadStaticBuffer(m_rhiStorageBuffers.at(i), data.constData());
+        } else if (m_rhiTextures.at(i)) {
+            updateBatch->uploadTexture(m_rhiTextures.at(i), QRhiTextureUploadDescription({ 0, 0, { data.constData(), quint32(data.size()) } }));
+        }
+    }
+}
+
+void ComputeItem::init()
+{
+    const QWindowList windowList = QGuiApplication::allWindows();
+    for (auto w : std::as_const(windowList)) {
+        if ((m_window = qobject_cast<QQuickWindow *>(w))) {
+            break;
+        }
+    }
+
+    if (!m_window) {
+        qWarning() << "No QQuickWindow found; cannot init ComputeItem";
+        return;
+    }
+
+    m_isInitialized = true;
+
+    m_updateTimer.setSingleShot(true);
+    connect(&m_updateTimer, &QTimer::timeout, m_window, &QQuickWindow::update);
+    connect(m_window, &QWindow::visibilityChanged, this, &ComputeItem::updateHidden);
+
+    // the initial computation runs with the first frame so that views find their contents
+    m_stepRequests = 1;
+
+    // synchronization and recording are driven by the scheduler of the window
+    m_scheduler = ComputeScheduler::forWindow(m_window);
+    m_scheduler->registerItem(this);
+}
+
+std::pair<QRhiTexture::Format, quint32> ComputeItem::toRhiTextureFormat(ImageBuffer::TextureFormat format) const
+{
+    switch (format) {
+        case ImageBuffer::RGBA8: return std::pair<QRhiTexture::Format, quint32>(QRhiTexture::RGBA8, 4);
+        case ImageBuffer::RGBA16F: return std::pair<QRhiTexture::Format, quint32>(QRhiTexture::RGBA16F, 8);
+        case ImageBuffer::RGBA32F: return std::pair<QRhiTexture::Format, quint32>(QRhiTexture::RGBA32F, 16);     
+        default: return std::pair<QRhiTexture::Format, quint32>(QRhiTexture::RGBA8, 4);
+    }
+}
+
+QRhiTexture::Flags ComputeItem::textureFlags(const ImageBuffer *imageBuffer) const
+{
+    QRhiTexture::Flags flags = QRhiTexture::UsedWithLoadStore | QRhiTexture::UsedAsTransferSource;
+    if (imageBuffer->mipmaps()) {
+        // the mip chain is regenerated by the ComputeScheduler after each compute pass
+        flags |= QRhiTexture::MipMapped | QRhiTexture::UsedWithGenerateMips;
+    }
+    return flags;
+}
+
+
+namespace {
+
+// bindings and kinds of all resources a shader declares
+QVector<std::pair<int, int>> resourceLayout(const QShader &shader)
+{
+    const QShaderDescription description = shader.description();
+    QVector<std::pair<int, int>> layout;
+    for (const auto &block : description.storageBlocks()) {
+        layout << std::make_pair(block.binding, 0);
+    }
+    for (const auto &image : description.storageImages()) {
+        layout << std::make_pair(image.binding, 1);
+    }
+    for (const auto &block : description.uniformBlocks()) {
+        layout << std::make_pair(block.binding, 2);
+    }
+    std::sort(layout.begin(), layout.end());
+    return layout;
+}
+
+}
+
+void ComputeItem::reloadPipeline(QRhi *rhi)
+{
+    QString errorMessage;
+    const QShader shader = loadComputeShader(rhi, &errorMessage);
+    if (!shader.isValid()) {
+        reportShaderError(errorMessage + QStringLiteral("; keeping the previous shader"));
+        return;
+    }
+
+    // the existing bindings are reused, so the new shader has to declare the same resources
+    if (resourceLayout(shader) != resourceLayout(m_computeShader)) {
+        reportShaderError(QStringLiteral("Binding layout of %1 changed; keeping the previous shader").arg(shaderName()));
+        return;
+    }
+
+    QRhiComputePipeline *pipeline = rhi->newComputePipeline();
+    pipeline->setShaderResourceBindings(m_computeBindings);
+    pipeline->setShaderStage({ QRhiShaderStage::Compute, shader });
+    if (!pipeline->create()) {
+        delete pipeline;
+        reportShaderError(QStringLiteral("Cannot create pipeline for %1; keeping the previous shader").arg(shaderName()));
+        return;
+    }
+
+    delete m_computePipeline;
+    m_computePipeline = pipeline;
+    m_computeShader = shader;
+    reportShaderError(QString());
+
+    // the local size may have changed
+    updateDispatches(rhi);
+}
+
+std::vector<QRhiShaderResourceBinding> ComputeItem::resourceBindings(const QVector<QRhiBuffer *> &storageBuffers, const QVector<QRhiTexture *> &textures) const
+{
+    std::vector<QRhiShaderResourceBinding> resourceBindingList;
+    quint32 binding = 0;
+    for (int i = 0; i < storageBuffers.size(); ++i) {
+        if (storageBuffers.at(i)) {
+            resourceBindingList.push_back(QRhiShaderResourceBinding::bufferLoadStore(binding, QRhiShaderResourceBinding::ComputeStage, storageBuffers.at(i)));
+            binding++;
+        } else if (textures.at(i)) {
+            resourceBindingList.push_back(QRhiShaderResourceBinding::imageLoadStore(binding, QRhiShaderResourceBinding::ComputeStage, textures.at(i), 0));
+            binding++;
+        }
+    }
+
+    resourceBindingList.push_back(QRhiShaderResourceBinding::uniformBuffer(binding, QRhiShaderResourceBinding::ComputeStage, m_computeUBuf));
+
+    if (m_builtinsBinding >= 0 && m_builtinsUBuf) {
+        resourceBindingList.push_back(QRhiShaderResourceBinding::uniformBufferWithDynamicOffset(m_builtinsBinding, QRhiShaderResourceBinding::ComputeStage, m_builtinsUBuf, sizeof(ComputeBuiltins)));
+    }
+    return resourceBindingList;
+}
+
+void ComputeItem::allocationFailed()
+{
+    // budget rejections are reported as memoryError instead and retried with another budget
+    if (m_resourcePool.budgetError().isEmpty()) {
+        m_hasErrors = true;
+    }
+}
+
+bool ComputeItem::createBufferResources(QRhi *rhi, int index)
+{
+    ComputeShaderBuffer *buf = m_buffers.at(index);
+
+    ComputeItem *owner = buf->computeItem();
+    if (owner && owner != this) {
+        // shared buffer: bind the resource of the owning ComputeItem, no copy
+        const int ownerIndex = owner->m_buffers.indexOf(buf);
+        m_rhiStorageBuffers[index] = owner->m_rhiStorageBuffers.value(ownerIndex);
+        m_rhiTextures[index] = owner->m_rhiTextures.value(ownerIndex);
+        m_borrowedResources[index] = true;
+        if (m_cpuActive) {
+            m_cpuSources[index] = { owner, ownerIndex };
+            if (!cpuData(index)) {
+                qWarning() << "Shared buffer" << index << "of" << shaderName() << "has no CPU copy; its owner does not run on the CPU";
+            }
+        }
+        return m_rhiStorageBuffers.at(index) || m_rhiTextures.at(index);
+    }
+
+    TraceSpan span("ComputeItem::createBufferResources");
+    span.addArg("index", index);
+
+    const auto byteBuffer = buf->buffer();
+
+    const auto &initializers = m_renderInitializers.value(index);
+
+    if (buf->type() == ComputeShaderBuffer::StorageBuffer) {
+        // without data of its own, the initializers tell the size
+        quint32 size = quint32(byteBuffer.size());
+        if (byteBuffer.isEmpty()) {
+            size = qobject_cast<StorageBuffer *>(buf)->structuredSize();
+            for (const auto &initializer : initializers) {
+                size = qMax(size, initializer.requiredSize());
+            }
+        }
+        if (size == 0) {
+            qWarning() << "Cannot upload empty storage buffer";
+            return false;
+        }
+        span.addArg("bytes", size);
+
+        QRhiBuffer *rhiBuf = m_resourcePool.acquireBuffer(rhi, QRhiBuffer::Immutable, QRhiBuffer::StorageBuffer | QRhiBuffer::VertexBuffer, size);
+        if (!rhiBuf) {
+            allocationFailed();
+            return false;
+        }
+
+        m_rhiStorageBuffers[index] = rhiBuf;
+        if (!byteBuffer.isEmpty()) {
+            // data of its own, e.g. a restored state, takes precedence over the initializers
+            m_initialUpdates->uploadStaticBuffer(rhiBuf, byteBuffer.constData());
+            setCpuData(index, byteBuffer, QSize());
+            return true;
+        }
+        setCpuData(index, m_cpuActive ? QByteArray(int(size), 0) : QByteArray(), QSize());
+        if (!runInitializers(rhi, index)) {
+            m_hasErrors = true;
+            return false;
+        }
+        // uploadBufferRanges() writes them after the fills
+        for (const auto &range : m_renderWrittenRanges.value(index)) {
+            m_renderRangeUploads.append({ index, range.offset, range.data });
+        }
+        return true;
+    }
+
+    if (buf->type() != ComputeShaderBuffer::Image) {
+        return false;
+    }
+
+    ImageBuffer *imageBuffer = qobject_cast<ImageBuffer*>(buf);
+    Q_ASSERT(imageBuffer);
+
+    QRhiTexture *texture = nullptr;
+    QSize imageSize;
+
+    if (byteBuffer.size() > 0) {
+
+        const auto formatData = toRhiTextureFormat(imageBuffer->textureFormat());
+        const auto textureFormat = formatData.first;
+        const auto bytesPerPixel = formatData.second;
+        imageSize = imageBuffer->imageSize();
+        const auto dataSize = imageSize.width() * imageSize.height() * bytesPerPixel;
+        if (dataSize != byteBuffer.size()) {
+            qWarning() << "Size mismatch; cannot upload image buffer";
+            m_hasErrors = true;
+            return false;
+        }
+
+        span.addArg("bytes", dataSize);
+        texture = m_resourcePool.acquireTexture(rhi, textureFormat, imageSize, textureFlags(imageBuffer));
+        if (texture) {
+            QRhiTextureUploadDescription textureDesc({ 0, 0, { byteBuffer.constData(), quint32(byteBuffer.size()) } });
+            m_initialUpdates->uploadTexture(texture, textureDesc);
+            setCpuData(index, byteBuffer, imageSize);
+        }
+
+    } else if (!imageBuffer->imageSource().isEmpty()) {
+        QImage image = QImage(imageBuffer->imageSource()).convertToFormat(QImage::Format_RGBA8888);
+        imageSize = image.size();
+        span.addArg("bytes", image.sizeInBytes());
+
+        texture = m_resourcePool.acquireTexture(rhi, QRhiTexture::RGBA8, imageSize, textureFlags(imageBuffer));
+        if (texture) {
+            m_initialUpdates->uploadTexture(texture, image);
+            setCpuData(index, QByteArray(reinterpret_cast<const char *>(image.constBits()), image.sizeInBytes()), imageSize);
+        }
 
+    } else if (!initializers.isEmpty() && !imageBuffer->imageSize().isEmpty()) {
+        // filled by the initializers below
+        const auto formatData = toRhiTextureFormat(imageBuffer->textureFormat());
+        imageSize = imageBuffer->imageSize();
+        span.addArg("bytes", qint64(imageSize.width()) * imageSize.height() * formatData.second);
+        texture = m_resourcePool.acquireTexture(rhi, formatData.first, imageSize, textureFlags(imageBuffer));
+        if (texture && m_cpuActive) {
+            setCpuData(index, QByteArray(imageSize.width() * imageSize.height() * int(formatData.second), 0), imageSize);
+        }
+
+    } else {
+        qWarning() << "Cannot upload image data";
+        m_hasErrors = true;
+        return false;
+    }
+
+    if (!texture) {
+        allocationFailed();
+        return false;
+    }
+
+    m_rhiTextures[index] = texture;
+    if (byteBuffer.isEmpty() && imageBuffer->imageSource().isEmpty() && !runInitializers(rhi, index)) {
+        m_hasErrors = true;
+    }
+
+    // views keep their QSGTexture across rebuilds; only the underlying texture changes
+    auto qsgTexture = static_cast<PlainComputeTexture *>(m_qsgTextures.at(index));
+    if (qsgTexture) {
+        qsgTexture->setTexture(texture, imageSize);
+    } else {
+        qsgTexture = new PlainComputeTexture(texture, imageSize);
+        m_qsgTextures[index] = qsgTexture;
+    }
+    imageBuffer->setQSGTexture(qsgTexture);
+    return true;
+}
+
+bool ComputeItem::runInitializers(QRhi *rhi, int index)
+{
+    // render thread; the fills are recorded with the pending uploads of m_initialUpdates
+    const auto &initializers = m_renderInitializers.value(index);
+    QRhiBuffer *buffer = m_rhiStorageBuffers.at(index);
+    QRhiTexture *texture = m_rhiTextures.at(index);
+    if (initializers.isEmpty() || (!buffer && !texture)) {
+        return true;
+    }
+
+    bool ok = true;
+    if (m_cpuActive) {
+        // the CPU copy is filled and uploaded; it is what the kernel works on
+        QByteArray &data = m_cpuData[index];
+        const QSize imageSize = m_cpuImageSizes.at(index);
+        for (const auto &initializer : initializers) {
+            if (buffer) {
+                ok = BufferInitializer::fillBuffer(initializer, &data) && ok;
+            } else {
+                const int pixels = qMax(1, imageSize.width() * imageSize.height());
+                ok = BufferInitializer::fillImage(initializer, &data, imageSize, int(data.size() / pixels)) && ok;
+            }
+        }
+        if (buffer) {
+            m_initialUpdates->uploadStaticBuffer(buffer, data.constData());
+        } else {
+            m_initialUpdates->uploadTexture(texture, QRhiTextureUploadDescription({ 0, 0, { data.constData(), quint32(data.size()) } }));
+        }
+        return ok;
+    }
+
+    for (const auto &initializer : initializers) {
+        ok = (buffer ? m_initializerKernels.scheduleFill(rhi, m_initialUpdates, initializer, buffer)
+                     : m_initializerKernels.scheduleFill(rhi, m_initialUpdates, initializer, texture)) && ok;
+    }
+    return ok;
+}
+
+bool ComputeItem::resizeBufferResources(QRhi *rhi, const ResizeRequest &request)
+{
+    ComputeShaderBuffer *buf = m_buffers.at(request.index);
+
+    TraceSpan span("ComputeItem::resizeBufferResources");
+    span.addArg("index", request.index);
+    if (buf->type() == ComputeShaderBuffer::StorageBuffer) {
+        span.addArg("bytes", request.size);
+    } else {
+        span.addArg("pixels", qint64(request.imageSize.width()) * request.imageSize.height());
+    }
+
+    if (buf->type() == ComputeShaderBuffer::StorageBuffer) {
+        QRhiBuffer *oldBuffer = m_rhiStorageBuffers.at(request.index);
+        QRhiBuffer *newBuffer = m_resourcePool.acquireBuffer(rhi, QRhiBuffer::Immutable, QRhiBuffer::StorageBuffer | QRhiBuffer::VertexBuffer, request.size);
+        if (!newBuffer) {
+            allocationFailed();
+            return false;
+        }
+
+        if (oldBuffer && request.preserve) {
+            if (!m_bufferResizer.scheduleCopy(rhi, m_initialUpdates, oldBuffer, newBuffer, oldBuffer->size(), request.pattern)) {
+                m_resourcePool.release(newBuffer);
+                m_hasErrors = true;
+                return false;
+            }
+        } else {
+            const QByteArray data = BufferResizer::resizedData(QByteArray(), int(request.size), request.pattern);
+            m_initialUpdates->uploadStaticBuffer(newBuffer, data.constData());
+        }
+
+        // the copy still reads the old buffer
+        if (oldBuffer) {
+            m_retiredBuffers << oldBuffer;
+        }
+        m_rhiStorageBuffers[request.index] = newBuffer;
+
+        if (m_cpuActive) {
+            const QByteArray oldData = request.preserve ? m_cpuData.at(request.index) : QByteArray();
+            setCpuData(request.index, BufferResizer::resizedData(oldData, int(request.size), request.pattern), QSize());
+        }
+        return true;
+    }
+
+    ImageBuffer *imageBuffer = qobject_cast<ImageBuffer*>(buf);
+    Q_ASSERT(imageBuffer);
+
+    QRhiTexture *oldTexture = m_rhiTextures.at(request.index);
+    const auto formatData = imageBuffer->buffer().isEmpty() && !imageBuffer->imageSource().isEmpty() ? std::make_pair(QRhiTexture::RGBA8, quint32(4))
+                                                            : toRhiTextureFormat(imageBuffer->textureFormat());
+    QRhiTexture *newTexture = m_resourcePool.acquireTexture(rhi, formatData.first, request.imageSize, textureFlags(imageBuffer));
+    if (!newTexture) {
+        allocationFailed();
+        return false;
+    }
+
+    // texture operations of a batch are executed in order: clear first, then copy the overlap
+    const QByteArray zeros(request.imageSize.width() * request.imageSize.height() * int(formatData.second), 0);
+    m_initialUpdates->uploadTexture(newTexture, QRhiTextureUploadDescription({ 0, 0, { zeros.constData(), quint32(zeros.size()) } }));
+
+    if (oldTexture && request.preserve) {
+        QRhiTextureCopyDescription copyDesc;
+        copyDesc.setPixelSize(oldTexture->pixelSize().boundedTo(request.imageSize));
+        m_initialUpdates->copyTexture(newTexture, oldTexture, copyDesc);
+    }
+
+    if (oldTexture) {
+        m_retiredTextures << oldTexture;
+    }
+    m_rhiTextures[request.index] = newTexture;
+
+    if (m_cpuActive) {
+        setCpuData(request.index, ImageBuffer::resizedData(m_cpuData.at(request.index), m_cpuImageSizes.at(request.index), request.imageSize,
+                                                           int(formatData.second), request.preserve), request.imageSize);
+    }
+
+    auto qsgTexture = static_cast<PlainComputeTexture *>(m_qsgTextures.at(request.index));
+    if (qsgTexture) {
+        qsgTexture->setTexture(newTexture, request.imageSize);
+    } else {
+        qsgTexture = new PlainComputeTexture(newTexture, request.imageSize);
+        m_qsgTextures[request.index] = qsgTexture;
+    }
+    imageBuffer->setQSGTexture(qsgTexture);
+    return true;
 }
 
+void ComputeItem::initPipeline(QRhi *rhi)
+{
+
+    if (!m_isInitialized || !rhi) {
+        return;
+    }
+
+    TraceSpan span("ComputeItem::initPipeline");
+    if (span.isActive()) {
+        span.addArg("shader", shaderName());
+    }
+
+    m_resourcePool.setBudget(m_renderMemoryBudget);
+    m_resourcePool.clearBudgetError();
+    // they bind the counter resources, which may be replaced below
+    releaseCounterFills();
+
+    // Only recreate what changed. Resources that are released here go back to the pool
+    // and are handed out again for requests of the same kind and size.
+    const bool fullRebuild = !m_pipelineIsInitialized || m_renderBuffersChanged;
+    bool rebuildBindings = fullRebuild || m_renderShaderChanged || m_renderBindingsChanged || !m_renderChangedBuffers.isEmpty()
+            || !m_renderResizeRequests.isEmpty();
+
+    // consumers of our buffers need to bind them again
+    bool ownResourcesChanged = fullRebuild || !m_renderResizeRequests.isEmpty();
+
+    if (fullRebuild) {
+        m_hasErrors = false;
+    }
+    const bool hadErrors = m_hasErrors;
+
+    if (fullRebuild) {
+
+        // drop pending uploads and resize copies, everything is uploaded again
+        if (m_initialUpdates) {
+            m_initialUpdates->release();
+            m_initialUpdates = nullptr;
+        }
+        m_bufferResizer.releaseResources();
+        m_initializerKernels.releaseResources();
+        releaseRetiredResources();
+        // the CPU side contents hold the written ranges, or createBufferResources() queues them
+        // again after the initializers
+        m_renderRangeUploads.clear();
+    }
+
+    if (!m_initialUpdates) {
+        m_initialUpdates = rhi->nextResourceUpdateBatch();
+    }
+
+    if (fullRebuild) {
+        for (int i = 0; i < m_rhiStorageBuffers.size(); ++i) {
+            releaseBufferResources(i);
+        }
+        releaseQSGTextures();
+
+        // one entry per buffer: rhi buffers for storage buffers and textures for images, nullptr otherwise
+        m_rhiStorageBuffers.fill(nullptr, m_buffers.size());
+        m_rhiTextures.fill(nullptr, m_buffers.size());
+        m_qsgTextures.fill(nullptr, m_buffers.size());
+        m_borrowedResources.fill(false, m_buffers.size());
+
+        m_cpuActive = useCpuBackend(rhi);
+        m_cpuKernel = m_cpuActive ? CpuKernels::kernel(m_renderCpuKernelName) : CpuKernels::Kernel();
+        m_cpuData.fill(QByteArray(), m_cpuActive ? m_buffers.size() : 0);
+        m_cpuSources.fill(CpuSource { nullptr, -1 }, m_cpuActive ? m_buffers.size() : 0);
+        m_cpuImageSizes.fill(QSize(), m_cpuActive ? m_buffers.size() : 0);
+
+        const Backend activeBackend = m_cpuActive ? Backend::Cpu : Backend::Gpu;
+        QMetaObject::invokeMethod(this, [this, activeBackend]() {
+            if (activeBackend != m_activeBackend) {
+                m_activeBackend = activeBackend;
+                emit activeBackendChanged();
+            }
+        }, Qt::QueuedConnection);
+
+        for (int i = 0; i < m_buffers.size(); ++i) {
+            createBufferResources(rhi, i);
+        }
+    } else {
+        m_renderRangeUploads.erase(std::remove_if(m_renderRangeUploads.begin(), m_renderRangeUploads.end(), [this](const RangeUpload &upload) {
+            return m_renderChangedBuffers.contains(upload.index);
+        }), m_renderRangeUploads.end());
+        for (const int index : std::as_const(m_renderChangedBuffers)) {
+            if (index >= 0 && index < m_buffers.size()) {
+                releaseBufferResources(index);
+                createBufferResources(rhi, index);
+                ownResourcesChanged = ownResourcesChanged || !m_borrowedResources.at(index);
+            }
+        }
+
+        // a full rebuild or a re-upload already uses the resized CPU side contents
+        for (const auto &request : std::as_const(m_renderResizeRequests)) {
+            if (request.index < m_buffers.size() && !m_renderChangedBuffers.contains(request.index)) {
+                resizeBufferResources(rhi, request);
+            }
+        }
+    }
+
+    Q_ASSERT(m_rhiStorageBuffers.length() == m_buffers.length());
+    Q_ASSERT(m_rhiTextures.length() == m_buffers.length());
+    Q_ASSERT(m_qsgTextures.length() == m_buffers.length());
+    Q_ASSERT(m_borrowedResources.length() == m_buffers.length());
+
+    if (ownResourcesChanged) {
+        m_resourceGeneration++;
+    }
+
+    // shared buffers whose owner has not created its resources yet
+    QSet<int> missingResources;
+    for (int i = 0; i < m_buffers.size(); ++i) {
+        if (m_borrowedResources.at(i) && !m_rhiStorageBuffers.at(i) && !m_rhiTextures.at(i)) {
+            missingResources.insert(i);
+        }
+    }
+
+    if (!m_computeUBuf) {
+        m_computeUBuf = m_resourcePool.acquireBuffer(rhi, QRhiBuffer::Dynamic, QRhiBuffer::UniformBuffer, qMax(uniformBufferSize(), quint32(16)));
+        updateUniformBuffer(m_initialUpdates);
+    }
+
+    if (!m_resourcePool.budgetError().isEmpty()) {
+        // nothing is bound to the missing resources and nothing is dispatched; a rebuild with
+        // another budget tries again
+        rebuildBindings = false;
+        releasePipelineObjects();
+    }
+
+    if (m_renderShaderChanged && m_renderAutotune) {
+        // another kernel; tune again once the pipeline exists
+        m_tunedPreamble.clear();
+        m_autotunePending = true;
+    }
+
+    if (m_renderShaderReloaded && !rebuildBindings && m_computePipeline) {
+        // the buffers stay in place, only the pipeline is replaced
+        reloadPipeline(rhi);
+        // unless there are more split dispatches than ComputeBuiltins slots now
+        rebuildBindings = m_builtinsBinding >= 0 && m_dispatches.size() > m_builtinsSlotsPerStep;
+    } else if (fullRebuild || m_renderShaderChanged || m_renderShaderReloaded || !m_computeShader.isValid()) {
+        QString errorMessage;
+        m_computeShader = loadComputeShader(rhi, &errorMessage);
+        reportShaderError(errorMessage);
+    }
+
+    if (!m_computePipeline && m_computeShader.isValid() && m_resourcePool.budgetError().isEmpty()) {
+        // the last pipeline could not be created; try again, e.g. after a hot reload
+        rebuildBindings = true;
+    }
+
+    if (rebuildBindings) {
+        releasePipelineObjects();
+    }
+
+    if (rebuildBindings && missingResources.isEmpty()) {
+        // the reserved ComputeBuiltins block is bound wherever the shader declares it
+        const auto uniformBlocks = m_computeShader.description().uniformBlocks();
+        for (const auto &uniformBlock : uniformBlocks) {
+            if (uniformBlock.blockName == "ComputeBuiltins") {
+                m_builtinsBinding = uniformBlock.binding;
+                break;
+            }
+        }
+
+        updateDispatches(rhi);
+
+        if (m_builtinsBinding >= 0) {
+            m_builtinsSlotSize = rhi->ubufAligned(sizeof(ComputeBuiltins));
+            m_builtinsSlotsPerStep = qMax(1, int(m_dispatches.size()));
+            m_builtinsUBuf = m_resourcePool.acquireBuffer(rhi, QRhiBuffer::Dynamic, QRhiBuffer::UniformBuffer,
+                                                          m_builtinsSlotSize * quint32(m_renderMaxStepsPerFrame * m_builtinsSlotsPerStep));
+            if (!m_builtinsUBuf) {
+                m_builtinsBinding = -1;
+            }
+        }
+
+        const auto resourceBindingList = resourceBindings(m_rhiStorageBuffers, m_rhiTextures);
+        m_computeBindings = rhi->newShaderResourceBindings();
+        m_computeBindings->setBindings(resourceBindingList.cbegin(), resourceBindingList.cend());
+        m_computeBindings->create();
+
+        // without a valid shader the error is reported already
+        if (m_computeShader.isValid()) {
+            m_computePipeline = rhi->newComputePipeline();
+            m_computePipeline->setShaderResourceBindings(m_computeBindings);
+            m_computePipeline->setShaderStage({ QRhiShaderStage::Compute, m_computeShader });
+            if (!m_computePipeline->create()) {
+                // nothing is dispatched until a rebuild or a reload succeeds
+                delete m_computePipeline;
+                m_computePipeline = nullptr;
+                reportShaderError(QStringLiteral("Cannot create pipeline for %1").arg(shaderName()));
+            }
+        }
+    }
+
+    // destroy whatever was not reused
+    m_resourcePool.trim();
+
+    m_renderBuffersChanged = false;
+    m_renderShaderChanged = false;
+    m_renderShaderReloaded = false;
+    m_renderBindingsChanged = false;
+    m_renderChangedBuffers = missingResources;
+    m_renderResizeRequests.clear();
+
+    m_producerGenerations.clear();
+    for (auto producer : std::as_const(m_renderProducers)) {
+        m_producerGenerations.insert(producer, producer->m_resourceGeneration);
+    }
+
+    m_pipelineIsInitialized = true;
+    m_dirty = !missingResources.isEmpty();
+
+    if (m_hasErrors && !hadErrors) {
+        qWarning() << "Cannot create the resources of" << shaderName() << "- it does not compute until the next full rebuild";
+    }
+
+    reportMemoryUsage(rhi);
+
+}
@@ -7,42 +7,146 @@
 #include <QObject>
 #include <QString>
 #include <QVector>
+#include <QVariantList>
+#include <QVariantMap>
 #include <QMetaType>
+#include <QElapsedTimer>
+#include <QFileSystemWatcher>
+#include <QPointer>
+#include <QHash>
+#include <QSet>
+#include <QTimer>
 #include <QQmlListProperty>
 #include <QQuickWindow>
 #include <QSGTexture>
 
 #include <qqml.h>
 
+#include <memory>
+
 #if QT_VERSION >= QT_VERSION_CHECK(6, 6, 0)
   #include <rhi/qrhi.h>
 #else
   #include <private/qrhi_p.h>
 #endif
 
+#include "asyncreadback.h"
 #include "computeshaderbuffer.h"
+#include "counterbuffer.h"
+#include "cpubackend.h"
 #include "storagebuffer.h"
 #include "imagebuffer.h"
+#include "bufferresizer.h"
+#include "initializerkernels.h"
+#include "resourcepool.h"
+
+class ComputeScheduler;
 
 class ComputeItem : public QObject,  public QQmlParserStatus
 {
     Q_OBJECT
+    // a precompiled .qsb file or GLSL source (.comp) that is compiled at runtime
     Q_PROPERTY(QString computeShader READ computeShader WRITE setComputeShader NOTIFY computeShaderChanged)
+    // inline GLSL source; takes precedence over computeShader
+    Q_PROPERTY(QString computeShaderSource READ computeShaderSource WRITE setComputeShaderSource NOTIFY computeShaderSourceChanged)
+    // compile-time constants for GLSL shaders, e.g. { COUNT: 1024, LOCAL_SIZE_X: 16 } together
+    // with layout(local_size_x = LOCAL_SIZE_X) in; ignored for precompiled .qsb shaders
+    Q_PROPERTY(QVariantMap defines READ defines WRITE setDefines NOTIFY definesChanged)
+    // times LOCAL_SIZE_X variants of a GLSL shader in offscreen frames and uses the fastest one;
+    // the shader declares layout(local_size_x = LOCAL_SIZE_X) in; see Autotuner
+    Q_PROPERTY(bool autotune READ autotune WRITE setAutotune NOTIFY autotuneChanged)
+    Q_PROPERTY(QVariantList autotuneCandidates READ autotuneCandidates WRITE setAutotuneCandidates NOTIFY autotuneCandidatesChanged)
+    Q_PROPERTY(int tunedLocalSize READ tunedLocalSize NOTIFY tunedLocalSizeChanged)
+    // reload the compute shader when the file changes; only the pipeline is recreated
+    Q_PROPERTY(bool hotReload READ hotReload WRITE setHotReload NOTIFY hotReloadChanged)
+    Q_PROPERTY(QString shaderError READ shaderError NOTIFY shaderErrorChanged)
     Q_PROPERTY(int dispatchX READ dispatchX WRITE setDispatchX NOTIFY dispatchXChanged)
     Q_PROPERTY(int dispatchY READ dispatchY WRITE setDispatchY NOTIFY dispatchYChanged)
     Q_PROPERTY(int dispatchZ READ dispatchZ WRITE setDispatchZ NOTIFY dispatchZChanged)
 
+    // number of invocations; if globalSizeX is set, the work group counts are derived from the
+    // local size of the shader and dispatchX/Y/Z are ignored. Work exceeding the work group
+    // limit of the backend is split into several dispatches, see ComputeBuiltins::workGroupOffset.
+    Q_PROPERTY(int globalSizeX READ globalSizeX WRITE setGlobalSizeX NOTIFY globalSizeXChanged)
+    Q_PROPERTY(int globalSizeY READ globalSizeY WRITE setGlobalSizeY NOTIFY globalSizeYChanged)
+    Q_PROPERTY(int globalSizeZ READ globalSizeZ WRITE setGlobalSizeZ NOTIFY globalSizeZChanged)
+
+    // simulation clock, see ComputeBuiltins
+    Q_PROPERTY(qreal fixedTimestep READ fixedTimestep WRITE setFixedTimestep NOTIFY fixedTimestepChanged)
+    Q_PROPERTY(int maxStepsPerFrame READ maxStepsPerFrame WRITE setMaxStepsPerFrame NOTIFY maxStepsPerFrameChanged)
+
+    // scheduling of continuous computations, see compute()
+    Q_PROPERTY(qreal targetRate READ targetRate WRITE setTargetRate NOTIFY targetRateChanged)
+    Q_PROPERTY(bool pauseWhenHidden READ pauseWhenHidden WRITE setPauseWhenHidden NOTIFY pauseWhenHiddenChanged)
+    Q_PROPERTY(StorageBuffer* convergenceBuffer READ convergenceBuffer WRITE setConvergenceBuffer NOTIFY convergenceBufferChanged)
+    Q_PROPERTY(qreal convergenceThreshold READ convergenceThreshold WRITE setConvergenceThreshold NOTIFY convergenceThresholdChanged)
+    Q_PROPERTY(qreal residual READ residual NOTIFY residualChanged)
+    // CPU time in milliseconds spent preparing and recording the work of the last frame
+    Q_PROPERTY(qreal recordTime READ recordTime NOTIFY recordTimeChanged)
+
+    // Runs the CpuKernels entry named cpuKernel instead of the compute shader. Auto uses the CPU
+    // on the QRhi Null backend, e.g. on build servers without GPU. Results are uploaded to the
+    // GPU resources after every frame, so views and consumers work unchanged.
+    Q_PROPERTY(Backend backend READ backend WRITE setBackend NOTIFY backendChanged)
+    Q_PROPERTY(QString cpuKernel READ cpuKernel WRITE setCpuKernel NOTIFY cpuKernelChanged)
+    // Gpu or Cpu, whichever the last rebuild picked
+    Q_PROPERTY(Backend activeBackend READ activeBackend NOTIFY activeBackendChanged)
+
+    // GPU memory in bytes held by this item after the last rebuild, see ResourcePool. Shared
+    // buffers count for the item owning them; pooledBytes are kept for reuse by rebuilds.
+    Q_PROPERTY(qint64 storageBufferBytes READ storageBufferBytes NOTIFY memoryUsageChanged)
+    Q_PROPERTY(qint64 uniformBufferBytes READ uniformBufferBytes NOTIFY memoryUsageChanged)
+    Q_PROPERTY(qint64 textureBytes READ textureBytes NOTIFY memoryUsageChanged)
+    Q_PROPERTY(qint64 pooledBytes READ pooledBytes NOTIFY memoryUsageChanged)
+    Q_PROPERTY(qint64 memoryUsage READ memoryUsage NOTIFY memoryUsageChanged)
+    // of all ComputeItems of the process
+    Q_PROPERTY(qint64 totalMemoryUsage READ totalMemoryUsage NOTIFY memoryUsageChanged)
+    // QRhi::statistics() of the window, e.g. usedBytes of the Vulkan allocator; Qt 6.6
+    Q_PROPERTY(QVariantMap rhiStatistics READ rhiStatistics NOTIFY memoryUsageChanged)
+    // Bytes this item may hold, 0 for no budget. The budget of all items is set with the
+    // QCI_MEMORY_BUDGET environment variable. Allocations beyond a budget fail the rebuild
+    // with memoryError instead of failing in the driver.
+    Q_PROPERTY(qint64 memoryBudget READ memoryBudget WRITE setMemoryBudget NOTIFY memoryBudgetChanged)
+    Q_PROPERTY(QString memoryError READ memoryError NOTIFY memoryUsageChanged)
+
     Q_PROPERTY(QQmlListProperty<ComputeShaderBuffer> buffers READ buffers FINAL)
     Q_INTERFACES(QQmlParserStatus)
     QML_ELEMENT
 
 public:
+    enum Backend
+    {
+        Auto,
+        Gpu,
+        Cpu
+    };
+    Q_ENUM(Backend)
+
     explicit ComputeItem(QObject *parent = nullptr);
     ~ComputeItem();
 
     QString computeShader() const;
     void setComputeShader(const QString &fileName);
 
+    QString computeShaderSource() const { return m_computeShaderSource; }
+    void setComputeShaderSource(const QString &source);
+
+    QVariantMap defines() const { return m_defines; }
+    void setDefines(const QVariantMap &defines);
+
+    bool autotune() const { return m_autotune; }
+    void setAutotune(bool autotune);
+
+    QVariantList autotuneCandidates() const { return m_autotuneCandidates; }
+    void setAutotuneCandidates(const QVariantList &candidates);
+
+    int tunedLocalSize() const { return m_tunedLocalSize; }
+
+    bool hotReload() const { return m_hotReload; }
+    void setHotReload(bool hotReload);
+
+    QString shaderError() const { return m_shaderError; }
+
     int dispatchX() const { return m_dispatchX; }
     void setDispatchX(int x) { if (x != m_dispatchX) { m_dispatchX = x; emit dispatchXChanged(); } };
 
@@ -50,7 +154,62 @@ public:
     void setDispatchY(int y) { if (y != m_dispatchY) { m_dispatchY = y; emit dispatchYChanged(); } };
 
     int dispatchZ() const { return m_dispatchZ; }
-    void setDispatchZ(int z) { if (z != m_dispatchZ) { m_dispatchY = z; emit dispatchZChanged(); } };;;
+    void setDispatchZ(int z) { if (z != m_dispatchZ) { m_dispatchZ = z; emit dispatchZChanged(); } };
+
+    int globalSizeX() const { return m_globalSize[0]; }
+    void setGlobalSizeX(int x) { setGlobalSize(0, x); }
+
+    int globalSizeY() const { return m_globalSize[1]; }
+    void setGlobalSizeY(int y) { setGlobalSize(1, y); }
+
+    int globalSizeZ() const { return m_globalSize[2]; }
+    void setGlobalSizeZ(int z) { setGlobalSize(2, z); }
+
+    qreal fixedTimestep() const { return m_fixedTimestep; }
+    void setFixedTimestep(qreal timestep);
+
+    int maxStepsPerFrame() const { return m_maxStepsPerFrame; }
+    void setMaxStepsPerFrame(int steps);
+
+    qreal targetRate() const { return m_targetRate; }
+    void setTargetRate(qreal rate);
+
+    bool pauseWhenHidden() const { return m_pauseWhenHidden; }
+    void setPauseWhenHidden(bool pause);
+
+    StorageBuffer* convergenceBuffer() const { return m_convergenceBuffer.data(); }
+    void setConvergenceBuffer(StorageBuffer *buffer);
+
+    qreal convergenceThreshold() const { return m_convergenceThreshold; }
+    void setConvergenceThreshold(qreal threshold);
+
+    qreal residual() const { return m_residual; }
+
+    qreal recordTime() const { return m_recordTime; }
+
+    Backend backend() const { return m_backend; }
+    void setBackend(Backend backend);
+
+    QString cpuKernel() const { return m_cpuKernelName; }
+    void setCpuKernel(const QString &name);
+
+    Backend activeBackend() const { return m_activeBackend; }
+
+    qint64 storageBufferBytes() const { return m_memoryUsage.storageBufferBytes; }
+    qint64 uniformBufferBytes() const { return m_memoryUsage.uniformBufferBytes; }
+    qint64 textureBytes() const { return m_memoryUsage.textureBytes; }
+    qint64 pooledBytes() const { return m_memoryUsage.idleBytes; }
+    qint64 memoryUsage() const { return m_memoryUsage.total(); }
+    qint64 totalMemoryUsage() const { return m_totalMemoryUsage; }
+    QVariantMap rhiStatistics() const { return m_rhiStatistics; }
+
+    qint64 memoryBudget() const { return m_memoryBudget; }
+    void setMemoryBudget(qint64 bytes);
+    QString memoryError() const { return m_memoryError; }
+
+    // views that display a buffer of this item; used to pause while all of them are hidden
+    void registerView(QQuickItem *view);
+    void unregisterView(QQuickItem *view);
 
     QQmlListProperty<ComputeShaderBuffer> buffers();
 
@@ -74,20 +233,60 @@ public:
     }
 
     QRhiBuffer* rhiStorageBufferAt(int idx) const;
+
+    // called by the buffers after a resize; the GPU resource is replaced with the next rebuild
+    void requestBufferResize(ComputeShaderBuffer *buffer, bool preserve, const QByteArray &pattern);
+    // called by storage buffers after element writes; only the range is uploaded with the next frame
+    void requestBufferRangeUpload(ComputeShaderBuffer *buffer, quint32 offset, const QByteArray &data);
     QSGTexture* qsgTextureAt(int idx) const;
 
 signals:
     void computeShaderChanged();
+    void computeShaderSourceChanged();
+    void definesChanged();
+    void autotuneChanged();
+    void autotuneCandidatesChanged();
+    void tunedLocalSizeChanged();
+    void hotReloadChanged();
+    void shaderErrorChanged();
     void dispatchXChanged();
     void dispatchYChanged();
     void dispatchZChanged();
-
+    void globalSizeXChanged();
+    void globalSizeYChanged();
+    void globalSizeZChanged();
+    void fixedTimestepChanged();
+    void maxStepsPerFrameChanged();
+    void targetRateChanged();
+    void pauseWhenHiddenChanged();
+    void convergenceBufferChanged();
+    void convergenceThresholdChanged();
+    void residualChanged();
+    void recordTimeChanged();
+    void backendChanged();
+    void cpuKernelChanged();
+    void activeBackendChanged();
+    void memoryUsageChanged();
+    void memoryBudgetChanged();
+
+    void converged();
     void notifyChange();
+    // the snapshot of saveState() has been written, or could not be taken
+    void stateSaved(const QString &path, bool success);
 
 public slots:
     void computeStep();
     void compute();
     void stop();
+    void resetClock();
+
+    // Takes a snapshot of all buffers and images, the uniform properties and the simulation
+    // clock with the next frame and writes it to path; see stateSaved(). Returns false if a
+    // snapshot is in progress already.
+    bool saveState(const QString &path);
+    // Loads a snapshot written by saveState() into the buffers and uniform properties. The
+    // contents are uploaded with the next frame; the buffers must match in number and type.
+    bool restoreState(const QString &path);
 
 private slots:
     void initPipeline(QRhi *rhi);
@@ -96,46 +295,204 @@ protected:
     void componentComplete() override;
     void classBegin() override {};
 
-private slots:
-    void handlePropertyChanged();
-
 private:
+    friend class UniformPropertyBinding;
+    friend class ComputeScheduler;
+    friend class ComputePrimitive;
+    friend class BufferRecorder;
+
     struct UniformProperty {
         QString name;
         QMetaType::Type metaType;
-        union {
-            qint32 i32value;
-            float fvalue;
-        };
+        quint32 offset;
         quint32 sizeInBytes;
     };
 
+    struct ResizeRequest {
+        int index;
+        quint32 size;
+        QSize imageSize;
+        bool preserve;
+        QByteArray pattern;
+    };
+
+    struct RangeUpload {
+        int index;
+        quint32 offset;
+        QByteArray data;
+    };
+
+    // a shared buffer in the CPU copies of its owner; see cpuData()
+    struct CpuSource {
+        ComputeItem *owner;
+        int index;
+    };
+
+    // settings of a CounterBuffer; copied in synchronize()
+    struct Counter {
+        int index;
+        // nullptr once the buffer is destroyed, see forgetCounter()
+        CounterBuffer *buffer;
+        quint32 resetValue;
+        bool autoReset;
+    };
+
+    // std140 layout of the reserved uniform block ComputeBuiltins
+    struct ComputeBuiltins {
+        quint32 step;
+        quint32 frame;
+        float elapsed;
+        float delta;
+        // uvec4; first work group of a split dispatch, add it to gl_WorkGroupID
+        quint32 workGroupOffset[4];
+    };
+
+    struct Dispatch {
+        int groups[3];
+        quint32 offset[3];
+    };
+
+    struct ClockState {
+        quint32 step { 0 };
+        quint32 frame { 0 };
+        qreal elapsed { 0.0 };
+    };
+
+    struct StateSnapshot {
+        struct Buffer {
+            qint32 type { 0 };
+            QSize imageSize;
+            // QRhiTexture::Format of images
+            quint32 format { 0 };
+            QByteArray data;
+        };
+
+        QString path;
+        QVariantMap uniforms;
+        ClockState clock;
+        QVector<Buffer> buffers;
+        bool failed { false };
+    };
+
     static void append_storageBuffer(QQmlListProperty<ComputeShaderBuffer> *list, ComputeShaderBuffer *storageBuffer);
 
     QShader loadShader(const QString &filename);
-    QRhi* rhiInterface() const;
+    QShader loadComputeShader(QRhi *rhi, QString *errorMessage);
+    bool isPrecompiledShader() const;
+    QByteArray glslSource(QString *errorMessage) const;
+    void setTunedLocalSize(int localSize);
+    void runAutotune(QRhi *rhi);
+    QString shaderName() const;
     void releaseResources();
+    void releaseQSGTextures();
+    void releasePipelineObjects();
+    void releaseBufferResources(int index);
+    bool createBufferResources(QRhi *rhi, int index);
+    void allocationFailed();
+    bool runInitializers(QRhi *rhi, int index);
+    void resetBuffers(QRhi *rhi);
+    void uploadBufferRanges(QRhiResourceUpdateBatch *updateBatch);
+    void resetCounters(QRhi *rhi, QRhiResourceUpdateBatch *updateBatch);
+    void recordCounterResets(QRhiCommandBuffer *cb);
+    void resetCpuCounters(const QVector<CpuComputeContext::Resource> &resources);
+    void readBackCounters(QRhiResourceUpdateBatch *readbacks);
+    void releaseCounterReadbacks();
+    void releaseCounterFills();
+    // under the mutex of the scheduler, see ComputeScheduler::forgetCounter()
+    void forgetCounter(CounterBuffer *counter);
+    std::vector<QRhiShaderResourceBinding> resourceBindings(const QVector<QRhiBuffer *> &storageBuffers, const QVector<QRhiTexture *> &textures) const;
+    QVector<ComputeItem *> producers() const;
+    bool updatePipeline(QRhi *rhi);
+    // one frame of work, called by ComputeScheduler in this order
+    void beginFrame(QRhi *rhi);
+    bool prepareFrame(QRhi *rhi, QRhiCommandBuffer *cb, QRhiResourceUpdateBatch *updateBatch);
+    void recordDispatches(QRhiCommandBuffer *cb);
+    void finishFrame(QRhiResourceUpdateBatch *readbacks);
+    void reportRecordTime(qreal milliseconds);
+    bool resizeBufferResources(QRhi *rhi, const ResizeRequest &request);
+    void releaseRetiredResources();
     void init();
-    void doCompute(QRhi *rhi, bool continuously = false);
+    int prepareCompute(QRhiResourceUpdateBatch *updateBatch, bool continuously);
+
+    bool isComputeDue();
+    void requestNextCompute();
+    void updateHidden();
+    void updateShaderWatcher();
+    void setShaderError(const QString &error);
+    void reportShaderError(const QString &error);
+    void reportMemoryUsage(QRhi *rhi);
+    void reloadPipeline(QRhi *rhi);
+    void handleResidual(float residual);
+    void readBackResidual(QRhiResourceUpdateBatch *readbacks);
+    void flushInitialUpdates(QRhiCommandBuffer *cb, QRhiResourceUpdateBatch *updateBatch);
+    void readBackState(QRhiResourceUpdateBatch *readbacks);
+    void handleStateReadback(int index, const QByteArray &data);
+    void finishStateSnapshot();
+    void writeStateSnapshot(const StateSnapshot &snapshot);
+    bool useCpuBackend(QRhi *rhi) const;
+    void setCpuData(int index, const QByteArray &data, const QSize &imageSize);
+    QByteArray *cpuData(int index);
+    QSize cpuImageSize(int index) const;
+    bool isCpuSourceValid(const CpuSource &source) const;
+    void runCpuSteps(QRhiResourceUpdateBatch *updateBatch);
 
     void handleDynamicProperties();
     bool isValidUniformProperty(const QString &name, const QVariant &value) const;
     quint32 uniformBufferSize() const;
+    void writeUniformValue(const UniformProperty &uniformProperty, const QVariant &value);
+    void writeUniformData(quint32 offset, const void *data, quint32 size);
+    void synchronize();
+    void syncUniformData();
     void updateUniformBuffer(QRhiResourceUpdateBatch *updateBatch);
+    // fills the ComputeBuiltins slots from firstStep on; returns the number of steps
+    int advanceClock(QRhiResourceUpdateBatch *updateBatch, bool singleStep, int firstStep);
+    void setGlobalSize(int dimension, int size);
+    void updateDispatches(QRhi *rhi);
 
     // return a pair with the corresponding RhiTexture::Format format and size in bytes
     std::pair<QRhiTexture::Format, quint32> toRhiTextureFormat(ImageBuffer::TextureFormat format) const;
+    QRhiTexture::Flags textureFlags(const ImageBuffer *imageBuffer) const;
 
     QVector<ComputeShaderBuffer *> m_buffers;
     QVector<QRhiBuffer *> m_rhiStorageBuffers;
+    QVector<QRhiTexture *> m_rhiTextures;
     QVector<QSGTexture *> m_qsgTextures;
+    // true for resources of shared buffers owned by another ComputeItem
+    QVector<bool> m_borrowedResources;
 
     int m_dispatchX { 1 };
     int m_dispatchY { 1 };
     int m_dispatchZ { 1 };
+    int m_globalSize[3] { 0, 0, 0 };
+
+    // split dispatches for the global size; empty if dispatchX/Y/Z are used
+    int m_renderGlobalSize[3] { 0, 0, 0 };
+    QVector<Dispatch> m_dispatches;
 
     QQuickWindow *m_window { nullptr };
+    QPointer<ComputeScheduler> m_scheduler;
     QString m_computeShaderFilename;
+    QString m_computeShaderSource;
+    QString m_renderShaderFilename;
+    QString m_renderShaderSource;
+    QVariantMap m_defines;
+    QByteArray m_definesPreamble;
+    QByteArray m_renderDefinesPreamble;
+    // shader and defines the "Defines are ignored" warning was given for
+    QByteArray m_ignoredDefines;
+
+    bool m_autotune { false };
+    bool m_autotuneChanged { false };
+    QVariantList m_autotuneCandidates { 32, 64, 128, 256, 512 };
+    int m_tunedLocalSize { 0 };
+    bool m_renderAutotune { false };
+    QVector<int> m_renderAutotuneCandidates;
+    bool m_autotunePending { false };
+    QByteArray m_tunedPreamble;
+    bool m_hotReload { false };
+    QString m_shaderError;
+    QString m_renderShaderError;
+    QFileSystemWatcher *m_shaderWatcher { nullptr };
     bool m_isInitialized { false };
     bool m_pipelineIsInitialized { false };
     bool m_dirty { false };
@@ -150,10 +507,159 @@ private:
     QRhiShaderResourceBindings *m_computeBindings { nullptr };
     QRhiComputePipeline *m_computePipeline { nullptr };
 
-    QVector<QRhiResource *> m_releasePool;
+    // Shared buffers. The ComputeItem a buffer was added to first owns its GPU resource, all
+    // other items bind that resource and are recorded after their producers in every frame.
+    // m_resourceGeneration changes whenever the own resources are replaced.
+    QVector<ComputeItem *> m_renderProducers;
+    QHash<ComputeItem *, quint64> m_producerGenerations;
+    quint64 m_resourceGeneration { 0 };
+
+    // requested computations; copied in synchronize()
+    int m_stepRequests { 0 };
+    int m_renderStepRequests { 0 };
+    bool m_renderRunning { false };
+
+    // work prepared for the current frame; reset in prepareFrame()
+    bool m_framePrepared { false };
+    bool m_recordedContinuously { false };
+    int m_recordedSteps { 0 };
+    qreal m_recordTime { 0.0 };
+
+    ResourcePool m_resourcePool;
+
+    // GPU memory accounting, see memoryUsage. The budget is copied in synchronize(), the
+    // usage is reported after every rebuild.
+    qint64 m_memoryBudget { 0 };
+    qint64 m_renderMemoryBudget { 0 };
+    ResourcePool::Usage m_memoryUsage;
+    qint64 m_totalMemoryUsage { 0 };
+    QVariantMap m_rhiStatistics;
+    QString m_memoryError;
+    QString m_renderMemoryError;
+
+    BufferResizer m_bufferResizer;
+    InitializerKernels m_initializerKernels;
+    // replaced by a resize; returned to the pool once the frame using them is recorded and
+    // destroyed with the next frame
+    QVector<QRhiBuffer *> m_retiredBuffers;
+    QVector<QRhiTexture *> m_retiredTextures;
+    bool m_trimPending { false };
+    QShader m_computeShader;
+
+    // What needs to be rebuilt. Recorded on the GUI thread and handed over in synchronize().
+    QSet<int> m_changedBuffers;
+    bool m_buffersChanged { false };
+    bool m_shaderChanged { false };
+    bool m_shaderReloaded { false };
+    bool m_bindingsChanged { false };
+
+    QVector<ResizeRequest> m_resizeRequests;
+    // buffers whose initializers run again on their current resources, see ComputeShaderBuffer::reset()
+    QSet<int> m_resetBuffers;
+    // element writes of storage buffers, see StorageBuffer::writeData()
+    QVector<RangeUpload> m_rangeUploads;
+
+    QSet<int> m_renderChangedBuffers;
+    QVector<ResizeRequest> m_renderResizeRequests;
+    QSet<int> m_renderResetBuffers;
+    QVector<RangeUpload> m_renderRangeUploads;
+    QVector<Counter> m_renderCounters;
+    // one small readback in flight per counter, by buffer index; released when the counters change
+    QHash<int, AsyncReadback *> m_counterReadbacks;
+    // values of completed readbacks by buffer index, handed to the counters in readBackCounters()
+    QHash<int, quint32> m_counterValues;
+    // the fills setting the counters before every step, InitializerKernels ids by buffer index
+    QHash<int, int> m_counterFills;
+    // the initializers of every buffer; copied in synchronize()
+    QVector<QVector<BufferInitializer::Parameters>> m_renderInitializers;
+    // element writes applied after the initializers, see StorageBuffer::writtenRanges()
+    QVector<QVector<StorageBuffer::WrittenRange>> m_renderWrittenRanges;
+    bool m_renderBuffersChanged { false };
+    bool m_renderShaderChanged { false };
+    bool m_renderShaderReloaded { false };
+    bool m_renderBindingsChanged { false };
 
     QVector<UniformProperty> m_uniformPropertyList;
-    // map signalIndex to uniform property index
-    QMap<int, int> m_signalIndexMap;
+
+    // Packed uniform block. m_uniformData is written on the GUI thread only, the render
+    // thread reads its own snapshot m_renderUniformData, which is taken in syncUniformData()
+    // while the GUI thread is blocked.
+    QByteArray m_uniformData;
+    QByteArray m_renderUniformData;
+    bool m_uniformDataChanged { false };
+
+    // Simulation clock; filled on the render thread for every dispatch if the shader declares
+    // the ComputeBuiltins uniform block. The settings are copied in synchronize().
+    qreal m_fixedTimestep { 0.0 };
+    int m_maxStepsPerFrame { 4 };
+    bool m_clockResetRequested { false };
+
+    qreal m_renderFixedTimestep { 0.0 };
+    int m_renderMaxStepsPerFrame { 4 };
+    bool m_renderClockResetRequested { false };
+
+    QRhiBuffer *m_builtinsUBuf { nullptr };
+    int m_builtinsBinding { -1 };
+    quint32 m_builtinsSlotSize { 0 };
+    // one slot per dispatch of a step
+    int m_builtinsSlotsPerStep { 1 };
+    QElapsedTimer m_clock;
+    qint64 m_lastClockNs { 0 };
+    qreal m_accumulator { 0.0 };
+    qreal m_simulationTime { 0.0 };
+    quint32 m_step { 0 };
+    quint32 m_frameIndex { 0 };
+
+    // Scheduling of continuous computations. The render thread copies of the
+    // settings are taken in synchronize().
+    qreal m_targetRate { 0.0 };
+    bool m_pauseWhenHidden { false };
+    bool m_hidden { false };
+    QPointer<StorageBuffer> m_convergenceBuffer;
+    qreal m_convergenceThreshold { 0.0 };
+    qreal m_residual { 0.0 };
+    QVector<QPointer<QQuickItem>> m_views;
+    QTimer m_updateTimer;
+
+    qreal m_renderTargetRate { 0.0 };
+    bool m_renderPaused { false };
+    StorageBuffer *m_renderConvergenceBuffer { nullptr };
+    QElapsedTimer m_rateTimer;
+    qint64 m_lastComputeNs { 0 };
+    AsyncReadback *m_residualReadback { nullptr };
+
+    // CPU backend. The kernel works on CPU copies of the buffers, shared buffers use the copy of
+    // their owner. Settings are copied in synchronize(), the backend is picked on a full rebuild.
+    Backend m_backend { Backend::Auto };
+    QString m_cpuKernelName;
+    Backend m_activeBackend { Backend::Gpu };
+
+    Backend m_renderBackend { Backend::Auto };
+    QString m_renderCpuKernelName;
+    bool m_cpuActive { false };
+    CpuKernels::Kernel m_cpuKernel;
+    QVector<QByteArray> m_cpuData;
+    QVector<CpuSource> m_cpuSources;
+    QVector<QSize> m_cpuImageSizes;
+    // the ComputeBuiltins of the steps prepared for the current frame
+    QVector<CpuBuiltins> m_cpuSteps;
+
+    // State snapshots, see saveState(). The uniform values are taken on the GUI thread, the
+    // buffers are read back on the render thread at the end of the next frame. One snapshot
+    // is in progress at a time.
+    QString m_saveStatePath;
+    QVariantMap m_saveStateUniforms;
+    bool m_savingState { false };
+    QString m_renderSaveStatePath;
+    QVariantMap m_renderSaveStateUniforms;
+    std::shared_ptr<StateSnapshot> m_stateSnapshot;
+    int m_outstandingStateReadbacks { 0 };
+    QVector<AsyncReadback *> m_stateReadbacks;
+
+    // clock of a restored snapshot; applied like a reset
+    ClockState m_restoredClock;
+    bool m_clockRestoreRequested { false };
+    ClockState m_renderRestoredClock;
+    bool m_renderClockRestoreRequested { false };
 
 };
\ No newline at end of file
@@ -0,0 +1,634 @@
+// SPDX-FileCopyrightText: 2024 basysKom GmbH
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#include "computeprimitives.h"
+
+#include <QDebug>
+#include <QGuiApplication>
+
+#include <cstring>
+
+#include "computeitem.h"
+#include "computescheduler.h"
+
+ComputePrimitive::ComputePrimitive(QObject *parent)
+    : QObject(parent)
+{
+    init();
+}
+
+ComputePrimitive::~ComputePrimitive()
+{
+    // the render thread does not see this primitive anymore once this returns
+    if (m_scheduler) {
+        m_scheduler->unregisterPrimitive(this);
+    }
+
+    for (auto readback : std::as_const(m_readbacks)) {
+        readback->release();
+    }
+    m_readbacks.clear();
+
+    m_kernels.releaseResources();
+    delete m_resultBuffer;
+    m_resultBuffer = nullptr;
+}
+
+void ComputePrimitive::init()
+{
+    const QWindowList windowList = QGuiApplication::allWindows();
+    for (auto w : std::as_const(windowList)) {
+        if ((m_window = qobject_cast<QQuickWindow *>(w))) {
+            break;
+        }
+    }
+
+    if (!m_window) {
+        qWarning() << "No QQuickWindow found; cannot init" << metaObject()->className();
+        return;
+    }
+
+    m_scheduler = ComputeScheduler::forWindow(m_window);
+    m_scheduler->registerPrimitive(this);
+}
+
+void ComputePrimitive::setCount(int count)
+{
+    if (count == m_count) {
+        return;
+    }
+    m_count = count;
+    emit countChanged();
+}
+
+void ComputePrimitive::setAutoRun(bool autoRun)
+{
+    if (autoRun == m_autoRun) {
+        return;
+    }
+    m_autoRun = autoRun;
+    emit autoRunChanged();
+}
+
+void ComputePrimitive::setReadBack(bool readBack)
+{
+    if (readBack == m_readBack) {
+        return;
+    }
+    m_readBack = readBack;
+    emit readBackChanged();
+}
+
+void ComputePrimitive::setResult(const QVariant &result)
+{
+    m_result = result;
+    emit resultChanged();
+}
+
+void ComputePrimitive::run()
+{
+    if (!m_window) {
+        qWarning() << metaObject()->className() << "is not initialized";
+        return;
+    }
+
+    // recorded with the next frame, see ComputeScheduler
+    m_runRequested = true;
+    m_window->update();
+}
+
+ComputePrimitive::RenderResource ComputePrimitive::renderResource(ComputeShaderBuffer *buffer) const
+{
+    // called while the GUI thread is blocked
+    RenderResource resource;
+    if (buffer && buffer->computeItem()) {
+        resource.item = buffer->computeItem();
+        resource.index = resource.item->indexForBuffer(buffer);
+    }
+    return resource;
+}
+
+QRhiBuffer* ComputePrimitive::rhiBuffer(const RenderResource &resource) const
+{
+    if (!resource.item || resource.index < 0 || resource.index >= resource.item->m_rhiStorageBuffers.size()) {
+        return nullptr;
+    }
+    return resource.item->m_rhiStorageBuffers.at(resource.index);
+}
+
+QRhiTexture* ComputePrimitive::rhiTexture(const RenderResource &resource) const
+{
+    if (!resource.item || resource.index < 0 || resource.index >= resource.item->m_rhiTextures.size()) {
+        return nullptr;
+    }
+    return resource.item->m_rhiTextures.at(resource.index);
+}
+
+QRhiBuffer* ComputePrimitive::resultBuffer(QRhi *rhi, quint32 size)
+{
+    if (m_resultBuffer && m_resultBuffer->size() == size) {
+        return m_resultBuffer;
+    }
+
+    delete m_resultBuffer;
+    m_resultBuffer = rhi->newBuffer(QRhiBuffer::Static, QRhiBuffer::StorageBuffer, size);
+    if (!m_resultBuffer->create()) {
+        qWarning() << "Cannot create the result buffer of" << metaObject()->className();
+        delete m_resultBuffer;
+        m_resultBuffer = nullptr;
+    }
+    return m_resultBuffer;
+}
+
+void ComputePrimitive::synchronize()
+{
+    // called on the render thread while the GUI thread is blocked
+    m_renderRunRequested = m_renderRunRequested || m_runRequested;
+    m_runRequested = false;
+    m_renderAutoRun = m_autoRun;
+    m_renderReadBack = m_readBack;
+    m_renderCount = m_count;
+
+    synchronizeParameters();
+    m_renderResourcesValid = true;
+}
+
+bool ComputePrimitive::prepare(QRhi *rhi, QRhiResourceUpdateBatch *updateBatch)
+{
+    // render thread, after all ComputeItems of the window have been prepared
+    if (!m_renderResourcesValid) {
+        return false;
+    }
+
+    const bool inputComputed = m_renderInput.item && m_renderInput.item->m_framePrepared;
+    if (!m_renderRunRequested && !(m_renderAutoRun && inputComputed)) {
+        return false;
+    }
+
+    switch (prepareKernels(rhi, updateBatch)) {
+    case PrepareResult::Ready:
+        m_renderRunRequested = false;
+        return true;
+    case PrepareResult::Waiting:
+        m_window->update();
+        return false;
+    default:
+        m_renderRunRequested = false;
+        return false;
+    }
+}
+
+void ComputePrimitive::record(QRhiCommandBuffer *cb)
+{
+    m_kernels.record(cb);
+}
+
+void ComputePrimitive::finish(QRhiResourceUpdateBatch *readbacks)
+{
+    // render thread
+    if (!m_renderReadBack) {
+        QMetaObject::invokeMethod(this, [this]() {
+            emit finished();
+        }, Qt::QueuedConnection);
+        return;
+    }
+
+    // at most one result in flight; runs in between are not read back
+    if (m_outstandingReadbacks > 0) {
+        return;
+    }
+
+    const auto ranges = this->readbacks();
+    while (m_readbacks.size() < ranges.size()) {
+        const int index = m_readbacks.size();
+        m_readbacks << new AsyncReadback([this, index](const QByteArray &data) {
+            handleReadback(index, data);
+        });
+    }
+
+    m_readbackData = QVector<QByteArray>(ranges.size());
+    m_outstandingReadbacks = ranges.size();
+    for (int i = 0; i < ranges.size(); ++i) {
+        m_readbacks.at(i)->readBackBuffer(readbacks, ranges.at(i).buffer, 0, ranges.at(i).size);
+    }
+}
+
+void ComputePrimitive::handleReadback(int index, const QByteArray &data)
+{
+    // render thread
+    m_readbackData[index] = data;
+    if (--m_outstandingReadbacks > 0) {
+        return;
+    }
+
+    const QVector<QByteArray> results = m_readbackData;
+    QMetaObject::invokeMethod(this, [this, results]() {
+        setResults(results);
+        emit finished();
+    }, Qt::QueuedConnection);
+}
+
+void ComputePrimitive::forgetItem(ComputeItem *item)
+{
+    // the resources are resolved again with the next synchronization
+    Q_UNUSED(item);
+    m_renderResourcesValid = false;
+}
+
+Reduce::Reduce(QObject *parent)
+    : ComputePrimitive(parent)
+{
+}
+
+void Reduce::setInput(StorageBuffer *input)
+{
+    if (input == m_input) {
+        return;
+    }
+    m_input = input;
+    emit inputChanged();
+}
+
+void Reduce::setOutput(StorageBuffer *output)
+{
+    if (output == m_output) {
+        return;
+    }
+    m_output = output;
+    emit outputChanged();
+}
+
+void Reduce::setValueType(ValueType type)
+{
+    if (type == m_valueType) {
+        return;
+    }
+    m_valueType = type;
+    emit valueTypeChanged();
+}
+
+void Reduce::setOperation(Operation operation)
+{
+    if (operation == m_operation) {
+        return;
+    }
+    m_operation = operation;
+    emit operationChanged();
+}
+
+void Reduce::synchronizeParameters()
+{
+    m_renderInput = renderResource(m_input);
+    m_renderOutput = renderResource(m_output);
+    m_renderHasOutput = !m_output.isNull();
+    m_renderValueType = m_valueType;
+    m_renderOperation = m_operation;
+}
+
+ComputePrimitive::PrepareResult Reduce::prepareKernels(QRhi *rhi, QRhiResourceUpdateBatch *updateBatch)
+{
+    if (!m_renderInput.item) {
+        qWarning() << "Reduce needs an input buffer that belongs to a ComputeItem";
+        return PrepareResult::Failed;
+    }
+
+    QRhiBuffer *input = rhiBuffer(m_renderInput);
+    m_renderTarget = m_renderHasOutput ? rhiBuffer(m_renderOutput) : resultBuffer(rhi, PrimitiveKernels::valueSize());
+    if (!input || !m_renderTarget) {
+        return PrepareResult::Waiting;
+    }
+
+    const bool prepared = m_kernels.prepareReduce(rhi, updateBatch, input, renderCount(m_renderCount),
+                                                  PrimitiveKernels::ValueType(m_renderValueType),
+                                                  PrimitiveKernels::Operation(m_renderOperation), m_renderTarget);
+    return prepared ? PrepareResult::Ready : PrepareResult::Failed;
+}
+
+QVector<ComputePrimitive::Readback> Reduce::readbacks() const
+{
+    return { { m_renderTarget, quint32(PrimitiveKernels::valueSize()) } };
+}
+
+void Reduce::setResults(const QVector<QByteArray> &data)
+{
+    if (data.isEmpty() || data.first().size() < PrimitiveKernels::valueSize()) {
+        return;
+    }
+
+    const char *value = data.first().constData();
+    switch (m_valueType) {
+    case Int: {
+        qint32 result;
+        memcpy(&result, value, sizeof(result));
+        setResult(result);
+        break;
+    }
+    case Float: {
+        float result;
+        memcpy(&result, value, sizeof(result));
+        setResult(result);
+        break;
+    }
+    default: {
+        quint32 result;
+        memcpy(&result, value, sizeof(result));
+        setResult(result);
+        break;
+    }
+    }
+}
+
+PrefixSum::PrefixSum(QObject *parent)
+    : ComputePrimitive(parent)
+{
+}
+
+void PrefixSum::setInput(StorageBuffer *input)
+{
+    if (input == m_input) {
+        return;
+    }
+    m_input = input;
+    emit inputChanged();
+}
+
+void PrefixSum::setOutput(StorageBuffer *output)
+{
+    if (output == m_output) {
+        return;
+    }
+    m_output = output;
+    emit outputChanged();
+}
+
+void PrefixSum::setValueType(ValueType type)
+{
+    if (type == m_valueType) {
+        return;
+    }
+    m_valueType = type;
+    emit valueTypeChanged();
+}
+
+void PrefixSum::setInclusive(bool inclusive)
+{
+    if (inclusive == m_inclusive) {
+        return;
+    }
+    m_inclusive = inclusive;
+    emit inclusiveChanged();
+}
+
+void PrefixSum::synchronizeParameters()
+{
+    m_renderInput = renderResource(m_input);
+    m_renderOutput = renderResource(m_output);
+    m_renderValueType = m_valueType;
+    m_renderInclusive = m_inclusive;
+}
+
+ComputePrimitive::PrepareResult PrefixSum::prepareKernels(QRhi *rhi, QRhiResourceUpdateBatch *updateBatch)
+{
+    if (!m_renderInput.item || !m_renderOutput.item) {
+        qWarning() << "PrefixSum needs an input and an output buffer that belong to a ComputeItem";
+        return PrepareResult::Failed;
+    }
+
+    QRhiBuffer *input = rhiBuffer(m_renderInput);
+    m_renderTarget = rhiBuffer(m_renderOutput);
+    if (!input || !m_renderTarget) {
+        return PrepareResult::Waiting;
+    }
+
+    const quint32 count = qMin(renderCount(m_renderCount), qMin(input->size(), m_renderTarget->size()) / quint32(PrimitiveKernels::valueSize()));
+    m_renderTargetSize = qMax(count, 1u) * quint32(PrimitiveKernels::valueSize());
+
+    const bool prepared = m_kernels.prepareScan(rhi, updateBatch, input, count, PrimitiveKernels::ValueType(m_renderValueType),
+                                                m_renderInclusive, m_renderTarget);
+    return prepared ? PrepareResult::Ready : PrepareResult::Failed;
+}
+
+QVector<ComputePrimitive::Readback> PrefixSum::readbacks() const
+{
+    return { { m_renderTarget, m_renderTargetSize } };
+}
+
+void PrefixSum::setResults(const QVector<QByteArray> &data)
+{
+    if (!data.isEmpty()) {
+        setResult(data.first());
+    }
+}
+
+RadixSort::RadixSort(QObject *parent)
+    : ComputePrimitive(parent)
+{
+}
+
+void RadixSort::setKeys(StorageBuffer *keys)
+{
+    if (keys == m_keys) {
+        return;
+    }
+    m_keys = keys;
+    emit keysChanged();
+}
+
+void RadixSort::setValues(StorageBuffer *values)
+{
+    if (values == m_values) {
+        return;
+    }
+    m_values = values;
+    emit valuesChanged();
+}
+
+void RadixSort::setKeyBits(int bits)
+{
+    bits = qBound(1, bits, 32);
+    if (bits == m_keyBits) {
+        return;
+    }
+    m_keyBits = bits;
+    emit keyBitsChanged();
+}
+
+void RadixSort::synchronizeParameters()
+{
+    m_renderInput = renderResource(m_keys);
+    m_renderValues = renderResource(m_values);
+    m_renderHasValues = !m_values.isNull();
+    m_renderKeyBits = m_keyBits;
+}
+
+ComputePrimitive::PrepareResult RadixSort::prepareKernels(QRhi *rhi, QRhiResourceUpdateBatch *updateBatch)
+{
+    if (!m_renderInput.item || (m_renderHasValues && !m_renderValues.item)) {
+        qWarning() << "RadixSort needs keys and values buffers that belong to a ComputeItem";
+        return PrepareResult::Failed;
+    }
+
+    m_renderKeysBuffer = rhiBuffer(m_renderInput);
+    m_renderValuesBuffer = m_renderHasValues ? rhiBuffer(m_renderValues) : nullptr;
+    if (!m_renderKeysBuffer || (m_renderHasValues && !m_renderValuesBuffer)) {
+        return PrepareResult::Waiting;
+    }
+
+    quint32 count = qMin(renderCount(m_renderCount), m_renderKeysBuffer->size() / quint32(PrimitiveKernels::valueSize()));
+    if (m_renderValuesBuffer) {
+        count = qMin(count, m_renderValuesBuffer->size() / quint32(PrimitiveKernels::valueSize()));
+    }
+    m_renderSize = qMax(count, 1u) * quint32(PrimitiveKernels::valueSize());
+
+    const bool prepared = m_kernels.prepareSort(rhi, updateBatch, m_renderKeysBuffer, m_renderValuesBuffer, count, m_renderKeyBits);
+    return prepared ? PrepareResult::Ready : PrepareResult::Failed;
+}
+
+QVector<ComputePrimitive::Readback> RadixSort::readbacks() const
+{
+    QVector<Readback> ranges { { m_renderKeysBuffer, m_renderSize } };
+    if (m_renderValuesBuffer) {
+        ranges.append({ m_renderValuesBuffer, m_renderSize });
+    }
+    return ranges;
+}
+
+void RadixSort::setResults(const QVector<QByteArray> &data)
+{
+    if (data.isEmpty()) {
+        return;
+    }
+
+    if (data.size() > 1) {
+        m_sortedValues = data.at(1);
+        emit sortedValuesChanged();
+    }
+    setResult(data.first());
+}
+
+Histogram::Histogram(QObject *parent)
+    : ComputePrimitive(parent)
+{
+}
+
+void Histogram::setInput(ComputeShaderBuffer *input)
+{
+    if (input == m_input) {
+        return;
+    }
+    m_input = input;
+    emit inputChanged();
+}
+
+void Histogram::setOutput(StorageBuffer *output)
+{
+    if (output == m_output) {
+        return;
+    }
+    m_output = output;
+    emit outputChanged();
+}
+
+void Histogram::setValueType(ValueType type)
+{
+    if (type == m_valueType) {
+        return;
+    }
+    m_valueType = type;
+    emit valueTypeChanged();
+}
+
+void Histogram::setBins(int bins)
+{
+    bins = qMax(1, bins);
+    if (bins == m_bins) {
+        return;
+    }
+    m_bins = bins;
+    emit binsChanged();
+}
+
+void Histogram::setMinimum(qreal minimum)
+{
+    if (qFuzzyCompare(minimum, m_minimum)) {
+        return;
+    }
+    m_minimum = minimum;
+    emit minimumChanged();
+}
+
+void Histogram::setMaximum(qreal maximum)
+{
+    if (qFuzzyCompare(maximum, m_maximum)) {
+        return;
+    }
+    m_maximum = maximum;
+    emit maximumChanged();
+}
+
+void Histogram::synchronizeParameters()
+{
+    m_renderInput = renderResource(m_input);
+    m_renderImageInput = m_input && m_input->type() == ComputeShaderBuffer::Image;
+    m_renderOutput = renderResource(m_output);
+    m_renderHasOutput = !m_output.isNull();
+    m_renderValueType = m_valueType;
+    m_renderBins = m_bins;
+    m_renderMinimum = float(m_minimum);
+    m_renderMaximum = float(m_maximum);
+}
+
+ComputePrimitive::PrepareResult Histogram::prepareKernels(QRhi *rhi, QRhiResourceUpdateBatch *updateBatch)
+{
+    if (!m_renderInput.item) {
+        qWarning() << "Histogram needs an input buffer that belongs to a ComputeItem";
+        return PrepareResult::Failed;
+    }
+
+    const int channels = m_renderImageInput ? 4 : 1;
+    m_renderTargetSize = quint32(channels * m_renderBins * PrimitiveKernels::valueSize());
+    m_renderTarget = m_renderHasOutput ? rhiBuffer(m_renderOutput) : resultBuffer(rhi, m_renderTargetSize);
+    if (!m_renderTarget) {
+        return PrepareResult::Waiting;
+    }
+
+    bool prepared = false;
+    if (m_renderImageInput) {
+        QRhiTexture *image = rhiTexture(m_renderInput);
+        if (!image) {
+            return PrepareResult::Waiting;
+        }
+        prepared = m_kernels.prepareHistogram(rhi, updateBatch, image, m_renderMinimum, m_renderMaximum, m_renderBins, m_renderTarget);
+    } else {
+        QRhiBuffer *input = rhiBuffer(m_renderInput);
+        if (!input) {
+            return PrepareResult::Waiting;
+        }
+        prepared = m_kernels.prepareHistogram(rhi, updateBatch, input, renderCount(m_renderCount), PrimitiveKernels::ValueType(m_renderValueType),
+                                              m_renderMinimum, m_renderMaximum, m_renderBins, m_renderTarget);
+    }
+    return prepared ? PrepareResult::Ready : PrepareResult::Failed;
+}
+
+QVector<ComputePrimitive::Readback> Histogram::readbacks() const
+{
+    return { { m_renderTarget, m_renderTargetSize } };
+}
+
+void Histogram::setResults(const QVector<QByteArray> &data)
+{
+    if (data.isEmpty()) {
+        return;
+    }
+
+    const QByteArray &counts = data.first();
+    QVariantList result;
+    result.reserve(counts.size() / int(sizeof(quint32)));
+    for (int offset = 0; offset + int(sizeof(quint32)) <= counts.size(); offset += sizeof(quint32)) {
+        quint32 count;
+        memcpy(&count, counts.constData() + offset, sizeof(count));
+        result << count;
+    }
+    setResult(result);
+}
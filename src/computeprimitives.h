@@ -0,0 +1,399 @@
+// SPDX-FileCopyrightText: 2024 basysKom GmbH
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#pragma once
+
+#include <QObject>
+#include <QByteArray>
+#include <QPointer>
+#include <QVariant>
+#include <QVector>
+#include <QQuickWindow>
+
+#include <qqml.h>
+
+#include "asyncreadback.h"
+#include "computeshaderbuffer.h"
+#include "primitivekernels.h"
+#include "storagebuffer.h"
+
+class ComputeItem;
+class ComputeScheduler;
+
+/**
+ * \brief Base of the parallel primitives operating on the buffers of ComputeItems
+ *
+ * A primitive runs after all ComputeItems of the window in the same compute pass, see
+ * ComputeScheduler, so it sees the results of the frame. The buffers it reads and writes
+ * must belong to a ComputeItem. Results are written to GPU buffers and, with readBack,
+ * read back asynchronously into the result property.
+ */
+class ComputePrimitive : public QObject
+{
+    Q_OBJECT
+    // number of values; 0 processes the whole input
+    Q_PROPERTY(int count READ count WRITE setCount NOTIFY countChanged)
+    // run in every frame in which the ComputeItem owning the input computes
+    Q_PROPERTY(bool autoRun READ autoRun WRITE setAutoRun NOTIFY autoRunChanged)
+    // read the result back into the result property after every run
+    Q_PROPERTY(bool readBack READ readBack WRITE setReadBack NOTIFY readBackChanged)
+    Q_PROPERTY(QVariant result READ result NOTIFY resultChanged)
+    QML_ELEMENT
+    QML_UNCREATABLE(QLatin1String(
+        "Cannot create a ComputePrimitive directly: Create a Reduce, PrefixSum, RadixSort or Histogram instead"
+    ))
+
+public:
+    //! Type of the 32 bit values of a storage buffer
+    enum ValueType {
+        UInt,
+        Int,
+        Float
+    };
+    Q_ENUM(ValueType)
+
+    explicit ComputePrimitive(QObject *parent = nullptr);
+    ~ComputePrimitive();
+
+    int count() const { return m_count; }
+    void setCount(int count);
+
+    bool autoRun() const { return m_autoRun; }
+    void setAutoRun(bool autoRun);
+
+    bool readBack() const { return m_readBack; }
+    void setReadBack(bool readBack);
+
+    QVariant result() const { return m_result; }
+
+    // runs with the next frame
+    Q_INVOKABLE void run();
+
+signals:
+    void countChanged();
+    void autoRunChanged();
+    void readBackChanged();
+    void resultChanged();
+
+    // the operation has been recorded; with readBack, the result has arrived as well
+    void finished();
+
+protected:
+    struct RenderResource {
+        ComputeItem *item { nullptr };
+        int index { -1 };
+    };
+
+    struct Readback {
+        QRhiBuffer *buffer { nullptr };
+        quint32 size { 0 };
+    };
+
+    enum class PrepareResult {
+        Ready,
+        // a buffer has no GPU resource yet; tried again with the next frame
+        Waiting,
+        Failed
+    };
+
+    // render thread while the GUI thread is blocked; copy the parameters and resolve the buffers
+    virtual void synchronizeParameters() = 0;
+    // render thread; prepares m_kernels
+    virtual PrepareResult prepareKernels(QRhi *rhi, QRhiResourceUpdateBatch *updateBatch) = 0;
+    // render thread; the buffers to read back after a run
+    virtual QVector<Readback> readbacks() const = 0;
+    // GUI thread; the data of the readbacks in order
+    virtual void setResults(const QVector<QByteArray> &data) = 0;
+
+    void setResult(const QVariant &result);
+
+    // the GPU resource of buffer, looked up on the render thread
+    RenderResource renderResource(ComputeShaderBuffer *buffer) const;
+    QRhiBuffer* rhiBuffer(const RenderResource &resource) const;
+    QRhiTexture* rhiTexture(const RenderResource &resource) const;
+    // a buffer owned by the primitive for results without an output buffer
+    QRhiBuffer* resultBuffer(QRhi *rhi, quint32 size);
+    static quint32 renderCount(int count) { return count > 0 ? quint32(count) : 0xffffffffu; }
+
+    // set in synchronizeParameters(); runs with autoRun when this item computes
+    RenderResource m_renderInput;
+    PrimitiveKernels m_kernels;
+    int m_renderCount { 0 };
+
+private:
+    friend class ComputeScheduler;
+
+    void init();
+    void synchronize();
+    bool prepare(QRhi *rhi, QRhiResourceUpdateBatch *updateBatch);
+    void record(QRhiCommandBuffer *cb);
+    void finish(QRhiResourceUpdateBatch *readbacks);
+    void forgetItem(ComputeItem *item);
+    void handleReadback(int index, const QByteArray &data);
+
+    QQuickWindow *m_window { nullptr };
+    QPointer<ComputeScheduler> m_scheduler;
+
+    int m_count { 0 };
+    bool m_autoRun { false };
+    bool m_readBack { true };
+    bool m_runRequested { false };
+    QVariant m_result;
+
+    bool m_renderRunRequested { false };
+    bool m_renderAutoRun { false };
+    bool m_renderReadBack { true };
+    // cleared when a ComputeItem goes away between synchronizing and recording
+    bool m_renderResourcesValid { false };
+    QRhiBuffer *m_resultBuffer { nullptr };
+    QVector<AsyncReadback *> m_readbacks;
+    QVector<QByteArray> m_readbackData;
+    int m_outstandingReadbacks { 0 };
+};
+
+/**
+ * \brief Sum, minimum or maximum of the values of a storage buffer
+ *
+ * The result is written to the first value of output, if set, and read back into result.
+ */
+class Reduce : public ComputePrimitive
+{
+    Q_OBJECT
+    Q_PROPERTY(StorageBuffer* input READ input WRITE setInput NOTIFY inputChanged)
+    Q_PROPERTY(StorageBuffer* output READ output WRITE setOutput NOTIFY outputChanged)
+    Q_PROPERTY(ValueType valueType READ valueType WRITE setValueType NOTIFY valueTypeChanged)
+    Q_PROPERTY(Operation operation READ operation WRITE setOperation NOTIFY operationChanged)
+    QML_ELEMENT
+
+public:
+    enum Operation {
+        Sum,
+        Min,
+        Max
+    };
+    Q_ENUM(Operation)
+
+    explicit Reduce(QObject *parent = nullptr);
+
+    StorageBuffer* input() const { return m_input.data(); }
+    void setInput(StorageBuffer *input);
+
+    StorageBuffer* output() const { return m_output.data(); }
+    void setOutput(StorageBuffer *output);
+
+    ValueType valueType() const { return m_valueType; }
+    void setValueType(ValueType type);
+
+    Operation operation() const { return m_operation; }
+    void setOperation(Operation operation);
+
+signals:
+    void inputChanged();
+    void outputChanged();
+    void valueTypeChanged();
+    void operationChanged();
+
+protected:
+    void synchronizeParameters() override;
+    PrepareResult prepareKernels(QRhi *rhi, QRhiResourceUpdateBatch *updateBatch) override;
+    QVector<Readback> readbacks() const override;
+    void setResults(const QVector<QByteArray> &data) override;
+
+private:
+    QPointer<StorageBuffer> m_input;
+    QPointer<StorageBuffer> m_output;
+    ValueType m_valueType { UInt };
+    Operation m_operation { Sum };
+
+    RenderResource m_renderOutput;
+    bool m_renderHasOutput { false };
+    ValueType m_renderValueType { UInt };
+    Operation m_renderOperation { Sum };
+    QRhiBuffer *m_renderTarget { nullptr };
+};
+
+/**
+ * \brief Inclusive or exclusive prefix sum of the values of a storage buffer
+ *
+ * The sums are written to output, which must be a different buffer than input. With
+ * readBack, result holds the sums as a byte array.
+ */
+class PrefixSum : public ComputePrimitive
+{
+    Q_OBJECT
+    Q_PROPERTY(StorageBuffer* input READ input WRITE setInput NOTIFY inputChanged)
+    Q_PROPERTY(StorageBuffer* output READ output WRITE setOutput NOTIFY outputChanged)
+    Q_PROPERTY(ValueType valueType READ valueType WRITE setValueType NOTIFY valueTypeChanged)
+    Q_PROPERTY(bool inclusive READ inclusive WRITE setInclusive NOTIFY inclusiveChanged)
+    QML_ELEMENT
+
+public:
+    explicit PrefixSum(QObject *parent = nullptr);
+
+    StorageBuffer* input() const { return m_input.data(); }
+    void setInput(StorageBuffer *input);
+
+    StorageBuffer* output() const { return m_output.data(); }
+    void setOutput(StorageBuffer *output);
+
+    ValueType valueType() const { return m_valueType; }
+    void setValueType(ValueType type);
+
+    bool inclusive() const { return m_inclusive; }
+    void setInclusive(bool inclusive);
+
+signals:
+    void inputChanged();
+    void outputChanged();
+    void valueTypeChanged();
+    void inclusiveChanged();
+
+protected:
+    void synchronizeParameters() override;
+    PrepareResult prepareKernels(QRhi *rhi, QRhiResourceUpdateBatch *updateBatch) override;
+    QVector<Readback> readbacks() const override;
+    void setResults(const QVector<QByteArray> &data) override;
+
+private:
+    QPointer<StorageBuffer> m_input;
+    QPointer<StorageBuffer> m_output;
+    ValueType m_valueType { UInt };
+    bool m_inclusive { false };
+
+    RenderResource m_renderOutput;
+    ValueType m_renderValueType { UInt };
+    bool m_renderInclusive { false };
+    QRhiBuffer *m_renderTarget { nullptr };
+    quint32 m_renderTargetSize { 0 };
+};
+
+/**
+ * \brief Stable radix sort of 32 bit unsigned keys, optionally with a value per key
+ *
+ * keys and values are sorted in place. keyBits limits the sort to the lowest bits of the
+ * keys, rounded up to whole bytes. With readBack, result holds the sorted keys and
+ * sortedValues the values as byte arrays.
+ */
+class RadixSort : public ComputePrimitive
+{
+    Q_OBJECT
+    Q_PROPERTY(StorageBuffer* keys READ keys WRITE setKeys NOTIFY keysChanged)
+    Q_PROPERTY(StorageBuffer* values READ values WRITE setValues NOTIFY valuesChanged)
+    Q_PROPERTY(int keyBits READ keyBits WRITE setKeyBits NOTIFY keyBitsChanged)
+    Q_PROPERTY(QByteArray sortedValues READ sortedValues NOTIFY sortedValuesChanged)
+    QML_ELEMENT
+
+public:
+    explicit RadixSort(QObject *parent = nullptr);
+
+    StorageBuffer* keys() const { return m_keys.data(); }
+    void setKeys(StorageBuffer *keys);
+
+    StorageBuffer* values() const { return m_values.data(); }
+    void setValues(StorageBuffer *values);
+
+    int keyBits() const { return m_keyBits; }
+    void setKeyBits(int bits);
+
+    QByteArray sortedValues() const { return m_sortedValues; }
+
+signals:
+    void keysChanged();
+    void valuesChanged();
+    void keyBitsChanged();
+    void sortedValuesChanged();
+
+protected:
+    void synchronizeParameters() override;
+    PrepareResult prepareKernels(QRhi *rhi, QRhiResourceUpdateBatch *updateBatch) override;
+    QVector<Readback> readbacks() const override;
+    void setResults(const QVector<QByteArray> &data) override;
+
+private:
+    QPointer<StorageBuffer> m_keys;
+    QPointer<StorageBuffer> m_values;
+    int m_keyBits { 32 };
+    QByteArray m_sortedValues;
+
+    RenderResource m_renderValues;
+    bool m_renderHasValues { false };
+    int m_renderKeyBits { 32 };
+    QRhiBuffer *m_renderKeysBuffer { nullptr };
+    QRhiBuffer *m_renderValuesBuffer { nullptr };
+    quint32 m_renderSize { 0 };
+};
+
+/**
+ * \brief Histogram of the values of a storage buffer or the channels of an image
+ *
+ * Values between minimum and maximum are counted into bins equally sized bins; values
+ * outside are counted into the first or last bin. Images are counted per channel, the
+ * output then holds bins counts for red, green, blue and alpha in this order. Channels
+ * of RGBA8 images are normalized to 0..1. The counts are written to output, if set, and
+ * read back into result as a list.
+ */
+class Histogram : public ComputePrimitive
+{
+    Q_OBJECT
+    Q_PROPERTY(ComputeShaderBuffer* input READ input WRITE setInput NOTIFY inputChanged)
+    Q_PROPERTY(StorageBuffer* output READ output WRITE setOutput NOTIFY outputChanged)
+    Q_PROPERTY(ValueType valueType READ valueType WRITE setValueType NOTIFY valueTypeChanged)
+    Q_PROPERTY(int bins READ bins WRITE setBins NOTIFY binsChanged)
+    Q_PROPERTY(qreal minimum READ minimum WRITE setMinimum NOTIFY minimumChanged)
+    Q_PROPERTY(qreal maximum READ maximum WRITE setMaximum NOTIFY maximumChanged)
+    QML_ELEMENT
+
+public:
+    explicit Histogram(QObject *parent = nullptr);
+
+    ComputeShaderBuffer* input() const { return m_input.data(); }
+    void setInput(ComputeShaderBuffer *input);
+
+    StorageBuffer* output() const { return m_output.data(); }
+    void setOutput(StorageBuffer *output);
+
+    ValueType valueType() const { return m_valueType; }
+    void setValueType(ValueType type);
+
+    int bins() const { return m_bins; }
+    void setBins(int bins);
+
+    qreal minimum() const { return m_minimum; }
+    void setMinimum(qreal minimum);
+
+    qreal maximum() const { return m_maximum; }
+    void setMaximum(qreal maximum);
+
+signals:
+    void inputChanged();
+    void outputChanged();
+    void valueTypeChanged();
+    void binsChanged();
+    void minimumChanged();
+    void maximumChanged();
+
+protected:
+    void synchronizeParameters() override;
+    PrepareResult prepareKernels(QRhi *rhi, QRhiResourceUpdateBatch *updateBatch) override;
+    QVector<Readback> readbacks() const override;
+    void setResults(const QVector<QByteArray> &data) override;
+
+private:
+    QPointer<ComputeShaderBuffer> m_input;
+    QPointer<StorageBuffer> m_output;
+    ValueType m_valueType { UInt };
+    int m_bins { 256 };
+    qreal m_minimum { 0.0 };
+    qreal m_maximum { 1.0 };
+
+    RenderResource m_renderOutput;
+    bool m_renderHasOutput { false };
+    bool m_renderImageInput { false };
+    ValueType m_renderValueType { UInt };
+    int m_renderBins { 256 };
+    float m_renderMinimum { 0.0f };
+    float m_renderMaximum { 1.0f };
+    QRhiBuffer *m_renderTarget { nullptr };
+    quint32 m_renderTargetSize { 0 };
+};
@@ -0,0 +1,280 @@
+// SPDX-FileCopyrightText: 2024 basysKom GmbH
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#include "computescheduler.h"
+
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QMutexLocker>
+#include <QSet>
+
+#include <functional>
+
+#include "bufferrecorder.h"
+#include "computeitem.h"
+#include "computeprimitives.h"
+#include "computetrace.h"
+
+ComputeScheduler* ComputeScheduler::forWindow(QQuickWindow *window)
+{
+    if (!window) {
+        return nullptr;
+    }
+
+    auto scheduler = window->findChild<ComputeScheduler *>(QString(), Qt::FindDirectChildrenOnly);
+    if (!scheduler) {
+        scheduler = new ComputeScheduler(window);
+    }
+    return scheduler;
+}
+
+ComputeScheduler::ComputeScheduler(QQuickWindow *window)
+    : QObject(window)
+    , m_window(window)
+{
+    // trial dispatches run in offscreen frames, which cannot be nested in the frame of the window
+    connect(m_window, &QQuickWindow::beforeFrameBegin, this, [this]() {
+        beginFrame();
+    }, Qt::DirectConnection);
+
+    connect(m_window, &QQuickWindow::beforeSynchronizing, this, [this]() {
+        synchronize();
+    }, Qt::DirectConnection);
+
+    connect(m_window, &QQuickWindow::beforeRendering, this, [this]() {
+        recordFrame();
+    }, Qt::DirectConnection);
+}
+
+void ComputeScheduler::registerItem(ComputeItem *item)
+{
+    QMutexLocker locker(&m_mutex);
+    if (!m_items.contains(item)) {
+        m_items << item;
+    }
+}
+
+void ComputeScheduler::unregisterItem(ComputeItem *item)
+{
+    QMutexLocker locker(&m_mutex);
+    m_items.removeAll(item);
+    m_renderItems.removeAll(item);
+    // a frame may be recorded without another synchronize; nobody may look at the item's
+    // resource generation anymore
+    for (auto other : std::as_const(m_items)) {
+        other->m_renderProducers.removeAll(item);
+        other->m_producerGenerations.remove(item);
+    }
+    for (auto primitive : std::as_const(m_primitives)) {
+        primitive->forgetItem(item);
+    }
+    for (auto recorder : std::as_const(m_recorders)) {
+        recorder->forgetItem(item);
+    }
+}
+
+void ComputeScheduler::forgetCounter(ComputeItem *item, CounterBuffer *counter)
+{
+    QMutexLocker locker(&m_mutex);
+    item->forgetCounter(counter);
+}
+
+void ComputeScheduler::registerPrimitive(ComputePrimitive *primitive)
+{
+    QMutexLocker locker(&m_mutex);
+    if (!m_primitives.contains(primitive)) {
+        m_primitives << primitive;
+    }
+}
+
+void ComputeScheduler::unregisterPrimitive(ComputePrimitive *primitive)
+{
+    QMutexLocker locker(&m_mutex);
+    m_primitives.removeAll(primitive);
+}
+
+void ComputeScheduler::registerRecorder(BufferRecorder *recorder)
+{
+    QMutexLocker locker(&m_mutex);
+    if (!m_recorders.contains(recorder)) {
+        m_recorders << recorder;
+    }
+}
+
+void ComputeScheduler::unregisterRecorder(BufferRecorder *recorder)
+{
+    QMutexLocker locker(&m_mutex);
+    m_recorders.removeAll(recorder);
+}
+
+QRhi* ComputeScheduler::rhi() const
+{
+    QSGRendererInterface *renderInterface = m_window->rendererInterface();
+    return static_cast<QRhi *>(renderInterface->getResource(m_window, QSGRendererInterface::RhiResource));
+}
+
+QRhiCommandBuffer* ComputeScheduler::commandBuffer() const
+{
+    QSGRendererInterface *renderInterface = m_window->rendererInterface();
+    QRhiSwapChain *swapChain =
+        static_cast<QRhiSwapChain *>(renderInterface->getResource(m_window, QSGRendererInterface::RhiSwapchainResource));
+    return swapChain ? swapChain->currentFrameCommandBuffer() : nullptr;
+}
+
+void ComputeScheduler::beginFrame()
+{
+    // render thread, outside of the frame of the window
+    QMutexLocker locker(&m_mutex);
+    QRhi *rhi = this->rhi();
+    if (!rhi) {
+        return;
+    }
+
+    for (auto item : std::as_const(m_renderItems)) {
+        item->beginFrame(rhi);
+    }
+}
+
+void ComputeScheduler::synchronize()
+{
+    // render thread while the GUI thread is blocked
+    QMutexLocker locker(&m_mutex);
+    for (auto item : std::as_const(m_items)) {
+        item->synchronize();
+    }
+    for (auto primitive : std::as_const(m_primitives)) {
+        primitive->synchronize();
+    }
+    for (auto recorder : std::as_const(m_recorders)) {
+        recorder->synchronize();
+    }
+    sortItems();
+
+    // the resources are created while synchronizing so that views find them
+    QRhi *rhi = this->rhi();
+    if (!rhi) {
+        return;
+    }
+    for (auto item : std::as_const(m_renderItems)) {
+        item->updatePipeline(rhi);
+    }
+}
+
+void ComputeScheduler::sortItems()
+{
+    // depth first over the producers; ties keep the registration order
+    m_renderItems.clear();
+    m_renderItems.reserve(m_items.size());
+
+    QSet<ComputeItem *> visiting;
+    std::function<void(ComputeItem *)> visit = [&](ComputeItem *item) {
+        if (m_renderItems.contains(item) || !m_items.contains(item)) {
+            return;
+        }
+        if (visiting.contains(item)) {
+            // items sharing buffers in both directions; fall back to the registration order
+            return;
+        }
+        visiting.insert(item);
+        for (auto producer : std::as_const(item->m_renderProducers)) {
+            visit(producer);
+        }
+        visiting.remove(item);
+        m_renderItems << item;
+    };
+
+    for (auto item : std::as_const(m_items)) {
+        visit(item);
+    }
+}
+
+void ComputeScheduler::recordFrame()
+{
+    // render thread
+    QMutexLocker locker(&m_mutex);
+    QRhi *rhi = this->rhi();
+    QRhiCommandBuffer *cb = commandBuffer();
+    if (!rhi || !cb || (m_renderItems.isEmpty() && m_primitives.isEmpty())) {
+        return;
+    }
+
+    TraceSpan span("ComputeScheduler::recordFrame");
+#if QT_VERSION >= QT_VERSION_CHECK(6, 6, 0)
+    if (span.isActive()) {
+        ComputeTrace::gpuFrame(cb->lastCompletedGpuTime());
+    }
+#endif
+
+    QElapsedTimer timer;
+    QVector<ComputeItem *> dueItems;
+    QVector<qint64> recordNs;
+
+    // Uploads and clock updates of all items go into one batch. Items with pending resize
+    // copies record them in their own passes here, ahead of the shared pass.
+    QRhiResourceUpdateBatch *updates = rhi->nextResourceUpdateBatch();
+    for (auto item : std::as_const(m_renderItems)) {
+        timer.start();
+        if (item->prepareFrame(rhi, cb, updates)) {
+            dueItems << item;
+            recordNs << timer.nsecsElapsed();
+        }
+    }
+
+    // primitives see the resources of the items as prepared above
+    QVector<ComputePrimitive *> duePrimitives;
+    for (auto primitive : std::as_const(m_primitives)) {
+        if (primitive->prepare(rhi, updates)) {
+            duePrimitives << primitive;
+        }
+    }
+
+    if (dueItems.isEmpty() && duePrimitives.isEmpty()) {
+        cb->resourceUpdate(updates);
+        return;
+    }
+
+    cb->beginComputePass(updates);
+    for (int i = 0; i < dueItems.size(); ++i) {
+        timer.start();
+        dueItems.at(i)->recordDispatches(cb);
+        recordNs[i] += timer.nsecsElapsed();
+    }
+    for (auto primitive : std::as_const(duePrimitives)) {
+        primitive->record(cb);
+    }
+
+    // readbacks are issued once all dispatches of the frame are done
+    QRhiResourceUpdateBatch *readbacks = rhi->nextResourceUpdateBatch();
+
+    // level 0 of mipmapped images was just written; shared images are regenerated once
+    QSet<QRhiTexture *> mipmapped;
+    for (auto item : std::as_const(dueItems)) {
+        for (auto texture : std::as_const(item->m_rhiTextures)) {
+            if (texture && texture->flags().testFlag(QRhiTexture::UsedWithGenerateMips)) {
+                mipmapped.insert(texture);
+            }
+        }
+    }
+    for (auto texture : std::as_const(mipmapped)) {
+        readbacks->generateMips(texture);
+    }
+
+    for (int i = 0; i < dueItems.size(); ++i) {
+        timer.start();
+        dueItems.at(i)->finishFrame(readbacks);
+        recordNs[i] += timer.nsecsElapsed();
+    }
+    for (auto primitive : std::as_const(duePrimitives)) {
+        primitive->finish(readbacks);
+    }
+    // recorders read back what the items and primitives of this frame wrote
+    for (auto recorder : std::as_const(m_recorders)) {
+        recorder->finish(readbacks);
+    }
+    cb->endComputePass(readbacks);
+
+    for (int i = 0; i < dueItems.size(); ++i) {
+        dueItems.at(i)->reportRecordTime(qreal(recordNs.at(i)) / 1e6);
+    }
+}
@@ -0,0 +1,82 @@
+// SPDX-FileCopyrightText: 2024 basysKom GmbH
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#pragma once
+
+#include <QObject>
+#include <QMutex>
+#include <QVector>
+#include <QPointer>
+#include <QQuickWindow>
+
+#if QT_VERSION >= QT_VERSION_CHECK(6, 6, 0)
+  #include <rhi/qrhi.h>
+#else
+  #include <private/qrhi_p.h>
+#endif
+
+class ComputeItem;
+class CounterBuffer;
+class ComputePrimitive;
+class BufferRecorder;
+
+/**
+ * \brief Records the work of all ComputeItems of a window in one compute pass
+ *
+ * There is one scheduler per QQuickWindow, created by the first ComputeItem that registers.
+ * It is the only receiver of the window's frame signals:
+ *
+ * - beforeFrameBegin: autotuning trials, which need offscreen frames
+ * - beforeSynchronizing: the items hand over their state while the GUI thread is blocked
+ *   and create or update their GPU resources
+ * - beforeRendering: the update batches of all due items are merged into one and their
+ *   dispatches are recorded in a single compute pass
+ *
+ * Items are recorded in registration order, except that the owner of a shared buffer is
+ * always recorded before the items borrowing it. ComputePrimitives are recorded after all
+ * items, BufferRecorders after the primitives. QRhi inserts the barriers between the dispatches of a pass that access the same
+ * resources.
+ */
+class ComputeScheduler : public QObject
+{
+    Q_OBJECT
+
+public:
+    // GUI thread
+    static ComputeScheduler* forWindow(QQuickWindow *window);
+
+    void registerItem(ComputeItem *item);
+    // blocks while a frame is recorded; the item must not be used by the render thread afterwards
+    void unregisterItem(ComputeItem *item);
+    // a destroyed counter of the item; the render thread does not hand it values anymore
+    void forgetCounter(ComputeItem *item, CounterBuffer *counter);
+
+    void registerPrimitive(ComputePrimitive *primitive);
+    void unregisterPrimitive(ComputePrimitive *primitive);
+
+    void registerRecorder(BufferRecorder *recorder);
+    void unregisterRecorder(BufferRecorder *recorder);
+
+private:
+    explicit ComputeScheduler(QQuickWindow *window);
+
+    QRhi* rhi() const;
+    QRhiCommandBuffer* commandBuffer() const;
+
+    void beginFrame();
+    void synchronize();
+    void recordFrame();
+    void sortItems();
+
+    QQuickWindow *m_window { nullptr };
+
+    // guards the lists against the render thread while items come and go
+    QMutex m_mutex;
+    // registration order; written on the GUI thread
+    QVector<ComputeItem *> m_items;
+    // producers first; taken in synchronize()
+    QVector<ComputeItem *> m_renderItems;
+    QVector<ComputePrimitive *> m_primitives;
+    QVector<BufferRecorder *> m_recorders;
+};
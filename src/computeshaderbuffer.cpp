@@ -3,6 +3,9 @@
 // SPDX-License-Identifier: LGPL-3.0-or-later
 
 #include "computeshaderbuffer.h"
+
+#include <QDebug>
+
 #include "computeitem.h"
 
 ComputeShaderBuffer::ComputeShaderBuffer(QObject *parent)
@@ -19,4 +22,72 @@ ComputeShaderBuffer::~ComputeShaderBuffer()
 void ComputeShaderBuffer::setComputeItem(ComputeItem *computeItem)
 {
     m_computeItem = computeItem;
-}
\ No newline at end of file
+}
+
+ComputeItem *ComputeShaderBuffer::computeItem() const
+{
+    return m_computeItem.data();
+}
+
+void ComputeShaderBuffer::requestResize(bool preserve, const QByteArray &pattern)
+{
+    if (m_computeItem) {
+        m_computeItem->requestBufferResize(this, preserve, pattern);
+    }
+}
+
+void ComputeShaderBuffer::requestRangeUpload(quint32 offset, const QByteArray &data)
+{
+    if (m_computeItem) {
+        m_computeItem->requestBufferRangeUpload(this, offset, data);
+    }
+}
+
+QQmlListProperty<BufferInitializer> ComputeShaderBuffer::initializers()
+{
+    return QQmlListProperty<BufferInitializer>(this, nullptr, &ComputeShaderBuffer::appendInitializer, &ComputeShaderBuffer::initializerCount,
+        &ComputeShaderBuffer::initializerAt, &ComputeShaderBuffer::clearInitializers);
+}
+
+QVector<BufferInitializer::Parameters> ComputeShaderBuffer::initializerParameters() const
+{
+    QVector<BufferInitializer::Parameters> parameters;
+    for (const auto &initializer : m_initializers) {
+        if (initializer) {
+            parameters << initializer->parameters();
+        }
+    }
+    return parameters;
+}
+
+void ComputeShaderBuffer::reset()
+{
+    if (m_initializers.isEmpty()) {
+        qWarning() << "Cannot reset a buffer without initializers";
+        return;
+    }
+    emit resetRequested();
+}
+
+void ComputeShaderBuffer::appendInitializer(QQmlListProperty<BufferInitializer> *list, BufferInitializer *initializer)
+{
+    auto buffer = static_cast<ComputeShaderBuffer *>(list->object);
+    if (initializer) {
+        buffer->m_initializers.append(initializer);
+    }
+}
+
+qsizetype ComputeShaderBuffer::initializerCount(QQmlListProperty<BufferInitializer> *list)
+{
+    return static_cast<ComputeShaderBuffer *>(list->object)->m_initializers.size();
+}
+
+BufferInitializer *ComputeShaderBuffer::initializerAt(QQmlListProperty<BufferInitializer> *list, qsizetype index)
+{
+    return static_cast<ComputeShaderBuffer *>(list->object)->m_initializers.value(index);
+}
+
+void ComputeShaderBuffer::clearInitializers(QQmlListProperty<BufferInitializer> *list)
+{
+    static_cast<ComputeShaderBuffer *>(list->object)->m_initializers.clear();
+}
@@ -7,12 +7,18 @@
 #include <QObject>
 #include <QQuickItem>
 #include <QPointer>
+#include <QQmlListProperty>
+#include <QVector>
+
+#include "bufferinitializer.h"
 
 class ComputeItem;
 
 class ComputeShaderBuffer : public QObject
 {
     Q_OBJECT
+    // run in order on the GPU when the resource is created and on reset(), see BufferInitializer
+    Q_PROPERTY(QQmlListProperty<BufferInitializer> initializers READ initializers)
     QML_ELEMENT
     QML_UNCREATABLE(QLatin1String(
         "Cannot create a ComputeShaderBuffer directly: Create a StorageBuffer or an ImageBuffer instead"
@@ -32,14 +38,36 @@ public:
 
     void setComputeItem(ComputeItem *computeItem);
     bool hasComputeItem() { return !m_computeItem.isNull(); }
+    // the ComputeItem owning the GPU resource; other ComputeItems may bind it as well
+    ComputeItem *computeItem() const;
 
     virtual QByteArray buffer() const = 0;
     virtual void setBuffer(const QByteArray &byteArray) = 0;
 
+    QQmlListProperty<BufferInitializer> initializers();
+    bool hasInitializers() const { return !m_initializers.isEmpty(); }
+    QVector<BufferInitializer::Parameters> initializerParameters() const;
+
+    // runs the initializers again on the current GPU resource; the pipeline is not rebuilt
+    Q_INVOKABLE void reset();
+
 signals:
     void bufferChanged();
+    void resetRequested();
+
+protected:
+    // let the ComputeItem replace the GPU resource of this buffer after a resize
+    void requestResize(bool preserve, const QByteArray &pattern = QByteArray());
+    // let the ComputeItem upload data to offset of the current GPU resource with the next frame
+    void requestRangeUpload(quint32 offset, const QByteArray &data);
 
 private:
+    static void appendInitializer(QQmlListProperty<BufferInitializer> *list, BufferInitializer *initializer);
+    static qsizetype initializerCount(QQmlListProperty<BufferInitializer> *list);
+    static BufferInitializer *initializerAt(QQmlListProperty<BufferInitializer> *list, qsizetype index);
+    static void clearInitializers(QQmlListProperty<BufferInitializer> *list);
+
     QPointer<ComputeItem> m_computeItem;
+    QVector<QPointer<BufferInitializer>> m_initializers;
 
 };
\ No newline at end of file
@@ -0,0 +1,180 @@
+// SPDX-FileCopyrightText: 2024 basysKom GmbH
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#include "computetrace.h"
+
+#include <QCoreApplication>
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QMutex>
+#include <QSet>
+#include <QThread>
+
+namespace {
+
+// written in chunks of this size; the rest when the application exits
+constexpr qsizetype FlushSize = 64 * 1024;
+// the track of the GPU frames, apart from the thread ids
+constexpr quint64 GpuTrack = 1;
+
+QByteArray escaped(const QString &value)
+{
+    QByteArray result;
+    const QByteArray utf8 = value.toUtf8();
+    for (const char c : utf8) {
+        if (c == '"' || c == '\\') {
+            result += '\\';
+        } else if (uchar(c) < 0x20) {
+            continue;
+        }
+        result += c;
+    }
+    return result;
+}
+
+class TraceWriter
+{
+public:
+    static TraceWriter *instance()
+    {
+        static TraceWriter writer;
+        return &writer;
+    }
+
+    qint64 now() const { return m_timer.nsecsElapsed(); }
+
+    void append(const char *name, qint64 startNs, qint64 durationNs, const QByteArray &args, quint64 track)
+    {
+        QMutexLocker locker(&m_mutex);
+        if (!m_file.isOpen()) {
+            return;
+        }
+
+        if (!m_tracks.contains(track)) {
+            m_tracks.insert(track);
+            appendEvent(QByteArrayLiteral("{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":") + m_pid
+                        + ",\"tid\":" + QByteArray::number(track)
+                        + ",\"args\":{\"name\":\"" + escaped(trackName(track)) + "\"}}");
+        }
+
+        appendEvent(QByteArrayLiteral("{\"name\":\"") + name
+                    + "\",\"cat\":\"compute\",\"ph\":\"X\",\"ts\":" + QByteArray::number(double(startNs) / 1000.0, 'f', 3)
+                    + ",\"dur\":" + QByteArray::number(double(durationNs) / 1000.0, 'f', 3)
+                    + ",\"pid\":" + m_pid + ",\"tid\":" + QByteArray::number(track)
+                    + ",\"args\":{" + args + "}}");
+    }
+
+private:
+    TraceWriter()
+        : m_pid(QByteArray::number(QCoreApplication::applicationPid()))
+    {
+        m_timer.start();
+        m_file.setFileName(qEnvironmentVariable("QCI_TRACE_FILE"));
+        if (!m_file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+            qWarning() << "Cannot open trace file" << m_file.fileName() << m_file.errorString();
+            return;
+        }
+        m_file.write("[\n");
+    }
+
+    ~TraceWriter()
+    {
+        QMutexLocker locker(&m_mutex);
+        if (!m_file.isOpen()) {
+            return;
+        }
+        m_pending += "\n]\n";
+        flush();
+        m_file.close();
+    }
+
+    QString trackName(quint64 track) const
+    {
+        if (track == GpuTrack) {
+            return QStringLiteral("GPU");
+        }
+        const QThread *thread = QThread::currentThread();
+        if (!thread->objectName().isEmpty()) {
+            return thread->objectName();
+        }
+        if (QCoreApplication::instance() && thread == QCoreApplication::instance()->thread()) {
+            return QStringLiteral("GUI thread");
+        }
+        return QString::fromLatin1(thread->metaObject()->className());
+    }
+
+    void appendEvent(const QByteArray &event)
+    {
+        if (m_hasEvents) {
+            m_pending += ",\n";
+        }
+        m_hasEvents = true;
+        m_pending += event;
+        if (m_pending.size() >= FlushSize) {
+            flush();
+        }
+    }
+
+    void flush()
+    {
+        m_file.write(m_pending);
+        m_file.flush();
+        m_pending.clear();
+    }
+
+    QElapsedTimer m_timer;
+    const QByteArray m_pid;
+    QMutex m_mutex;
+    QFile m_file;
+    QByteArray m_pending;
+    bool m_hasEvents { false };
+    QSet<quint64> m_tracks;
+};
+
+} // namespace
+
+const bool ComputeTrace::s_enabled = !qEnvironmentVariableIsEmpty("QCI_TRACE_FILE");
+
+qint64 ComputeTrace::now()
+{
+    return TraceWriter::instance()->now();
+}
+
+void ComputeTrace::completeEvent(const char *name, qint64 startNs, qint64 durationNs, const QByteArray &args)
+{
+    const auto track = quint64(quintptr(QThread::currentThreadId()));
+    TraceWriter::instance()->append(name, startNs, durationNs, args, track);
+}
+
+void ComputeTrace::gpuFrame(double seconds)
+{
+    if (!s_enabled || seconds <= 0.0) {
+        return;
+    }
+    const qint64 durationNs = qint64(seconds * 1e9);
+    TraceWriter::instance()->append("GPU frame", now() - durationNs, durationNs, QByteArray(), GpuTrack);
+}
+
+void TraceSpan::addArg(const char *key, qint64 value)
+{
+    if (!isActive()) {
+        return;
+    }
+    if (!m_args.isEmpty()) {
+        m_args += ',';
+    }
+    m_args += '"' + QByteArray(key) + "\":" + QByteArray::number(value);
+}
+
+void TraceSpan::addArg(const char *key, const QString &value)
+{
+    if (!isActive()) {
+        return;
+    }
+    if (!m_args.isEmpty()) {
+        m_args += ',';
+    }
+    m_args += '"' + QByteArray(key) + "\":\"" + escaped(value) + '"';
+}
@@ -0,0 +1,75 @@
+// SPDX-FileCopyrightText: 2024 basysKom GmbH
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#pragma once
+
+#include <QByteArray>
+#include <QString>
+
+/**
+ * \brief Timeline of the compute and render hot paths in the Chrome trace event format
+ *
+ * Set QCI_TRACE_FILE to a file name to record; the file can be opened in Perfetto or
+ * chrome://tracing. Spans are recorded on the thread they run on. The GPU time of every
+ * completed frame is added on a track of its own, ending when the render thread learns about
+ * it; this needs QRhi timestamps, e.g. QSG_RHI_PROFILE=1, and Qt 6.6.
+ *
+ * Without QCI_TRACE_FILE a span costs a check of a flag.
+ */
+class ComputeTrace
+{
+public:
+    static bool isEnabled() { return s_enabled; }
+
+    // nanoseconds on the timeline of the trace
+    static qint64 now();
+
+    // name must outlive the call; args is a list of "key":value pairs without braces
+    static void completeEvent(const char *name, qint64 startNs, qint64 durationNs, const QByteArray &args);
+    // render thread; the GPU time of the last completed frame, see QRhiCommandBuffer::lastCompletedGpuTime()
+    static void gpuFrame(double seconds);
+
+private:
+    static const bool s_enabled;
+};
+
+/**
+ * \brief Records the lifetime of a scope as a span of the trace
+ *
+ *     TraceSpan span("ComputeItem::initPipeline");
+ *     if (span.isActive()) {
+ *         span.addArg("shader", shaderName());
+ *     }
+ */
+class TraceSpan
+{
+public:
+    explicit TraceSpan(const char *name)
+        : m_name(name)
+    {
+        if (ComputeTrace::isEnabled()) {
+            m_start = ComputeTrace::now();
+        }
+    }
+
+    ~TraceSpan()
+    {
+        if (m_start >= 0) {
+            ComputeTrace::completeEvent(m_name, m_start, ComputeTrace::now() - m_start, m_args);
+        }
+    }
+
+    TraceSpan(const TraceSpan &) = delete;
+    TraceSpan &operator=(const TraceSpan &) = delete;
+
+    bool isActive() const { return m_start >= 0; }
+
+    void addArg(const char *key, qint64 value);
+    void addArg(const char *key, const QString &value);
+
+private:
+    const char *m_name;
+    qint64 m_start { -1 };
+    QByteArray m_args;
+};
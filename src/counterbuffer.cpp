@@ -0,0 +1,55 @@
+// SPDX-FileCopyrightText: 2024 basysKom GmbH
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#include "counterbuffer.h"
+
+#include <QMetaObject>
+
+CounterBuffer::CounterBuffer(QObject *parent)
+    : StorageBuffer(parent)
+{
+    // the contents of a new GPU resource
+    setBuffer(QByteArray(sizeof(quint32), 0));
+}
+
+void CounterBuffer::setResetValue(quint32 value)
+{
+    if (value == m_resetValue) {
+        return;
+    }
+    m_resetValue = value;
+    emit resetValueChanged();
+
+    // also the contents a rebuild starts from
+    resetCounter();
+}
+
+void CounterBuffer::setAutoReset(bool autoReset)
+{
+    if (autoReset != m_autoReset) {
+        m_autoReset = autoReset;
+        emit autoResetChanged();
+    }
+}
+
+void CounterBuffer::resetCounter()
+{
+    writeData(0, QByteArray(reinterpret_cast<const char *>(&m_resetValue), sizeof(quint32)));
+}
+
+void CounterBuffer::setRenderValue(quint32 value)
+{
+    m_renderValue.store(value, std::memory_order_relaxed);
+    QMetaObject::invokeMethod(this, [this, value]() {
+        setValue(value);
+    }, Qt::QueuedConnection);
+}
+
+void CounterBuffer::setValue(quint32 value)
+{
+    if (value != m_value) {
+        m_value = value;
+        emit valueChanged();
+    }
+}
@@ -0,0 +1,68 @@
+// SPDX-FileCopyrightText: 2024 basysKom GmbH
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#pragma once
+
+#include <QObject>
+
+#include <atomic>
+
+#include "storagebuffer.h"
+
+/**
+ * \brief A storage buffer holding one atomic counter
+ *
+ * The counter of append and consume buffers, stream compaction and the like. The shader
+ * declares it as
+ *
+ *     layout(std430, binding = 1) buffer Counter { uint count; } counter;
+ *
+ * and takes slots with atomicAdd(counter.count, 1u). With autoReset the owning ComputeItem
+ * sets it to resetValue ahead of every step it dispatches, so with several steps per frame
+ * the count is that of the last one. After the frame the counter is read back
+ * asynchronously, value lags behind by a frame or two.
+ *
+ * Bound to StorageBufferView::countBuffer the counter limits the drawn points.
+ */
+class CounterBuffer : public StorageBuffer
+{
+    Q_OBJECT
+    // the last value read back from the GPU
+    Q_PROPERTY(quint32 value READ value NOTIFY valueChanged)
+    Q_PROPERTY(quint32 resetValue READ resetValue WRITE setResetValue NOTIFY resetValueChanged)
+    // reset before every step; otherwise on resetCounter() only
+    Q_PROPERTY(bool autoReset READ autoReset WRITE setAutoReset NOTIFY autoResetChanged)
+    QML_ELEMENT
+
+public:
+    explicit CounterBuffer(QObject *parent = nullptr);
+
+    quint32 value() const { return m_value; }
+
+    quint32 resetValue() const { return m_resetValue; }
+    void setResetValue(quint32 value);
+
+    bool autoReset() const { return m_autoReset; }
+    void setAutoReset(bool autoReset);
+
+    // sets the counter to resetValue with the next frame
+    Q_INVOKABLE void resetCounter();
+
+    // render thread; the last value read back, -1 before the first readback
+    qint64 renderValue() const { return m_renderValue.load(std::memory_order_relaxed); }
+    void setRenderValue(quint32 value);
+
+signals:
+    void valueChanged();
+    void resetValueChanged();
+    void autoResetChanged();
+
+private:
+    void setValue(quint32 value);
+
+    quint32 m_value { 0 };
+    quint32 m_resetValue { 0 };
+    bool m_autoReset { true };
+    std::atomic<qint64> m_renderValue { -1 };
+};
@@ -0,0 +1,139 @@
+// SPDX-FileCopyrightText: 2024 basysKom GmbH
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#include "cpubackend.h"
+
+#include <QDebug>
+#include <QReadWriteLock>
+#include <QSemaphore>
+#include <QThread>
+
+#include <atomic>
+
+namespace {
+
+struct KernelRegistry
+{
+    QReadWriteLock lock;
+    QHash<QString, CpuKernels::Kernel> kernels;
+};
+
+KernelRegistry &registry()
+{
+    static KernelRegistry instance;
+    return instance;
+}
+
+// enough invocations per batch to amortize claiming it, enough batches to balance the threads
+constexpr int MinInvocationsPerBatch = 1024;
+constexpr int BatchesPerThread = 4;
+
+} // namespace
+
+void CpuKernels::registerKernel(const QString &name, const CpuKernel &kernel, int localSizeX, int localSizeY, int localSizeZ)
+{
+    if (!kernel) {
+        qWarning() << "Cannot register an empty CPU kernel" << name;
+        return;
+    }
+
+    Kernel entry;
+    entry.function = kernel;
+    entry.localSize[0] = qMax(1, localSizeX);
+    entry.localSize[1] = qMax(1, localSizeY);
+    entry.localSize[2] = qMax(1, localSizeZ);
+
+    QWriteLocker locker(&registry().lock);
+    registry().kernels.insert(name, entry);
+}
+
+void CpuKernels::unregisterKernel(const QString &name)
+{
+    QWriteLocker locker(&registry().lock);
+    registry().kernels.remove(name);
+}
+
+bool CpuKernels::contains(const QString &name)
+{
+    QReadLocker locker(&registry().lock);
+    return registry().kernels.contains(name);
+}
+
+CpuKernels::Kernel CpuKernels::kernel(const QString &name)
+{
+    QReadLocker locker(&registry().lock);
+    return registry().kernels.value(name);
+}
+
+CpuDispatcher::CpuDispatcher()
+{
+    setThreadCount(QThread::idealThreadCount());
+}
+
+CpuDispatcher *CpuDispatcher::instance()
+{
+    static CpuDispatcher dispatcher;
+    return &dispatcher;
+}
+
+void CpuDispatcher::setThreadCount(int count)
+{
+    m_threadCount = qMax(1, count);
+    // the calling thread works as well
+    m_pool.setMaxThreadCount(qMax(1, m_threadCount - 1));
+}
+
+void CpuDispatcher::run(const CpuComputeContext &context, const CpuKernel &kernel)
+{
+    const int *groups = context.workGroups();
+    const int *local = context.localSize();
+    const int *global = context.globalSize();
+    if (!kernel || groups[0] <= 0 || groups[1] <= 0 || groups[2] <= 0) {
+        return;
+    }
+
+    const qint64 totalGroups = qint64(groups[0]) * groups[1] * groups[2];
+    const qint64 invocationsPerGroup = qint64(local[0]) * local[1] * local[2];
+    const qint64 groupsPerBatchForSize = (MinInvocationsPerBatch + invocationsPerGroup - 1) / invocationsPerGroup;
+    const qint64 groupsPerBatchForBalance = totalGroups / (qint64(m_threadCount) * BatchesPerThread);
+    const int groupsPerBatch = int(qBound(qint64(1), qMax(groupsPerBatchForSize, groupsPerBatchForBalance), qint64(groups[0])));
+
+    const int batchesPerRow = (groups[0] + groupsPerBatch - 1) / groupsPerBatch;
+    const int batchCount = batchesPerRow * groups[1] * groups[2];
+
+    std::atomic<int> nextBatch { 0 };
+    const auto work = [&]() {
+        for (int index = nextBatch.fetch_add(1, std::memory_order_relaxed); index < batchCount;
+             index = nextBatch.fetch_add(1, std::memory_order_relaxed)) {
+            CpuWorkGroupBatch batch;
+            const int row = index / batchesPerRow;
+            batch.groupBegin = (index % batchesPerRow) * groupsPerBatch;
+            batch.groupEnd = qMin(groups[0], batch.groupBegin + groupsPerBatch);
+            batch.groupY = row % groups[1];
+            batch.groupZ = row / groups[1];
+
+            batch.xBegin = batch.groupBegin * local[0];
+            batch.xEnd = qMin(global[0], batch.groupEnd * local[0]);
+            batch.yBegin = batch.groupY * local[1];
+            batch.yEnd = qMin(global[1], batch.yBegin + local[1]);
+            batch.zBegin = batch.groupZ * local[2];
+            batch.zEnd = qMin(global[2], batch.zBegin + local[2]);
+
+            if (batch.xBegin < batch.xEnd && batch.yBegin < batch.yEnd && batch.zBegin < batch.zEnd) {
+                kernel(context, batch);
+            }
+        }
+    };
+
+    const int helpers = qMin(m_threadCount - 1, batchCount - 1);
+    QSemaphore done;
+    for (int i = 0; i < helpers; ++i) {
+        m_pool.start([&work, &done]() {
+            work();
+            done.release();
+        });
+    }
+    work();
+    done.acquire(qMax(0, helpers));
+}
@@ -0,0 +1,238 @@
+// SPDX-FileCopyrightText: 2024 basysKom GmbH
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#pragma once
+
+#include <QByteArray>
+#include <QHash>
+#include <QSize>
+#include <QString>
+#include <QThreadPool>
+#include <QVector>
+
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <new>
+
+// alignment of the CpuSoA component arrays; one cache line, enough for AVX-512
+constexpr int CpuSimdAlignment = 64;
+
+// the values of the ComputeBuiltins block for one step, see ComputeItem
+struct CpuBuiltins
+{
+    quint32 step { 0 };
+    quint32 frame { 0 };
+    float elapsed { 0.0f };
+    float delta { 0.0f };
+};
+
+/**
+ * \brief A run of work groups along x for one y and z; the unit of work of a CPU kernel
+ *
+ * The invocation ranges are clamped to the global size of the ComputeItem, so a kernel loops
+ * over [xBegin, xEnd) without bounds checks and the compiler can vectorize the inner loop.
+ */
+struct CpuWorkGroupBatch
+{
+    int groupBegin { 0 };
+    int groupEnd { 0 };
+    int groupY { 0 };
+    int groupZ { 0 };
+
+    int xBegin { 0 };
+    int xEnd { 0 };
+    int yBegin { 0 };
+    int yEnd { 0 };
+    int zBegin { 0 };
+    int zEnd { 0 };
+};
+
+/**
+ * \brief What a CPU kernel sees of its ComputeItem during one step
+ *
+ * Buffers are addressed by their index in ComputeItem::buffers, which is their binding in the
+ * compute shader as well. Images are tightly packed rows of imageSize(index).width() pixels.
+ * The uniform block is packed exactly as for the GPU: one 4 byte slot per dynamic property,
+ * floats for real properties and 32 bit integers for int and bool properties.
+ *
+ * Kernels run on several threads at once and must only write to disjoint ranges.
+ */
+class CpuComputeContext
+{
+public:
+    struct Resource
+    {
+        char *data { nullptr };
+        qsizetype size { 0 };
+        QSize imageSize;
+    };
+
+    int bufferCount() const { return int(m_resources.size()); }
+    char *data(int index) const { return index >= 0 && index < m_resources.size() ? m_resources.at(index).data : nullptr; }
+    qsizetype size(int index) const { return index >= 0 && index < m_resources.size() ? m_resources.at(index).size : 0; }
+    QSize imageSize(int index) const { return index >= 0 && index < m_resources.size() ? m_resources.at(index).imageSize : QSize(); }
+
+    template<typename T>
+    T *array(int index) const { return reinterpret_cast<T *>(data(index)); }
+
+    template<typename T>
+    qsizetype count(int index) const { return size(index) / qsizetype(sizeof(T)); }
+
+    // T is float for real properties and qint32 for int and bool properties; look values up
+    // once per batch, not per invocation
+    template<typename T>
+    T uniform(const QString &name) const
+    {
+        static_assert(sizeof(T) == 4, "uniform slots are 4 bytes");
+        T value {};
+        const quint32 offset = m_uniformOffsets.value(name, quint32(-1));
+        if (offset != quint32(-1) && offset + sizeof(T) <= quint32(m_uniforms.size())) {
+            memcpy(&value, m_uniforms.constData() + offset, sizeof(T));
+        }
+        return value;
+    }
+
+    const CpuBuiltins &builtins() const { return m_builtins; }
+
+    const int *workGroups() const { return m_workGroups; }
+    const int *localSize() const { return m_localSize; }
+    const int *globalSize() const { return m_globalSize; }
+
+    // set up by the ComputeItem; data must stay valid and detached while the kernel runs
+    void setResources(const QVector<Resource> &resources) { m_resources = resources; }
+    void setUniforms(const QByteArray &uniforms, const QHash<QString, quint32> &offsets) { m_uniforms = uniforms; m_uniformOffsets = offsets; }
+    void setBuiltins(const CpuBuiltins &builtins) { m_builtins = builtins; }
+    // invocations beyond globalSize are not run
+    void setWorkGroups(const int workGroups[3], const int localSize[3], const int globalSize[3])
+    {
+        std::copy(workGroups, workGroups + 3, m_workGroups);
+        std::copy(localSize, localSize + 3, m_localSize);
+        std::copy(globalSize, globalSize + 3, m_globalSize);
+    }
+
+private:
+    QVector<Resource> m_resources;
+    QByteArray m_uniforms;
+    QHash<QString, quint32> m_uniformOffsets;
+    CpuBuiltins m_builtins;
+    int m_workGroups[3] { 1, 1, 1 };
+    int m_localSize[3] { 1, 1, 1 };
+    int m_globalSize[3] { 1, 1, 1 };
+};
+
+using CpuKernel = std::function<void(const CpuComputeContext &context, const CpuWorkGroupBatch &batch)>;
+
+/**
+ * \brief Process wide registry of CPU kernels
+ *
+ * A ComputeItem whose cpuKernel names a registered kernel runs it instead of its compute
+ * shader on the CPU backend. Register the kernels before the QML scene is loaded; the
+ * registry may be used from any thread.
+ */
+class CpuKernels
+{
+public:
+    struct Kernel
+    {
+        CpuKernel function;
+        int localSize[3] { 64, 1, 1 };
+    };
+
+    static void registerKernel(const QString &name, const CpuKernel &kernel, int localSizeX = 64, int localSizeY = 1, int localSizeZ = 1);
+    static void unregisterKernel(const QString &name);
+    static bool contains(const QString &name);
+    // a kernel without function if none is registered under name
+    static Kernel kernel(const QString &name);
+};
+
+/**
+ * \brief Runs the work groups of a CPU kernel on a pool of threads
+ *
+ * The work groups are cut into batches of whole work groups along x. Workers, the calling
+ * thread included, claim the next batch from a shared counter until none is left, which
+ * balances uneven batches like work stealing does without per-thread queues.
+ */
+class CpuDispatcher
+{
+public:
+    static CpuDispatcher *instance();
+
+    int threadCount() const { return m_threadCount; }
+    // including the calling thread; QThread::idealThreadCount() by default
+    void setThreadCount(int count);
+
+    // blocks until all work groups of context are done
+    void run(const CpuComputeContext &context, const CpuKernel &kernel);
+
+private:
+    CpuDispatcher();
+
+    QThreadPool m_pool;
+    int m_threadCount { 1 };
+};
+
+/**
+ * \brief Structure of arrays copy of an interleaved float buffer
+ *
+ * Each component is a contiguous array aligned to CpuSimdAlignment, so loops over one component
+ * vectorize where strided loops over the original structs do not. Gather the range of a batch,
+ * compute on the components and scatter the results back.
+ */
+template<int Components>
+class CpuSoA
+{
+public:
+    void gather(const float *interleaved, int count, int strideInFloats = Components, int firstComponent = 0)
+    {
+        reserve(count);
+        m_count = count;
+        for (int c = 0; c < Components; ++c) {
+            float *component = this->component(c);
+            const float *source = interleaved + firstComponent + c;
+            for (int i = 0; i < count; ++i) {
+                component[i] = source[i * strideInFloats];
+            }
+        }
+    }
+
+    void scatter(float *interleaved, int strideInFloats = Components, int firstComponent = 0) const
+    {
+        for (int c = 0; c < Components; ++c) {
+            const float *component = this->component(c);
+            float *target = interleaved + firstComponent + c;
+            for (int i = 0; i < m_count; ++i) {
+                target[i * strideInFloats] = component[i];
+            }
+        }
+    }
+
+    int count() const { return m_count; }
+
+    float *component(int index) { return m_data.get() + index * m_capacity; }
+    const float *component(int index) const { return m_data.get() + index * m_capacity; }
+
+private:
+    struct AlignedDelete
+    {
+        void operator()(float *data) const { ::operator delete[](data, std::align_val_t(CpuSimdAlignment)); }
+    };
+
+    void reserve(int count)
+    {
+        // every component starts on an aligned address
+        constexpr int floatsPerLine = CpuSimdAlignment / int(sizeof(float));
+        const int capacity = (count + floatsPerLine - 1) / floatsPerLine * floatsPerLine;
+        if (capacity <= m_capacity) {
+            return;
+        }
+        m_data.reset(static_cast<float *>(::operator new[](sizeof(float) * size_t(capacity) * Components, std::align_val_t(CpuSimdAlignment))));
+        m_capacity = capacity;
+    }
+
+    std::unique_ptr<float[], AlignedDelete> m_data;
+    int m_capacity { 0 };
+    int m_count { 0 };
+};
@@ -7,6 +7,8 @@
 #include <QDebug>
 #include <QImage>
 
+#include <cstring>
+
 ImageBuffer::ImageBuffer(QObject *parent)
     : ComputeShaderBuffer(parent)
 {
@@ -70,6 +72,55 @@ void ImageBuffer::setTextureFormat(TextureFormat format)
     }
 }
 
+bool ImageBuffer::mipmaps() const
+{
+    return m_mipmaps;
+}
+
+void ImageBuffer::setMipmaps(bool mipmaps)
+{
+    if (mipmaps != m_mipmaps) {
+        m_mipmaps = mipmaps;
+        emit mipmapsChanged();
+    }
+}
+
+
+void ImageBuffer::resize(const QSize &size, bool preserve)
+{
+    if (size.isEmpty()) {
+        qWarning() << "Cannot resize image buffer to" << size;
+        return;
+    }
+
+    if (size == m_imageSize) {
+        return;
+    }
+
+    // re-layout the CPU side copy for a later full rebuild; images loaded from imageSource are reloaded then
+    if (!m_buffer.isEmpty() && m_imageSize.isValid()) {
+        const int bytesPerPixel = m_buffer.size() / (m_imageSize.width() * m_imageSize.height());
+        m_buffer = resizedData(m_buffer, m_imageSize, size, bytesPerPixel, preserve);
+    }
+
+    m_imageSize = size;
+    emit imageSizeChanged();
+    requestResize(preserve);
+}
+
+QByteArray ImageBuffer::resizedData(const QByteArray &data, const QSize &from, const QSize &to, int bytesPerPixel, bool preserve)
+{
+    QByteArray resized(to.width() * to.height() * bytesPerPixel, 0);
+    if (preserve && !data.isEmpty()) {
+        const int rowBytes = qMin(to.width(), from.width()) * bytesPerPixel;
+        const int rows = qMin(to.height(), from.height());
+        for (int y = 0; y < rows; ++y) {
+            memcpy(resized.data() + y * to.width() * bytesPerPixel,
+                   data.constData() + y * from.width() * bytesPerPixel, rowBytes);
+        }
+    }
+    return resized;
+}
 
 void ImageBuffer::setQSGTexture(QSGTexture *qsgTexture)
 {
@@ -24,6 +24,10 @@ class ImageBuffer : public ComputeShaderBuffer
     Q_PROPERTY(TextureFormat textureFormat READ textureFormat WRITE setTextureFormat NOTIFY textureFormatChanged)
 
     Q_PROPERTY(QString imageSource READ imageSource WRITE setImageSource NOTIFY imageSourceChanged)
+
+    // allocates a full mip chain that is regenerated after every compute pass; for heavily downscaled views.
+    // Like textureFormat, a change applies when the image is uploaded again.
+    Q_PROPERTY(bool mipmaps READ mipmaps WRITE setMipmaps NOTIFY mipmapsChanged)
     QML_ELEMENT
 
 public:
@@ -54,6 +58,19 @@ public:
     TextureFormat textureFormat() const;
     void setTextureFormat(TextureFormat format);
 
+    bool mipmaps() const;
+    void setMipmaps(bool mipmaps);
+
+    /**
+     * Resizes the image without uploading it again. If preserve is set, the overlapping region of
+     * the current contents is copied on the GPU. New space is zeroed.
+     * The buffer property keeps the CPU side contents and is not updated with GPU results.
+     */
+    Q_INVOKABLE void resize(const QSize &size, bool preserve = true);
+
+    // tightly packed pixels of size from re-laid out for size to; new space is zeroed
+    static QByteArray resizedData(const QByteArray &data, const QSize &from, const QSize &to, int bytesPerPixel, bool preserve);
+
     void setQSGTexture(QSGTexture *qsgTexture);
     QSGTexture* qsgTexture() const;
 
@@ -61,12 +78,14 @@ signals:
     void imageSourceChanged();
     void imageSizeChanged();
     void textureFormatChanged();
+    void mipmapsChanged();
 
 private:
     QByteArray m_buffer;
     QString m_imageSource;
     QSize m_imageSize;
     TextureFormat m_textureFormat { TextureFormat::RGBA8 };
+    bool m_mipmaps { false };
 
     QPointer<QSGTexture> m_qsgTexture;
 };
\ No newline at end of file
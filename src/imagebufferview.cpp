@@ -5,8 +5,45 @@
 #include "imagebufferview.h"
 
 #include <QDebug>
+#include <QRunnable>
+#include <QQuickWindow>
 #include <QSGTexture>
-#include <QSGSimpleTextureNode>
+#include <QSGTextureProvider>
+#include <QSGImageNode>
+
+#include "computetrace.h"
+
+// Hands out the PlainComputeTexture of the result buffer. Lives on the render thread.
+class ImageBufferTextureProvider : public QSGTextureProvider
+{
+public:
+    QSGTexture *texture() const override { return m_texture.data(); }
+
+    void setTexture(QSGTexture *texture, QSGTexture::Filtering filtering, QSGTexture::Filtering mipmapFiltering)
+    {
+        if (texture) {
+            // same sampling as the view's own node
+            texture->setFiltering(filtering);
+            texture->setMipmapFiltering(mipmapFiltering);
+        }
+        if (texture != m_texture.data()) {
+            m_texture = texture;
+            emit textureChanged();
+        }
+    }
+
+private:
+    QPointer<QSGTexture> m_texture;
+};
+
+class CleanupImageBufferTextureProvider : public QRunnable
+{
+public:
+    CleanupImageBufferTextureProvider(ImageBufferTextureProvider *provider) : m_provider(provider) { }
+    void run() override { delete m_provider; }
+private:
+    ImageBufferTextureProvider *m_provider;
+};
 
 ImageBufferView::ImageBufferView(QQuickItem *parent)
     : QQuickItem(parent)
@@ -16,7 +53,7 @@ ImageBufferView::ImageBufferView(QQuickItem *parent)
 
 ImageBufferView::~ImageBufferView()
 {
-
+    releaseTextureProvider();
 }
 
 ComputeItem* ImageBufferView::computeItem() const
@@ -29,10 +66,12 @@ void ImageBufferView::setComputeItem(ComputeItem *item)
     if (item != m_computeItem) {
         if (m_computeItem) {
             m_computeItem->disconnect(this);
+            m_computeItem->unregisterView(this);
         }
         m_computeItem = item;
         if (m_computeItem) {
             connect(m_computeItem, &ComputeItem::notifyChange, this, &QQuickItem::update);
+            m_computeItem->registerView(this);
         }
         emit computeItemChanged();
     }
@@ -51,8 +90,102 @@ void ImageBufferView::setResultBuffer(ImageBuffer* buffer)
     }
 }
 
+ImageBufferView::Filtering ImageBufferView::filtering() const
+{
+    return m_filtering;
+}
+
+void ImageBufferView::setFiltering(Filtering filtering)
+{
+    if (filtering != m_filtering) {
+        m_filtering = filtering;
+        emit filteringChanged();
+        update();
+    }
+}
+
+bool ImageBufferView::mipmap() const
+{
+    return m_mipmap;
+}
+
+void ImageBufferView::setMipmap(bool mipmap)
+{
+    if (mipmap != m_mipmap) {
+        m_mipmap = mipmap;
+        emit mipmapChanged();
+        update();
+    }
+}
+
+bool ImageBufferView::isTextureProvider() const
+{
+    return true;
+}
+
+QSGTextureProvider *ImageBufferView::textureProvider() const
+{
+    // an enabled layer takes precedence, as for the built-in items
+    if (QQuickItem::isTextureProvider()) {
+        return QQuickItem::textureProvider();
+    }
+
+    // render thread, GUI thread is blocked
+    if (!m_provider) {
+        m_provider = new ImageBufferTextureProvider;
+    }
+    updateTextureProvider();
+    return m_provider;
+}
+
+void ImageBufferView::releaseResources()
+{
+    releaseTextureProvider();
+}
+
+void ImageBufferView::invalidateSceneGraph()
+{
+    delete m_provider;
+    m_provider = nullptr;
+}
+
+void ImageBufferView::releaseTextureProvider()
+{
+    if (!m_provider) {
+        return;
+    }
+
+    if (window()) {
+        window()->scheduleRenderJob(new CleanupImageBufferTextureProvider(m_provider), QQuickWindow::BeforeSynchronizingStage);
+    } else {
+        m_provider->deleteLater();
+    }
+    m_provider = nullptr;
+}
+
+void ImageBufferView::updateTextureProvider() const
+{
+    if (!m_provider) {
+        return;
+    }
+    QSGTexture *texture = m_imageBuffer.isNull() ? nullptr : m_imageBuffer->qsgTexture();
+    m_provider->setTexture(texture, QSGTexture::Filtering(m_filtering), mipmapFiltering(texture));
+}
+
+QSGTexture::Filtering ImageBufferView::mipmapFiltering(QSGTexture *texture) const
+{
+    if (!m_mipmap || !texture || !texture->hasMipmaps()) {
+        return QSGTexture::None;
+    }
+    return QSGTexture::Filtering(m_filtering);
+}
+
 QSGNode* ImageBufferView::updatePaintNode(QSGNode *oldNode, UpdatePaintNodeData *data)
 {
+    TraceSpan span("ImageBufferView::updatePaintNode");
+
+    // keep effects sampling this item in sync, even if the item itself is hidden
+    updateTextureProvider();
 
     if (!m_computeItem) {
         return oldNode;
@@ -69,13 +202,14 @@ QSGNode* ImageBufferView::updatePaintNode(QSGNode *oldNode, UpdatePaintNodeData
         return oldNode;
     }
 
-    QSGSimpleTextureNode *node = static_cast<QSGSimpleTextureNode *>(oldNode);
+    QSGImageNode *node = static_cast<QSGImageNode *>(oldNode);
     if (!node) {
-        node = new QSGSimpleTextureNode();
+        node = window()->createImageNode();
     }
 
-   node->setTexture(texture);
-   node->setFiltering(QSGTexture::Linear);
+    node->setTexture(texture);
+    node->setFiltering(QSGTexture::Filtering(m_filtering));
+    node->setMipmapFiltering(mipmapFiltering(texture));
 
     node->setRect(boundingRect());
     return node;
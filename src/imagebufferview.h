@@ -8,6 +8,7 @@
 #include <QVector>
 #include <QQuickItem>
 #include <QSGNode>
+#include <QSGTexture>
 #include <QPointer>
 
 #include <qqml.h>
@@ -15,14 +16,27 @@
 #include "computeitem.h"
 #include "imagebuffer.h"
 
+class ImageBufferTextureProvider;
+
 class ImageBufferView : public QQuickItem
 {
     Q_OBJECT
     Q_PROPERTY(ComputeItem *computeItem READ computeItem WRITE setComputeItem NOTIFY computeItemChanged)
     Q_PROPERTY(ImageBuffer* resultBuffer READ resultBuffer WRITE setResultBuffer NOTIFY resultBufferChanged)
+    Q_PROPERTY(Filtering filtering READ filtering WRITE setFiltering NOTIFY filteringChanged)
+    // samples the mip chain when downscaled; needs an ImageBuffer with mipmaps enabled
+    Q_PROPERTY(bool mipmap READ mipmap WRITE setMipmap NOTIFY mipmapChanged)
     QML_ELEMENT
 
 public:
+    //! Keep in sync with QSGTexture::Filtering
+    enum Filtering
+    {
+        Nearest = QSGTexture::Nearest,
+        Linear = QSGTexture::Linear
+    };
+    Q_ENUM(Filtering)
+
     explicit ImageBufferView(QQuickItem *parent = nullptr);
     ~ImageBufferView();
 
@@ -32,16 +46,40 @@ public:
     ImageBuffer* resultBuffer() const;
     void setResultBuffer(ImageBuffer* buffer);
 
+    Filtering filtering() const;
+    void setFiltering(Filtering filtering);
+
+    bool mipmap() const;
+    void setMipmap(bool mipmap);
+
+    // lets ShaderEffect, MultiEffect etc. sample the result texture without an extra layer
+    bool isTextureProvider() const override;
+    QSGTextureProvider *textureProvider() const override;
+
 signals:
     void computeItemChanged();
     void resultBufferChanged();
+    void filteringChanged();
+    void mipmapChanged();
 
 protected:
     QSGNode *updatePaintNode(QSGNode *oldNode, UpdatePaintNodeData *data) override;
+    void releaseResources() override;
+
+private slots:
+    // invoked by QQuickWindow on the render thread when the scene graph goes away
+    void invalidateSceneGraph();
 
 private:
+    void releaseTextureProvider();
+    void updateTextureProvider() const;
+    QSGTexture::Filtering mipmapFiltering(QSGTexture *texture) const;
+
     ComputeItem* m_computeItem { nullptr };
     QPointer<ImageBuffer> m_imageBuffer;
+    Filtering m_filtering { Filtering::Linear };
+    bool m_mipmap { false };
+    mutable ImageBufferTextureProvider *m_provider { nullptr };
 
 
 };
\ No newline at end of file
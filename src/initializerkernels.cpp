@@ -0,0 +1,285 @@
+// SPDX-FileCopyrightText: 2024 basysKom GmbH
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#include "initializerkernels.h"
+
+#include <QDebug>
+#include <QFile>
+
+#include "shadercompiler.h"
+
+namespace {
+constexpr quint32 bufferWorkgroupSize = 256;
+constexpr quint32 imageWorkgroupSize = 16;
+// minimum number of work groups per dimension guaranteed by all backends
+constexpr quint32 maxGroupsPerDimension = 65535;
+}
+
+InitializerKernels::~InitializerKernels()
+{
+    releaseResources();
+}
+
+bool InitializerKernels::scheduleFill(QRhi *rhi, QRhiResourceUpdateBatch *updateBatch, const BufferInitializer::Parameters &parameters,
+                                      QRhiBuffer *buffer)
+{
+    Fill fill;
+    if (!createBufferFill(rhi, updateBatch, parameters, buffer, fill)) {
+        return false;
+    }
+    if (fill.pipeline) {
+        m_pendingFills.append(fill);
+    }
+    return true;
+}
+
+int InitializerKernels::createRecurringFill(QRhi *rhi, QRhiResourceUpdateBatch *updateBatch, const BufferInitializer::Parameters &parameters,
+                                            QRhiBuffer *buffer)
+{
+    Fill fill;
+    if (!createBufferFill(rhi, updateBatch, parameters, buffer, fill) || !fill.pipeline) {
+        return -1;
+    }
+    const int id = m_nextRecurringFill++;
+    m_recurringFills.insert(id, fill);
+    return id;
+}
+
+void InitializerKernels::recordRecurringFill(QRhiCommandBuffer *cb, int id) const
+{
+    const auto it = m_recurringFills.constFind(id);
+    if (it == m_recurringFills.constEnd()) {
+        return;
+    }
+    cb->setComputePipeline(it->pipeline);
+    cb->setShaderResources();
+    cb->dispatch(it->groupsX, it->groupsY, 1);
+}
+
+void InitializerKernels::releaseRecurringFill(int id)
+{
+    auto it = m_recurringFills.find(id);
+    if (it != m_recurringFills.end()) {
+        releaseFill(*it);
+        m_recurringFills.erase(it);
+    }
+}
+
+bool InitializerKernels::createBufferFill(QRhi *rhi, QRhiResourceUpdateBatch *updateBatch, const BufferInitializer::Parameters &parameters,
+                                          QRhiBuffer *buffer, Fill &fill)
+{
+    if (!rhi || !updateBatch || !buffer) {
+        return false;
+    }
+
+    Params params = this->params(parameters);
+    params.count = parameters.elementCount(buffer->size());
+    params.width = parameters.width > 0 ? parameters.width : qMax(1u, params.count);
+    if (params.count == 0) {
+        return true;
+    }
+
+    const quint32 groups = (params.count + bufferWorkgroupSize - 1) / bufferWorkgroupSize;
+    fill.groupsX = int(qMin(groups, maxGroupsPerDimension));
+    fill.groupsY = int((groups + maxGroupsPerDimension - 1) / maxGroupsPerDimension);
+    params.rowInvocations = quint32(fill.groupsX) * bufferWorkgroupSize;
+
+    QByteArray preamble;
+    switch (parameters.valueType) {
+    case BufferInitializer::Int:
+        preamble = "#define VALUE_INT\n";
+        break;
+    case BufferInitializer::UInt:
+        preamble = "#define VALUE_UINT\n";
+        break;
+    default:
+        preamble = "#define VALUE_FLOAT\n";
+        break;
+    }
+
+    return create(rhi, updateBatch, parameters, preamble,
+                  QRhiShaderResourceBinding::bufferLoadStore(1, QRhiShaderResourceBinding::ComputeStage, buffer), params, fill);
+}
+
+bool InitializerKernels::scheduleFill(QRhi *rhi, QRhiResourceUpdateBatch *updateBatch, const BufferInitializer::Parameters &parameters,
+                                      QRhiTexture *texture)
+{
+    if (!rhi || !updateBatch || !texture) {
+        return false;
+    }
+
+    QByteArray preamble = "#define TARGET_IMAGE\n";
+    switch (texture->format()) {
+    case QRhiTexture::RGBA8:
+        preamble += "#define IMAGE_FORMAT rgba8\n";
+        break;
+    case QRhiTexture::RGBA16F:
+        preamble += "#define IMAGE_FORMAT rgba16f\n";
+        break;
+    case QRhiTexture::RGBA32F:
+        preamble += "#define IMAGE_FORMAT rgba32f\n";
+        break;
+    default:
+        qWarning() << "Cannot initialize images of format" << texture->format();
+        return false;
+    }
+
+    const QSize size = texture->pixelSize();
+    Params params = this->params(parameters);
+    params.width = quint32(qMax(1, size.width()));
+    params.count = quint32(size.width() * size.height());
+    params.components = 4;
+
+    Fill fill;
+    fill.groupsX = int((quint32(size.width()) + imageWorkgroupSize - 1) / imageWorkgroupSize);
+    fill.groupsY = int((quint32(size.height()) + imageWorkgroupSize - 1) / imageWorkgroupSize);
+
+    if (!create(rhi, updateBatch, parameters, preamble,
+                QRhiShaderResourceBinding::imageStore(1, QRhiShaderResourceBinding::ComputeStage, texture, 0), params, fill)) {
+        return false;
+    }
+    m_pendingFills.append(fill);
+    return true;
+}
+
+bool InitializerKernels::create(QRhi *rhi, QRhiResourceUpdateBatch *updateBatch, const BufferInitializer::Parameters &parameters,
+                                const QByteArray &preamble, const QRhiShaderResourceBinding &target, const Params &params, Fill &fill)
+{
+    const QShader computeShader = shader(rhi, preamble, parameters.fill == BufferInitializer::Custom ? parameters.customFunction : QByteArray());
+    if (!computeShader.isValid()) {
+        return false;
+    }
+
+    fill.paramsBuffer = rhi->newBuffer(QRhiBuffer::Dynamic, QRhiBuffer::UniformBuffer, sizeof(Params));
+    if (!fill.paramsBuffer->create()) {
+        qWarning() << "Cannot create resources for initializing a buffer";
+        releaseFill(fill);
+        return false;
+    }
+    updateBatch->updateDynamicBuffer(fill.paramsBuffer, 0, sizeof(Params), &params);
+
+    fill.bindings = rhi->newShaderResourceBindings();
+    fill.bindings->setBindings({
+        QRhiShaderResourceBinding::uniformBuffer(0, QRhiShaderResourceBinding::ComputeStage, fill.paramsBuffer),
+        target
+    });
+    fill.bindings->create();
+
+    fill.pipeline = rhi->newComputePipeline();
+    fill.pipeline->setShaderResourceBindings(fill.bindings);
+    fill.pipeline->setShaderStage({ QRhiShaderStage::Compute, computeShader });
+    if (!fill.pipeline->create()) {
+        qWarning() << "Cannot create pipeline for initializing a buffer";
+        releaseFill(fill);
+        return false;
+    }
+    return true;
+}
+
+void InitializerKernels::recordFills(QRhiCommandBuffer *cb, QRhiResourceUpdateBatch *updateBatch)
+{
+    if (m_pendingFills.isEmpty()) {
+        if (updateBatch) {
+            cb->resourceUpdate(updateBatch);
+        }
+        return;
+    }
+
+    cb->beginComputePass(updateBatch);
+    for (const auto &fill : std::as_const(m_pendingFills)) {
+        cb->setComputePipeline(fill.pipeline);
+        cb->setShaderResources();
+        cb->dispatch(fill.groupsX, fill.groupsY, 1);
+    }
+    cb->endComputePass();
+
+    m_finishedFills += m_pendingFills;
+    m_pendingFills.clear();
+}
+
+void InitializerKernels::releaseFinished()
+{
+    for (auto &fill : m_finishedFills) {
+        releaseFill(fill);
+    }
+    m_finishedFills.clear();
+}
+
+void InitializerKernels::releaseResources()
+{
+    releaseFinished();
+    for (auto &fill : m_pendingFills) {
+        releaseFill(fill);
+    }
+    m_pendingFills.clear();
+    for (auto &fill : m_recurringFills) {
+        releaseFill(fill);
+    }
+    m_recurringFills.clear();
+}
+
+QShader InitializerKernels::shader(QRhi *rhi, const QByteArray &preamble, const QByteArray &customFunction)
+{
+    const QByteArray key = preamble + '\n' + customFunction;
+    auto it = m_shaders.constFind(key);
+    if (it != m_shaders.constEnd()) {
+        return it.value();
+    }
+
+    QFile file(QLatin1String(":/shaders/initializers/fill.comp"));
+    if (!file.open(QIODevice::ReadOnly)) {
+        qWarning() << "Cannot open shader file:" << file.fileName();
+        return QShader();
+    }
+
+    QByteArray source = file.readAll();
+    QByteArray variantPreamble = preamble;
+    if (!customFunction.isEmpty()) {
+        variantPreamble += "#define CUSTOM_FILL\n";
+        source.replace("//#CUSTOM_FUNCTION", customFunction);
+    }
+
+    QString errorMessage;
+    const QShader computeShader = ShaderCompiler::compileComputeShader(rhi, source, variantPreamble, &errorMessage);
+    if (!computeShader.isValid()) {
+        qWarning().noquote() << "Cannot compile buffer initializer:" << errorMessage;
+    }
+    m_shaders.insert(key, computeShader);
+    return computeShader;
+}
+
+InitializerKernels::Params InitializerKernels::params(const BufferInitializer::Parameters &parameters)
+{
+    Params params;
+    params.fill = quint32(parameters.fill);
+    params.count = parameters.count;
+    params.offset = parameters.offset;
+    params.stride = parameters.stride;
+    params.components = parameters.components;
+    params.width = parameters.width;
+    params.seed = parameters.seed;
+    params.rowInvocations = 0;
+    for (int c = 0; c < 4; ++c) {
+        params.value[c] = parameters.value[c];
+        params.background[c] = parameters.background[c];
+        params.rect[c] = parameters.rect[c];
+    }
+    params.range[0] = parameters.minimum;
+    params.range[1] = parameters.maximum;
+    params.range[2] = parameters.mean;
+    params.range[3] = parameters.deviation;
+    params.shape[0] = parameters.center[0];
+    params.shape[1] = parameters.center[1];
+    params.shape[2] = parameters.radius;
+    params.shape[3] = parameters.step;
+    return params;
+}
+
+void InitializerKernels::releaseFill(Fill &fill)
+{
+    delete fill.pipeline;
+    delete fill.bindings;
+    delete fill.paramsBuffer;
+    fill = Fill();
+}
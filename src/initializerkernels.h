@@ -0,0 +1,107 @@
+// SPDX-FileCopyrightText: 2024 basysKom GmbH
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#pragma once
+
+#include <QByteArray>
+#include <QHash>
+#include <QVector>
+
+#if QT_VERSION >= QT_VERSION_CHECK(6, 6, 0)
+  #include <rhi/qrhi.h>
+#else
+  #include <private/qrhi_p.h>
+#endif
+
+#include "bufferinitializer.h"
+
+/**
+ * \brief Runs BufferInitializers on the GPU
+ *
+ * Fills are scheduled while the pipeline is (re)built or a buffer is reset and recorded in a
+ * compute pass of their own before the next dispatch, like the copies of BufferResizer. The
+ * kernel shaders/initializers/fill.comp is compiled at runtime by ShaderCompiler, once per
+ * kind of target and custom function. The transient resources of a fill are kept until the
+ * following frame.
+ *
+ * Recurring fills are recorded again and again into a compute pass that is open already, e.g.
+ * the counter resets ahead of every step, and are kept until they are released.
+ *
+ * Render thread only.
+ */
+class InitializerKernels
+{
+public:
+    InitializerKernels() = default;
+    ~InitializerKernels();
+
+    InitializerKernels(const InitializerKernels &) = delete;
+    InitializerKernels &operator=(const InitializerKernels &) = delete;
+
+    bool scheduleFill(QRhi *rhi, QRhiResourceUpdateBatch *updateBatch, const BufferInitializer::Parameters &parameters,
+                      QRhiBuffer *buffer);
+    bool scheduleFill(QRhi *rhi, QRhiResourceUpdateBatch *updateBatch, const BufferInitializer::Parameters &parameters,
+                      QRhiTexture *texture);
+
+    bool hasPendingFills() const { return !m_pendingFills.isEmpty(); }
+
+    // records one compute pass containing all pending fills, in the order they were scheduled;
+    // updateBatch may be nullptr
+    void recordFills(QRhiCommandBuffer *cb, QRhiResourceUpdateBatch *updateBatch);
+
+    // releases the resources of the fills recorded in an earlier frame
+    void releaseFinished();
+
+    // returns an id for recordRecurringFill(), -1 on failure
+    int createRecurringFill(QRhi *rhi, QRhiResourceUpdateBatch *updateBatch, const BufferInitializer::Parameters &parameters,
+                            QRhiBuffer *buffer);
+    // inside a compute pass; the caller sets its own pipeline again afterwards
+    void recordRecurringFill(QRhiCommandBuffer *cb, int id) const;
+    void releaseRecurringFill(int id);
+
+    void releaseResources();
+
+private:
+    // std140 layout of the InitParams block of fill.comp
+    struct Params {
+        quint32 fill;
+        quint32 count;
+        quint32 offset;
+        quint32 stride;
+        quint32 components;
+        quint32 width;
+        quint32 seed;
+        quint32 rowInvocations;
+        float value[4];
+        float background[4];
+        float range[4];
+        float rect[4];
+        float shape[4];
+    };
+
+    struct Fill {
+        QRhiBuffer *paramsBuffer { nullptr };
+        QRhiShaderResourceBindings *bindings { nullptr };
+        QRhiComputePipeline *pipeline { nullptr };
+        int groupsX { 0 };
+        int groupsY { 0 };
+    };
+
+    // fill.pipeline stays nullptr if there is nothing to fill
+    bool createBufferFill(QRhi *rhi, QRhiResourceUpdateBatch *updateBatch, const BufferInitializer::Parameters &parameters,
+                          QRhiBuffer *buffer, Fill &fill);
+    bool create(QRhi *rhi, QRhiResourceUpdateBatch *updateBatch, const BufferInitializer::Parameters &parameters,
+                const QByteArray &preamble, const QRhiShaderResourceBinding &target, const Params &params, Fill &fill);
+    QShader shader(QRhi *rhi, const QByteArray &preamble, const QByteArray &customFunction);
+
+    static Params params(const BufferInitializer::Parameters &parameters);
+    static void releaseFill(Fill &fill);
+
+    // compiled kernel variants
+    QHash<QByteArray, QShader> m_shaders;
+    QVector<Fill> m_pendingFills;
+    QVector<Fill> m_finishedFills;
+    QHash<int, Fill> m_recurringFills;
+    int m_nextRecurringFill { 0 };
+};
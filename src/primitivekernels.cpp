@@ -0,0 +1,457 @@
+// SPDX-FileCopyrightText: 2024 basysKom GmbH
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#include "primitivekernels.h"
+
+#include <QDebug>
+#include <QFile>
+
+#include <cstring>
+
+#include "shadercompiler.h"
+
+namespace {
+// values handled by one work group of reduce.comp, scan.comp, scan_add.comp and histogram.comp
+constexpr quint32 blockSize = 2048;
+// keys handled by one work group of radix_count.comp and radix_scatter.comp
+constexpr quint32 tileSize = 1024;
+constexpr quint32 radix = 16;
+constexpr quint32 clearWorkgroupSize = 256;
+// counters a work group of histogram.comp keeps in shared memory
+constexpr int maxSharedBins = 4096;
+// minimum number of work groups per dimension guaranteed by all backends
+constexpr quint32 maxGroupsPerDimension = 65535;
+
+QByteArray resourceKey(const QRhiResource *resource)
+{
+    return resource ? QByteArray::number(resource->globalResourceId()) : QByteArray("-");
+}
+
+quint32 floatBits(float value)
+{
+    quint32 bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+}
+
+PrimitiveKernels::~PrimitiveKernels()
+{
+    releaseResources();
+}
+
+bool PrimitiveKernels::prepareReduce(QRhi *rhi, QRhiResourceUpdateBatch *updateBatch, QRhiBuffer *input, quint32 count,
+                                     ValueType type, Operation operation, QRhiBuffer *output)
+{
+    if (!rhi || !updateBatch || !input || !output || output->size() < quint32(valueSize())) {
+        return false;
+    }
+
+    count = qMin(count, input->size() / quint32(valueSize()));
+    const QByteArray key = "reduce " + resourceKey(input) + ' ' + resourceKey(output) + ' ' + QByteArray::number(count)
+            + ' ' + QByteArray::number(int(type)) + ' ' + QByteArray::number(int(operation));
+    if (isCurrent(rhi, key)) {
+        return true;
+    }
+    begin(rhi, key);
+
+    QByteArray preamble = typePreamble(type);
+    switch (operation) {
+    case Operation::Min:
+        preamble += "#define OP_MIN\n";
+        break;
+    case Operation::Max:
+        preamble += "#define OP_MAX\n";
+        break;
+    default:
+        preamble += "#define OP_SUM\n";
+        break;
+    }
+
+    // every level leaves one value per work group until a single one is left
+    QRhiBuffer *source = input;
+    quint32 remaining = count;
+    for (;;) {
+        const quint32 groups = groupsFor(remaining, blockSize);
+        QRhiBuffer *destination = groups == 1 ? output : newStorageBuffer(groups * valueSize());
+
+        Params params;
+        params.count = remaining;
+        addDispatch("reduce", preamble, groups, params, { load(1, source), store(2, destination) });
+
+        if (groups == 1) {
+            break;
+        }
+        source = destination;
+        remaining = groups;
+    }
+
+    return finish(updateBatch);
+}
+
+bool PrimitiveKernels::prepareScan(QRhi *rhi, QRhiResourceUpdateBatch *updateBatch, QRhiBuffer *input, quint32 count,
+                                   ValueType type, bool inclusive, QRhiBuffer *output)
+{
+    if (!rhi || !updateBatch || !input || !output) {
+        return false;
+    }
+
+    if (input == output) {
+        qWarning() << "A prefix sum cannot be computed in place";
+        return false;
+    }
+
+    count = qMin(count, qMin(input->size(), output->size()) / quint32(valueSize()));
+    const QByteArray key = "scan " + resourceKey(input) + ' ' + resourceKey(output) + ' ' + QByteArray::number(count)
+            + ' ' + QByteArray::number(int(type)) + ' ' + QByteArray::number(int(inclusive));
+    if (isCurrent(rhi, key)) {
+        return true;
+    }
+    begin(rhi, key);
+
+    addScan(typePreamble(type), input, output, count, inclusive);
+    return finish(updateBatch);
+}
+
+bool PrimitiveKernels::prepareSort(QRhi *rhi, QRhiResourceUpdateBatch *updateBatch, QRhiBuffer *keys, QRhiBuffer *values,
+                                   quint32 count, int keyBits)
+{
+    if (!rhi || !updateBatch || !keys) {
+        return false;
+    }
+
+    count = qMin(count, keys->size() / quint32(valueSize()));
+    if (values) {
+        count = qMin(count, values->size() / quint32(valueSize()));
+    }
+    // an even number of passes ends in the input buffers, so whole bytes are sorted
+    const int passes = 2 * ((qBound(1, keyBits, 32) + 7) / 8);
+
+    const QByteArray key = "sort " + resourceKey(keys) + ' ' + resourceKey(values) + ' ' + QByteArray::number(count)
+            + ' ' + QByteArray::number(passes);
+    if (isCurrent(rhi, key)) {
+        return true;
+    }
+    begin(rhi, key);
+
+    const quint32 tiles = groupsFor(count, tileSize);
+    QRhiBuffer *counts = newStorageBuffer(radix * tiles * valueSize());
+    QRhiBuffer *offsets = newStorageBuffer(radix * tiles * valueSize());
+    QRhiBuffer *scratchKeys = newStorageBuffer(qMax(count, 1u) * valueSize());
+    QRhiBuffer *scratchValues = values ? newStorageBuffer(qMax(count, 1u) * valueSize()) : nullptr;
+
+    const QByteArray scatterPreamble = values ? QByteArray("#define HAS_VALUES\n") : QByteArray();
+
+    QRhiBuffer *keysIn = keys;
+    QRhiBuffer *keysOut = scratchKeys;
+    QRhiBuffer *valuesIn = values;
+    QRhiBuffer *valuesOut = scratchValues;
+    for (int pass = 0; pass < passes; ++pass) {
+        Params params;
+        params.count = count;
+        params.arg0 = quint32(pass) * 4;
+        params.arg1 = tiles;
+
+        addDispatch("radix_count", QByteArray(), tiles, params, { load(1, keysIn), store(2, counts) });
+        addScan(typePreamble(ValueType::UInt), counts, offsets, radix * tiles, false);
+
+        QVector<QRhiShaderResourceBinding> resources { load(1, keysIn), store(2, keysOut), load(3, offsets) };
+        if (values) {
+            resources << load(4, valuesIn) << store(5, valuesOut);
+        }
+        addDispatch("radix_scatter", scatterPreamble, tiles, params, resources);
+
+        std::swap(keysIn, keysOut);
+        std::swap(valuesIn, valuesOut);
+    }
+
+    return finish(updateBatch);
+}
+
+bool PrimitiveKernels::prepareHistogram(QRhi *rhi, QRhiResourceUpdateBatch *updateBatch, QRhiBuffer *input, quint32 count,
+                                        ValueType type, float minimum, float maximum, int bins, QRhiBuffer *output)
+{
+    if (!rhi || !updateBatch || !input || !output || bins < 1 || output->size() < quint32(bins * valueSize())) {
+        return false;
+    }
+
+    count = qMin(count, input->size() / quint32(valueSize()));
+    const QByteArray key = "histogram " + resourceKey(input) + ' ' + resourceKey(output) + ' ' + QByteArray::number(count)
+            + ' ' + QByteArray::number(int(type)) + ' ' + QByteArray::number(minimum) + ' ' + QByteArray::number(maximum)
+            + ' ' + QByteArray::number(bins);
+    if (isCurrent(rhi, key)) {
+        return true;
+    }
+    begin(rhi, key);
+
+    QByteArray preamble = typePreamble(type) + "#define CHANNELS 1\n#define BINS " + QByteArray::number(bins) + '\n';
+    if (bins <= maxSharedBins) {
+        preamble += "#define SHARED_BINS\n";
+    }
+
+    Params clear;
+    clear.count = quint32(bins);
+    addDispatch("histogram", preamble + "#define CLEAR\n", groupsFor(quint32(bins), clearWorkgroupSize), clear, { loadStore(1, output) });
+
+    Params params;
+    params.count = count;
+    params.arg0 = floatBits(minimum);
+    params.arg1 = floatBits(maximum);
+    addDispatch("histogram", preamble, groupsFor(count, blockSize), params, { loadStore(1, output), load(2, input) });
+
+    return finish(updateBatch);
+}
+
+bool PrimitiveKernels::prepareHistogram(QRhi *rhi, QRhiResourceUpdateBatch *updateBatch, QRhiTexture *image,
+                                        float minimum, float maximum, int bins, QRhiBuffer *output)
+{
+    constexpr int channels = 4;
+    if (!rhi || !updateBatch || !image || !output || bins < 1 || output->size() < quint32(channels * bins * valueSize())) {
+        return false;
+    }
+
+    QByteArray imageFormat;
+    switch (image->format()) {
+    case QRhiTexture::RGBA8:
+        imageFormat = "rgba8";
+        break;
+    case QRhiTexture::RGBA16F:
+        imageFormat = "rgba16f";
+        break;
+    case QRhiTexture::RGBA32F:
+        imageFormat = "rgba32f";
+        break;
+    default:
+        qWarning() << "Unsupported image format for a histogram:" << image->format();
+        return false;
+    }
+
+    const QSize size = image->pixelSize();
+    const quint32 count = quint32(size.width() * size.height());
+    const QByteArray key = "image histogram " + resourceKey(image) + ' ' + resourceKey(output) + ' ' + QByteArray::number(count)
+            + ' ' + QByteArray::number(minimum) + ' ' + QByteArray::number(maximum) + ' ' + QByteArray::number(bins);
+    if (isCurrent(rhi, key)) {
+        return true;
+    }
+    begin(rhi, key);
+
+    QByteArray preamble = "#define IMAGE_INPUT\n#define IMAGE_FORMAT " + imageFormat + "\n#define CHANNELS 4\n#define BINS "
+            + QByteArray::number(bins) + '\n';
+    if (channels * bins <= maxSharedBins) {
+        preamble += "#define SHARED_BINS\n";
+    }
+
+    Params clear;
+    clear.count = quint32(channels * bins);
+    addDispatch("histogram", preamble + "#define CLEAR\n", groupsFor(clear.count, clearWorkgroupSize), clear, { loadStore(1, output) });
+
+    Params params;
+    params.count = count;
+    params.arg0 = floatBits(minimum);
+    params.arg1 = floatBits(maximum);
+    params.arg2 = quint32(size.width());
+    addDispatch("histogram", preamble, groupsFor(count, blockSize), params,
+                { loadStore(1, output), QRhiShaderResourceBinding::imageLoad(2, QRhiShaderResourceBinding::ComputeStage, image, 0) });
+
+    return finish(updateBatch);
+}
+
+void PrimitiveKernels::record(QRhiCommandBuffer *cb)
+{
+    // QRhi inserts the barriers between dispatches that access the same resources
+    for (const auto &dispatch : std::as_const(m_dispatches)) {
+        cb->setComputePipeline(dispatch.pipeline);
+        cb->setShaderResources(dispatch.bindings);
+        cb->dispatch(dispatch.groupsX, dispatch.groupsY, 1);
+    }
+}
+
+void PrimitiveKernels::releaseResources()
+{
+    releaseOperation();
+    m_shaders.clear();
+    m_rhi = nullptr;
+}
+
+bool PrimitiveKernels::isCurrent(QRhi *rhi, const QByteArray &key) const
+{
+    return rhi == m_rhi && key == m_key && !m_dispatches.isEmpty();
+}
+
+void PrimitiveKernels::begin(QRhi *rhi, const QByteArray &key)
+{
+    releaseOperation();
+    if (rhi != m_rhi) {
+        m_shaders.clear();
+    }
+    m_rhi = rhi;
+    m_key = key;
+}
+
+bool PrimitiveKernels::finish(QRhiResourceUpdateBatch *updateBatch)
+{
+    m_paramsSlotSize = m_rhi->ubufAligned(sizeof(Params));
+    m_paramsBuffer = m_rhi->newBuffer(QRhiBuffer::Dynamic, QRhiBuffer::UniformBuffer, m_paramsSlotSize * quint32(m_params.size()));
+    if (!m_paramsBuffer->create()) {
+        qWarning() << "Cannot create the parameter buffer of a compute primitive";
+        releaseOperation();
+        return false;
+    }
+
+    for (int i = 0; i < m_dispatches.size(); ++i) {
+        updateBatch->updateDynamicBuffer(m_paramsBuffer, quint32(i) * m_paramsSlotSize, sizeof(Params), &m_params.at(i));
+
+        Dispatch &dispatch = m_dispatches[i];
+        QVector<QRhiShaderResourceBinding> bindings = dispatch.resources;
+        bindings.prepend(QRhiShaderResourceBinding::uniformBuffer(0, QRhiShaderResourceBinding::ComputeStage, m_paramsBuffer,
+                                                                   quint32(i) * m_paramsSlotSize, sizeof(Params)));
+        dispatch.bindings = m_rhi->newShaderResourceBindings();
+        dispatch.bindings->setBindings(bindings.cbegin(), bindings.cend());
+        if (!dispatch.bindings->create()) {
+            qWarning() << "Cannot create the bindings of compute primitive kernel" << dispatch.kernel;
+            releaseOperation();
+            return false;
+        }
+
+        // the bindings of all dispatches of a kernel variant are layout compatible
+        const QByteArray pipelineKey = dispatch.kernel + '\n' + dispatch.preamble;
+        dispatch.pipeline = m_pipelines.value(pipelineKey);
+        if (!dispatch.pipeline) {
+            const QShader computeShader = shader(dispatch.kernel, dispatch.preamble);
+            dispatch.pipeline = m_rhi->newComputePipeline();
+            dispatch.pipeline->setShaderResourceBindings(dispatch.bindings);
+            dispatch.pipeline->setShaderStage({ QRhiShaderStage::Compute, computeShader });
+            m_pipelines.insert(pipelineKey, dispatch.pipeline);
+            if (!computeShader.isValid() || !dispatch.pipeline->create()) {
+                qWarning() << "Cannot create the pipeline of compute primitive kernel" << dispatch.kernel;
+                releaseOperation();
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+void PrimitiveKernels::releaseOperation()
+{
+    for (auto &dispatch : m_dispatches) {
+        delete dispatch.bindings;
+    }
+    m_dispatches.clear();
+    m_params.clear();
+
+    qDeleteAll(m_pipelines);
+    m_pipelines.clear();
+
+    delete m_paramsBuffer;
+    m_paramsBuffer = nullptr;
+
+    qDeleteAll(m_scratchBuffers);
+    m_scratchBuffers.clear();
+
+    m_key.clear();
+}
+
+QRhiBuffer* PrimitiveKernels::newStorageBuffer(quint32 size)
+{
+    // created right away; a failure surfaces when the bindings are created
+    QRhiBuffer *buffer = m_rhi->newBuffer(QRhiBuffer::Static, QRhiBuffer::StorageBuffer, qMax(size, quint32(valueSize())));
+    if (!buffer->create()) {
+        qWarning() << "Cannot create a scratch buffer of" << size << "bytes for a compute primitive";
+    }
+    m_scratchBuffers << buffer;
+    return buffer;
+}
+
+void PrimitiveKernels::addDispatch(const QByteArray &kernel, const QByteArray &preamble, quint32 groups, Params params,
+                                   const QVector<QRhiShaderResourceBinding> &resources)
+{
+    Dispatch dispatch;
+    dispatch.kernel = kernel;
+    dispatch.preamble = preamble;
+    dispatch.resources = resources;
+    dispatch.groupsX = int(qMin(groups, maxGroupsPerDimension));
+    dispatch.groupsY = int((groups + maxGroupsPerDimension - 1) / maxGroupsPerDimension);
+
+    params.groupsPerRow = quint32(dispatch.groupsX);
+    m_dispatches << dispatch;
+    m_params << params;
+}
+
+void PrimitiveKernels::addScan(const QByteArray &preamble, QRhiBuffer *input, QRhiBuffer *output, quint32 count, bool inclusive)
+{
+    // scan every block, then scan the block totals and add them to the blocks
+    const quint32 groups = groupsFor(count, blockSize);
+    QRhiBuffer *sums = newStorageBuffer(groups * valueSize());
+
+    Params params;
+    params.count = count;
+    params.arg0 = inclusive ? 1 : 0;
+    addDispatch("scan", preamble, groups, params, { load(1, input), store(2, output), store(3, sums) });
+
+    if (groups > 1) {
+        QRhiBuffer *scannedSums = newStorageBuffer(groups * valueSize());
+        addScan(preamble, sums, scannedSums, groups, false);
+
+        Params addParams;
+        addParams.count = count;
+        addDispatch("scan_add", preamble, groups, addParams, { loadStore(1, output), load(2, scannedSums) });
+    }
+}
+
+QShader PrimitiveKernels::shader(const QByteArray &kernel, const QByteArray &preamble)
+{
+    const QByteArray key = kernel + '\n' + preamble;
+    auto it = m_shaders.constFind(key);
+    if (it != m_shaders.constEnd()) {
+        return it.value();
+    }
+
+    QFile file(QLatin1String(":/shaders/primitives/%1.comp").arg(QString::fromLatin1(kernel)));
+    if (!file.open(QIODevice::ReadOnly)) {
+        qWarning() << "Cannot open shader file:" << file.fileName();
+        return QShader();
+    }
+
+    QString errorMessage;
+    const QShader computeShader = ShaderCompiler::compileComputeShader(m_rhi, file.readAll(), preamble, &errorMessage);
+    if (!computeShader.isValid()) {
+        qWarning().noquote() << "Cannot compile compute primitive kernel" << kernel << ":" << errorMessage;
+    }
+    m_shaders.insert(key, computeShader);
+    return computeShader;
+}
+
+QByteArray PrimitiveKernels::typePreamble(ValueType type)
+{
+    switch (type) {
+    case ValueType::Int:
+        return "#define VALUE_TYPE int\n#define VALUE_TYPE_INT\n";
+    case ValueType::Float:
+        return "#define VALUE_TYPE float\n#define VALUE_TYPE_FLOAT\n";
+    default:
+        return "#define VALUE_TYPE uint\n#define VALUE_TYPE_UINT\n";
+    }
+}
+
+quint32 PrimitiveKernels::groupsFor(quint32 count, quint32 valuesPerGroup)
+{
+    return qMax(1u, (count + valuesPerGroup - 1) / valuesPerGroup);
+}
+
+QRhiShaderResourceBinding PrimitiveKernels::load(int binding, QRhiBuffer *buffer)
+{
+    return QRhiShaderResourceBinding::bufferLoad(binding, QRhiShaderResourceBinding::ComputeStage, buffer);
+}
+
+QRhiShaderResourceBinding PrimitiveKernels::store(int binding, QRhiBuffer *buffer)
+{
+    return QRhiShaderResourceBinding::bufferStore(binding, QRhiShaderResourceBinding::ComputeStage, buffer);
+}
+
+QRhiShaderResourceBinding PrimitiveKernels::loadStore(int binding, QRhiBuffer *buffer)
+{
+    return QRhiShaderResourceBinding::bufferLoadStore(binding, QRhiShaderResourceBinding::ComputeStage, buffer);
+}
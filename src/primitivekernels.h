@@ -0,0 +1,138 @@
+// SPDX-FileCopyrightText: 2024 basysKom GmbH
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#pragma once
+
+#include <QByteArray>
+#include <QHash>
+#include <QVector>
+
+#if QT_VERSION >= QT_VERSION_CHECK(6, 6, 0)
+  #include <rhi/qrhi.h>
+#else
+  #include <private/qrhi_p.h>
+#endif
+
+/**
+ * \brief Parallel primitives on storage buffers and images: reduce, scan, sort and histogram
+ *
+ * A PrimitiveKernels object holds one prepared operation. prepare*() creates the transient
+ * buffers, bindings and pipelines for the given resources and uploads the parameters with
+ * the update batch; record() adds the dispatches to the compute pass that is currently
+ * recorded. As long as the arguments do not change, preparing again reuses everything.
+ *
+ * The kernels in shaders/primitives are compiled at runtime by ShaderCompiler, once per
+ * value type and operation, so their variants share its on-disk cache. Every kernel
+ * processes blocks of 1024 or 2048 values per work group and splits large dispatches
+ * into rows of work groups.
+ *
+ * Values are 32 bit. Render thread only.
+ */
+class PrimitiveKernels
+{
+public:
+    enum class ValueType {
+        UInt,
+        Int,
+        Float
+    };
+
+    enum class Operation {
+        Sum,
+        Min,
+        Max
+    };
+
+    PrimitiveKernels() = default;
+    ~PrimitiveKernels();
+
+    PrimitiveKernels(const PrimitiveKernels &) = delete;
+    PrimitiveKernels &operator=(const PrimitiveKernels &) = delete;
+
+    // reduces count values of input to a single value at the start of output
+    bool prepareReduce(QRhi *rhi, QRhiResourceUpdateBatch *updateBatch, QRhiBuffer *input, quint32 count,
+                       ValueType type, Operation operation, QRhiBuffer *output);
+
+    // inclusive or exclusive prefix sum of count values; output must not be input
+    bool prepareScan(QRhi *rhi, QRhiResourceUpdateBatch *updateBatch, QRhiBuffer *input, quint32 count,
+                     ValueType type, bool inclusive, QRhiBuffer *output);
+
+    // stable in place sort of count 32 bit unsigned keys by their lowest keyBits bits;
+    // values (may be nullptr) are moved along with their keys
+    bool prepareSort(QRhi *rhi, QRhiResourceUpdateBatch *updateBatch, QRhiBuffer *keys, QRhiBuffer *values,
+                     quint32 count, int keyBits = 32);
+
+    // counts count values of input into bins equally sized bins between minimum and maximum
+    bool prepareHistogram(QRhi *rhi, QRhiResourceUpdateBatch *updateBatch, QRhiBuffer *input, quint32 count,
+                          ValueType type, float minimum, float maximum, int bins, QRhiBuffer *output);
+
+    // counts every channel of image separately; output holds bins counts per channel, RGBA
+    bool prepareHistogram(QRhi *rhi, QRhiResourceUpdateBatch *updateBatch, QRhiTexture *image,
+                          float minimum, float maximum, int bins, QRhiBuffer *output);
+
+    bool isPrepared() const { return !m_dispatches.isEmpty(); }
+
+    // records the dispatches of the prepared operation; must be called inside a compute pass
+    void record(QRhiCommandBuffer *cb);
+
+    void releaseResources();
+
+    static int valueSize() { return 4; }
+
+private:
+    struct Dispatch {
+        QByteArray kernel;
+        QByteArray preamble;
+        // all but the parameter block at binding 0
+        QVector<QRhiShaderResourceBinding> resources;
+        QRhiShaderResourceBindings *bindings { nullptr };
+        QRhiComputePipeline *pipeline { nullptr };
+        int groupsX { 0 };
+        int groupsY { 0 };
+    };
+
+    // the parameter block of a dispatch, see the Params blocks of the kernels
+    struct Params {
+        quint32 count { 0 };
+        quint32 groupsPerRow { 0 };
+        quint32 arg0 { 0 };
+        quint32 arg1 { 0 };
+        quint32 arg2 { 0 };
+        quint32 padding[3] { 0, 0, 0 };
+    };
+
+    // returns true if the operation described by key is prepared already
+    bool isCurrent(QRhi *rhi, const QByteArray &key) const;
+    void begin(QRhi *rhi, const QByteArray &key);
+    // creates the parameter buffer, the bindings and the pipelines of the added dispatches
+    bool finish(QRhiResourceUpdateBatch *updateBatch);
+    void releaseOperation();
+
+    QRhiBuffer* newStorageBuffer(quint32 size);
+    void addDispatch(const QByteArray &kernel, const QByteArray &preamble, quint32 groups, Params params,
+                     const QVector<QRhiShaderResourceBinding> &resources);
+    void addScan(const QByteArray &preamble, QRhiBuffer *input, QRhiBuffer *output, quint32 count, bool inclusive);
+    QShader shader(const QByteArray &kernel, const QByteArray &preamble);
+
+    static QByteArray typePreamble(ValueType type);
+    static quint32 groupsFor(quint32 count, quint32 valuesPerGroup);
+    static QRhiShaderResourceBinding load(int binding, QRhiBuffer *buffer);
+    static QRhiShaderResourceBinding store(int binding, QRhiBuffer *buffer);
+    static QRhiShaderResourceBinding loadStore(int binding, QRhiBuffer *buffer);
+
+    QRhi *m_rhi { nullptr };
+    // identifies the prepared operation and its resources
+    QByteArray m_key;
+
+    QVector<Dispatch> m_dispatches;
+    QVector<Params> m_params;
+    QRhiBuffer *m_paramsBuffer { nullptr };
+    quint32 m_paramsSlotSize { 0 };
+    QVector<QRhiBuffer *> m_scratchBuffers;
+    // one pipeline per kernel variant of the operation
+    QHash<QByteArray, QRhiComputePipeline *> m_pipelines;
+
+    // compiled kernel variants; kept across operations
+    QHash<QByteArray, QShader> m_shaders;
+};
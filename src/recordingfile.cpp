@@ -0,0 +1,324 @@
+// SPDX-FileCopyrightText: 2024 basysKom GmbH
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#include "recordingfile.h"
+
+#include <QDebug>
+#include <QMutexLocker>
+
+#include <cstring>
+
+namespace {
+
+qint64 paddedSize(qint64 size)
+{
+    return (size + Recording::RecordingAlignment - 1) / Recording::RecordingAlignment * Recording::RecordingAlignment;
+}
+
+} // namespace
+
+RecordingWriter::RecordingWriter(const QString &fileName, Recording::Compression compression, int compressionLevel, int maxQueuedFrames, DropPolicy dropPolicy)
+    : m_fileName(fileName)
+    , m_compression(compression)
+    , m_compressionLevel(compressionLevel)
+    , m_maxQueuedFrames(qMax(1, maxQueuedFrames))
+    , m_dropPolicy(dropPolicy)
+{
+    // deleted on the thread it was created on, once the queue is written
+    connect(this, &QThread::finished, this, &QObject::deleteLater);
+}
+
+std::shared_ptr<RecordingWriter> RecordingWriter::create(const QString &fileName, Recording::Compression compression, int compressionLevel,
+                                                         int maxQueuedFrames, DropPolicy dropPolicy)
+{
+    return std::shared_ptr<RecordingWriter>(new RecordingWriter(fileName, compression, compressionLevel, maxQueuedFrames, dropPolicy),
+                                            [](RecordingWriter *writer) { writer->shutdown(); });
+}
+
+RecordingWriter::~RecordingWriter()
+{
+    // the thread has finished or was never started
+    wait();
+    m_dataFile.close();
+    m_indexFile.close();
+}
+
+void RecordingWriter::shutdown()
+{
+    // the last reference may be released on the render thread, which must not wait for the disk
+    QMutexLocker locker(&m_mutex);
+    m_progress = nullptr;
+    if (!m_started) {
+        locker.unlock();
+        deleteLater();
+        return;
+    }
+    // run() writes the queued frames and returns; finished() deletes the writer
+    m_stopping = true;
+    m_queueChanged.wakeAll();
+}
+
+bool RecordingWriter::open(QString *errorMessage)
+{
+    m_dataFile.setFileName(m_fileName);
+    if (!m_dataFile.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        *errorMessage = QStringLiteral("Cannot open %1: %2").arg(m_fileName, m_dataFile.errorString());
+        return false;
+    }
+
+    m_indexFile.setFileName(m_fileName + QStringLiteral(".index"));
+    if (!m_indexFile.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        *errorMessage = QStringLiteral("Cannot open %1: %2").arg(m_indexFile.fileName(), m_indexFile.errorString());
+        m_dataFile.close();
+        return false;
+    }
+
+    Recording::FileHeader header;
+    memcpy(header.magic, Recording::Magic, sizeof(header.magic));
+    header.version = Recording::Version;
+    header.reserved = 0;
+    if (m_dataFile.write(reinterpret_cast<const char *>(&header), sizeof(header)) != qint64(sizeof(header))) {
+        *errorMessage = QStringLiteral("Cannot write %1: %2").arg(m_fileName, m_dataFile.errorString());
+        return false;
+    }
+
+    m_started = true;
+    start(QThread::LowPriority);
+    return true;
+}
+
+void RecordingWriter::setProgressCallback(const ProgressCallback &callback)
+{
+    QMutexLocker locker(&m_mutex);
+    m_progress = callback;
+}
+
+bool RecordingWriter::enqueue(Recording::Frame frame)
+{
+    QMutexLocker locker(&m_mutex);
+    if (m_stopping) {
+        return false;
+    }
+
+    bool dropped = false;
+    if (int(m_queue.size()) >= m_maxQueuedFrames) {
+        dropped = true;
+        m_droppedFrames++;
+        if (m_dropPolicy == DropNewest) {
+            reportProgress();
+            return false;
+        }
+        m_queue.pop_front();
+    }
+
+    m_queue.push_back(std::move(frame));
+    m_queueChanged.wakeOne();
+    if (dropped) {
+        reportProgress();
+    }
+    return !dropped;
+}
+
+void RecordingWriter::reportDropped()
+{
+    QMutexLocker locker(&m_mutex);
+    m_droppedFrames++;
+    reportProgress();
+}
+
+void RecordingWriter::reportProgress()
+{
+    // m_mutex is locked
+    if (m_progress) {
+        m_progress(m_writtenFrames, m_writtenBytes, m_droppedFrames);
+    }
+}
+
+void RecordingWriter::run()
+{
+    forever {
+        Recording::Frame frame;
+        {
+            QMutexLocker locker(&m_mutex);
+            while (m_queue.empty() && !m_stopping) {
+                m_queueChanged.wait(&m_mutex);
+            }
+            if (m_queue.empty()) {
+                break;
+            }
+            frame = std::move(m_queue.front());
+            m_queue.pop_front();
+        }
+
+        const bool written = write(frame);
+
+        QMutexLocker locker(&m_mutex);
+        if (written) {
+            m_writtenFrames++;
+            m_writtenBytes += quint64(frame.data.size());
+        } else {
+            m_droppedFrames++;
+        }
+        reportProgress();
+    }
+
+    m_dataFile.close();
+    m_indexFile.close();
+}
+
+bool RecordingWriter::write(const Recording::Frame &frame)
+{
+    // writer thread
+    const QByteArray payload = m_compression == Recording::ZlibCompression ? qCompress(frame.data, m_compressionLevel) : frame.data;
+
+    Recording::ChunkHeader header;
+    header.magic = Recording::ChunkMagic;
+    header.compression = m_compression;
+    header.step = frame.step;
+    header.width = quint32(qMax(0, frame.imageSize.width()));
+    header.height = quint32(qMax(0, frame.imageSize.height()));
+    header.format = frame.format;
+    header.reserved = 0;
+    header.rawSize = quint64(frame.data.size());
+    header.storedSize = quint64(payload.size());
+
+    const qint64 chunkOffset = m_dataFile.pos();
+    const QByteArray padding(int(paddedSize(payload.size()) - payload.size()), 0);
+    if (m_dataFile.write(reinterpret_cast<const char *>(&header), sizeof(header)) != qint64(sizeof(header))
+            || m_dataFile.write(payload) != payload.size()
+            || m_dataFile.write(padding) != padding.size()) {
+        qWarning() << "Cannot write recording" << m_fileName << m_dataFile.errorString();
+        // leave no partial chunk behind for the next frame to follow
+        m_dataFile.seek(chunkOffset);
+        m_dataFile.resize(chunkOffset);
+        return false;
+    }
+    m_dataFile.flush();
+
+    Recording::IndexEntry entry;
+    entry.step = header.step;
+    entry.offset = quint64(chunkOffset) + sizeof(header);
+    entry.rawSize = header.rawSize;
+    entry.storedSize = header.storedSize;
+    entry.compression = header.compression;
+    entry.width = header.width;
+    entry.height = header.height;
+    entry.format = header.format;
+    m_indexFile.write(reinterpret_cast<const char *>(&entry), sizeof(entry));
+    m_indexFile.flush();
+    return true;
+}
+
+bool BufferRecording::open(const QString &fileName)
+{
+    close();
+
+    m_file.setFileName(fileName);
+    if (!m_file.open(QIODevice::ReadOnly)) {
+        m_errorString = m_file.errorString();
+        return false;
+    }
+
+    m_size = m_file.size();
+    Recording::FileHeader header;
+    if (m_size < qint64(sizeof(header)) || !(m_map = m_file.map(0, m_size))) {
+        m_errorString = QStringLiteral("Cannot map %1").arg(fileName);
+        close();
+        return false;
+    }
+
+    memcpy(&header, m_map, sizeof(header));
+    if (memcmp(header.magic, Recording::Magic, sizeof(header.magic)) != 0 || header.version != Recording::Version) {
+        m_errorString = QStringLiteral("%1 is not a recording of version %2").arg(fileName).arg(Recording::Version);
+        close();
+        return false;
+    }
+
+    // frames written after the last index entry are picked up by scanning
+    readIndex(fileName + QStringLiteral(".index"));
+    const qint64 scanOffset = m_frames.isEmpty() ? qint64(sizeof(header))
+                                                 : qint64(m_frames.last().offset) + paddedSize(qint64(m_frames.last().storedSize));
+    scanChunks(scanOffset);
+    return true;
+}
+
+void BufferRecording::close()
+{
+    if (m_map) {
+        m_file.unmap(m_map);
+        m_map = nullptr;
+    }
+    m_file.close();
+    m_size = 0;
+    m_frames.clear();
+}
+
+void BufferRecording::readIndex(const QString &indexFileName)
+{
+    QFile indexFile(indexFileName);
+    if (!indexFile.open(QIODevice::ReadOnly)) {
+        return;
+    }
+
+    const QByteArray index = indexFile.readAll();
+    const int count = index.size() / int(sizeof(Recording::IndexEntry));
+    m_frames.reserve(count);
+    for (int i = 0; i < count; ++i) {
+        Recording::IndexEntry entry;
+        memcpy(&entry, index.constData() + i * sizeof(entry), sizeof(entry));
+        if (entry.offset + entry.storedSize > quint64(m_size)) {
+            // written after the data file was mapped
+            break;
+        }
+
+        FrameInfo info;
+        info.step = entry.step;
+        info.offset = entry.offset;
+        info.rawSize = entry.rawSize;
+        info.storedSize = entry.storedSize;
+        info.compression = entry.compression;
+        info.imageSize = QSize(int(entry.width), int(entry.height));
+        info.format = entry.format;
+        m_frames << info;
+    }
+}
+
+void BufferRecording::scanChunks(qint64 offset)
+{
+    while (offset + qint64(sizeof(Recording::ChunkHeader)) <= m_size) {
+        Recording::ChunkHeader header;
+        memcpy(&header, m_map + offset, sizeof(header));
+        const qint64 payloadOffset = offset + qint64(sizeof(header));
+        if (header.magic != Recording::ChunkMagic || payloadOffset + qint64(header.storedSize) > m_size) {
+            // a partially written chunk ends the recording
+            return;
+        }
+
+        FrameInfo info;
+        info.step = header.step;
+        info.offset = quint64(payloadOffset);
+        info.rawSize = header.rawSize;
+        info.storedSize = header.storedSize;
+        info.compression = header.compression;
+        info.imageSize = QSize(int(header.width), int(header.height));
+        info.format = header.format;
+        m_frames << info;
+
+        offset = payloadOffset + paddedSize(qint64(header.storedSize));
+    }
+}
+
+QByteArray BufferRecording::frame(int index) const
+{
+    if (index < 0 || index >= m_frames.size() || !m_map) {
+        return QByteArray();
+    }
+
+    const FrameInfo &info = m_frames.at(index);
+    const char *payload = reinterpret_cast<const char *>(m_map + info.offset);
+    if (info.compression == Recording::ZlibCompression) {
+        return qUncompress(reinterpret_cast<const uchar *>(payload), qsizetype(info.storedSize));
+    }
+    return QByteArray::fromRawData(payload, qsizetype(info.rawSize));
+}
@@ -0,0 +1,181 @@
+// SPDX-FileCopyrightText: 2024 basysKom GmbH
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#pragma once
+
+#include <QByteArray>
+#include <QFile>
+#include <QMutex>
+#include <QSize>
+#include <QString>
+#include <QThread>
+#include <QVector>
+#include <QWaitCondition>
+
+#include <deque>
+#include <functional>
+#include <memory>
+
+/*
+ * Recording files are append-only. The data file starts with a FileHeader and holds one chunk
+ * per frame: a ChunkHeader followed by the payload, padded to RecordingAlignment so that the
+ * payloads of a memory mapped file are aligned. The index file (data file name + ".index")
+ * holds one IndexEntry per frame and is only a shortcut: a reader scans the chunks if it is
+ * missing or shorter, e.g. after a crash. All values are in native byte order.
+ */
+namespace Recording {
+
+constexpr char Magic[8] = { 'Q', 'C', 'I', 'R', 'E', 'C', '\0', '\1' };
+constexpr quint32 Version = 1;
+constexpr quint32 ChunkMagic = 0x46494351; // "QCIF"
+constexpr int RecordingAlignment = 16;
+
+enum Compression : quint32 {
+    NoCompression = 0,
+    // qCompress(), zlib with a 4 byte size prefix
+    ZlibCompression = 1
+};
+
+struct FileHeader {
+    char magic[8];
+    quint32 version;
+    quint32 reserved;
+};
+
+struct ChunkHeader {
+    quint32 magic;
+    quint32 compression;
+    quint64 step;
+    // images only; 0 for storage buffers
+    quint32 width;
+    quint32 height;
+    // QRhiTexture::Format of images
+    quint32 format;
+    quint32 reserved;
+    quint64 rawSize;
+    quint64 storedSize;
+};
+
+struct IndexEntry {
+    quint64 step;
+    // of the payload in the data file
+    quint64 offset;
+    quint64 rawSize;
+    quint64 storedSize;
+    quint32 compression;
+    quint32 width;
+    quint32 height;
+    quint32 format;
+};
+
+struct Frame {
+    quint64 step { 0 };
+    QSize imageSize;
+    quint32 format { 0 };
+    QByteArray data;
+};
+
+} // namespace Recording
+
+/**
+ * \brief Writes the frames of a BufferRecorder on a thread of its own
+ *
+ * The queue is bounded. When the disk cannot keep up, enqueue() drops a frame according to the
+ * policy instead of blocking the render thread. Writers are shared with create(); once the last
+ * reference is gone, on whichever thread, the writer thread writes the queued frames, closes
+ * the files and deletes the writer on the GUI thread. Releasing a reference never waits.
+ */
+class RecordingWriter : public QThread
+{
+public:
+    enum DropPolicy {
+        DropNewest,
+        DropOldest
+    };
+
+    // any thread; called with the totals after every written or dropped frame
+    using ProgressCallback = std::function<void(quint64 writtenFrames, quint64 writtenBytes, quint64 droppedFrames)>;
+
+    static std::shared_ptr<RecordingWriter> create(const QString &fileName, Recording::Compression compression, int compressionLevel,
+                                                   int maxQueuedFrames, DropPolicy dropPolicy);
+    ~RecordingWriter();
+
+    // GUI thread; opens the files and starts the thread
+    bool open(QString *errorMessage);
+    void setProgressCallback(const ProgressCallback &callback);
+
+    // any thread; returns false if a frame was dropped
+    bool enqueue(Recording::Frame frame);
+    void reportDropped();
+
+protected:
+    void run() override;
+
+private:
+    RecordingWriter(const QString &fileName, Recording::Compression compression, int compressionLevel, int maxQueuedFrames, DropPolicy dropPolicy);
+
+    // any thread; the deleter of create()
+    void shutdown();
+    bool write(const Recording::Frame &frame);
+    void reportProgress();
+
+    QString m_fileName;
+    Recording::Compression m_compression;
+    int m_compressionLevel;
+    int m_maxQueuedFrames;
+    DropPolicy m_dropPolicy;
+
+    QFile m_dataFile;
+    QFile m_indexFile;
+
+    QMutex m_mutex;
+    QWaitCondition m_queueChanged;
+    std::deque<Recording::Frame> m_queue;
+    bool m_started { false };
+    bool m_stopping { false };
+    ProgressCallback m_progress;
+    quint64 m_writtenFrames { 0 };
+    quint64 m_writtenBytes { 0 };
+    quint64 m_droppedFrames { 0 };
+};
+
+/**
+ * \brief Memory mapped read access to a recording for playback and analysis
+ *
+ * Uncompressed frames are returned without a copy and stay valid until close().
+ */
+class BufferRecording
+{
+public:
+    struct FrameInfo {
+        quint64 step { 0 };
+        quint64 offset { 0 };
+        quint64 rawSize { 0 };
+        quint64 storedSize { 0 };
+        quint32 compression { Recording::NoCompression };
+        QSize imageSize;
+        quint32 format { 0 };
+    };
+
+    BufferRecording() = default;
+    ~BufferRecording() { close(); }
+
+    bool open(const QString &fileName);
+    void close();
+    QString errorString() const { return m_errorString; }
+
+    int frameCount() const { return int(m_frames.size()); }
+    const FrameInfo &frameInfo(int index) const { return m_frames.at(index); }
+    QByteArray frame(int index) const;
+
+private:
+    void readIndex(const QString &indexFileName);
+    void scanChunks(qint64 offset);
+
+    QFile m_file;
+    uchar *m_map { nullptr };
+    qint64 m_size { 0 };
+    QVector<FrameInfo> m_frames;
+    QString m_errorString;
+};
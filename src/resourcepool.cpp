@@ -0,0 +1,201 @@
+// SPDX-FileCopyrightText: 2024 basysKom GmbH
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#include "resourcepool.h"
+
+#include <QDebug>
+
+#include <algorithm>
+
+std::atomic<qint64> ResourcePool::s_globalBudget { qEnvironmentVariable("QCI_MEMORY_BUDGET").toLongLong() };
+std::atomic<qint64> ResourcePool::s_globalBytes { 0 };
+
+namespace {
+
+quint32 bytesPerPixel(QRhiTexture::Format format)
+{
+    switch (format) {
+    case QRhiTexture::R8:
+    case QRhiTexture::RED_OR_ALPHA8:
+        return 1;
+    case QRhiTexture::RG8:
+    case QRhiTexture::R16:
+    case QRhiTexture::R16F:
+        return 2;
+    case QRhiTexture::RGBA16F:
+        return 8;
+    case QRhiTexture::RGBA32F:
+        return 16;
+    default:
+        return 4;
+    }
+}
+
+} // namespace
+
+ResourcePool::~ResourcePool()
+{
+    trim();
+}
+
+qint64 ResourcePool::textureBytes(const QRhiTexture *texture)
+{
+    QSize size = texture->pixelSize();
+    const qint64 pixelBytes = bytesPerPixel(texture->format());
+    qint64 bytes = qint64(size.width()) * size.height() * pixelBytes;
+    if (texture->flags().testFlag(QRhiTexture::MipMapped)) {
+        while (size.width() > 1 || size.height() > 1) {
+            size = QSize(qMax(1, size.width() / 2), qMax(1, size.height() / 2));
+            bytes += qint64(size.width()) * size.height() * pixelBytes;
+        }
+    }
+    return bytes;
+}
+
+bool ResourcePool::reserve(qint64 bytes)
+{
+    const auto fits = [this, bytes]() {
+        const qint64 globalBudget = s_globalBudget.load();
+        return (m_budget <= 0 || m_bytes + bytes <= m_budget) && (globalBudget <= 0 || s_globalBytes.load() + bytes <= globalBudget);
+    };
+    if (fits()) {
+        return true;
+    }
+
+    // idle resources are given up before an allocation is rejected
+    trim();
+    if (fits()) {
+        return true;
+    }
+
+    m_budgetError = QStringLiteral("Cannot allocate %1 bytes: %2 bytes are held here (budget %3), %4 bytes by all items (budget %5)")
+            .arg(bytes).arg(m_bytes).arg(m_budget).arg(s_globalBytes.load()).arg(s_globalBudget.load());
+    // reported by the owner, see budgetError()
+    return false;
+}
+
+QRhiBuffer *ResourcePool::acquireBuffer(QRhi *rhi, QRhiBuffer::Type type, QRhiBuffer::UsageFlags usage, quint32 size)
+{
+    const auto it = std::find_if(m_idleBuffers.begin(), m_idleBuffers.end(), [&](QRhiBuffer *buffer) {
+        return buffer->type() == type && buffer->usage() == usage && buffer->size() == size;
+    });
+
+    if (it != m_idleBuffers.end()) {
+        QRhiBuffer *buffer = *it;
+        m_idleBuffers.erase(it);
+        return buffer;
+    }
+
+    if (!reserve(size)) {
+        return nullptr;
+    }
+
+    QRhiBuffer *buffer = rhi->newBuffer(type, usage, size);
+    if (!buffer->create()) {
+        qWarning() << "Cannot create buffer of size" << size;
+        delete buffer;
+        return nullptr;
+    }
+    m_buffers << buffer;
+    m_bytes += size;
+    s_globalBytes += size;
+    return buffer;
+}
+
+QRhiTexture *ResourcePool::acquireTexture(QRhi *rhi, QRhiTexture::Format format, const QSize &size, QRhiTexture::Flags flags)
+{
+    const auto it = std::find_if(m_idleTextures.begin(), m_idleTextures.end(), [&](QRhiTexture *texture) {
+        return texture->format() == format && texture->pixelSize() == size && texture->flags() == flags;
+    });
+
+    if (it != m_idleTextures.end()) {
+        QRhiTexture *texture = *it;
+        m_idleTextures.erase(it);
+        return texture;
+    }
+
+    QRhiTexture *texture = rhi->newTexture(format, size, 1, flags);
+    const qint64 bytes = textureBytes(texture);
+    if (!reserve(bytes)) {
+        delete texture;
+        return nullptr;
+    }
+    if (!texture->create()) {
+        qWarning() << "Cannot create texture of size" << size;
+        delete texture;
+        return nullptr;
+    }
+    m_textures << texture;
+    m_bytes += bytes;
+    s_globalBytes += bytes;
+    return texture;
+}
+
+void ResourcePool::release(QRhiBuffer *buffer)
+{
+    if (buffer && !m_idleBuffers.contains(buffer)) {
+        m_idleBuffers.append(buffer);
+    }
+}
+
+void ResourcePool::release(QRhiTexture *texture)
+{
+    if (texture && !m_idleTextures.contains(texture)) {
+        m_idleTextures.append(texture);
+    }
+}
+
+void ResourcePool::trim()
+{
+    for (auto buffer : std::as_const(m_idleBuffers)) {
+        destroy(buffer);
+    }
+    m_idleBuffers.clear();
+
+    for (auto texture : std::as_const(m_idleTextures)) {
+        destroy(texture);
+    }
+    m_idleTextures.clear();
+}
+
+void ResourcePool::destroy(QRhiBuffer *buffer)
+{
+    if (m_buffers.removeOne(buffer)) {
+        m_bytes -= buffer->size();
+        s_globalBytes -= buffer->size();
+    }
+    delete buffer;
+}
+
+void ResourcePool::destroy(QRhiTexture *texture)
+{
+    if (m_textures.removeOne(texture)) {
+        const qint64 bytes = textureBytes(texture);
+        m_bytes -= bytes;
+        s_globalBytes -= bytes;
+    }
+    delete texture;
+}
+
+ResourcePool::Usage ResourcePool::usage() const
+{
+    Usage usage;
+    for (auto buffer : m_buffers) {
+        if (m_idleBuffers.contains(buffer)) {
+            usage.idleBytes += buffer->size();
+        } else if (buffer->usage().testFlag(QRhiBuffer::UniformBuffer)) {
+            usage.uniformBufferBytes += buffer->size();
+        } else {
+            usage.storageBufferBytes += buffer->size();
+        }
+    }
+    for (auto texture : m_textures) {
+        if (m_idleTextures.contains(texture)) {
+            usage.idleBytes += textureBytes(texture);
+        } else {
+            usage.textureBytes += textureBytes(texture);
+        }
+    }
+    return usage;
+}
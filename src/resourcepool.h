@@ -0,0 +1,98 @@
+// SPDX-FileCopyrightText: 2024 basysKom GmbH
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#pragma once
+
+#include <QSize>
+#include <QString>
+#include <QVector>
+
+#include <atomic>
+
+#if QT_VERSION >= QT_VERSION_CHECK(6, 6, 0)
+  #include <rhi/qrhi.h>
+#else
+  #include <private/qrhi_p.h>
+#endif
+
+/**
+ * \brief Pool of idle QRhiBuffers and QRhiTextures
+ *
+ * Buffers are matched by (type, usage, size), textures by (format, size, flags).
+ * Resources released during a pipeline rebuild are handed out again to the
+ * rebuild instead of being destroyed and reallocated. trim() destroys whatever
+ * was not reused.
+ *
+ * The pool accounts for the bytes of all resources it created, in use or idle, and can hold
+ * them to a budget of its own and to a budget shared by all pools. An allocation that would
+ * exceed a budget first destroys the idle resources and is rejected if that is not enough.
+ * Texture sizes are estimates from format, size and mip levels; drivers may pad them.
+ *
+ * Render thread only, except for the global budget and total.
+ */
+class ResourcePool
+{
+public:
+    ResourcePool() = default;
+    ~ResourcePool();
+
+    ResourcePool(const ResourcePool &) = delete;
+    ResourcePool &operator=(const ResourcePool &) = delete;
+
+    // returns a created resource or nullptr if the creation failed
+    QRhiBuffer *acquireBuffer(QRhi *rhi, QRhiBuffer::Type type, QRhiBuffer::UsageFlags usage, quint32 size);
+    QRhiTexture *acquireTexture(QRhi *rhi, QRhiTexture::Format format, const QSize &size, QRhiTexture::Flags flags);
+
+    // hand a resource back to the pool; nullptr is ignored
+    void release(QRhiBuffer *buffer);
+    void release(QRhiTexture *texture);
+
+    // destroy all idle resources
+    void trim();
+
+    int idleCount() const { return m_idleBuffers.size() + m_idleTextures.size(); }
+
+    struct Usage {
+        // in use
+        qint64 storageBufferBytes { 0 };
+        qint64 uniformBufferBytes { 0 };
+        qint64 textureBytes { 0 };
+        // kept for reuse
+        qint64 idleBytes { 0 };
+
+        qint64 total() const { return storageBufferBytes + uniformBufferBytes + textureBytes + idleBytes; }
+    };
+    Usage usage() const;
+
+    // bytes; 0 for no budget
+    qint64 budget() const { return m_budget; }
+    void setBudget(qint64 bytes) { m_budget = qMax(qint64(0), bytes); }
+    // why the last allocation was rejected; cleared by clearBudgetError()
+    QString budgetError() const { return m_budgetError; }
+    void clearBudgetError() { m_budgetError.clear(); }
+
+    // Shared by all pools of the process; QCI_MEMORY_BUDGET sets the initial value in bytes
+    static qint64 globalBudget() { return s_globalBudget.load(); }
+    static void setGlobalBudget(qint64 bytes) { s_globalBudget.store(qMax(qint64(0), bytes)); }
+    static qint64 globalBytes() { return s_globalBytes.load(); }
+
+    static qint64 textureBytes(const QRhiTexture *texture);
+
+private:
+    bool reserve(qint64 bytes);
+    void destroy(QRhiBuffer *buffer);
+    void destroy(QRhiTexture *texture);
+
+    QVector<QRhiBuffer *> m_idleBuffers;
+    QVector<QRhiTexture *> m_idleTextures;
+    // all resources created by this pool and not destroyed yet, idle ones included
+    QVector<QRhiBuffer *> m_buffers;
+    QVector<QRhiTexture *> m_textures;
+    qint64 m_bytes { 0 };
+    qint64 m_budget { 0 };
+    QString m_budgetError;
+
+    static std::atomic<qint64> s_globalBudget;
+    static std::atomic<qint64> s_globalBytes;
+};
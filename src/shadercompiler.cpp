@@ -0,0 +1,176 @@
+// SPDX-FileCopyrightText: 2024 basysKom GmbH
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#include "shadercompiler.h"
+
+#include <QCryptographicHash>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QHash>
+#include <QMutex>
+#include <QRegularExpression>
+#include <QSaveFile>
+#include <QStandardPaths>
+
+#if QT_VERSION >= QT_VERSION_CHECK(6, 6, 0)
+  #include <rhi/qshaderbaker.h>
+#else
+  #include <private/qshaderbaker_p.h>
+#endif
+
+namespace {
+
+// variants compiled in this process, shared by all items and render threads
+QMutex variantCacheMutex;
+QHash<QByteArray, QShader> variantCache;
+
+// shading languages needed by the backend; compute shaders need GLSL 430 / GLSL ES 310
+QList<QShaderBaker::GeneratedShader> generatedShaders(QRhi *rhi)
+{
+    switch (rhi->backend()) {
+    case QRhi::OpenGLES2:
+        return { { QShader::GlslShader, QShaderVersion(430) },
+                 { QShader::GlslShader, QShaderVersion(310, QShaderVersion::GlslEs) } };
+    case QRhi::D3D11:
+#if QT_VERSION >= QT_VERSION_CHECK(6, 6, 0)
+    case QRhi::D3D12:
+#endif
+        return { { QShader::HlslShader, QShaderVersion(50) } };
+    case QRhi::Metal:
+        return { { QShader::MslShader, QShaderVersion(12) } };
+    default:
+        return { { QShader::SpirvShader, QShaderVersion(100) } };
+    }
+}
+
+}
+
+QShader ShaderCompiler::compileComputeShader(QRhi *rhi, const QByteArray &source, const QByteArray &preamble, QString *errorMessage)
+{
+    if (!rhi) {
+        return QShader();
+    }
+
+    const QByteArray key = cacheKey(rhi, source, preamble);
+    {
+        QMutexLocker locker(&variantCacheMutex);
+        const auto it = variantCache.constFind(key);
+        if (it != variantCache.constEnd()) {
+            return it.value();
+        }
+    }
+
+    const QString cacheFileName = cacheDirectory() + QLatin1Char('/') + QString::fromLatin1(key) + QLatin1String(".qsb");
+
+    QFile cacheFile(cacheFileName);
+    if (cacheFile.open(QIODevice::ReadOnly)) {
+        const QShader shader = QShader::fromSerialized(cacheFile.readAll());
+        if (shader.isValid()) {
+            QMutexLocker locker(&variantCacheMutex);
+            variantCache.insert(key, shader);
+            return shader;
+        }
+    }
+
+    QShaderBaker baker;
+    baker.setSourceString(insertPreamble(source, preamble), QShader::ComputeStage);
+    baker.setGeneratedShaders(generatedShaders(rhi));
+    baker.setGeneratedShaderVariants({ QShader::StandardShader });
+
+    const QShader shader = baker.bake();
+    if (!shader.isValid()) {
+        if (errorMessage) {
+            *errorMessage = baker.errorMessage();
+        }
+        return QShader();
+    }
+
+    // the cache is an optimization only; failing to write it is not an error
+    QDir().mkpath(cacheDirectory());
+    QSaveFile saveFile(cacheFileName);
+    if (saveFile.open(QIODevice::WriteOnly)) {
+        saveFile.write(shader.serialized());
+        if (!saveFile.commit()) {
+            qWarning() << "Cannot write shader cache file" << cacheFileName;
+        }
+    }
+
+    QMutexLocker locker(&variantCacheMutex);
+    variantCache.insert(key, shader);
+    return shader;
+}
+
+QByteArray ShaderCompiler::definesPreamble(const QVariantMap &defines)
+{
+    static const QRegularExpression identifier(QStringLiteral("^[A-Za-z_][A-Za-z0-9_]*$"));
+
+    QByteArray preamble;
+    for (auto it = defines.constBegin(); it != defines.constEnd(); ++it) {
+        if (!identifier.match(it.key()).hasMatch()) {
+            qWarning() << "Ignoring invalid define" << it.key();
+            continue;
+        }
+
+        const QVariant &value = it.value();
+        QByteArray text;
+        switch (value.typeId()) {
+        case QMetaType::Bool:
+            text = value.toBool() ? "1" : "0";
+            break;
+        case QMetaType::Float:
+        case QMetaType::Double:
+            // keep floating point constants floating point, 1.0 would otherwise become 1
+            text = QByteArray::number(value.toDouble(), 'g', 9);
+            if (!text.contains('.') && !text.contains('e') && !text.contains("inf") && !text.contains("nan")) {
+                text += ".0";
+            }
+            break;
+        default:
+            text = value.toString().toUtf8();
+            break;
+        }
+
+        preamble += "#define " + it.key().toUtf8() + ' ' + text + '\n';
+    }
+    return preamble;
+}
+
+QByteArray ShaderCompiler::insertPreamble(const QByteArray &source, const QByteArray &preamble)
+{
+    if (preamble.isEmpty()) {
+        return source;
+    }
+
+    // #version has to stay the first directive
+    const int versionIndex = source.indexOf("#version");
+    if (versionIndex < 0) {
+        return preamble + source;
+    }
+
+    const int lineEnd = source.indexOf('\n', versionIndex);
+    if (lineEnd < 0) {
+        return source + '\n' + preamble;
+    }
+
+    QByteArray result = source;
+    result.insert(lineEnd + 1, preamble);
+    return result;
+}
+
+QString ShaderCompiler::cacheDirectory()
+{
+    return QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + QLatin1String("/qtquickcomputeitem/shaders");
+}
+
+QByteArray ShaderCompiler::cacheKey(QRhi *rhi, const QByteArray &source, const QByteArray &preamble)
+{
+    QCryptographicHash hash(QCryptographicHash::Sha256);
+    hash.addData(source);
+    hash.addData(QByteArrayLiteral("\0"));
+    hash.addData(preamble);
+    hash.addData(QByteArray::number(int(rhi->backend())));
+    hash.addData(QByteArrayLiteral(QT_VERSION_STR));
+    return hash.result().toHex();
+}
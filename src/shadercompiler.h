@@ -0,0 +1,42 @@
+// SPDX-FileCopyrightText: 2024 basysKom GmbH
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#pragma once
+
+#include <QByteArray>
+#include <QString>
+#include <QVariantMap>
+
+#if QT_VERSION >= QT_VERSION_CHECK(6, 6, 0)
+  #include <rhi/qrhi.h>
+#else
+  #include <private/qrhi_p.h>
+#endif
+
+/**
+ * \brief Compiles GLSL compute shaders at runtime
+ *
+ * The source is compiled with QShaderBaker for the shading languages the backend of the
+ * given QRhi needs. Results are stored in an on-disk cache below QStandardPaths::CacheLocation,
+ * keyed by a hash of the source, the preamble, the backend and the Qt version, so repeated
+ * runs skip the compilation. Variants compiled in this process are additionally kept in
+ * memory, so switching between them is instant.
+ */
+class ShaderCompiler
+{
+public:
+    // returns an invalid QShader and sets errorMessage if the compilation fails
+    // the preamble is inserted after the #version directive
+    static QShader compileComputeShader(QRhi *rhi, const QByteArray &source, const QByteArray &preamble = QByteArray(),
+                                        QString *errorMessage = nullptr);
+
+    // one #define per entry; invalid names are skipped with a warning
+    static QByteArray definesPreamble(const QVariantMap &defines);
+
+    static QString cacheDirectory();
+
+private:
+    static QByteArray cacheKey(QRhi *rhi, const QByteArray &source, const QByteArray &preamble);
+    static QByteArray insertPreamble(const QByteArray &source, const QByteArray &preamble);
+};
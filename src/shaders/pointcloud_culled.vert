@@ -0,0 +1,49 @@
+// SPDX-FileCopyrightText: 2024 basysKom GmbH
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#version 440
+
+layout(location = 0) in vec4 position;
+layout(location = 1) in vec4 color;
+
+layout(location = 0) out vec4 vertexColor;
+
+layout(std140, binding = 0) uniform VSUbuf
+{
+    mat4 mvpProjection;
+    float width;
+    float height;
+    float pointSize;
+    int flip;
+} vsubuf;
+
+// number of valid points, written on the GPU
+layout(std430, binding = 1) readonly buffer DrawCount
+{
+    uint count;
+} drawCount;
+
+out gl_PerVertex { vec4 gl_Position; float gl_PointSize; };
+
+void main()
+{
+    // the draw call is sized from an asynchronous readback and may exceed the current count
+    if (uint(gl_VertexIndex) >= drawCount.count) {
+        vertexColor = vec4(0.0);
+        gl_PointSize = 1.0;
+        gl_Position = vec4(2.0, 2.0, 2.0, 1.0); // outside of the clip volume
+        return;
+    }
+
+    // transform to view coords
+    vec4 itemPos = (position + vec4(1.0, 1.0, 0.0, 0.0)) * vec4(0.5, 0.5, 1.0, 1.0);
+    if (vsubuf.flip != 0) {
+        itemPos.y = 1.0 - itemPos.y;
+    }
+    itemPos = itemPos * vec4(vsubuf.width, vsubuf.height, 1.0, 1.0);
+
+    vertexColor = color;
+    gl_PointSize = vsubuf.pointSize;
+    gl_Position = vsubuf.mvpProjection * itemPos;
+}
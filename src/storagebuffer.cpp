@@ -6,10 +6,28 @@
 
 #include <QDebug>
 
+#include <algorithm>
+#include <cstring>
+#include <utility>
+
+#include "bufferresizer.h"
+
+namespace {
+
+quint32 alignedTo(quint32 value, quint32 alignment)
+{
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+} // namespace
+
 StorageBuffer::StorageBuffer(QObject *parent)
     : ComputeShaderBuffer(parent)
 {
-
+    // the initializers overwrite the written ranges
+    connect(this, &ComputeShaderBuffer::resetRequested, this, [this]() {
+        m_writtenRanges.clear();
+    });
 }
 
 StorageBuffer::~StorageBuffer()
@@ -26,6 +44,7 @@ void StorageBuffer::setBuffer(const QByteArray &byteArray)
 {
     if (m_buffer != byteArray) {
         m_buffer = byteArray;
+        m_writtenRanges.clear();
 #if 0
         qDebug() << m_buffer.length();
         if (m_buffer.length() > 0) {
@@ -41,3 +60,306 @@ void StorageBuffer::setBuffer(const QByteArray &byteArray)
     }
 }
 
+void StorageBuffer::resize(int newSize, bool preserve, const QByteArray &pattern)
+{
+    if (newSize <= 0 || newSize % 4 != 0 || pattern.size() % 4 != 0) {
+        qWarning() << "Cannot resize storage buffer: size and pattern must be multiples of 4 bytes";
+        return;
+    }
+
+    // keep the CPU side copy in sync for a later full rebuild; no bufferChanged as that re-uploads
+    m_buffer = BufferResizer::resizedData(preserve ? m_buffer : QByteArray(), newSize, pattern);
+    if (preserve) {
+        for (const auto &range : std::as_const(m_writtenRanges)) {
+            const qsizetype size = qMin(range.data.size(), m_buffer.size() - qsizetype(range.offset));
+            if (size > 0) {
+                memcpy(m_buffer.data() + range.offset, range.data.constData(), size_t(size));
+            }
+        }
+    }
+    m_writtenRanges.clear();
+    requestResize(preserve, pattern);
+}
+
+
+QQmlListProperty<BufferField> StorageBuffer::fields()
+{
+    return QQmlListProperty<BufferField>(this, nullptr, &StorageBuffer::appendField, &StorageBuffer::fieldCount,
+        &StorageBuffer::fieldAt, &StorageBuffer::clearFields);
+}
+
+void StorageBuffer::appendField(QQmlListProperty<BufferField> *list, BufferField *field)
+{
+    auto buffer = static_cast<StorageBuffer *>(list->object);
+    if (!field) {
+        return;
+    }
+    buffer->m_fields.append(field);
+    connect(field, &BufferField::changed, buffer, &StorageBuffer::updateLayout);
+    buffer->updateLayout();
+}
+
+qsizetype StorageBuffer::fieldCount(QQmlListProperty<BufferField> *list)
+{
+    return static_cast<StorageBuffer *>(list->object)->m_fields.size();
+}
+
+BufferField *StorageBuffer::fieldAt(QQmlListProperty<BufferField> *list, qsizetype index)
+{
+    return static_cast<StorageBuffer *>(list->object)->m_fields.value(index);
+}
+
+void StorageBuffer::clearFields(QQmlListProperty<BufferField> *list)
+{
+    auto buffer = static_cast<StorageBuffer *>(list->object);
+    for (const auto &field : std::as_const(buffer->m_fields)) {
+        if (field) {
+            disconnect(field, &BufferField::changed, buffer, &StorageBuffer::updateLayout);
+        }
+    }
+    buffer->m_fields.clear();
+    buffer->updateLayout();
+}
+
+void StorageBuffer::setLayout(Layout layout)
+{
+    if (layout == m_layout) {
+        return;
+    }
+    m_layout = layout;
+    emit layoutChanged();
+    updateLayout();
+}
+
+void StorageBuffer::setCount(int count)
+{
+    count = qMax(0, count);
+    if (count == m_count) {
+        return;
+    }
+    m_count = count;
+    emit countChanged();
+
+    if (m_stride == 0) {
+        return;
+    }
+    if (m_buffer.isEmpty()) {
+        // created again with the new size; the initializers run again
+        const quint32 size = initialSize();
+        m_writtenRanges.erase(std::remove_if(m_writtenRanges.begin(), m_writtenRanges.end(), [size](const WrittenRange &range) {
+            return range.offset + quint32(range.data.size()) > size;
+        }), m_writtenRanges.end());
+        emit bufferChanged();
+    } else if (count > 0) {
+        resize(count * int(m_stride));
+    }
+}
+
+void StorageBuffer::updateLayout()
+{
+    // members are placed at their base alignment, the stride is a multiple of the largest one
+    QVector<Member> members;
+    quint32 offset = 0;
+    quint32 structAlignment = 4;
+    for (const auto &field : std::as_const(m_fields)) {
+        if (!field) {
+            continue;
+        }
+        const quint32 alignment = BufferField::alignment(field->type());
+        offset = alignedTo(offset, alignment);
+        members << Member { field->name(), field->type(), offset };
+        offset += BufferField::size(field->type());
+        structAlignment = qMax(structAlignment, alignment);
+    }
+    if (m_layout == Std140) {
+        // std140 rounds the alignment of structs up to that of a vec4
+        structAlignment = qMax(structAlignment, 16u);
+    }
+    m_members = members;
+
+    const quint32 stride = members.isEmpty() ? 0 : alignedTo(offset, structAlignment);
+    if (stride == m_stride) {
+        return;
+    }
+    const bool reset = m_stride > 0 && !m_buffer.isEmpty();
+    m_stride = stride;
+    // the ranges do not match the new layout anymore
+    m_writtenRanges.clear();
+    emit strideChanged();
+
+    if (reset) {
+        // the contents do not match the new layout anymore
+        setBuffer(QByteArray(qsizetype(structuredSize()), 0));
+    }
+}
+
+const StorageBuffer::Member *StorageBuffer::member(const QString &name) const
+{
+    for (const auto &member : m_members) {
+        if (member.name == name) {
+            return &member;
+        }
+    }
+    return nullptr;
+}
+
+bool StorageBuffer::checkElement(int index) const
+{
+    if (m_stride == 0) {
+        qWarning() << "Cannot access elements of a storage buffer without fields";
+        return false;
+    }
+    if (index < 0 || index >= m_count) {
+        qWarning() << "Cannot access storage buffer element" << index << ": Index out of bounds";
+        return false;
+    }
+    return true;
+}
+
+int StorageBuffer::fieldOffset(const QString &name) const
+{
+    const Member *m = member(name);
+    return m ? int(m->offset) : -1;
+}
+
+QVariant StorageBuffer::readMember(int index, const Member &member) const
+{
+    const qsizetype offset = qsizetype(index) * m_stride + member.offset;
+    const qsizetype size = qsizetype(BufferField::size(member.type));
+    if (offset + size <= m_buffer.size()) {
+        return BufferField::decode(member.type, m_buffer.constData() + offset);
+    }
+
+    // without data of its own the buffer reads as zeros, except for the written ranges
+    char bytes[16 * 4] = {};
+    for (const auto &range : m_writtenRanges) {
+        const qsizetype begin = qMax(offset, qsizetype(range.offset));
+        const qsizetype end = qMin(offset + size, qsizetype(range.offset) + range.data.size());
+        if (begin < end) {
+            memcpy(bytes + (begin - offset), range.data.constData() + (begin - range.offset), size_t(end - begin));
+        }
+    }
+    return BufferField::decode(member.type, bytes);
+}
+
+quint32 StorageBuffer::initialSize() const
+{
+    quint32 size = structuredSize();
+    for (const auto &initializer : initializerParameters()) {
+        size = qMax(size, initializer.requiredSize());
+    }
+    return size;
+}
+
+QVariantMap StorageBuffer::element(int index) const
+{
+    QVariantMap values;
+    if (!checkElement(index)) {
+        return values;
+    }
+    for (const auto &member : m_members) {
+        values.insert(member.name, readMember(index, member));
+    }
+    return values;
+}
+
+void StorageBuffer::setElement(int index, const QVariantMap &values)
+{
+    if (!checkElement(index)) {
+        return;
+    }
+
+    const qsizetype offset = qsizetype(index) * m_stride;
+    const qsizetype stride = qsizetype(m_stride);
+    if (m_buffer.isEmpty()) {
+        // the other members hold what the initializers wrote, so only the given ones are written
+        QVector<std::pair<const Member *, QByteArray>> writes;
+        for (auto it = values.cbegin(); it != values.cend(); ++it) {
+            const Member *m = member(it.key());
+            if (!m) {
+                qWarning() << "Cannot set storage buffer element: No field" << it.key();
+                return;
+            }
+            QByteArray data(qsizetype(BufferField::size(m->type)), 0);
+            if (!BufferField::encode(m->type, it.value(), data.data())) {
+                return;
+            }
+            writes.append({ m, data });
+        }
+        for (const auto &write : std::as_const(writes)) {
+            writeData(int(offset + write.first->offset), write.second);
+        }
+        return;
+    }
+
+    // one upload for the whole element; members that are not given keep their contents
+    QByteArray data = offset + stride <= m_buffer.size() ? m_buffer.mid(offset, stride) : QByteArray(stride, 0);
+    for (auto it = values.cbegin(); it != values.cend(); ++it) {
+        const Member *m = member(it.key());
+        if (!m) {
+            qWarning() << "Cannot set storage buffer element: No field" << it.key();
+            return;
+        }
+        if (!BufferField::encode(m->type, it.value(), data.data() + m->offset)) {
+            return;
+        }
+    }
+    writeData(int(offset), data);
+}
+
+QVariant StorageBuffer::field(int index, const QString &name) const
+{
+    if (!checkElement(index)) {
+        return QVariant();
+    }
+    const Member *m = member(name);
+    if (!m) {
+        qWarning() << "Cannot get storage buffer element: No field" << name;
+        return QVariant();
+    }
+    return readMember(index, *m);
+}
+
+void StorageBuffer::setField(int index, const QString &name, const QVariant &value)
+{
+    if (!checkElement(index)) {
+        return;
+    }
+    const Member *m = member(name);
+    if (!m) {
+        qWarning() << "Cannot set storage buffer element: No field" << name;
+        return;
+    }
+    QByteArray data(qsizetype(BufferField::size(m->type)), 0);
+    if (BufferField::encode(m->type, value, data.data())) {
+        writeData(int(qsizetype(index) * m_stride + m->offset), data);
+    }
+}
+
+bool StorageBuffer::writeData(int offset, const QByteArray &data)
+{
+    if (offset < 0 || offset % 4 != 0 || data.size() % 4 != 0) {
+        qWarning() << "Cannot write storage buffer: offset and size must be multiples of 4 bytes";
+        return false;
+    }
+    const qsizetype size = m_buffer.isEmpty() ? qsizetype(initialSize()) : m_buffer.size();
+    if (qsizetype(offset) + data.size() > size) {
+        qWarning() << "Cannot write storage buffer: Range out of bounds";
+        return false;
+    }
+
+    if (m_buffer.isEmpty()) {
+        // a zeroed copy would replace the initializers at the next rebuild; ranges written over
+        // completely are dropped so that repeated writes do not pile up
+        const quint32 begin = quint32(offset);
+        const quint32 end = begin + quint32(data.size());
+        m_writtenRanges.erase(std::remove_if(m_writtenRanges.begin(), m_writtenRanges.end(), [begin, end](const WrittenRange &range) {
+            return range.offset >= begin && range.offset + quint32(range.data.size()) <= end;
+        }), m_writtenRanges.end());
+        m_writtenRanges.append({ begin, data });
+    } else {
+        memcpy(m_buffer.data() + offset, data.constData(), size_t(data.size()));
+    }
+    requestRangeUpload(quint32(offset), data);
+    return true;
+}
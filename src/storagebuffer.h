@@ -6,17 +6,46 @@
 
 #include <QObject>
 #include <QByteArray>
+#include <QPointer>
+#include <QQmlListProperty>
 #include <QQuickItem>
+#include <QVariantMap>
+#include <QVector>
 
+#include "bufferfield.h"
 #include "computeshaderbuffer.h"
 
+/**
+ * \brief A shader storage buffer
+ *
+ * The contents are raw bytes by default. With fields the buffer is an array of count structs
+ * instead, laid out like the shader declares them, and single elements can be read and written
+ * from QML. Element writes only upload the bytes they touch, see writeData().
+ *
+ * Without data of its own, the buffer keeps the written ranges instead of a CPU copy. They are
+ * applied again on top of the initializers whenever the resource is created, see writtenRanges().
+ */
 class StorageBuffer : public ComputeShaderBuffer
 {
     Q_OBJECT
     Q_PROPERTY(QByteArray buffer READ buffer WRITE setBuffer NOTIFY bufferChanged)
+    // the members of one element in declaration order
+    Q_PROPERTY(QQmlListProperty<BufferField> fields READ fields)
+    Q_PROPERTY(Layout layout READ layout WRITE setLayout NOTIFY layoutChanged)
+    // number of elements; the buffer holds count * stride bytes
+    Q_PROPERTY(int count READ count WRITE setCount NOTIFY countChanged)
+    // bytes per element, e.g. for StorageBufferView::strideInByte; 0 without fields
+    Q_PROPERTY(int stride READ stride NOTIFY strideChanged)
     QML_ELEMENT
 
 public:
+    // the layout qualifier of the buffer block in the shader
+    enum Layout {
+        Std430,
+        Std140
+    };
+    Q_ENUM(Layout)
+
     explicit StorageBuffer(QObject *parent = nullptr);
     ~StorageBuffer();
 
@@ -25,6 +54,82 @@ public:
     QByteArray buffer() const override;
     void setBuffer(const QByteArray &byteArray) override;
 
+    /**
+     * Resizes the buffer to newSize bytes without uploading it again. If preserve is set, the
+     * current contents are copied on the GPU, otherwise the whole buffer is filled. New space is
+     * zeroed or filled with the repeating pattern. Sizes must be multiples of 4 bytes.
+     * The buffer property keeps the CPU side contents and is not updated with GPU results.
+     */
+    Q_INVOKABLE void resize(int newSize, bool preserve = true, const QByteArray &pattern = QByteArray());
+
+    QQmlListProperty<BufferField> fields();
+
+    Layout layout() const { return m_layout; }
+    void setLayout(Layout layout);
+
+    int count() const { return m_count; }
+    void setCount(int count);
+
+    int stride() const { return int(m_stride); }
+    // bytes of count elements; 0 without fields
+    quint32 structuredSize() const { return quint32(m_count) * m_stride; }
+
+    // byte offset of the named field within an element, -1 if there is none
+    Q_INVOKABLE int fieldOffset(const QString &name) const;
+
+    /**
+     * Element access. Reads return the CPU side contents, not the results of the GPU. Writes
+     * update the CPU side contents and upload the touched bytes only; bufferChanged is not
+     * emitted as that would upload the whole buffer again.
+     */
+    Q_INVOKABLE QVariantMap element(int index) const;
+    Q_INVOKABLE void setElement(int index, const QVariantMap &values);
+    Q_INVOKABLE QVariant field(int index, const QString &name) const;
+    Q_INVOKABLE void setField(int index, const QString &name, const QVariant &value);
+
+    /**
+     * Replaces data.size() bytes at offset. Without data of its own, the range is kept in
+     * writtenRanges() instead. Offset and size must be multiples of 4 bytes.
+     */
+    bool writeData(int offset, const QByteArray &data);
+
+    struct WrittenRange {
+        quint32 offset;
+        QByteArray data;
+    };
+    // the writes since the last reset of a buffer without data of its own, in order
+    QVector<WrittenRange> writtenRanges() const { return m_writtenRanges; }
+
+signals:
+    void countChanged();
+    void layoutChanged();
+    void strideChanged();
+
 private:
+    struct Member {
+        QString name;
+        BufferField::Type type;
+        quint32 offset;
+    };
+
+    static void appendField(QQmlListProperty<BufferField> *list, BufferField *field);
+    static qsizetype fieldCount(QQmlListProperty<BufferField> *list);
+    static BufferField *fieldAt(QQmlListProperty<BufferField> *list, qsizetype index);
+    static void clearFields(QQmlListProperty<BufferField> *list);
+
+    void updateLayout();
+    const Member *member(const QString &name) const;
+    bool checkElement(int index) const;
+    QVariant readMember(int index, const Member &member) const;
+    // count * stride or what the initializers need, whichever is larger
+    quint32 initialSize() const;
+
     QByteArray m_buffer;
+    QVector<WrittenRange> m_writtenRanges;
+
+    QVector<QPointer<BufferField>> m_fields;
+    Layout m_layout { Std430 };
+    int m_count { 0 };
+    QVector<Member> m_members;
+    quint32 m_stride { 0 };
 };
\ No newline at end of file
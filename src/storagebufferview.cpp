@@ -11,7 +11,22 @@
 #include <QRunnable>
 #include <QSGSimpleTextureNode>
 #include <QSGRenderNode>
-
+#include <QtMath>
+
+#include <cstring>
+
+#if QT_CONFIG(opengl)
+  #include <QOpenGLContext>
+  #include <QOpenGLFunctions>
+  #if QT_VERSION >= QT_VERSION_CHECK(6, 6, 0)
+    #include <rhi/qrhi_platform.h>
+  #else
+    #include <private/qrhigles2_p.h>
+  #endif
+#endif
+
+#include "asyncreadback.h"
+#include "computetrace.h"
 #include "storagebuffer.h"
 
 class PointCloudRenderNode : public QSGRenderNode
@@ -23,10 +38,15 @@ public:
 public:
     void setWindow(QQuickWindow *window) { m_window = window; }
     void setPointBuffer(QRhiBuffer* buffer) { m_buffer = buffer; }
+    // value is the last one read back, -1 if there is none yet
+    void setCountBuffer(QRhiBuffer *buffer, qint64 value);
 
     void setNumberOfPoints(int nop) { m_numberOfPoints = nop; }
     void setPointSize(float ps) { m_pointSize = ps; }
-    void setStrideInByte(quint32 stride) { m_strideInByte = stride; }
+    void setStrideInByte(quint32 stride);
+
+    void setCulling(bool culling);
+    void setDecimationCellSize(float cellSize);
 
     void setBoundingRect(const QRectF &rect) { m_boundingRect = rect; }
 
@@ -39,7 +59,21 @@ private:
     QShader loadShader(const QString &filename);
     QRhi* checkRhi() const;
     QRhiSwapChain* checkSwapChain() const;
-    
+    QSizeF viewportSize() const;
+
+    void releasePipeline();
+    void releaseCullingResources();
+    void prepareCulling(QRhi *rhi, QRhiCommandBuffer *commandBuffer, const QMatrix4x4 &mvpProjection, qint32 flip);
+    int drawCount() const;
+    quint32 sourceCount() const;
+
+    // culling and count buffers read a storage buffer in the vertex stage; without support the
+    // points are drawn like without them. Without decimation the compacted points would be
+    // a copy of the source, which is drawn directly and clipped by the rasterizer instead.
+    bool cullingActive() const { return m_culling && m_decimationCellSize > 0.0 && m_vertexStorageBuffers > 0; }
+    QRhiBuffer *activeCountBuffer() const { return m_vertexStorageBuffers > 0 ? m_countBuffer : nullptr; }
+    void checkVertexStorageBuffers(QRhi *rhi);
+
     QRectF m_boundingRect;
 
     int m_numberOfPoints { 0 };
@@ -48,13 +82,99 @@ private:
 
     QQuickWindow *m_window { nullptr };
     QRhiBuffer *m_buffer { nullptr }; 
+    QRhiBuffer *m_countBuffer { nullptr };
+    qint64 m_countValue { -1 };
+    // -1 until checked on the first prepare()
+    int m_vertexStorageBuffers { -1 };
+    bool m_vertexStorageWarned { false };
 
     std::unique_ptr<QRhiGraphicsPipeline> m_pipeline;
     std::unique_ptr<QRhiShaderResourceBindings> m_resourceBindings;
     std::unique_ptr<QRhiBuffer> m_uniformBuffer;
 
+    // culling and decimation pre-pass
+    bool m_culling { false };
+    float m_decimationCellSize { 0.0 };
+    quint32 m_frameStamp { 0 };
+    quint32 m_capacity { 0 };
+    quint32 m_gridWidth { 0 };
+    quint32 m_gridHeight { 0 };
+    quint32 m_visibleCount { 0 };
+    bool m_hasVisibleCount { false };
+
+    std::unique_ptr<QRhiComputePipeline> m_cullPipeline;
+    std::unique_ptr<QRhiShaderResourceBindings> m_cullBindings;
+    std::unique_ptr<QRhiBuffer> m_cullUniformBuffer;
+    std::unique_ptr<QRhiBuffer> m_visiblePointBuffer;
+    std::unique_ptr<QRhiBuffer> m_drawCountBuffer;
+    std::unique_ptr<QRhiBuffer> m_gridBuffer;
+    // the source count without a count buffer
+    std::unique_ptr<QRhiBuffer> m_noCountBuffer;
+    QRhiBuffer *m_cullSourceBuffer { nullptr };
+    QRhiBuffer *m_cullCountBuffer { nullptr };
+    AsyncReadback *m_drawCountReadback { nullptr };
+
 };
 
+namespace {
+
+// std140 layout of CullUbuf in pointcloud_cull.comp
+struct CullUniforms
+{
+    float mvpProjection[16];
+    float width;
+    float height;
+    float viewportWidth;
+    float viewportHeight;
+    float cellSize;
+    float margin;
+    qint32 flip;
+    quint32 strideInFloats;
+    quint32 numberOfPoints;
+    quint32 capacity;
+    quint32 gridWidth;
+    quint32 gridHeight;
+    quint32 frameStamp;
+};
+
+constexpr quint32 cullWorkgroupSize = 256;
+constexpr quint32 visiblePointStride = 8 * sizeof(float);
+
+// Counts read back asynchronously lag behind. The shaders check the current count on the GPU,
+// so leave some headroom for growing counts.
+quint32 withHeadroom(quint32 count)
+{
+    return count + count / 8 + cullWorkgroupSize;
+}
+
+#ifndef GL_MAX_VERTEX_SHADER_STORAGE_BLOCKS
+#define GL_MAX_VERTEX_SHADER_STORAGE_BLOCKS 0x90D6
+#endif
+
+bool supportsVertexStorageBuffers(QRhi *rhi)
+{
+    // storage buffers come with compute support
+    if (!rhi->isFeatureSupported(QRhi::Compute)) {
+        return false;
+    }
+#if QT_CONFIG(opengl)
+    // OpenGL (ES) may support them in compute shaders only
+    if (rhi->backend() == QRhi::OpenGLES2) {
+        const auto handles = static_cast<const QRhiGles2NativeHandles *>(rhi->nativeHandles());
+        QOpenGLContext *context = handles ? handles->context : nullptr;
+        if (!context) {
+            return false;
+        }
+        GLint blocks = 0;
+        context->functions()->glGetIntegerv(GL_MAX_VERTEX_SHADER_STORAGE_BLOCKS, &blocks);
+        return blocks > 0;
+    }
+#endif
+    return true;
+}
+
+}
+
 PointCloudRenderNode::PointCloudRenderNode()
 {
 
@@ -62,7 +182,50 @@ PointCloudRenderNode::PointCloudRenderNode()
 
 PointCloudRenderNode::~PointCloudRenderNode()
 {
+    releaseResources();
+}
+
+void PointCloudRenderNode::setStrideInByte(quint32 stride)
+{
+    if (stride != m_strideInByte) {
+        m_strideInByte = stride;
+        // the stride is part of the vertex input layout
+        releasePipeline();
+    }
+}
+
+void PointCloudRenderNode::setCountBuffer(QRhiBuffer *buffer, qint64 value)
+{
+    if (buffer != m_countBuffer) {
+        m_countBuffer = buffer;
+        // the vertex shader and its bindings depend on the count buffer
+        releasePipeline();
+    }
+    m_countValue = value;
+}
+
+void PointCloudRenderNode::setCulling(bool culling)
+{
+    if (culling != m_culling) {
+        m_culling = culling;
+        releasePipeline();
+        if (!m_culling) {
+            releaseCullingResources();
+        }
+    }
+}
 
+void PointCloudRenderNode::setDecimationCellSize(float cellSize)
+{
+    const bool decimationChanged = (cellSize > 0.0) != (m_decimationCellSize > 0.0);
+    m_decimationCellSize = cellSize;
+    if (decimationChanged && m_culling) {
+        // switches between the pre-pass and the source buffer
+        releasePipeline();
+        if (m_decimationCellSize <= 0.0) {
+            releaseCullingResources();
+        }
+    }
 }
 
 StorageBufferView::StorageBufferView(QQuickItem *parent)
@@ -87,10 +250,14 @@ void StorageBufferView::setComputeItem(ComputeItem *item)
 
         if (m_computeItem) {
             disconnect(m_computeItem, &ComputeItem::notifyChange, this, &QQuickItem::update);
+            m_computeItem->unregisterView(this);
         }
 
         m_computeItem = item;
-        connect(m_computeItem, &ComputeItem::notifyChange, this,  &QQuickItem::update);
+        if (m_computeItem) {
+            connect(m_computeItem, &ComputeItem::notifyChange, this,  &QQuickItem::update);
+            m_computeItem->registerView(this);
+        }
         emit computeItemChanged();
     }
 }
@@ -116,6 +283,28 @@ void StorageBufferView::setResultBuffer(const StorageBuffer* buffer)
     }
 }
 
+CounterBuffer* StorageBufferView::countBuffer() const
+{
+    if (m_countBufferIndex < 0) {
+        return nullptr;
+    }
+
+    return qobject_cast<CounterBuffer*>(m_computeItem->bufferAt(m_countBufferIndex));
+}
+
+void StorageBufferView::setCountBuffer(const CounterBuffer* buffer)
+{
+    if (!m_computeItem) {
+        return;
+    }
+    int countBufferIndex = m_computeItem->indexForBuffer<CounterBuffer>(buffer);
+    if (countBufferIndex != m_countBufferIndex) {
+        m_countBufferIndex = countBufferIndex;
+        emit countBufferChanged();
+        update();
+    }
+}
+
 void StorageBufferView::setNumberOfPoints(int nop)
 {
     if (nop != m_numberOfPoints) {
@@ -147,8 +336,31 @@ void StorageBufferView::setStrideInByte(quint32 stride)
     }
 }
 
+void StorageBufferView::setCulling(bool culling)
+{
+    if (culling != m_culling) {
+        m_culling = culling;
+        emit cullingChanged();
+        update();
+    }
+}
+
+void StorageBufferView::setDecimationCellSize(float cellSize)
+{
+    if (cellSize < 0.0) {
+        qWarning() << "Cannot set a negative decimation cell size";
+        return;
+    }
+    if (cellSize != m_decimationCellSize) {
+        m_decimationCellSize = cellSize;
+        emit decimationCellSizeChanged();
+        update();
+    }
+}
+
 QSGNode* StorageBufferView::updatePaintNode(QSGNode *old, UpdatePaintNodeData *)
 {
+    TraceSpan span("StorageBufferView::updatePaintNode");
 
     if (!m_computeItem) {
         qWarning() << "Cannot render without ComputeItem";
@@ -172,9 +384,18 @@ QSGNode* StorageBufferView::updatePaintNode(QSGNode *old, UpdatePaintNodeData *)
     node->setNumberOfPoints(m_numberOfPoints);
     node->setPointSize(m_pointSize);
     node->setStrideInByte(m_strideInByte);
+    node->setCulling(m_culling);
+    node->setDecimationCellSize(m_decimationCellSize);
     node->setBoundingRect(boundingRect());
     node->setPointBuffer(buffer);
 
+    CounterBuffer *counter = countBuffer();
+    if (counter) {
+        node->setCountBuffer(m_computeItem->rhiStorageBufferAt(m_countBufferIndex), counter->renderValue());
+    } else {
+        node->setCountBuffer(nullptr, -1);
+    }
+
     return node;
 }
 
@@ -222,38 +443,238 @@ QRhiSwapChain* PointCloudRenderNode::checkSwapChain() const
     return swapChain;
 }
 
+QSizeF PointCloudRenderNode::viewportSize() const
+{
+    qreal dpr = 1.0;
+    const auto screen = m_window->screen();
+    if (screen) {
+      dpr = screen->devicePixelRatio();
+    }
+    return QSizeF(m_window->width() * dpr, m_window->height() * dpr);
+}
+
+int PointCloudRenderNode::drawCount() const
+{
+    if (!cullingActive()) {
+        return int(sourceCount());
+    }
+
+    // the vertex shader discards all vertices beyond the visible count of this frame
+    if (!m_hasVisibleCount) {
+        return int(m_capacity);
+    }
+    return int(qMin(m_capacity, withHeadroom(m_visibleCount)));
+}
+
+quint32 PointCloudRenderNode::sourceCount() const
+{
+    // numberOfPoints is the upper bound, e.g. the capacity of an append buffer
+    const quint32 numberOfPoints = quint32(qMax(0, m_numberOfPoints));
+    if (!activeCountBuffer() || m_countValue < 0) {
+        return numberOfPoints;
+    }
+    return qMin(numberOfPoints, withHeadroom(quint32(m_countValue)));
+}
+
+void PointCloudRenderNode::prepareCulling(QRhi *rhi, QRhiCommandBuffer *commandBuffer, const QMatrix4x4 &mvpProjection, qint32 flip)
+{
+    if (!m_buffer || m_numberOfPoints <= 0) {
+        m_capacity = 0;
+        return;
+    }
+
+    // only runs with decimation, see cullingActive()
+    const QSizeF viewport = viewportSize();
+    const quint32 gridWidth = quint32(qCeil(viewport.width() / m_decimationCellSize));
+    const quint32 gridHeight = quint32(qCeil(viewport.height() / m_decimationCellSize));
+    const quint32 gridCells = qMax(1u, gridWidth * gridHeight);
+
+    // at most one point per grid cell survives
+    const quint32 capacity = qMin(quint32(m_numberOfPoints), gridCells);
+
+    QRhiResourceUpdateBatch *cullUpdates = rhi->nextResourceUpdateBatch();
+    bool rebuildBindings = !m_cullBindings || m_cullSourceBuffer != m_buffer || m_cullCountBuffer != m_countBuffer;
+
+    if (!m_cullUniformBuffer) {
+        m_cullUniformBuffer.reset(rhi->newBuffer(QRhiBuffer::Dynamic, QRhiBuffer::UniformBuffer, sizeof(CullUniforms)));
+        m_cullUniformBuffer->create();
+
+        m_drawCountBuffer.reset(rhi->newBuffer(QRhiBuffer::Static, QRhiBuffer::StorageBuffer, sizeof(quint32)));
+        m_drawCountBuffer->create();
+
+        static const quint32 unlimited = ~0u;
+        m_noCountBuffer.reset(rhi->newBuffer(QRhiBuffer::Static, QRhiBuffer::StorageBuffer, sizeof(quint32)));
+        m_noCountBuffer->create();
+        cullUpdates->uploadStaticBuffer(m_noCountBuffer.get(), 0, sizeof(quint32), &unlimited);
+
+        m_drawCountReadback = new AsyncReadback([this](const QByteArray &data) {
+            if (data.size() >= int(sizeof(quint32))) {
+                m_visibleCount = *reinterpret_cast<const quint32 *>(data.constData());
+                m_hasVisibleCount = true;
+            }
+        });
+    }
+
+    if (!m_visiblePointBuffer || capacity != m_capacity) {
+        m_visiblePointBuffer.reset(rhi->newBuffer(QRhiBuffer::Static, QRhiBuffer::StorageBuffer | QRhiBuffer::VertexBuffer,
+                                                  qMax(1u, capacity) * visiblePointStride));
+        m_visiblePointBuffer->create();
+        m_capacity = capacity;
+        m_hasVisibleCount = false;
+        rebuildBindings = true;
+    }
+
+    if (!m_gridBuffer || gridWidth != m_gridWidth || gridHeight != m_gridHeight) {
+        m_gridBuffer.reset(rhi->newBuffer(QRhiBuffer::Static, QRhiBuffer::StorageBuffer, gridCells * sizeof(quint32)));
+        m_gridBuffer->create();
+        cullUpdates->uploadStaticBuffer(m_gridBuffer.get(), QByteArray(int(gridCells * sizeof(quint32)), 0).constData());
+        m_gridWidth = gridWidth;
+        m_gridHeight = gridHeight;
+        // stamps start again with a fresh grid
+        m_frameStamp = 0;
+        rebuildBindings = true;
+    }
+
+    if (rebuildBindings) {
+        m_cullBindings.reset(rhi->newShaderResourceBindings());
+        m_cullBindings->setBindings({
+            QRhiShaderResourceBinding::bufferLoad(0, QRhiShaderResourceBinding::ComputeStage, m_buffer),
+            QRhiShaderResourceBinding::bufferStore(1, QRhiShaderResourceBinding::ComputeStage, m_visiblePointBuffer.get()),
+            QRhiShaderResourceBinding::bufferLoadStore(2, QRhiShaderResourceBinding::ComputeStage, m_drawCountBuffer.get()),
+            QRhiShaderResourceBinding::bufferLoadStore(3, QRhiShaderResourceBinding::ComputeStage, m_gridBuffer.get()),
+            QRhiShaderResourceBinding::uniformBuffer(4, QRhiShaderResourceBinding::ComputeStage, m_cullUniformBuffer.get()),
+            QRhiShaderResourceBinding::bufferLoad(5, QRhiShaderResourceBinding::ComputeStage, m_countBuffer ? m_countBuffer : m_noCountBuffer.get())
+        });
+        m_cullBindings->create();
+        m_cullSourceBuffer = m_buffer;
+        m_cullCountBuffer = m_countBuffer;
+
+        m_cullPipeline.reset(rhi->newComputePipeline());
+        m_cullPipeline->setShaderResourceBindings(m_cullBindings.get());
+        m_cullPipeline->setShaderStage({ QRhiShaderStage::Compute, loadShader(QLatin1String(":/shaders/pointcloud_cull.comp.qsb")) });
+        m_cullPipeline->create();
+
+        // the graphics pipeline references the draw count buffer
+        releasePipeline();
+    }
+
+    m_frameStamp++;
+    if (m_frameStamp == 0) {
+        m_frameStamp = 1;
+    }
+
+    CullUniforms uniforms;
+    memcpy(uniforms.mvpProjection, mvpProjection.constData(), sizeof(uniforms.mvpProjection));
+    uniforms.width = m_boundingRect.width();
+    uniforms.height = m_boundingRect.height();
+    uniforms.viewportWidth = viewport.width();
+    uniforms.viewportHeight = viewport.height();
+    uniforms.cellSize = m_decimationCellSize;
+    // keep points whose sprite still reaches into the viewport
+    uniforms.margin = m_pointSize / qMax(1.0, qMin(viewport.width(), viewport.height()));
+    uniforms.flip = flip;
+    uniforms.strideInFloats = m_strideInByte / sizeof(float);
+    // the points beyond the count of a count buffer are skipped by the shader
+    const quint32 sourcePoints = sourceCount();
+    uniforms.numberOfPoints = sourcePoints;
+    uniforms.capacity = m_capacity;
+    uniforms.gridWidth = m_gridWidth;
+    uniforms.gridHeight = m_gridHeight;
+    uniforms.frameStamp = m_frameStamp;
+
+    static const quint32 zero = 0;
+    cullUpdates->updateDynamicBuffer(m_cullUniformBuffer.get(), 0, sizeof(CullUniforms), &uniforms);
+    cullUpdates->uploadStaticBuffer(m_drawCountBuffer.get(), 0, sizeof(quint32), &zero);
+
+    QRhiResourceUpdateBatch *readbackUpdates = nullptr;
+    if (!m_drawCountReadback->isPending()) {
+        readbackUpdates = rhi->nextResourceUpdateBatch();
+        m_drawCountReadback->readBackBuffer(readbackUpdates, m_drawCountBuffer.get(), 0, sizeof(quint32));
+    }
+
+    commandBuffer->beginComputePass(cullUpdates);
+    commandBuffer->setComputePipeline(m_cullPipeline.get());
+    commandBuffer->setShaderResources();
+    commandBuffer->dispatch(int((sourcePoints + cullWorkgroupSize - 1) / cullWorkgroupSize), 1, 1);
+    commandBuffer->endComputePass(readbackUpdates);
+}
+
+void PointCloudRenderNode::checkVertexStorageBuffers(QRhi *rhi)
+{
+    if (m_vertexStorageBuffers < 0) {
+        m_vertexStorageBuffers = supportsVertexStorageBuffers(rhi) ? 1 : 0;
+    }
+    if (m_vertexStorageBuffers == 0 && (m_culling || m_countBuffer) && !m_vertexStorageWarned) {
+        qWarning() << "Storage buffers are not supported in vertex shaders; drawing numberOfPoints without culling or count buffer";
+        m_vertexStorageWarned = true;
+    }
+}
+
 void PointCloudRenderNode::prepare()
 {
+    TraceSpan span("PointCloudRenderNode::prepare");
+    span.addArg("points", m_numberOfPoints);
+
     QRhi *rhi = checkRhi();
     QRhiSwapChain *swapChain = checkSwapChain();
     if (!rhi || !swapChain) {
         return;
     }
 
+    QRhiCommandBuffer *commandBuffer = swapChain->currentFrameCommandBuffer();
+
+    const QMatrix4x4 *mvp = matrix();
+    QMatrix4x4 mat(*projectionMatrix());
+
+    // multiply to get mvpProjection matrix
+    mat = mat * *mvp;
+
+    qint32 flip = rhi->isYUpInFramebuffer() ? 1 : 0;
+
+    checkVertexStorageBuffers(rhi);
+
+    // the compute pre-pass must be recorded outside of the render pass
+    if (cullingActive()) {
+        prepareCulling(rhi, commandBuffer, mat, flip);
+    }
+
     QRhiResourceUpdateBatch *resourceUpdates = rhi->nextResourceUpdateBatch();
 
-    if (!m_pipeline) {
+    if (!m_pipeline && (!cullingActive() || m_drawCountBuffer)) {
 
         static quint32 ubufSize = 64 + 4 + 4 + 4 + 4; // QMatrix4x4 (mvpProjection) + float (width) + float (height) + float (pointSize) + int (flip);
         m_uniformBuffer.reset(rhi->newBuffer(QRhiBuffer::Dynamic, QRhiBuffer::UniformBuffer, ubufSize));
         m_uniformBuffer->create();
 
+        // the culled points or the points of a count buffer stop at a count written on the GPU
+        QRhiBuffer *countBuffer = cullingActive() ? m_drawCountBuffer.get() : activeCountBuffer();
+
         m_resourceBindings.reset(rhi->newShaderResourceBindings());
-        m_resourceBindings->setBindings({
-            QRhiShaderResourceBinding::uniformBuffer(0, QRhiShaderResourceBinding::VertexStage | QRhiShaderResourceBinding::FragmentStage, m_uniformBuffer.get())
-        });
+        if (countBuffer) {
+            m_resourceBindings->setBindings({
+                QRhiShaderResourceBinding::uniformBuffer(0, QRhiShaderResourceBinding::VertexStage | QRhiShaderResourceBinding::FragmentStage, m_uniformBuffer.get()),
+                QRhiShaderResourceBinding::bufferLoad(1, QRhiShaderResourceBinding::VertexStage, countBuffer)
+            });
+        } else {
+            m_resourceBindings->setBindings({
+                QRhiShaderResourceBinding::uniformBuffer(0, QRhiShaderResourceBinding::VertexStage | QRhiShaderResourceBinding::FragmentStage, m_uniformBuffer.get())
+            });
+        }
         m_resourceBindings->create();
 
+        const QString vertexShader = countBuffer ? QLatin1String(":/shaders/pointcloud_culled.vert.qsb")
+                                                 : QLatin1String(":/shaders/pointcloud.vert.qsb");
+
         m_pipeline.reset(rhi->newGraphicsPipeline());
         m_pipeline->setTopology(QRhiGraphicsPipeline::Points);
         m_pipeline->setShaderStages({
-            { QRhiShaderStage::Vertex, loadShader(QLatin1String(":/shaders/pointcloud.vert.qsb")) },
+            { QRhiShaderStage::Vertex, loadShader(vertexShader) },
             { QRhiShaderStage::Fragment, loadShader(QLatin1String(":/shaders/pointcloud.frag.qsb")) }
         });
 
         QRhiVertexInputLayout inputLayout;
         inputLayout.setBindings({
-            { m_strideInByte }
+            { cullingActive() ? visiblePointStride : m_strideInByte }
         });
         inputLayout.setAttributes({
             { 0, 0, QRhiVertexInputAttribute::Float2, 0 },
@@ -265,27 +686,26 @@ void PointCloudRenderNode::prepare()
         m_pipeline->create();
     }
 
-    const QMatrix4x4 *mvp = matrix();
-    QMatrix4x4 mat(*projectionMatrix());
-
-    // multiply to get mvpProjection matrix
-    mat = mat * *mvp;
+    if (!m_uniformBuffer) {
+        resourceUpdates->release();
+        return;
+    }
 
     float width = m_boundingRect.width();
     float height = m_boundingRect.height();
-    qint32 flip = rhi->isYUpInFramebuffer() ? 1 : 0;
 
     resourceUpdates->updateDynamicBuffer(m_uniformBuffer.get(), 0,  64, mat.constData());
     resourceUpdates->updateDynamicBuffer(m_uniformBuffer.get(), 64, 4, &width);
     resourceUpdates->updateDynamicBuffer(m_uniformBuffer.get(), 68, 4, &height);
     resourceUpdates->updateDynamicBuffer(m_uniformBuffer.get(), 72, 4, &m_pointSize);
     resourceUpdates->updateDynamicBuffer(m_uniformBuffer.get(), 76, 4, &flip);
-    swapChain->currentFrameCommandBuffer()->resourceUpdate(resourceUpdates);
+    commandBuffer->resourceUpdate(resourceUpdates);
 
 }
 
 void PointCloudRenderNode::render(const RenderState *state)
 {
+    TraceSpan span("PointCloudRenderNode::render");
 
    if (!m_window) {
         qWarning("Cannot render without window");
@@ -303,31 +723,64 @@ void PointCloudRenderNode::render(const RenderState *state)
         return;
     }
 
-    QRhiCommandBuffer *commandBuffer = swapChain->currentFrameCommandBuffer();
-    const auto outputPixelSize = swapChain->currentFrameRenderTarget()->pixelSize();
- 
-    qreal dpr = 1.0;
-    const auto screen = m_window->screen();
-    if (screen) {
-      dpr = screen->devicePixelRatio();
+    if (!m_pipeline) {
+        return;
     }
-    commandBuffer->setViewport({ 0.0f, 0.0f,
-                                 float(m_window->width() * dpr), float(m_window->height() * dpr) });
+
+    QRhiBuffer *vertexBuffer = cullingActive() ? m_visiblePointBuffer.get() : m_buffer;
+    const int count = drawCount();
+    if (!vertexBuffer || count <= 0) {
+        return;
+    }
+
+    QRhiCommandBuffer *commandBuffer = swapChain->currentFrameCommandBuffer();
+
+    const QSizeF viewport = viewportSize();
+    commandBuffer->setViewport({ 0.0f, 0.0f, float(viewport.width()), float(viewport.height()) });
     commandBuffer->setGraphicsPipeline(m_pipeline.get());
     commandBuffer->setShaderResources();
 
-    QRhiCommandBuffer::VertexInput vbufBinding(m_buffer, 0);
+    QRhiCommandBuffer::VertexInput vbufBinding(vertexBuffer, 0);
     commandBuffer->setVertexInput(0, 1, &vbufBinding);
-    commandBuffer->draw(m_numberOfPoints);
+    commandBuffer->draw(count);
 
 }
 
-void PointCloudRenderNode::releaseResources()
+void PointCloudRenderNode::releasePipeline()
 {
     m_pipeline.reset();
     m_resourceBindings.reset();
+}
+
+void PointCloudRenderNode::releaseCullingResources()
+{
+    m_cullPipeline.reset();
+    m_cullBindings.reset();
+    m_cullUniformBuffer.reset();
+    m_visiblePointBuffer.reset();
+    m_drawCountBuffer.reset();
+    m_gridBuffer.reset();
+    m_noCountBuffer.reset();
+    m_cullSourceBuffer = nullptr;
+    m_cullCountBuffer = nullptr;
+    m_capacity = 0;
+    m_gridWidth = 0;
+    m_gridHeight = 0;
+    m_hasVisibleCount = false;
+
+    if (m_drawCountReadback) {
+        m_drawCountReadback->release();
+        m_drawCountReadback = nullptr;
+    }
+}
+
+void PointCloudRenderNode::releaseResources()
+{
+    releasePipeline();
+    releaseCullingResources();
     m_uniformBuffer.reset();
     m_buffer = nullptr;
+    m_countBuffer = nullptr;
 }
 
 
@@ -12,6 +12,7 @@
 #include <qqml.h>
 
 #include "computeitem.h"
+#include "counterbuffer.h"
 #include "storagebuffer.h"
 
 class StorageBufferView : public QQuickItem
@@ -49,6 +50,21 @@ class StorageBufferView : public QQuickItem
      */
     Q_PROPERTY(int numberOfPoints READ numberOfPoints WRITE setNumberOfPoints NOTIFY numberOfPointsChanged)
 
+    /**
+     * \property StorageBufferView::countBuffer
+     *
+     * \brief The counter of the valid points, e.g. of an append buffer
+     *
+     * If set, only the first points up to the value of the CounterBuffer are rendered, at most
+     * numberOfPoints. The draw call is sized from the value read back last, the vertex shader
+     * skips the points beyond the current value on the GPU.
+     *
+     * \note The counter must be a buffer of the same ComputeItem
+     * \note Requires storage buffer support in the vertex stage; without it numberOfPoints are
+     * rendered and a warning is printed once
+     */
+    Q_PROPERTY(CounterBuffer* countBuffer READ countBuffer WRITE setCountBuffer NOTIFY countBufferChanged)
+
     /**
      * \property StorageBufferView::pointSize
      *
@@ -74,9 +90,36 @@ class StorageBufferView : public QQuickItem
      *    28: alpha
      * 
      * The unused position can be used as desired. If you have more particle data in your buffer, set the stride accordingly 
-     *     
+     * or bind it to StorageBuffer::stride of a buffer with fields.
+     *
      */
     Q_PROPERTY(quint32 strideInByte READ strideInByte WRITE setStrideInByte NOTIFY strideInByteChanged)
+
+    /**
+     * \property StorageBufferView::culling
+     *
+     * \brief Enables a compute pre-pass that culls points outside the visible area
+     *
+     * When enabled together with a decimationCellSize, the points are culled against the
+     * viewport on the GPU and the remaining points are compacted into a separate draw buffer
+     * before rendering. The number of drawn vertices then depends on the visible points
+     * instead of numberOfPoints. Without decimation the points are drawn from the buffer
+     * directly and clipped by the rasterizer; a compacted copy would save nothing.
+     *
+     * \note Requires storage buffer support in the vertex stage; without it all points are
+     * rendered without the pre-pass and a warning is printed once
+     */
+    Q_PROPERTY(bool culling READ culling WRITE setCulling NOTIFY cullingChanged)
+
+    /**
+     * \property StorageBufferView::decimationCellSize
+     *
+     * \brief Size of a decimation grid cell in pixels
+     *
+     * If culling is enabled and the cell size is greater than 0, at most one point
+     * is rendered per grid cell. A value of 0 disables the decimation.
+     */
+    Q_PROPERTY(float decimationCellSize READ decimationCellSize WRITE setDecimationCellSize NOTIFY decimationCellSizeChanged)
     QML_ELEMENT
 
 public:
@@ -92,12 +135,21 @@ public:
     int numberOfPoints() const { return m_numberOfPoints; }
     void setNumberOfPoints(int nop);
 
+    CounterBuffer* countBuffer() const;
+    void setCountBuffer(const CounterBuffer* buffer);
+
     float pointSize() const { return m_pointSize; }
     void setPointSize(float ps);
 
     quint32 strideInByte() const { return m_strideInByte; }
     void setStrideInByte(quint32 stride);
 
+    bool culling() const { return m_culling; }
+    void setCulling(bool culling);
+
+    float decimationCellSize() const { return m_decimationCellSize; }
+    void setDecimationCellSize(float cellSize);
+
 protected:
     QSGNode *updatePaintNode(QSGNode *old, UpdatePaintNodeData *) override;
 
@@ -105,17 +157,24 @@ signals:
     void computeItemChanged();
     void resultBufferChanged();
     void numberOfPointsChanged();
+    void countBufferChanged();
     void pointSizeChanged();
     void strideInByteChanged();
+    void cullingChanged();
+    void decimationCellSizeChanged();
 
 private:
     ComputeItem* m_computeItem { nullptr };
     
     int m_resultBufferIndex { -1 };
+    int m_countBufferIndex { -1 };
 
     int m_numberOfPoints { 0 };
     float m_pointSize { 1.0 };
 
     quint32 m_strideInByte { 8 * sizeof(float) };
 
+    bool m_culling { false };
+    float m_decimationCellSize { 0.0 };
+
 };
\ No newline at end of file
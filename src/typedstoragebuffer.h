@@ -0,0 +1,143 @@
+// SPDX-FileCopyrightText: 2024 basysKom GmbH
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#pragma once
+
+#include <QByteArray>
+#include <QDebug>
+#include <QMatrix4x4>
+#include <QPointer>
+#include <QVector>
+#include <QVector2D>
+#include <QVector3D>
+#include <QVector4D>
+
+#include <cstddef>
+#include <cstring>
+#include <type_traits>
+
+#include "storagebuffer.h"
+
+namespace Std430 {
+
+// GLSL types with their std430 base alignment, for element structs of TypedStorageBuffer
+struct alignas(8) vec2 { float x, y; };
+struct alignas(16) vec4 { float x, y, z, w; };
+struct alignas(8) ivec2 { qint32 x, y; };
+struct alignas(16) ivec4 { qint32 x, y, z, w; };
+struct alignas(8) uvec2 { quint32 x, y; };
+struct alignas(16) uvec4 { quint32 x, y, z, w; };
+// column major
+struct alignas(16) mat4 { float m[16]; };
+// a vec3 with its 4 padding bytes; a scalar directly behind a vec3 cannot be expressed in C++,
+// declare it in front of the vec3 or use a vec4
+struct alignas(16) vec3 { float x, y, z, padding; };
+
+/**
+ * The base alignment std430 requires for a member of type T. Qt's vector types are accepted as
+ * members, but are only aligned to 4 bytes by the compiler; alignment() is what their offset has
+ * to be a multiple of, see QCI_STD430_MEMBER.
+ */
+template <typename T>
+constexpr std::size_t alignment()
+{
+    if constexpr (std::is_array_v<T>) {
+        // std430 arrays are aligned like their elements
+        return alignment<std::remove_extent_t<T>>();
+    } else if constexpr (std::is_same_v<T, QVector2D>) {
+        return 8;
+    } else if constexpr (std::is_same_v<T, QVector3D> || std::is_same_v<T, QVector4D>) {
+        return 16;
+    } else {
+        static_assert(!std::is_same_v<T, QMatrix4x4>, "QMatrix4x4 is not a plain 4x4 float matrix; use Std430::mat4");
+        static_assert(!std::is_arithmetic_v<T> || sizeof(T) == 4, "std430 scalars are 32 bit: float, qint32 or quint32");
+        return alignof(T);
+    }
+}
+
+} // namespace Std430
+
+/**
+ * Checks at compile time that member of Struct is where std430 places it, and that the size of
+ * Struct is a multiple of its alignment as the array stride requires. Use it once per member
+ * next to the struct:
+ *
+ *     struct Particle { Std430::vec2 position; float u; float v; Std430::vec4 color; };
+ *     QCI_STD430_MEMBER(Particle, position);
+ *     QCI_STD430_MEMBER(Particle, color);
+ */
+#define QCI_STD430_MEMBER(Struct, member) \
+    static_assert(offsetof(Struct, member) % Std430::alignment<decltype(Struct::member)>() == 0, \
+                  #Struct "::" #member " is not aligned as std430 requires"); \
+    static_assert(sizeof(Struct) % Std430::alignment<decltype(Struct::member)>() == 0, \
+                  "the size of " #Struct " is not a std430 array stride because of " #member)
+
+/**
+ * \brief Element access to a StorageBuffer holding an array of T from C++
+ *
+ * T is the C++ counterpart of the element struct in the shader and is copied bytewise, so it has
+ * to be trivially copyable and laid out like std430 does; check its members with
+ * QCI_STD430_MEMBER. Writes upload the touched elements only, see StorageBuffer::writeData().
+ * The buffer needs contents of its own first, see assign() and resize().
+ */
+template <typename T>
+class TypedStorageBuffer
+{
+    static_assert(std::is_trivially_copyable_v<T>, "TypedStorageBuffer elements are copied bytewise");
+    static_assert(std::is_standard_layout_v<T>, "TypedStorageBuffer elements need a standard layout for offsetof");
+    static_assert(sizeof(T) % 4 == 0, "std430 elements are made of 32 bit words");
+
+public:
+    explicit TypedStorageBuffer(StorageBuffer *buffer)
+        : m_buffer(buffer)
+    {
+        if (m_buffer && m_buffer->stride() > 0 && m_buffer->stride() != int(sizeof(T))) {
+            qWarning() << "The fields of" << m_buffer << "do not match an element of" << sizeof(T) << "bytes";
+        }
+    }
+
+    StorageBuffer *buffer() const { return m_buffer.data(); }
+
+    int count() const { return m_buffer ? int(m_buffer->buffer().size() / qsizetype(sizeof(T))) : 0; }
+
+    // replaces the contents and uploads the whole buffer
+    void assign(const QVector<T> &elements)
+    {
+        if (m_buffer) {
+            m_buffer->setBuffer(QByteArray(reinterpret_cast<const char *>(elements.constData()), elements.size() * qsizetype(sizeof(T))));
+        }
+    }
+
+    // resizes to count elements, see StorageBuffer::resize()
+    void resize(int count, bool preserve = true)
+    {
+        if (m_buffer) {
+            m_buffer->resize(count * int(sizeof(T)), preserve);
+        }
+    }
+
+    // the CPU side contents, not the results of the GPU
+    T at(int index) const
+    {
+        T element {};
+        if (m_buffer && index >= 0 && index < count()) {
+            memcpy(&element, m_buffer->buffer().constData() + qsizetype(index) * qsizetype(sizeof(T)), sizeof(T));
+        }
+        return element;
+    }
+
+    bool set(int index, const T &element) { return set(index, &element, 1); }
+
+    // writes count consecutive elements with a single upload
+    bool set(int first, const T *elements, int count)
+    {
+        if (!m_buffer || first < 0 || count <= 0) {
+            return false;
+        }
+        return m_buffer->writeData(first * int(sizeof(T)), QByteArray(reinterpret_cast<const char *>(elements), count * qsizetype(sizeof(T))));
+    }
+
+private:
+    QPointer<StorageBuffer> m_buffer;
+};
@@ -0,0 +1,60 @@
+// SPDX-FileCopyrightText: 2024 basysKom GmbH
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#include "uniformpropertybinding.h"
+#include "computeitem.h"
+
+UniformPropertyBinding::UniformPropertyBinding(ComputeItem *computeItem, const QMetaProperty &property, QMetaType::Type metaType, quint32 offset)
+    : QObject(computeItem)
+    , m_computeItem(computeItem)
+    , m_property(property)
+    , m_propertyIndex(property.propertyIndex())
+    , m_propertyType(property.metaType().id())
+    , m_metaType(metaType)
+    , m_offset(offset)
+{
+
+}
+
+void UniformPropertyBinding::update()
+{
+    switch (m_propertyType) {
+    case QMetaType::Int: {
+        const qint32 value = readProperty<int>(m_computeItem, m_propertyIndex);
+        m_computeItem->writeUniformData(m_offset, &value, sizeof(qint32));
+        break;
+    }
+    case QMetaType::Bool: {
+        const qint32 value = readProperty<bool>(m_computeItem, m_propertyIndex) ? 1 : 0;
+        m_computeItem->writeUniformData(m_offset, &value, sizeof(qint32));
+        break;
+    }
+    case QMetaType::Double: {
+        // QML real properties are doubles, the uniform block holds 4 byte floats
+        const float value = float(readProperty<double>(m_computeItem, m_propertyIndex));
+        m_computeItem->writeUniformData(m_offset, &value, sizeof(float));
+        break;
+    }
+    default:
+        readVariant();
+        break;
+    }
+}
+
+void UniformPropertyBinding::readVariant()
+{
+    // the declared type says nothing about the size of the value, e.g. of var properties
+    const QVariant value = m_property.read(m_computeItem);
+    if (!value.isValid()) {
+        return;
+    }
+
+    if (m_metaType == QMetaType::Int || m_metaType == QMetaType::Bool) {
+        const qint32 i32value = value.toInt();
+        m_computeItem->writeUniformData(m_offset, &i32value, sizeof(qint32));
+    } else if (m_metaType == QMetaType::Double) {
+        const float fvalue = value.toFloat();
+        m_computeItem->writeUniformData(m_offset, &fvalue, sizeof(float));
+    }
+}
@@ -0,0 +1,54 @@
+// SPDX-FileCopyrightText: 2024 basysKom GmbH
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#pragma once
+
+#include <QObject>
+#include <QMetaProperty>
+#include <QMetaType>
+
+class ComputeItem;
+
+/**
+ * \brief Connects one uniform property of a ComputeItem to its slot in the uniform block
+ *
+ * The property, its type and the uniform offset are resolved once. On every change the
+ * property is written directly into the packed uniform data of the ComputeItem. Properties
+ * declared as int, bool or real are read with a typed metacall (no QVariant, no name lookup);
+ * all others, e.g. var properties, with QMetaProperty::read().
+ */
+class UniformPropertyBinding : public QObject
+{
+    Q_OBJECT
+
+public:
+    // metaType is the type of the uniform, taken from the value of the property
+    UniformPropertyBinding(ComputeItem *computeItem, const QMetaProperty &property, QMetaType::Type metaType, quint32 offset);
+
+    // Reads a property with a typed metacall, the calling convention of QMetaProperty::read()
+    // without the QVariant. The property must be declared with type T, the metacall writes a T.
+    template<typename T>
+    static T readProperty(QObject *object, int propertyIndex)
+    {
+        T value {};
+        int status = -1;
+        void *argv[] = { &value, nullptr, &status };
+        QMetaObject::metacall(object, QMetaObject::ReadProperty, propertyIndex, argv);
+        return value;
+    }
+
+public slots:
+    void update();
+
+private:
+    void readVariant();
+
+    ComputeItem *m_computeItem;
+    QMetaProperty m_property;
+    int m_propertyIndex;
+    // the declared type of the property; decides how it is read
+    int m_propertyType;
+    QMetaType::Type m_metaType;
+    quint32 m_offset;
+};
@@ -0,0 +1,147 @@
+// SPDX-FileCopyrightText: 2024 basysKom GmbH
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#include "cpubench.h"
+
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QThread>
+
+#include "cpubackend.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <vector>
+
+namespace {
+
+constexpr float DiffusionU = 0.19f;
+constexpr float DiffusionV = 0.062f;
+constexpr float Feed = 0.06f;
+constexpr float Kill = 0.062f;
+
+// u and v interleaved per cell; even steps read buffer 0 and write buffer 1, odd steps the other way
+void grayScottStep(const CpuComputeContext &context, const CpuWorkGroupBatch &batch)
+{
+    const bool even = context.builtins().step % 2 == 0;
+    const float *in = context.array<float>(even ? 0 : 1);
+    float *out = context.array<float>(even ? 1 : 0);
+    const int width = context.globalSize()[0];
+    const int height = context.globalSize()[1];
+
+    for (int y = batch.yBegin; y < batch.yEnd; ++y) {
+        const float *row = in + 2 * y * width;
+        const float *above = in + 2 * ((y + height - 1) % height) * width;
+        const float *below = in + 2 * ((y + 1) % height) * width;
+        float *target = out + 2 * y * width;
+
+        for (int x = batch.xBegin; x < batch.xEnd; ++x) {
+            const int left = 2 * (x == 0 ? width - 1 : x - 1);
+            const int right = 2 * (x == width - 1 ? 0 : x + 1);
+            const int center = 2 * x;
+
+            const float u = row[center];
+            const float v = row[center + 1];
+            const float laplaceU = row[left] + row[right] + above[center] + below[center] - 4.0f * u;
+            const float laplaceV = row[left + 1] + row[right + 1] + above[center + 1] + below[center + 1] - 4.0f * v;
+            const float uvv = u * v * v;
+
+            target[center] = u + DiffusionU * laplaceU - uvv + Feed * (1.0f - u);
+            target[center + 1] = v + DiffusionV * laplaceV + uvv - (Feed + Kill) * v;
+        }
+    }
+}
+
+QByteArray initialGrid(int size)
+{
+    std::vector<float> cells(size_t(size) * size * 2);
+    for (int y = 0; y < size; ++y) {
+        for (int x = 0; x < size; ++x) {
+            const bool seeded = std::abs(x - size / 2) < size / 16 && std::abs(y - size / 2) < size / 16;
+            cells[2 * (size_t(y) * size + x)] = 1.0f;
+            cells[2 * (size_t(y) * size + x) + 1] = seeded ? 1.0f : 0.0f;
+        }
+    }
+    return QByteArray(reinterpret_cast<const char *>(cells.data()), int(cells.size() * sizeof(float)));
+}
+
+struct Run {
+    double milliseconds { 0.0 };
+    QByteArray result;
+};
+
+Run run(int size, int iterations, int threads)
+{
+    CpuDispatcher::instance()->setThreadCount(threads);
+
+    QByteArray buffers[2] = { initialGrid(size), QByteArray(size * size * 2 * int(sizeof(float)), 0) };
+    CpuComputeContext context;
+    context.setResources({ { buffers[0].data(), buffers[0].size(), QSize() }, { buffers[1].data(), buffers[1].size(), QSize() } });
+
+    // rows of 64 cells per work group, as a GPU kernel with local_size_x = 64 would do it
+    const int localSize[3] = { 64, 1, 1 };
+    const int globalSize[3] = { size, size, 1 };
+    const int workGroups[3] = { (size + localSize[0] - 1) / localSize[0], size, 1 };
+    context.setWorkGroups(workGroups, localSize, globalSize);
+
+    const auto step = [&context](quint32 index) {
+        CpuBuiltins builtins;
+        builtins.step = index;
+        context.setBuiltins(builtins);
+        CpuDispatcher::instance()->run(context, grayScottStep);
+    };
+
+    // warm up the pool and the caches, an even number of steps keeps the result in buffer 0
+    step(0);
+    step(1);
+
+    QElapsedTimer timer;
+    timer.start();
+    for (int i = 0; i < iterations; ++i) {
+        step(quint32(i));
+    }
+    Run result;
+    result.milliseconds = double(timer.nsecsElapsed()) / 1e6 / iterations;
+    result.result = buffers[iterations % 2];
+    return result;
+}
+
+} // namespace
+
+int benchmarkCpu(int size, int iterations, QTextStream &out)
+{
+    const int previousThreads = CpuDispatcher::instance()->threadCount();
+    const int idealThreads = QThread::idealThreadCount();
+
+    std::vector<int> threadCounts;
+    for (int threads = 1; threads < idealThreads; threads *= 2) {
+        threadCounts.push_back(threads);
+    }
+    threadCounts.push_back(idealThreads);
+
+    out << "Gray-Scott " << size << "x" << size << ", " << iterations << " steps per run" << Qt::endl;
+    out << QStringLiteral("%1 %2 %3 %4 %5").arg(QStringLiteral("threads"), 8).arg(QStringLiteral("ms/step"), 10)
+               .arg(QStringLiteral("Mcells/s"), 10).arg(QStringLiteral("speedup"), 8).arg(QStringLiteral("result"), 8) << Qt::endl;
+
+    int mismatches = 0;
+    Run reference;
+    for (const int threads : threadCounts) {
+        const Run result = run(size, iterations, threads);
+        if (threads == 1) {
+            reference = result;
+        }
+        // every cell is computed from the same inputs, whatever the thread count
+        const bool correct = result.result == reference.result;
+        if (!correct) {
+            ++mismatches;
+        }
+        const double cellsPerSecond = double(size) * size / (result.milliseconds / 1e3);
+        out << QStringLiteral("%1 %2 %3 %4 %5").arg(threads, 8).arg(result.milliseconds, 10, 'f', 3)
+                   .arg(cellsPerSecond / 1e6, 10, 'f', 1).arg(reference.milliseconds / result.milliseconds, 8, 'f', 2)
+                   .arg(correct ? QStringLiteral("ok") : QStringLiteral("WRONG"), 8) << Qt::endl;
+    }
+
+    CpuDispatcher::instance()->setThreadCount(previousThreads);
+    return mismatches;
+}
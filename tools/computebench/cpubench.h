@@ -0,0 +1,12 @@
+// SPDX-FileCopyrightText: 2024 basysKom GmbH
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#pragma once
+
+#include <QTextStream>
+
+// Runs a Gray-Scott step on a size x size grid through the CPU backend with 1, 2, 4, ... threads
+// and prints the time per step and the speedup over one thread. Returns the number of thread
+// counts whose result differs from the single threaded one.
+int benchmarkCpu(int size, int iterations, QTextStream &out);
@@ -0,0 +1,319 @@
+// SPDX-FileCopyrightText: 2024 basysKom GmbH
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+// Times a family of compute shader variants, e.g. the same kernel baked with different
+// local sizes, on an offscreen QRhi and prints the same table the autotuner logs:
+//
+//   computebench --backend vulkan --global 1024x1024 --iterations 50 k_64.qsb k_128.qsb k_256.qsb
+//
+// The resources are created from the reflection data of the first variant and are zero
+// initialized, so kernels whose work depends on the buffer contents are timed with that input.
+//
+// With --primitives N, the parallel primitives are run on N random values instead, checked
+// against their std:: counterparts and timed against them:
+//
+//   computebench --backend vulkan --primitives 16777216
+//
+// With --cpu N, a Gray-Scott step on an N x N grid is run through the CPU backend with an
+// increasing number of threads to show how it scales across cores; no GPU is needed:
+//
+//   computebench --cpu 2048
+//
+// With --properties N, a uniform property is changed N times, once written through
+// QObject::property() and once through the typed read of UniformPropertyBinding:
+//
+//   computebench --properties 1000000
+
+#include "autotuner.h"
+#include "cpubench.h"
+#include "primitivesbench.h"
+#include "uniformsbench.h"
+
+#include <QCommandLineParser>
+#include <QFile>
+#include <QFileInfo>
+#include <QGuiApplication>
+#include <QOffscreenSurface>
+#include <QSurfaceFormat>
+#include <QTextStream>
+
+#if QT_CONFIG(vulkan)
+  #include <QVulkanInstance>
+#endif
+
+#if QT_VERSION < QT_VERSION_CHECK(6, 6, 0)
+  #include <private/qrhinull_p.h>
+  #include <private/qrhigles2_p.h>
+  #if QT_CONFIG(vulkan)
+    #include <private/qrhivulkan_p.h>
+  #endif
+  #ifdef Q_OS_WIN
+    #include <private/qrhid3d11_p.h>
+  #endif
+  #if defined(Q_OS_MACOS) || defined(Q_OS_IOS)
+    #include <private/qrhimetal_p.h>
+  #endif
+#endif
+
+#include <algorithm>
+#include <memory>
+
+namespace {
+
+QRhiTexture::Format textureFormat(QShaderDescription::ImageFormat format)
+{
+    switch (format) {
+    case QShaderDescription::ImageFormatRgba16f:
+        return QRhiTexture::RGBA16F;
+    case QShaderDescription::ImageFormatRgba32f:
+        return QRhiTexture::RGBA32F;
+    case QShaderDescription::ImageFormatR32f:
+        return QRhiTexture::R32F;
+    case QShaderDescription::ImageFormatR16f:
+        return QRhiTexture::R16F;
+    case QShaderDescription::ImageFormatR8:
+        return QRhiTexture::R8;
+    default:
+        return QRhiTexture::RGBA8;
+    }
+}
+
+// "N", "XxY" or "XxYxZ"
+std::array<int, 3> parseSize(const QString &value)
+{
+    std::array<int, 3> size { 1, 1, 1 };
+    const auto parts = value.split(QLatin1Char('x'));
+    for (int i = 0; i < std::min<int>(parts.size(), 3); ++i) {
+        size[i] = std::max(1, parts[i].toInt());
+    }
+    return size;
+}
+
+int divideRoundingUp(int value, int divisor)
+{
+    return (value + divisor - 1) / std::max(1, divisor);
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    QGuiApplication app(argc, argv);
+    QCoreApplication::setApplicationName(QStringLiteral("computebench"));
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(QStringLiteral("Times compute shader variants and prints the fastest one."));
+    parser.addHelpOption();
+    parser.addPositionalArgument(QStringLiteral("shaders"), QStringLiteral("The .qsb variants of one kernel."), QStringLiteral("shader.qsb..."));
+
+    const QCommandLineOption backendOption(QStringLiteral("backend"), QStringLiteral("vulkan, opengl, d3d11, metal or null."), QStringLiteral("name"),
+#if defined(Q_OS_MACOS) || defined(Q_OS_IOS)
+                                           QStringLiteral("metal"));
+#elif defined(Q_OS_WIN)
+                                           QStringLiteral("d3d11"));
+#elif QT_CONFIG(vulkan)
+                                           QStringLiteral("vulkan"));
+#else
+                                           QStringLiteral("opengl"));
+#endif
+    const QCommandLineOption globalOption(QStringLiteral("global"), QStringLiteral("Global size in invocations, N, XxY or XxYxZ."), QStringLiteral("size"),
+                                          QStringLiteral("1048576"));
+    const QCommandLineOption iterationsOption(QStringLiteral("iterations"), QStringLiteral("Dispatches per timed frame."), QStringLiteral("count"),
+                                              QStringLiteral("20"));
+    const QCommandLineOption bufferSizeOption(QStringLiteral("buffer-size"), QStringLiteral("Size of every storage buffer in bytes."), QStringLiteral("bytes"),
+                                              QStringLiteral("67108864"));
+    const QCommandLineOption imageSizeOption(QStringLiteral("image-size"), QStringLiteral("Size of every storage image, WxH."), QStringLiteral("size"),
+                                             QStringLiteral("1024x1024"));
+    const QCommandLineOption primitivesOption(QStringLiteral("primitives"), QStringLiteral("Check and time the parallel primitives on this many values."),
+                                              QStringLiteral("count"));
+    const QCommandLineOption cpuOption(QStringLiteral("cpu"), QStringLiteral("Time the CPU backend on a grid of this size with 1, 2, 4, ... threads."),
+                                       QStringLiteral("size"));
+    const QCommandLineOption propertiesOption(QStringLiteral("properties"), QStringLiteral("Time this many changes of a uniform property before and after UniformPropertyBinding."),
+                                              QStringLiteral("count"));
+    parser.addOptions({ backendOption, globalOption, iterationsOption, bufferSizeOption, imageSizeOption, primitivesOption, cpuOption, propertiesOption });
+    parser.process(app);
+
+    QTextStream out(stdout);
+    QTextStream err(stderr);
+
+    const int iterations = std::max(1, parser.value(iterationsOption).toInt());
+
+    if (parser.isSet(cpuOption)) {
+        const int size = std::max(1, parser.value(cpuOption).toInt());
+        return benchmarkCpu(size, iterations, out) == 0 ? 0 : 1;
+    }
+
+    if (parser.isSet(propertiesOption)) {
+        const int count = std::max(1, parser.value(propertiesOption).toInt());
+        return benchmarkUniforms(count, out);
+    }
+
+    QVector<Autotuner::Variant> variants;
+    for (const auto &fileName : parser.positionalArguments()) {
+        QFile file(fileName);
+        if (!file.open(QIODevice::ReadOnly)) {
+            err << "Could not open " << fileName << Qt::endl;
+            return 1;
+        }
+        const QShader shader = QShader::fromSerialized(file.readAll());
+        if (!shader.isValid()) {
+            err << fileName << " is not a valid .qsb file" << Qt::endl;
+            return 1;
+        }
+        variants.append({ QFileInfo(fileName).completeBaseName(), shader });
+    }
+    if (variants.isEmpty() && !parser.isSet(primitivesOption)) {
+        parser.showHelp(1);
+    }
+
+    const QString backend = parser.value(backendOption).toLower();
+    const QRhi::Flags flags =
+#if QT_VERSION >= QT_VERSION_CHECK(6, 6, 0)
+        QRhi::EnableTimestamps;
+#else
+        QRhi::Flags();
+#endif
+
+    std::unique_ptr<QRhi> rhi;
+    std::unique_ptr<QOffscreenSurface> fallbackSurface;
+#if QT_CONFIG(vulkan)
+    QVulkanInstance vulkanInstance;
+#endif
+
+    if (backend == QLatin1String("null")) {
+        QRhiNullInitParams params;
+        rhi.reset(QRhi::create(QRhi::Null, &params, flags));
+    } else if (backend == QLatin1String("opengl")) {
+        QSurfaceFormat format = QSurfaceFormat::defaultFormat();
+        format.setVersion(4, 3);
+        format.setProfile(QSurfaceFormat::CoreProfile);
+        fallbackSurface.reset(QRhiGles2InitParams::newFallbackSurface(format));
+        QRhiGles2InitParams params;
+        params.format = format;
+        params.fallbackSurface = fallbackSurface.get();
+        rhi.reset(QRhi::create(QRhi::OpenGLES2, &params, flags));
+#if QT_CONFIG(vulkan)
+    } else if (backend == QLatin1String("vulkan")) {
+        vulkanInstance.setExtensions(QRhiVulkanInitParams::preferredInstanceExtensions());
+        if (vulkanInstance.create()) {
+            QRhiVulkanInitParams params;
+            params.inst = &vulkanInstance;
+            rhi.reset(QRhi::create(QRhi::Vulkan, &params, flags));
+        }
+#endif
+#ifdef Q_OS_WIN
+    } else if (backend == QLatin1String("d3d11")) {
+        QRhiD3D11InitParams params;
+        rhi.reset(QRhi::create(QRhi::D3D11, &params, flags));
+#endif
+#if defined(Q_OS_MACOS) || defined(Q_OS_IOS)
+    } else if (backend == QLatin1String("metal")) {
+        QRhiMetalInitParams params;
+        rhi.reset(QRhi::create(QRhi::Metal, &params, flags));
+#endif
+    } else {
+        err << "Unsupported backend " << backend << Qt::endl;
+        return 1;
+    }
+
+    if (!rhi) {
+        err << "Could not create a " << backend << " QRhi" << Qt::endl;
+        return 1;
+    }
+    if (!rhi->isFeatureSupported(QRhi::Compute)) {
+        err << "The " << backend << " backend does not support compute shaders" << Qt::endl;
+        return 1;
+    }
+
+    if (parser.isSet(primitivesOption)) {
+        out << "Device: " << Autotuner::deviceKey(rhi.get()) << Qt::endl;
+        const quint32 count = std::max(1u, parser.value(primitivesOption).toUInt());
+        return benchmarkPrimitives(rhi.get(), count, iterations, out) == 0 ? 0 : 1;
+    }
+
+    // the variants differ in their local size only, so the first one describes the resources
+    const QShaderDescription description = variants.first().shader.description();
+    const int bufferSize = std::max(1, parser.value(bufferSizeOption).toInt());
+    const auto imageSize = parseSize(parser.value(imageSizeOption));
+
+    std::vector<std::unique_ptr<QRhiResource>> resources;
+    QVector<QRhiShaderResourceBinding> bindingList;
+    QRhiResourceUpdateBatch *updates = rhi->nextResourceUpdateBatch();
+
+    for (const auto &block : description.storageBlocks()) {
+        const int size = std::max(bufferSize, block.knownSize);
+        auto *buffer = rhi->newBuffer(QRhiBuffer::Immutable, QRhiBuffer::StorageBuffer, size);
+        if (!buffer->create()) {
+            err << "Could not create a storage buffer of " << size << " bytes" << Qt::endl;
+            return 1;
+        }
+        updates->uploadStaticBuffer(buffer, QByteArray(size, 0).constData());
+        bindingList << QRhiShaderResourceBinding::bufferLoadStore(block.binding, QRhiShaderResourceBinding::ComputeStage, buffer);
+        resources.emplace_back(buffer);
+    }
+
+    for (const auto &block : description.uniformBlocks()) {
+        auto *buffer = rhi->newBuffer(QRhiBuffer::Dynamic, QRhiBuffer::UniformBuffer, rhi->ubufAligned(block.size));
+        if (!buffer->create()) {
+            err << "Could not create a uniform buffer of " << block.size << " bytes" << Qt::endl;
+            return 1;
+        }
+        updates->updateDynamicBuffer(buffer, 0, block.size, QByteArray(block.size, 0).constData());
+        bindingList << QRhiShaderResourceBinding::uniformBuffer(block.binding, QRhiShaderResourceBinding::ComputeStage, buffer);
+        resources.emplace_back(buffer);
+    }
+
+    for (const auto &image : description.storageImages()) {
+        auto *texture = rhi->newTexture(textureFormat(image.imageFormat), QSize(imageSize[0], imageSize[1]), 1, QRhiTexture::UsedWithLoadStore);
+        if (!texture->create()) {
+            err << "Could not create a storage image of " << imageSize[0] << "x" << imageSize[1] << Qt::endl;
+            return 1;
+        }
+        bindingList << QRhiShaderResourceBinding::imageLoadStore(image.binding, QRhiShaderResourceBinding::ComputeStage, texture, 0);
+        resources.emplace_back(texture);
+    }
+
+    // the uploads are submitted before any variant is timed
+    QRhiCommandBuffer *cb = nullptr;
+    if (rhi->beginOffscreenFrame(&cb) != QRhi::FrameOpSuccess) {
+        err << "Could not begin an offscreen frame" << Qt::endl;
+        return 1;
+    }
+    cb->resourceUpdate(updates);
+    rhi->endOffscreenFrame();
+
+    std::unique_ptr<QRhiShaderResourceBindings> bindings(rhi->newShaderResourceBindings());
+    bindings->setBindings(bindingList.cbegin(), bindingList.cend());
+    if (!bindings->create()) {
+        err << "Could not create the shader resource bindings" << Qt::endl;
+        return 1;
+    }
+
+    const auto globalSize = parseSize(parser.value(globalOption));
+    const auto groupCount = [&globalSize](const QShader &shader) {
+        const auto localSize = shader.description().computeShaderLocalSize();
+        return std::array<int, 3> { divideRoundingUp(globalSize[0], int(localSize[0])),
+                                    divideRoundingUp(globalSize[1], int(localSize[1])),
+                                    divideRoundingUp(globalSize[2], int(localSize[2])) };
+    };
+
+    const auto results = Autotuner::benchmark(rhi.get(), variants, bindings.get(), -1, groupCount, iterations);
+
+    out << "Device: " << Autotuner::deviceKey(rhi.get()) << Qt::endl;
+    out << "Global size: " << globalSize[0] << "x" << globalSize[1] << "x" << globalSize[2]
+        << ", " << iterations << " dispatches per frame" << Qt::endl;
+    out << Autotuner::table(results) << Qt::endl;
+
+    const int best = Autotuner::fastest(results);
+    if (best < 0) {
+        err << "No variant could be timed" << Qt::endl;
+        return 1;
+    }
+    out << "Fastest: " << results[best].name << Qt::endl;
+
+    // the bindings and the resources must go before the QRhi
+    bindings.reset();
+    resources.clear();
+    return 0;
+}
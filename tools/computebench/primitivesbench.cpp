@@ -0,0 +1,278 @@
+// SPDX-FileCopyrightText: 2024 basysKom GmbH
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#include "primitivesbench.h"
+
+#include <QElapsedTimer>
+#include <QRandomGenerator>
+
+#include "primitivekernels.h"
+
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <numeric>
+#include <vector>
+
+namespace {
+
+struct Measurement {
+    QString name;
+    double gpuMilliseconds { 0.0 };
+    double cpuMilliseconds { 0.0 };
+    bool correct { false };
+};
+
+using Prepare = std::function<bool(QRhiResourceUpdateBatch *updateBatch)>;
+
+class Bench
+{
+public:
+    Bench(QRhi *rhi, int iterations) : m_rhi(rhi), m_iterations(iterations) { }
+
+    ~Bench()
+    {
+        m_kernels.releaseResources();
+        for (auto buffer : m_buffers) {
+            delete buffer;
+        }
+    }
+
+    template<typename T>
+    QRhiBuffer* upload(const std::vector<T> &values)
+    {
+        const quint32 size = quint32(std::max<size_t>(values.size(), 1) * sizeof(T));
+        auto buffer = m_rhi->newBuffer(QRhiBuffer::Static, QRhiBuffer::StorageBuffer, size);
+        buffer->create();
+        m_buffers.push_back(buffer);
+
+        QRhiCommandBuffer *cb = nullptr;
+        if (m_rhi->beginOffscreenFrame(&cb) == QRhi::FrameOpSuccess) {
+            QRhiResourceUpdateBatch *updates = m_rhi->nextResourceUpdateBatch();
+            updates->uploadStaticBuffer(buffer, 0, quint32(values.size() * sizeof(T)), values.data());
+            cb->resourceUpdate(updates);
+            m_rhi->endOffscreenFrame();
+        }
+        return buffer;
+    }
+
+    QRhiBuffer* buffer(quint32 size)
+    {
+        auto buffer = m_rhi->newBuffer(QRhiBuffer::Static, QRhiBuffer::StorageBuffer, std::max(size, 4u));
+        buffer->create();
+        m_buffers.push_back(buffer);
+        return buffer;
+    }
+
+    template<typename T>
+    std::vector<T> readBack(QRhiBuffer *buffer, size_t count)
+    {
+        QRhiReadbackResult result;
+        QRhiCommandBuffer *cb = nullptr;
+        if (m_rhi->beginOffscreenFrame(&cb) == QRhi::FrameOpSuccess) {
+            QRhiResourceUpdateBatch *updates = m_rhi->nextResourceUpdateBatch();
+            updates->readBackBuffer(buffer, 0, quint32(count * sizeof(T)), &result);
+            cb->resourceUpdate(updates);
+            // waits for the GPU, the readback has completed afterwards
+            m_rhi->endOffscreenFrame();
+        }
+
+        std::vector<T> values(count);
+        memcpy(values.data(), result.data.constData(), std::min<size_t>(result.data.size(), count * sizeof(T)));
+        return values;
+    }
+
+    // runs the primitive once for the result check; returns false if it cannot be prepared
+    bool run(const Prepare &prepare)
+    {
+        return record(prepare, 1) >= 0.0;
+    }
+
+    // milliseconds per run of the primitive
+    double time(const Prepare &prepare)
+    {
+        return record(prepare, m_iterations) / m_iterations;
+    }
+
+private:
+    double record(const Prepare &prepare, int runs)
+    {
+        QRhiCommandBuffer *cb = nullptr;
+        QElapsedTimer timer;
+        timer.start();
+        if (m_rhi->beginOffscreenFrame(&cb) != QRhi::FrameOpSuccess) {
+            return -1.0;
+        }
+
+        QRhiResourceUpdateBatch *updates = m_rhi->nextResourceUpdateBatch();
+        if (!prepare(updates)) {
+            cb->resourceUpdate(updates);
+            m_rhi->endOffscreenFrame();
+            return -1.0;
+        }
+
+        cb->beginComputePass(updates);
+        for (int i = 0; i < runs; ++i) {
+            m_kernels.record(cb);
+        }
+        cb->endComputePass();
+        m_rhi->endOffscreenFrame();
+
+        double seconds = 0.0;
+#if QT_VERSION >= QT_VERSION_CHECK(6, 6, 0)
+        seconds = cb->lastCompletedGpuTime();
+#endif
+        if (seconds <= 0.0) {
+            seconds = double(timer.nsecsElapsed()) / 1e9;
+        }
+        return seconds * 1000.0;
+    }
+
+public:
+    PrimitiveKernels m_kernels;
+
+private:
+    QRhi *m_rhi;
+    int m_iterations;
+    std::vector<QRhiBuffer *> m_buffers;
+};
+
+template<typename F>
+double cpuTime(const F &function)
+{
+    QElapsedTimer timer;
+    timer.start();
+    function();
+    return double(timer.nsecsElapsed()) / 1e6;
+}
+
+} // namespace
+
+int benchmarkPrimitives(QRhi *rhi, quint32 count, int iterations, QTextStream &out)
+{
+    QRandomGenerator random(1234);
+    std::vector<quint32> keys(count);
+    std::vector<float> floats(count);
+    std::vector<quint32> bytes(count);
+    for (quint32 i = 0; i < count; ++i) {
+        keys[i] = random.generate();
+        floats[i] = float(random.generateDouble() * 2.0 - 1.0);
+        bytes[i] = keys[i] & 0xffu;
+    }
+
+    std::vector<quint32> indices(count);
+    std::iota(indices.begin(), indices.end(), 0u);
+
+    Bench bench(rhi, iterations);
+    QVector<Measurement> measurements;
+
+    {
+        Measurement m { QStringLiteral("reduce sum uint") };
+        QRhiBuffer *input = bench.upload(keys);
+        QRhiBuffer *output = bench.buffer(4);
+        const auto prepare = [&](QRhiResourceUpdateBatch *updates) {
+            return bench.m_kernels.prepareReduce(rhi, updates, input, count, PrimitiveKernels::ValueType::UInt,
+                                                 PrimitiveKernels::Operation::Sum, output);
+        };
+        quint32 expected = 0;
+        m.cpuMilliseconds = cpuTime([&]() { expected = std::accumulate(keys.begin(), keys.end(), 0u); });
+        m.correct = bench.run(prepare) && bench.readBack<quint32>(output, 1).front() == expected;
+        m.gpuMilliseconds = bench.time(prepare);
+        measurements << m;
+    }
+
+    {
+        Measurement m { QStringLiteral("reduce max float") };
+        QRhiBuffer *input = bench.upload(floats);
+        QRhiBuffer *output = bench.buffer(4);
+        const auto prepare = [&](QRhiResourceUpdateBatch *updates) {
+            return bench.m_kernels.prepareReduce(rhi, updates, input, count, PrimitiveKernels::ValueType::Float,
+                                                 PrimitiveKernels::Operation::Max, output);
+        };
+        float expected = 0.0f;
+        m.cpuMilliseconds = cpuTime([&]() { expected = *std::max_element(floats.begin(), floats.end()); });
+        m.correct = bench.run(prepare) && bench.readBack<float>(output, 1).front() == expected;
+        m.gpuMilliseconds = bench.time(prepare);
+        measurements << m;
+    }
+
+    {
+        Measurement m { QStringLiteral("exclusive prefix sum uint") };
+        QRhiBuffer *input = bench.upload(keys);
+        QRhiBuffer *output = bench.buffer(count * 4);
+        const auto prepare = [&](QRhiResourceUpdateBatch *updates) {
+            return bench.m_kernels.prepareScan(rhi, updates, input, count, PrimitiveKernels::ValueType::UInt, false, output);
+        };
+        std::vector<quint32> expected(count);
+        m.cpuMilliseconds = cpuTime([&]() { std::exclusive_scan(keys.begin(), keys.end(), expected.begin(), 0u); });
+        m.correct = bench.run(prepare) && bench.readBack<quint32>(output, count) == expected;
+        m.gpuMilliseconds = bench.time(prepare);
+        measurements << m;
+    }
+
+    {
+        Measurement m { QStringLiteral("radix sort key-value") };
+        QRhiBuffer *sortKeys = bench.upload(keys);
+        QRhiBuffer *sortValues = bench.upload(indices);
+        const auto prepare = [&](QRhiResourceUpdateBatch *updates) {
+            return bench.m_kernels.prepareSort(rhi, updates, sortKeys, sortValues, count);
+        };
+
+        std::vector<std::pair<quint32, quint32>> expected(count);
+        for (quint32 i = 0; i < count; ++i) {
+            expected[i] = { keys[i], i };
+        }
+        m.cpuMilliseconds = cpuTime([&]() {
+            std::stable_sort(expected.begin(), expected.end(), [](const auto &a, const auto &b) { return a.first < b.first; });
+        });
+
+        // the first run sorts the random keys, the timed runs sort the sorted keys again
+        m.correct = bench.run(prepare);
+        const auto sortedKeys = bench.readBack<quint32>(sortKeys, count);
+        const auto sortedValues = bench.readBack<quint32>(sortValues, count);
+        for (quint32 i = 0; m.correct && i < count; ++i) {
+            m.correct = sortedKeys[i] == expected[i].first && sortedValues[i] == expected[i].second;
+        }
+        m.gpuMilliseconds = bench.time(prepare);
+        measurements << m;
+    }
+
+    {
+        constexpr int bins = 256;
+        Measurement m { QStringLiteral("histogram 256 bins") };
+        QRhiBuffer *input = bench.upload(bytes);
+        QRhiBuffer *output = bench.buffer(bins * 4);
+        const auto prepare = [&](QRhiResourceUpdateBatch *updates) {
+            return bench.m_kernels.prepareHistogram(rhi, updates, input, count, PrimitiveKernels::ValueType::UInt,
+                                                    0.0f, float(bins), bins, output);
+        };
+        std::vector<quint32> expected(bins, 0);
+        m.cpuMilliseconds = cpuTime([&]() {
+            for (const auto value : bytes) {
+                expected[value]++;
+            }
+        });
+        m.correct = bench.run(prepare) && bench.readBack<quint32>(output, bins) == expected;
+        m.gpuMilliseconds = bench.time(prepare);
+        measurements << m;
+    }
+
+    int failures = 0;
+    out << Qt::left << qSetFieldWidth(28) << "Primitive" << qSetFieldWidth(12) << "GPU ms" << "CPU ms"
+        << "GPU GVal/s" << "CPU GVal/s" << qSetFieldWidth(0) << "Result" << Qt::endl;
+    for (const auto &m : std::as_const(measurements)) {
+        const auto throughput = [count](double milliseconds) {
+            return milliseconds > 0.0 ? double(count) / (milliseconds * 1e6) : 0.0;
+        };
+        out << qSetFieldWidth(28) << m.name << qSetFieldWidth(12)
+            << QString::number(m.gpuMilliseconds, 'f', 3) << QString::number(m.cpuMilliseconds, 'f', 3)
+            << QString::number(throughput(m.gpuMilliseconds), 'f', 2) << QString::number(throughput(m.cpuMilliseconds), 'f', 2)
+            << qSetFieldWidth(0) << (m.correct ? "ok" : "MISMATCH") << Qt::endl;
+        if (!m.correct) {
+            failures++;
+        }
+    }
+    return failures;
+}
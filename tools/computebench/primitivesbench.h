@@ -0,0 +1,18 @@
+// SPDX-FileCopyrightText: 2024 basysKom GmbH
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#pragma once
+
+#include <QTextStream>
+
+#if QT_VERSION >= QT_VERSION_CHECK(6, 6, 0)
+  #include <rhi/qrhi.h>
+#else
+  #include <private/qrhi_p.h>
+#endif
+
+// Runs every parallel primitive on count random values, checks the results against a
+// std:: implementation on the CPU and prints the throughput of both. Returns the number
+// of primitives whose result did not match.
+int benchmarkPrimitives(QRhi *rhi, quint32 count, int iterations, QTextStream &out);
@@ -0,0 +1,136 @@
+// SPDX-FileCopyrightText: 2024 basysKom GmbH
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#include "uniformsbench.h"
+
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QMetaMethod>
+#include <QMetaProperty>
+#include <QObject>
+
+#include "uniformpropertybinding.h"
+
+#include <cstring>
+
+namespace {
+
+// a uniform property of a ComputeItem
+class UniformSource : public QObject
+{
+    Q_OBJECT
+    Q_PROPERTY(double feed READ feed WRITE setFeed NOTIFY feedChanged)
+
+public:
+    double feed() const { return m_feed; }
+    void setFeed(double feed)
+    {
+        if (feed != m_feed) {
+            m_feed = feed;
+            emit feedChanged();
+        }
+    }
+
+signals:
+    void feedChanged();
+
+private:
+    double m_feed { 0.0 };
+};
+
+// the packed uniform block; one slot per path
+class UniformBlock : public QObject
+{
+    Q_OBJECT
+
+public:
+    UniformBlock(UniformSource *source, int propertyIndex)
+        : m_source(source)
+        , m_propertyIndex(propertyIndex)
+    {
+    }
+
+    float value() const
+    {
+        float value;
+        memcpy(&value, m_data.constData(), sizeof(float));
+        return value;
+    }
+
+public slots:
+    // the name of the property is looked up from the notify signal and read into a QVariant
+    void updateByName()
+    {
+        static const QByteArray changeSignalPostfix = QByteArrayLiteral("Changed");
+        QObject *senderObj = sender();
+        const QMetaMethod metaMethod = senderObj->metaObject()->method(senderSignalIndex());
+        const QByteArray propName = metaMethod.name().chopped(changeSignalPostfix.size());
+        const QVariant value = senderObj->property(propName);
+        if (value.isValid() && value.canConvert<float>()) {
+            const float fvalue = value.toFloat();
+            memcpy(m_data.data(), &fvalue, sizeof(float));
+        }
+    }
+
+    // the property is resolved once, see UniformPropertyBinding::update()
+    void updateTyped()
+    {
+        const float fvalue = float(UniformPropertyBinding::readProperty<double>(m_source, m_propertyIndex));
+        memcpy(m_data.data(), &fvalue, sizeof(float));
+    }
+
+private:
+    UniformSource *m_source;
+    int m_propertyIndex;
+    QByteArray m_data { sizeof(float), 0 };
+};
+
+struct Run {
+    double nanoseconds { 0.0 };
+    float result { 0.0f };
+};
+
+Run run(int count, void (UniformBlock::*update)())
+{
+    UniformSource source;
+    const QMetaProperty property = source.metaObject()->property(source.metaObject()->indexOfProperty("feed"));
+    UniformBlock block(&source, property.propertyIndex());
+    QObject::connect(&source, &UniformSource::feedChanged, &block, update);
+
+    // warm up the connection and the caches
+    for (int i = 0; i < 1000; ++i) {
+        source.setFeed(-1.0 - i);
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+    for (int i = 0; i < count; ++i) {
+        source.setFeed(i * 0.001);
+    }
+    Run result;
+    result.nanoseconds = double(timer.nsecsElapsed()) / count;
+    result.result = block.value();
+    return result;
+}
+
+} // namespace
+
+int benchmarkUniforms(int count, QTextStream &out)
+{
+    const Run before = run(count, &UniformBlock::updateByName);
+    const Run after = run(count, &UniformBlock::updateTyped);
+    const bool correct = before.result == after.result;
+
+    out << count << " changes of a real uniform property" << Qt::endl;
+    out << QStringLiteral("%1 %2 %3").arg(QStringLiteral("path"), 20).arg(QStringLiteral("ns/change"), 10)
+               .arg(QStringLiteral("speedup"), 8) << Qt::endl;
+    out << QStringLiteral("%1 %2 %3").arg(QStringLiteral("QObject::property()"), 20).arg(before.nanoseconds, 10, 'f', 1)
+               .arg(1.0, 8, 'f', 2) << Qt::endl;
+    out << QStringLiteral("%1 %2 %3").arg(QStringLiteral("binding"), 20).arg(after.nanoseconds, 10, 'f', 1)
+               .arg(before.nanoseconds / after.nanoseconds, 8, 'f', 2) << Qt::endl;
+    out << "result: " << (correct ? "ok" : "WRONG") << Qt::endl;
+    return correct ? 0 : 1;
+}
+
+#include "uniformsbench.moc"
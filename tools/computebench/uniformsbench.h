@@ -0,0 +1,13 @@
+// SPDX-FileCopyrightText: 2024 basysKom GmbH
+//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+
+#pragma once
+
+#include <QTextStream>
+
+// Changes a real property count times and writes it into a uniform slot on every change, once
+// through QObject::property() as ComputeItem did before UniformPropertyBinding, and once with
+// the typed read of UniformPropertyBinding. Prints the time per change of both. Returns 1 if
+// the two paths wrote different values.
+int benchmarkUniforms(int count, QTextStream &out);